@@ -165,6 +165,12 @@ CONFIG(libarchive):equals(TEMPLATE, app) {
         unix:LIBS += -llzma
         win32:LIBS += -lliblzma
     }
+    !isEmpty(IFW_ZSTD_LIBRARY) {
+        LIBS += $$IFW_ZSTD_LIBRARY
+    } else {
+        unix:LIBS += -lzstd
+        win32:LIBS += -llibzstd
+    }
     macos {
         !isEmpty(IFW_ICONV_LIBRARY) {
             LIBS += $$IFW_ICONV_LIBRARY
@@ -50,6 +50,7 @@ __FBSDID("$FreeBSD$");
 
 struct private_data {
 	int		 compression_level;
+	int		 threads;
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	ZSTD_CStream	*cstream;
 	int64_t		 total_in;
@@ -68,6 +69,7 @@ struct private_data {
 
 #define MINVER_NEGCLEVEL 10304
 #define MINVER_MINCLEVEL 10306
+#define MINVER_NBWORKERS 10400
 
 static int archive_compressor_zstd_options(struct archive_write_filter *,
 		    const char *, const char *);
@@ -204,6 +206,16 @@ archive_compressor_zstd_options(struct archive_write_filter *f, const char *key,
 		}
 		data->compression_level = level;
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "threads") == 0) {
+		int threads = atoi(value);
+		if (string_is_numeric(value) != ARCHIVE_OK) {
+			return (ARCHIVE_WARN);
+		}
+		if (threads < 0) {
+			return (ARCHIVE_WARN);
+		}
+		data->threads = threads;
+		return (ARCHIVE_OK);
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -252,6 +264,14 @@ archive_compressor_zstd_open(struct archive_write_filter *f)
 		return (ARCHIVE_FATAL);
 	}
 
+#if ZSTD_VERSION_NUMBER >= MINVER_NBWORKERS
+	/* Multithreaded compression is best effort: libzstd built without
+	 * ZSTD_MULTITHREAD rejects the parameter and compresses serially. */
+	if (data->threads != 0)
+		ZSTD_CCtx_setParameter(data->cstream, ZSTD_c_nbWorkers,
+		    data->threads);
+#endif
+
 	return (ARCHIVE_OK);
 }
 
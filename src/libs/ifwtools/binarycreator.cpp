@@ -41,6 +41,7 @@
 
 #include <QDateTime>
 #include <QDirIterator>
+#include <QElapsedTimer>
 #include <QDomDocument>
 #include <QProcess>
 #include <QRegExp>
@@ -371,14 +372,18 @@ static int assemble(Input input, const QInstaller::Settings &settings, const QSt
     }
 #endif
 
-    QFile out(generateTemporaryFileName());
-
     QString targetName = input.outputPath;
 #ifdef Q_OS_MACOS
     QDir resourcePath(QFileInfo(input.outputPath).dir());
     resourcePath.cdUp();
     resourcePath.cd(QLatin1String("Resources"));
     targetName = resourcePath.filePath(QLatin1String("installer.dat"));
+
+    // Create the file next to the target, so that renaming it does not copy the data again.
+    QFile out(generateTemporaryFileName(targetName));
+#else
+    // The data gets appended to the copy of the installer base, which is next to the target.
+    QFile out(tempFile);
 #endif
 
     {
@@ -391,18 +396,24 @@ static int assemble(Input input, const QInstaller::Settings &settings, const QSt
         }
     }
 
+    QElapsedTimer timer;
+    timer.start();
+    qint64 dataBegin = 0;
     try {
+#ifdef Q_OS_MACOS
         QInstaller::openForWrite(&out);
         QFile exe(input.installerExePath);
-
-#ifdef Q_OS_MACOS
         if (!exe.copy(input.outputPath)) {
             throw Error(QString::fromLatin1("Cannot copy %1 to %2: %3").arg(exe.fileName(),
                 input.outputPath, exe.errorString()));
         }
 #else
-        QInstaller::openForRead(&exe);
-        QInstaller::appendData(&out, &exe, exe.size());
+        // Not opened for appending, as the kernel cannot copy into files opened that way.
+        if (!out.open(QIODevice::ReadWrite) || !out.seek(out.size())) {
+            throw Error(QString::fromLatin1("Cannot open file \"%1\" for writing: %2").arg(
+                QDir::toNativeSeparators(out.fileName()), out.errorString()));
+        }
+        dataBegin = out.pos();
 #endif
 
         foreach (const QInstallerTools::PackageInfo &info, input.packages) {
@@ -421,8 +432,15 @@ static int assemble(Input input, const QInstaller::Settings &settings, const QSt
         const QList<QInstaller::OperationBlob> operations;
         BinaryContent::writeBinaryContent(&out, operations, input.manager,
             BinaryContent::MagicInstallerMarker, BinaryContent::MagicCookie);
+
+        const qint64 written = out.pos() - dataBegin;
+        const qint64 elapsed = qMax(qint64(1), timer.elapsed());
+        qDebug().noquote() << "Wrote" << humanReadableSize(written) << "of installer data in"
+            << QString::number(elapsed / 1000.0, 'f', 1) << "seconds,"
+            << humanReadableSize(written * 1000 / elapsed) << "per second.";
     } catch (const Error &e) {
         qCritical("Error occurred while assembling the installer: %s", qPrintable(e.message()));
+        out.remove();
         QFile::remove(tempFile);
         return EXIT_FAILURE;
     }
@@ -430,6 +448,7 @@ static int assemble(Input input, const QInstaller::Settings &settings, const QSt
     if (!out.rename(targetName)) {
         qCritical("Cannot write installer to %s: %s", targetName.toUtf8().constData(),
             out.errorString().toUtf8().constData());
+        out.remove();
         QFile::remove(tempFile);
         return EXIT_FAILURE;
     }
@@ -767,9 +786,17 @@ int QInstallerTools::createBinary(BinaryCreatorArgs args, QString &argumentError
     QTemporaryDir tmp;
     tmp.setAutoRemove(false);
     const QString tmpMetaDir = tmp.path();
-    QTemporaryDir tmp2;
-    tmp2.setAutoRemove(false);
-    const QString tmpRepoDir = tmp2.path();
+    // Keep the repository next to the installer, so that prebuilt archives can be cloned into
+    // it and appended to the installer without copying the data on supporting file systems.
+    QScopedPointer<QTemporaryDir> tmp2;
+    if (!args.target.isEmpty()) {
+        tmp2.reset(new QTemporaryDir(QFileInfo(args.target).absolutePath()
+            + QLatin1String("/.binarycreator-XXXXXX")));
+    }
+    if (!tmp2 || !tmp2->isValid())
+        tmp2.reset(new QTemporaryDir);
+    tmp2->setAutoRemove(false);
+    const QString tmpRepoDir = tmp2->path();
     try {
         const Settings settings = Settings::fromFileAndPrefix(args.configFile, QFileInfo(args.configFile)
             .absolutePath());
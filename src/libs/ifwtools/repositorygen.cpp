@@ -34,8 +34,12 @@
 #include "errors.h"
 #include "globals.h"
 #include "archivefactory.h"
+#include "archivechunks.h"
+#include "archivepatch.h"
+#include "lib7zarchive.h"
 #include "settings.h"
 #include "qinstallerglobal.h"
+#include "repositoryindex.h"
 #include "utils.h"
 #include "scriptengine.h"
 
@@ -43,10 +47,17 @@
 
 #include <QtCore/QDirIterator>
 #include <QtCore/QRegExp>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <QtXml/QDomDocument>
+#include <QSaveFile>
 #include <QTemporaryDir>
+#include <QTextStream>
 
+#include <algorithm>
 #include <iostream>
 
 #define QUOTE_(x) #x
@@ -55,6 +66,10 @@
 using namespace QInstaller;
 using namespace QInstallerTools;
 
+// package.xml elements that only configure the packaging, they are not copied to Updates.xml
+static const QLatin1String scArchiveDictionarySize("ArchiveDictionarySize");
+static const QLatin1String scArchiveSolidBlockSize("ArchiveSolidBlockSize");
+
 void QInstallerTools::printRepositoryGenOptions()
 {
     std::cout << "  -p|--packages dir         The directory containing the available packages." << std::endl;
@@ -128,6 +143,44 @@ static QStringList copyFilesFromNode(const QString &parentNode, const QString &c
     return copiedFiles;
 }
 
+// Indexes the PackageUpdate elements below \a root by component name, in a single pass.
+static QMultiHash<QString, QDomElement> packageUpdatesByName(const QDomElement &root)
+{
+    QMultiHash<QString, QDomElement> updates;
+    for (QDomElement update = root.firstChildElement(QLatin1String("PackageUpdate")); !update.isNull();
+            update = update.nextSiblingElement(QLatin1String("PackageUpdate"))) {
+        updates.insert(update.firstChildElement(scName).text(), update);
+    }
+    return updates;
+}
+
+// Reads the size given by the element \a tagName of \a package into \a size, which is not
+// modified if the element is missing. Returns \c false if the size is invalid.
+static bool readArchiveSize(const QDomElement &package, const QString &tagName, quint64 *size)
+{
+    const QDomElement element = package.firstChildElement(tagName);
+    if (element.isNull())
+        return true;
+    bool ok = false;
+    *size = sizeFromString(element.text(), &ok);
+    return ok;
+}
+
+// Serializes \a doc straight into \a file, without creating a copy of the whole document in memory.
+static void writeXmlDocument(const QDomDocument &doc, QFile *file)
+{
+    QInstaller::openForWrite(file);
+    QTextStream stream(file);
+    stream.setCodec("UTF-8");
+    doc.save(stream, 1);
+    stream.flush();
+    if (stream.status() != QTextStream::Ok) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot write file \"%1\": %2").arg(
+            QDir::toNativeSeparators(file->fileName()), file->errorString()));
+    }
+    file->close();
+}
+
 void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &metaDataDir,
     const PackageInfoVector &packages, const QString &appName, const QString &appVersion,
     const QStringList &uniteMetadatas)
@@ -141,17 +194,11 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
     QFile existingUpdatesXml(QFileInfo(metaDataDir, QLatin1String("Updates.xml")).absoluteFilePath());
     if (existingUpdatesXml.open(QIODevice::ReadOnly) && doc.setContent(&existingUpdatesXml)) {
         root = doc.documentElement();
-        // remove entry for this component from existing Updates.xml, if found
+        // remove entries for these components from existing Updates.xml, if found
+        const QMultiHash<QString, QDomElement> existingUpdates = packageUpdatesByName(root);
         foreach (const PackageInfo &info, packages) {
-            const QDomNodeList packageNodes = root.childNodes();
-            for (int i = packageNodes.count() - 1; i >= 0; --i) {
-                const QDomNode node = packageNodes.at(i);
-                if (node.nodeName() != QLatin1String("PackageUpdate"))
-                    continue;
-                if (node.firstChildElement(QLatin1String("Name")).text() != info.name)
-                    continue;
-                root.removeChild(node);
-            }
+            foreach (const QDomElement &update, existingUpdates.values(info.name))
+                root.removeChild(update);
         }
         existingUpdatesXml.close();
     } else {
@@ -191,7 +238,8 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
             // list of current unused or later transformed tags
             QStringList blackList;
             blackList << QLatin1String("UserInterfaces") << QLatin1String("Translations") <<
-                         QLatin1String("Licenses") << QLatin1String("Name") << QLatin1String("Operations");
+                         QLatin1String("Licenses") << QLatin1String("Name") << QLatin1String("Operations")
+                      << scArchiveDictionarySize << scArchiveSolidBlockSize;
 
             bool foundDefault = false;
             bool foundVirtual = false;
@@ -245,6 +293,8 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
             // get the size of the data
             quint64 componentSize = 0;
             quint64 compressedComponentSize = 0;
+            QStringList archiveEntries;
+            QStringList archiveRoots;
 
             const QDir::Filters filters = QDir::Files | QDir::NoDotAndDotDot;
             const QDir dataDir = QString::fromLatin1("%1/%2/data").arg(metaDataDir, info.name);
@@ -252,6 +302,10 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
                                                            : QDir(QString::fromLatin1("%1/%2").arg(metaDataDir, info.name)).entryInfoList(filters);
             qDebug() << "calculate size of directory" << dataDir.absolutePath();
             foreach (const QFileInfo &fi, entries) {
+                // patches are downloaded instead of the archives, not in addition to them
+                if (fi.fileName().contains(archivePatchFileName(QString())))
+                    continue;
+
                 try {
                     QScopedPointer<AbstractArchive> archive(ArchiveFactory::instance().create(fi.filePath()));
                     if (fi.isDir()) {
@@ -266,10 +320,31 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
                         // if it's an archive already, list its files and sum the uncompressed sizes
                         compressedComponentSize += fi.size();
 
+                        quint64 archiveSize = 0;
                         QVector<ArchiveEntry>::const_iterator fileIt;
                         const QVector<ArchiveEntry> files = archive->list();
                         for (fileIt = files.begin(); fileIt != files.end(); ++fileIt)
-                            componentSize += fileIt->uncompressedSize;
+                            archiveSize += fileIt->uncompressedSize;
+                        componentSize += archiveSize;
+
+                        // remember the number of entries, so the installer does not need to
+                        // scan the archive again before extracting it
+                        if (fi.fileName().startsWith(info.version)) {
+                            const QString archiveName = fi.fileName().mid(info.version.count());
+                            archiveEntries.append(QString::fromLatin1("%1:%2:%3").arg(archiveName)
+                                .arg(files.count()).arg(archiveSize));
+
+                            // and its top level entries, so it can tell whether archives
+                            // extracted to the same directory can overwrite each other
+                            QSet<QString> roots;
+                            for (fileIt = files.begin(); fileIt != files.end(); ++fileIt)
+                                roots.insert(fileIt->path.section(QLatin1Char('/'), 0, 0, QString::SectionSkipEmpty));
+                            roots.remove(QString());
+                            QStringList sortedRoots = roots.values();
+                            std::sort(sortedRoots.begin(), sortedRoots.end());
+                            foreach (const QString &root, sortedRoots)
+                                archiveRoots.append(archiveName + QLatin1Char('/') + root);
+                        }
                     } else {
                         // otherwise just add its size
                         const quint64 size = QInstaller::fileSize(fi);
@@ -290,11 +365,38 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
             fileElement.setAttribute(QLatin1String("OS"), QLatin1String("Any"));
             update.appendChild(fileElement);
 
+            if (!archiveEntries.isEmpty()) {
+                update.appendChild(doc.createElement(QLatin1String("ArchiveEntries"))).appendChild(doc
+                    .createTextNode(archiveEntries.join(QChar::fromLatin1(','))));
+            }
+
+            if (!archiveRoots.isEmpty()) {
+                update.appendChild(doc.createElement(QLatin1String("ArchiveRoots"))).appendChild(doc
+                    .createTextNode(archiveRoots.join(QChar::fromLatin1('\n'))));
+            }
+
+            if (!info.entryHashes.isEmpty()) {
+                update.appendChild(doc.createElement(QLatin1String("EntryHashes"))).appendChild(doc
+                    .createTextNode(info.entryHashes.join(QChar::fromLatin1('\n'))));
+            }
+
             if (info.createContentSha1Node) {
                 QDomNode contentSha1Element = update.appendChild(doc.createElement(QLatin1String("ContentSha1")));
                 contentSha1Element.appendChild(doc.createTextNode(info.contentSha1));
             }
 
+            if (info.chunkedArchives) {
+                update.appendChild(doc.createElement(scChunkedArchives)).appendChild(doc
+                    .createTextNode(scTrue));
+            }
+
+            if (!info.patchArchives.isEmpty()) {
+                update.appendChild(doc.createElement(scPatchBaseVersion)).appendChild(doc
+                    .createTextNode(info.patchBaseVersion));
+                update.appendChild(doc.createElement(scPatchArchives)).appendChild(doc
+                    .createTextNode(info.patchArchives.join(QChar::fromLatin1(','))));
+            }
+
             root.appendChild(update);
 
             // copy script file
@@ -406,7 +508,21 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
                 throw QInstaller::Error(QString::fromLatin1("Cannot restore \"PackageUpdate\" description for node %1").arg(info.name));
             }
 
-            root.appendChild(update.documentElement());
+            QDomElement restored = update.documentElement();
+            if (info.chunkedArchives && restored.firstChildElement(scChunkedArchives).isNull()) {
+                restored.appendChild(update.createElement(scChunkedArchives)).appendChild(update
+                    .createTextNode(scTrue));
+            }
+            // the patches of the source repository are not copied, only the ones created now
+            restored.removeChild(restored.firstChildElement(scPatchBaseVersion));
+            restored.removeChild(restored.firstChildElement(scPatchArchives));
+            if (!info.patchArchives.isEmpty()) {
+                restored.appendChild(update.createElement(scPatchBaseVersion)).appendChild(update
+                    .createTextNode(info.patchBaseVersion));
+                restored.appendChild(update.createElement(scPatchArchives)).appendChild(update
+                    .createTextNode(info.patchArchives.join(QChar::fromLatin1(','))));
+            }
+            root.appendChild(restored);
         }
     }
 
@@ -428,8 +544,7 @@ void QInstallerTools::copyMetaData(const QString &_targetDir, const QString &met
     doc.appendChild(root);
 
     QFile targetUpdatesXml(targetDir + QLatin1String("/Updates.xml"));
-    QInstaller::openForWrite(&targetUpdatesXml);
-    QInstaller::blockingWrite(&targetUpdatesXml, doc.toByteArray());
+    writeXmlDocument(doc, &targetUpdatesXml);
 }
 
 PackageInfoVector QInstallerTools::createListOfPackages(const QStringList &packagesDirectories,
@@ -526,6 +641,14 @@ PackageInfoVector QInstallerTools::createListOfPackages(const QStringList &packa
         }
         info.dependencies = packageElement.firstChildElement(QLatin1String("Dependencies")).text()
             .split(QInstaller::commaRegExp(), QString::SkipEmptyParts);
+        if (!readArchiveSize(packageElement, scArchiveDictionarySize, &info.dictionarySize)
+                || !readArchiveSize(packageElement, scArchiveSolidBlockSize, &info.solidBlockSize)) {
+            if (ignoreInvalidPackages)
+                continue;
+            throw QInstaller::Error(QString::fromLatin1("Archive compression settings for \"%1\" are invalid! "
+                "Supported format: number of bytes, optionally followed by k, m or g")
+                .arg(QDir::toNativeSeparators(fileInfo.absoluteFilePath())));
+        }
         info.directory = it->filePath();
         if (packagesUpdatedWithSha.contains(info.name)) {
             info.createContentSha1Node = true;
@@ -723,43 +846,41 @@ QHash<QString, QString> QInstallerTools::buildPathToVersionMapping(const Package
     return map;
 }
 
-static void writeSHA1ToNodeWithName(QDomDocument &doc, QDomNodeList &list, const QByteArray &sha1sum,
-    const QString &nodename = QString())
+static void writeSHA1ToNodeWithName(QDomDocument &doc, const QList<QDomElement> &list,
+    const QByteArray &sha1sum, const QString &nodename = QString())
 {
     if (nodename.isEmpty())
         qDebug() << "Writing sha1sum node.";
     else
         qDebug() << "Searching sha1sum node for" << nodename;
     QString sha1Value = QString::fromLatin1(sha1sum.toHex().constData());
-    for (int i = 0; i < list.size(); ++i) {
-        QDomNode curNode = list.at(i);
-        QDomNode nameTag = curNode.firstChildElement(scName);
-        if ((!nameTag.isNull() && nameTag.toElement().text() == nodename) || nodename.isEmpty()) {
-            QDomNode sha1Node = curNode.firstChildElement(scSHA1);
-            QDomNode newSha1Node = doc.createElement(scSHA1);
-            newSha1Node.appendChild(doc.createTextNode(sha1Value));
-
-            if (!sha1Node.isNull() && sha1Node.hasChildNodes()) {
-                QDomNode sha1NodeChild = sha1Node.firstChild();
-                QString sha1OldValue = sha1NodeChild.nodeValue();
-                if (sha1Value == sha1OldValue) {
-                    qDebug() << "- keeping the existing sha1sum" << sha1OldValue;
-                    continue;
-                } else {
-                    qDebug() << "- clearing the old sha1sum" << sha1OldValue;
-                    sha1Node.removeChild(sha1NodeChild);
-                }
+    foreach (QDomElement curNode, list) {
+        QDomNode sha1Node = curNode.firstChildElement(scSHA1);
+        QDomNode newSha1Node = doc.createElement(scSHA1);
+        newSha1Node.appendChild(doc.createTextNode(sha1Value));
+
+        if (!sha1Node.isNull() && sha1Node.hasChildNodes()) {
+            QDomNode sha1NodeChild = sha1Node.firstChild();
+            QString sha1OldValue = sha1NodeChild.nodeValue();
+            if (sha1Value == sha1OldValue) {
+                qDebug() << "- keeping the existing sha1sum" << sha1OldValue;
+                continue;
+            } else {
+                qDebug() << "- clearing the old sha1sum" << sha1OldValue;
+                sha1Node.removeChild(sha1NodeChild);
             }
-            if (sha1Node.isNull())
-                curNode.appendChild(newSha1Node);
-            else
-                curNode.replaceChild(newSha1Node, sha1Node);
-            qDebug() << "- writing the sha1sum" << sha1Value;
         }
+        if (sha1Node.isNull())
+            curNode.appendChild(newSha1Node);
+        else
+            curNode.replaceChild(newSha1Node, sha1Node);
+        qDebug() << "- writing the sha1sum" << sha1Value;
     }
 }
 
-void QInstallerTools::createArchive(const QString &filename, const QStringList &data, Compression compression)
+QByteArray QInstallerTools::createArchive(const QString &filename, const QStringList &data,
+    Compression compression, int threadCount, bool solid, quint64 dictionarySize,
+    quint64 solidBlockSize)
 {
     QScopedPointer<AbstractArchive> targetArchive(ArchiveFactory::instance().create(filename));
     if (!targetArchive) {
@@ -767,10 +888,40 @@ void QInstallerTools::createArchive(const QString &filename, const QStringList &
             "object for archive \"%1\": \"%2\".").arg(filename, QLatin1String(Q_FUNC_INFO)));
     }
     targetArchive->setCompressionLevel(compression);
-    if (!(targetArchive->open(QIODevice::WriteOnly) && targetArchive->create(data))) {
+    targetArchive->setCompressionThreadCount(threadCount);
+    targetArchive->setDictionarySize(dictionarySize);
+    targetArchive->setSolidBlockSize(solidBlockSize);
+    // Only 7z archives can be written without solid compression, which compresses every
+    // file on its own. Lib7zArchive::update() creates them that way.
+    Lib7zArchive *const nonSolidArchive = solid ? nullptr
+        : qobject_cast<Lib7zArchive *>(targetArchive.data());
+    if (nonSolidArchive) {
+        if (QFile::exists(filename) && !QFile::remove(filename)) {
+            throw Error(QString::fromLatin1("Cannot remove file \"%1\".")
+                .arg(QDir::toNativeSeparators(filename)));
+        }
+        if (!nonSolidArchive->update(data, QStringList())) {
+            throw Error(QString::fromLatin1("Could not create archive \"%1\": %2").arg(
+                QDir::toNativeSeparators(filename), targetArchive->errorString()));
+        }
+    } else if (!(targetArchive->open(QIODevice::WriteOnly) && targetArchive->create(data))) {
         throw Error(QString::fromLatin1("Could not create archive \"%1\": %2").arg(
             QDir::toNativeSeparators(filename), targetArchive->errorString()));
     }
+    return targetArchive->archiveHash();
+}
+
+// Returns the SHA-1 checksum of the archive file, unless it is already known from writing it.
+static QByteArray archiveHash(QFile *archive, const QByteArray &writtenHash)
+{
+    if (!writtenHash.isEmpty()) {
+        qDebug() << "Using hash of archive" << archive->fileName() << "calculated while writing it";
+        return writtenHash;
+    }
+    qDebug() << "Creating hash of archive" << archive->fileName();
+    if (!archive->isOpen())
+        QInstaller::openForRead(archive);
+    return QInstaller::calculateHash(archive, QCryptographicHash::Sha1);
 }
 
 void QInstallerTools::compressMetaDirectories(const QString &repoDir, const QString &existingUnite7zUrl,
@@ -800,9 +951,7 @@ void QInstallerTools::compressMetaDirectories(const QString &repoDir, const QStr
             QInstaller::removeFiles(path, true);
     }
 
-    QInstaller::openForWrite(&existingUpdatesXml);
-    QInstaller::blockingWrite(&existingUpdatesXml, doc.toByteArray());
-    existingUpdatesXml.close();
+    writeXmlDocument(doc, &existingUpdatesXml);
 }
 
 QStringList QInstallerTools::unifyMetadata(const QString &repoDir, const QString &existingRepoDir, QDomDocument doc)
@@ -818,44 +967,34 @@ QStringList QInstallerTools::unifyMetadata(const QString &repoDir, const QString
         dir.cdUp();
     }
 
-    QTemporaryDir existingRepoTempDir;
-    QString existingRepoTemp = existingRepoTempDir.path();
-    if (!existingRepoDir.isEmpty()) {
-        existingRepoTempDir.setAutoRemove(false);
-        QScopedPointer<AbstractArchive> archiveFile(ArchiveFactory::instance().create(existingRepoDir));
-        if (!archiveFile) {
-            throw QInstaller::Error(QString::fromLatin1("Could not create handler "
-                "object for archive \"%1\": \"%2\".").arg(existingRepoDir, QLatin1String(Q_FUNC_INFO)));
-        }
-        if (!(archiveFile->open(QIODevice::ReadOnly) && archiveFile->extract(existingRepoTemp))) {
-            throw Error(QString::fromLatin1("Could not extract archive \"%1\": %2").arg(
-                QDir::toNativeSeparators(existingRepoDir), archiveFile->errorString()));
-        }
-        QDir dir2(existingRepoTemp);
-        QStringList existingRepoEntries = dir2.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-        foreach (const QString existingRepoEntry, existingRepoEntries) {
-            if (entryList.contains(existingRepoEntry)) {
-                continue;
-            } else {
-                dir2.cd(existingRepoEntry);
-                const QString absPath = dir2.absolutePath();
-                absPaths.append(absPath);
-                dir2.cdUp();
-            }
-        }
-    }
-
-    // Compress all metadata from repository to one single 7z
+    // Compress all metadata from repository to one single 7z. An existing archive is updated
+    // in place: only the entries of the components in the repository directory get replaced,
+    // the entries of all other components are kept without compressing them again.
     const QString metadataFilename = QDateTime::currentDateTime().
             toString(QLatin1String("yyyy-MM-dd-hhmm")) + QLatin1String("_meta.7z");
     const QString tmpTarget = repoDir + QDir::separator() + metadataFilename;
-    createArchive(tmpTarget, absPaths);
+    if (!existingRepoDir.isEmpty()) {
+        QFile existingMetadata(existingRepoDir);
+        if (!existingMetadata.copy(tmpTarget)) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot copy file \"%1\" to \"%2\": %3").arg(
+                QDir::toNativeSeparators(existingRepoDir), QDir::toNativeSeparators(tmpTarget),
+                existingMetadata.errorString()));
+        }
+    }
+    Lib7zArchive metadataArchive(tmpTarget);
+    if (!metadataArchive.update(absPaths, entryList)) {
+        throw Error(QString::fromLatin1("Could not update archive \"%1\": %2").arg(
+            QDir::toNativeSeparators(tmpTarget), metadataArchive.errorString()));
+    }
 
     QFile tmp(tmpTarget);
     tmp.open(QFile::ReadOnly);
-    const QByteArray sha1Sum = QInstaller::calculateHash(&tmp, QCryptographicHash::Sha1);
+    const QByteArray sha1Sum = archiveHash(&tmp, metadataArchive.archiveHash());
     QDomNodeList elements =  doc.elementsByTagName(QLatin1String("Updates"));
-    writeSHA1ToNodeWithName(doc, elements, sha1Sum, QString());
+    QList<QDomElement> updatesElements;
+    for (int i = 0; i < elements.count(); ++i)
+        updatesElements.append(elements.at(i).toElement());
+    writeSHA1ToNodeWithName(doc, updatesElements, sha1Sum, QString());
 
     qDebug() << "Updating the metadata node with name " << metadataFilename;
     if (elements.count() > 0) {
@@ -870,15 +1009,13 @@ QStringList QInstallerTools::unifyMetadata(const QString &repoDir, const QString
         else
             node.replaceChild(newNodeTag, nameTag);
     }
-    QInstaller::removeDirectory(existingRepoTemp, true);
     return absPaths;
 }
 
 void QInstallerTools::splitMetadata(const QStringList &entryList, const QString &repoDir,
                                     QDomDocument doc, const QHash<QString, QString> &versionMapping)
 {
-    QStringList absPaths;
-    QDomNodeList elements =  doc.elementsByTagName(QLatin1String("PackageUpdate"));
+    const QMultiHash<QString, QDomElement> elements = packageUpdatesByName(doc.documentElement());
     QDir dir(repoDir);
     foreach (const QString &i, entryList) {
         dir.cd(i);
@@ -890,14 +1027,14 @@ void QInstallerTools::splitMetadata(const QStringList &entryList, const QString
         const QString fn = QLatin1String(versionPrefix.toLatin1() + "meta.7z");
         const QString tmpTarget = repoDir + QLatin1String("/") + fn;
 
-        createArchive(tmpTarget, QStringList() << absPath);
+        const QByteArray writtenHash = createArchive(tmpTarget, QStringList() << absPath);
 
         // remove the files that got compressed
         QInstaller::removeFiles(absPath, true);
         QFile tmp(tmpTarget);
         tmp.open(QFile::ReadOnly);
-        const QByteArray sha1Sum = QInstaller::calculateHash(&tmp, QCryptographicHash::Sha1);
-        writeSHA1ToNodeWithName(doc, elements, sha1Sum, path);
+        const QByteArray sha1Sum = archiveHash(&tmp, writtenHash);
+        writeSHA1ToNodeWithName(doc, elements.values(path), sha1Sum, path);
         const QString finalTarget = absPath + QLatin1String("/") + fn;
         if (!tmp.rename(finalTarget)) {
             throw QInstaller::Error(QString::fromLatin1("Cannot move file \"%1\" to \"%2\".").arg(
@@ -907,102 +1044,720 @@ void QInstallerTools::splitMetadata(const QStringList &entryList, const QString
     }
 }
 
-void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QString &repoDir,
-    PackageInfoVector *const infos, const QString &archiveSuffix, Compression compression)
+// Files smaller than this are not worth linking at install time.
+static const qint64 scMinimumEntryHashSize = 64 * 1024;
+
+// Appends "<sha1> <r|w> <archive>/<path>" lines for the larger regular files of source, which
+// is packaged into archiveName relative to baseDir. Read-only files are marked with 'r', the
+// installer may hard link those instead of cloning them.
+static void appendEntryHashes(QStringList *entryHashes, const QString &archiveName,
+    const QDir &baseDir, const QString &source)
 {
-    for (int i = 0; i < infos->count(); ++i) {
-        const PackageInfo info = infos->at(i);
-        const QString name = info.name;
-        qDebug() << "Copying component data for" << name;
-
-        const QString namedRepoDir = QString::fromLatin1("%1/%2").arg(repoDir, name);
-        if (!QDir().mkpath(namedRepoDir)) {
-            throw QInstaller::Error(QString::fromLatin1("Cannot create repository directory for component \"%1\".")
-                .arg(name));
+    QStringList files;
+    if (QFileInfo(source).isDir()) {
+        QDirIterator it(source, QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot,
+            QDirIterator::Subdirectories);
+        while (it.hasNext())
+            files.append(it.next());
+    } else {
+        files.append(source);
+    }
+
+    foreach (const QString &file, files) {
+        const QFileInfo fileInfo(file);
+        if (fileInfo.isSymLink() || !fileInfo.isFile() || fileInfo.size() < scMinimumEntryHashSize)
+            continue;
+        const QByteArray hash = QInstaller::calculateHash(file, QCryptographicHash::Sha1).toHex();
+        if (hash.isEmpty())
+            continue;
+        const QLatin1Char mode = fileInfo.permission(QFile::WriteOwner) ? QLatin1Char('w') : QLatin1Char('r');
+        entryHashes->append(QString::fromLatin1("%1 %2 %3/%4").arg(QLatin1String(hash)).arg(mode)
+            .arg(archiveName, baseDir.relativeFilePath(file)));
+    }
+}
+
+// Bump when the layout of the build cache or the way component data is packaged changes.
+static const int scBuildCacheVersion = 2;
+
+struct CachedFile
+{
+    qint64 size = -1;
+    qint64 modified = -1;
+    QByteArray sha1;
+};
+
+struct BuildCacheEntry
+{
+    QByteArray key;
+    QHash<QString, CachedFile> files;
+    QStringList outputs;
+    QStringList entryHashes;
+};
+
+static BuildCacheEntry readBuildCacheEntry(const QString &cacheDir)
+{
+    BuildCacheEntry entry;
+    QFile file(cacheDir + QLatin1String("/manifest.xml"));
+    QDomDocument doc;
+    if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file))
+        return entry;
+
+    const QDomElement root = doc.documentElement();
+    if (root.attribute(QLatin1String("version")).toInt() != scBuildCacheVersion)
+        return entry;
+
+    entry.key = root.firstChildElement(QLatin1String("Key")).text().toLatin1();
+    for (QDomElement el = root.firstChildElement(QLatin1String("File")); !el.isNull();
+            el = el.nextSiblingElement(QLatin1String("File"))) {
+        CachedFile cachedFile;
+        cachedFile.size = el.attribute(QLatin1String("size")).toLongLong();
+        cachedFile.modified = el.attribute(QLatin1String("modified")).toLongLong();
+        cachedFile.sha1 = QByteArray::fromHex(el.attribute(QLatin1String("sha1")).toLatin1());
+        entry.files.insert(el.attribute(QLatin1String("path")), cachedFile);
+    }
+    for (QDomElement el = root.firstChildElement(QLatin1String("Output")); !el.isNull();
+            el = el.nextSiblingElement(QLatin1String("Output"))) {
+        entry.outputs.append(el.text());
+    }
+    entry.entryHashes = root.firstChildElement(QLatin1String("EntryHashes")).text()
+        .split(QLatin1Char('\n'), QString::SkipEmptyParts);
+    return entry;
+}
+
+// Stores the given outputs of a component together with the manifest describing its inputs.
+// The outputs are stored without the version prefix, so that a new version of unchanged data
+// can reuse them. The manifest is written last, so an interrupted write never leaves a usable
+// entry behind.
+static void writeBuildCacheEntry(const QString &cacheDir, const BuildCacheEntry &entry,
+    const QStringList &outputs, const QString &version)
+{
+    QInstaller::removeDirectory(cacheDir, true);
+    if (!QDir().mkpath(cacheDir)) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot create build cache directory \"%1\".")
+            .arg(QDir::toNativeSeparators(cacheDir)));
+    }
+
+    QDomDocument doc;
+    QDomElement root = doc.createElement(QLatin1String("BuildCache"));
+    root.setAttribute(QLatin1String("version"), scBuildCacheVersion);
+    doc.appendChild(root);
+    root.appendChild(doc.createElement(QLatin1String("Key"))).appendChild(doc
+        .createTextNode(QLatin1String(entry.key)));
+
+    QStringList paths = entry.files.keys();
+    std::sort(paths.begin(), paths.end());
+    foreach (const QString &path, paths) {
+        const CachedFile cachedFile = entry.files.value(path);
+        QDomElement el = doc.createElement(QLatin1String("File"));
+        el.setAttribute(QLatin1String("path"), path);
+        el.setAttribute(QLatin1String("size"), cachedFile.size);
+        el.setAttribute(QLatin1String("modified"), cachedFile.modified);
+        el.setAttribute(QLatin1String("sha1"), QLatin1String(cachedFile.sha1.toHex()));
+        root.appendChild(el);
+    }
+
+    foreach (const QString &output, outputs) {
+        QString fileName = QFileInfo(output).fileName();
+        if (fileName.startsWith(version))
+            fileName = fileName.mid(version.length());
+        QFile source(output);
+        if (!source.copy(cacheDir + QLatin1Char('/') + fileName)) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot copy file \"%1\" to the build cache: %2")
+                .arg(QDir::toNativeSeparators(output), source.errorString()));
         }
+        root.appendChild(doc.createElement(QLatin1String("Output"))).appendChild(doc
+            .createTextNode(fileName));
+    }
 
-        if (info.copiedFiles.isEmpty()) {
-            QStringList compressedFiles;
-            QStringList filesToCompress;
-            foreach (const QString &packageDir, packageDirs) {
-                const QDir dataDir(QString::fromLatin1("%1/%2/data").arg(packageDir, name));
-                foreach (const QString &entry, dataDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Files)) {
-                    QFileInfo fileInfo(dataDir.absoluteFilePath(entry));
-                    if (fileInfo.isFile() && !fileInfo.isSymLink()) {
-                        const QString absoluteEntryFilePath = dataDir.absoluteFilePath(entry);
-                        QScopedPointer<AbstractArchive> archive(ArchiveFactory::instance()
-                            .create(absoluteEntryFilePath));
-                        if (archive && archive->open(QIODevice::ReadOnly) && archive->isSupported()) {
-                            QFile tmp(absoluteEntryFilePath);
-                            QString target = QString::fromLatin1("%1/%3%2").arg(namedRepoDir, entry, info.version);
-                            qDebug() << "Copying archive from" << tmp.fileName() << "to" << target;
-                            if (!tmp.copy(target)) {
-                                throw QInstaller::Error(QString::fromLatin1("Cannot copy file \"%1\" to \"%2\": %3")
-                                    .arg(QDir::toNativeSeparators(tmp.fileName()), QDir::toNativeSeparators(target), tmp.errorString()));
-                            }
-                            compressedFiles.append(target);
-                        } else {
-                            filesToCompress.append(absoluteEntryFilePath);
-                        }
-                    } else if (fileInfo.isDir()) {
-                        qDebug() << "Compressing data directory" << entry;
-                        QString target = QString::fromLatin1("%1/%3%2.%4").arg(namedRepoDir, entry, info.version, archiveSuffix);
-                        createArchive(target, QStringList() << dataDir.absoluteFilePath(entry), compression);
+    if (!entry.entryHashes.isEmpty()) {
+        root.appendChild(doc.createElement(QLatin1String("EntryHashes"))).appendChild(doc
+            .createTextNode(entry.entryHashes.join(QLatin1Char('\n'))));
+    }
+
+    QFile manifest(cacheDir + QLatin1String("/manifest.xml"));
+    QInstaller::openForWrite(&manifest);
+    QInstaller::blockingWrite(&manifest, doc.toByteArray());
+}
+
+// Calculates the key of the build cache entry of a component from the contents of its data
+// directories and the packaging settings. The version is not part of the key, it only names
+// the outputs. File hashes are reused from the previous entry as
+// long as the size and modification time of a file did not change.
+static QByteArray buildCacheKey(const QStringList &packageDirs, const PackageInfo &info,
+    const QString &archiveSuffix, Compression compression, bool recordEntryHashes, bool solid,
+    const BuildCacheEntry &previous, QHash<QString, CachedFile> *files)
+{
+    QCryptographicHash key(QCryptographicHash::Sha1);
+    key.addData(QString::fromLatin1("%1|%2|%3|%4|%5|%6|%7|%8").arg(scBuildCacheVersion)
+        .arg(info.name, archiveSuffix).arg(int(compression))
+        .arg(int(recordEntryHashes)).arg(int(solid)).arg(info.dictionarySize)
+        .arg(info.solidBlockSize).toUtf8());
+
+    for (int i = 0; i < packageDirs.count(); ++i) {
+        const QDir dataDir(QString::fromLatin1("%1/%2/data").arg(packageDirs.at(i), info.name));
+        if (!dataDir.exists())
+            continue;
+
+        QStringList paths;
+        QDirIterator it(dataDir.absolutePath(), QDir::AllEntries | QDir::Hidden | QDir::System
+            | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            paths.append(it.next());
+        std::sort(paths.begin(), paths.end());
+
+        foreach (const QString &path, paths) {
+            const QFileInfo fileInfo(path);
+            const QString relativePath = QString::fromLatin1("%1/%2").arg(i)
+                .arg(dataDir.relativeFilePath(path));
+            QByteArray content;
+            if (fileInfo.isSymLink()) {
+                content = QFile::encodeName(fileInfo.symLinkTarget());
+            } else if (fileInfo.isFile()) {
+                CachedFile cachedFile = previous.files.value(relativePath);
+                const qint64 modified = fileInfo.lastModified().toMSecsSinceEpoch();
+                if (cachedFile.sha1.isEmpty() || cachedFile.size != fileInfo.size()
+                        || cachedFile.modified != modified) {
+                    cachedFile.size = fileInfo.size();
+                    cachedFile.modified = modified;
+                    cachedFile.sha1 = QInstaller::calculateHash(path, QCryptographicHash::Sha1);
+                }
+                files->insert(relativePath, cachedFile);
+                content = cachedFile.sha1;
+            }
+            key.addData(relativePath.toUtf8() + '\0' + QByteArray::number(int(fileInfo.permissions()))
+                + '\0' + content + '\0');
+        }
+    }
+    return key.result().toHex();
+}
+
+// Copies the outputs of a build cache entry to the repository, named after the version of the
+// component, and updates the info with them.
+static bool restoreFromBuildCache(const QString &cacheDir, const BuildCacheEntry &entry,
+    const QString &targetDir, PackageInfo *const packageInfo)
+{
+    if (entry.outputs.isEmpty())
+        return false;
+
+    QStringList copiedFiles;
+    QString contentSha1;
+    foreach (const QString &output, entry.outputs) {
+        QFile source(cacheDir + QLatin1Char('/') + output);
+        const QString target = targetDir + QLatin1Char('/') + packageInfo->version + output;
+        QFile::remove(target);
+        if (!source.copy(target)) {
+            qDebug() << "Cannot restore" << output << "from the build cache:" << source.errorString();
+            foreach (const QString &copiedFile, copiedFiles)
+                QFile::remove(copiedFile);
+            return false;
+        }
+        copiedFiles.append(target);
+        if (output.endsWith(QLatin1String(".sha1")) && source.open(QIODevice::ReadOnly))
+            contentSha1 = QLatin1String(source.readAll());
+    }
+
+    packageInfo->copiedFiles = copiedFiles;
+    packageInfo->entryHashes = entry.entryHashes;
+    if (packageInfo->createContentSha1Node)
+        packageInfo->contentSha1 = contentSha1;
+    return true;
+}
+
+// Copies a prebuilt archive into the repository. Uses a copy-on-write clone if source and
+// target share a file system that supports it, so that the archive data is not duplicated.
+static void copyArchive(const QString &source, const QString &target)
+{
+    qDebug() << "Copying archive from" << source << "to" << target;
+    QFile placeholder(target);
+    if (placeholder.open(QIODevice::WriteOnly)) {
+        placeholder.close();
+        if (QInstaller::cloneFile(source, target)) {
+            // the clone keeps the mode of the placeholder, QFile::copy() keeps the one of source
+            QFile::setPermissions(target, QFile::permissions(source));
+            return;
+        }
+        placeholder.remove();
+    }
+
+    QFile file(source);
+    if (!file.copy(target)) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot copy file \"%1\" to \"%2\": %3")
+            .arg(QDir::toNativeSeparators(source), QDir::toNativeSeparators(target), file.errorString()));
+    }
+}
+
+// Packages the data of a single component, only modifies the given info.
+static void copyPackageData(const QStringList &packageDirs, const QString &repoDir,
+    PackageInfo *const packageInfo, const QString &archiveSuffix,
+    Compression compression, bool recordEntryHashes, int threadCount, const QString &cacheDir,
+    bool chunks)
+{
+    const PackageInfo info = *packageInfo;
+    const QString name = info.name;
+    qDebug() << "Copying component data for" << name;
+
+    const QString namedRepoDir = QString::fromLatin1("%1/%2").arg(repoDir, name);
+    if (!QDir().mkpath(namedRepoDir)) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot create repository directory for component \"%1\".")
+            .arg(name));
+    }
+
+    if (info.copiedFiles.isEmpty()) {
+        BuildCacheEntry cacheEntry;
+        const QString componentCacheDir = cacheDir.isEmpty() ? QString()
+            : QString::fromLatin1("%1/%2").arg(cacheDir, name);
+        if (!componentCacheDir.isEmpty()) {
+            const BuildCacheEntry previous = readBuildCacheEntry(componentCacheDir);
+            cacheEntry.key = buildCacheKey(packageDirs, info, archiveSuffix, compression,
+                recordEntryHashes, !chunks, previous, &cacheEntry.files);
+            if (cacheEntry.key == previous.key
+                    && restoreFromBuildCache(componentCacheDir, previous, namedRepoDir, packageInfo)) {
+                qDebug() << "Reusing cached data for component" << name;
+                return;
+            }
+        }
+
+        QStringList compressedFiles;
+        QHash<QString, QByteArray> writtenHashes;
+        QStringList filesToCompress;
+        foreach (const QString &packageDir, packageDirs) {
+            const QDir dataDir(QString::fromLatin1("%1/%2/data").arg(packageDir, name));
+            foreach (const QString &entry, dataDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Files)) {
+                QFileInfo fileInfo(dataDir.absoluteFilePath(entry));
+                if (fileInfo.isFile() && !fileInfo.isSymLink()) {
+                    const QString absoluteEntryFilePath = dataDir.absoluteFilePath(entry);
+                    QScopedPointer<AbstractArchive> archive(ArchiveFactory::instance()
+                        .create(absoluteEntryFilePath));
+                    if (archive && archive->open(QIODevice::ReadOnly) && archive->isSupported()) {
+                        const QString target = QString::fromLatin1("%1/%3%2").arg(namedRepoDir, entry, info.version);
+                        copyArchive(absoluteEntryFilePath, target);
                         compressedFiles.append(target);
-                    } else if (fileInfo.isSymLink()) {
-                        filesToCompress.append(dataDir.absoluteFilePath(entry));
+                    } else {
+                        filesToCompress.append(absoluteEntryFilePath);
                     }
+                } else if (fileInfo.isDir()) {
+                    qDebug() << "Compressing data directory" << entry;
+                    QString target = QString::fromLatin1("%1/%3%2.%4").arg(namedRepoDir, entry, info.version, archiveSuffix);
+                    writtenHashes.insert(target, createArchive(target, QStringList()
+                        << dataDir.absoluteFilePath(entry), compression, threadCount, !chunks,
+                        info.dictionarySize, info.solidBlockSize));
+                    compressedFiles.append(target);
+                    if (recordEntryHashes) {
+                        appendEntryHashes(&packageInfo->entryHashes, entry + QLatin1Char('.') + archiveSuffix,
+                            dataDir, dataDir.absoluteFilePath(entry));
+                    }
+                } else if (fileInfo.isSymLink()) {
+                    filesToCompress.append(dataDir.absoluteFilePath(entry));
+                }
+            }
+        }
+
+        if (!filesToCompress.isEmpty()) {
+            qDebug() << "Compressing files found in data directory:" << filesToCompress;
+            QString target = QString::fromLatin1("%1/%2content.%3").arg(namedRepoDir, info.version, archiveSuffix);
+            writtenHashes.insert(target, createArchive(target, filesToCompress, compression,
+                threadCount, !chunks, info.dictionarySize, info.solidBlockSize));
+            compressedFiles.append(target);
+            if (recordEntryHashes) {
+                foreach (const QString &file, filesToCompress) {
+                    appendEntryHashes(&packageInfo->entryHashes, QLatin1String("content.") + archiveSuffix,
+                        QFileInfo(file).dir(), file);
                 }
             }
+        }
+
+        foreach (const QString &target, compressedFiles) {
+            packageInfo->copiedFiles.append(target);
+
+            QFile archiveFile(target);
+            QFile archiveHashFile(archiveFile.fileName() + QLatin1String(".sha1"));
+
+            qDebug() << "Hash is stored in" << archiveHashFile.fileName();
+
+            try {
+                const QByteArray hashOfArchiveData = archiveHash(&archiveFile,
+                    writtenHashes.value(target)).toHex();
+                archiveFile.close();
+
+                QInstaller::openForWrite(&archiveHashFile);
+                archiveHashFile.write(hashOfArchiveData);
+                qDebug() << "Generated sha1 hash:" << hashOfArchiveData;
+                packageInfo->copiedFiles.append(archiveHashFile.fileName());
+                if (packageInfo->createContentSha1Node)
+                    packageInfo->contentSha1 = QLatin1String(hashOfArchiveData);
+                archiveHashFile.close();
+            } catch (const QInstaller::Error &/*e*/) {
+                archiveFile.close();
+                archiveHashFile.close();
+                throw;
+            }
+        }
 
-            if (!filesToCompress.isEmpty()) {
-                qDebug() << "Compressing files found in data directory:" << filesToCompress;
-                QString target = QString::fromLatin1("%1/%2content.%3").arg(namedRepoDir, info.version, archiveSuffix);
-                createArchive(target, filesToCompress, compression);
-                compressedFiles.append(target);
+        if (!componentCacheDir.isEmpty() && !packageInfo->copiedFiles.isEmpty()) {
+            cacheEntry.entryHashes = packageInfo->entryHashes;
+            try {
+                writeBuildCacheEntry(componentCacheDir, cacheEntry, packageInfo->copiedFiles,
+                    info.version);
+            } catch (const QInstaller::Error &e) {
+                qWarning().noquote() << "Cannot update the build cache of component" << name << ":"
+                    << e.message();
+                QInstaller::removeDirectory(componentCacheDir, true);
             }
+        }
+    } else {
+        foreach (const QString &file, packageInfo->copiedFiles) {
+            copyArchive(file, QString::fromLatin1("%1/%2").arg(namedRepoDir, QFileInfo(file).fileName()));
+        }
+    }
+}
 
-            foreach (const QString &target, compressedFiles) {
-                (*infos)[i].copiedFiles.append(target);
+static void extractArchive(const QString &archivePath, const QString &targetDir)
+{
+    QScopedPointer<AbstractArchive> archive(ArchiveFactory::instance().create(archivePath));
+    if (!archive) {
+        throw QInstaller::Error(QString::fromLatin1("Could not create handler "
+            "object for archive \"%1\": \"%2\".").arg(archivePath, QLatin1String(Q_FUNC_INFO)));
+    }
+    if (!(archive->open(QIODevice::ReadOnly) && archive->extract(targetDir))) {
+        throw QInstaller::Error(QString::fromLatin1("Could not extract archive \"%1\": %2").arg(
+            QDir::toNativeSeparators(archivePath), archive->errorString()));
+    }
+}
+
+// Creates a patch archive for every data archive of the component that also exists in the
+// previous version kept in patchBaseDir. Patches that are not smaller than the archive they
+// replace are dropped.
+static void createArchivePatches(const QString &repoDir, const QString &patchBaseDir,
+    PackageInfo *const packageInfo, Compression compression, int threadCount)
+{
+    const PackageInfo info = *packageInfo;
+    const QString namedRepoDir = QString::fromLatin1("%1/%2").arg(repoDir, info.name);
+    foreach (const QString &file, info.copiedFiles) {
+        const QString fileName = QFileInfo(file).fileName();
+        if (fileName.endsWith(QLatin1String(".sha1"), Qt::CaseInsensitive)
+                || !fileName.startsWith(info.version)) {
+            continue;
+        }
 
-                QFile archiveFile(target);
-                QFile archiveHashFile(archiveFile.fileName() + QLatin1String(".sha1"));
+        const QString archiveName = fileName.mid(info.version.length());
+        const QString baseArchive = QString::fromLatin1("%1/%2/%3%4").arg(patchBaseDir, info.name,
+            info.patchBaseVersion, archiveName);
+        if (!QFileInfo(baseArchive).isFile())
+            continue;
 
-                qDebug() << "Hash is stored in" << archiveHashFile.fileName();
-                qDebug() << "Creating hash of archive" << archiveFile.fileName();
+        QTemporaryDir workDir;
+        if (!workDir.isValid()) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot create temporary directory: %1")
+                .arg(workDir.errorString()));
+        }
+        const QString baseDir = workDir.path() + QLatin1String("/base");
+        const QString targetDir = workDir.path() + QLatin1String("/target");
+        const QString patchDir = workDir.path() + QLatin1String("/patch");
+        extractArchive(baseArchive, baseDir);
+        extractArchive(QString::fromLatin1("%1/%2").arg(namedRepoDir, fileName), targetDir);
+        if (!createArchivePatch(baseDir, targetDir, patchDir)) {
+            qDebug() << "Cannot create a patch for archive" << fileName << "of component" << info.name;
+            continue;
+        }
 
-                try {
-                    QInstaller::openForRead(&archiveFile);
-                    const QByteArray hashOfArchiveData = QInstaller::calculateHash(&archiveFile,
-                        QCryptographicHash::Sha1).toHex();
-                    archiveFile.close();
-
-                    QInstaller::openForWrite(&archiveHashFile);
-                    archiveHashFile.write(hashOfArchiveData);
-                    qDebug() << "Generated sha1 hash:" << hashOfArchiveData;
-                    (*infos)[i].copiedFiles.append(archiveHashFile.fileName());
-                    if ((*infos)[i].createContentSha1Node)
-                        (*infos)[i].contentSha1 = QLatin1String(hashOfArchiveData);
-                    archiveHashFile.close();
-                } catch (const QInstaller::Error &/*e*/) {
-                    archiveFile.close();
-                    archiveHashFile.close();
-                    throw;
-                }
+        QStringList patchData;
+        foreach (const QFileInfo &fi, QDir(patchDir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot))
+            patchData.append(fi.absoluteFilePath());
+        QFile patch(QString::fromLatin1("%1/%2").arg(namedRepoDir, archivePatchFileName(fileName)));
+        const QByteArray writtenHash = createArchive(patch.fileName(), patchData, compression,
+            threadCount, true, info.dictionarySize, info.solidBlockSize);
+        if (patch.size() >= QFileInfo(namedRepoDir, fileName).size()) {
+            qDebug() << "Skipping patch" << patch.fileName() << "as it is not smaller than the archive";
+            patch.remove();
+            continue;
+        }
+
+        const QByteArray sha1 = archiveHash(&patch, writtenHash).toHex();
+        patch.close();
+        QFile patchHashFile(patch.fileName() + QLatin1String(".sha1"));
+        QInstaller::openForWrite(&patchHashFile);
+        QInstaller::blockingWrite(&patchHashFile, sha1);
+        packageInfo->patchArchives.append(QString::fromLatin1("%1:%2:%3").arg(archiveName,
+            QLatin1String(sha1)).arg(patch.size()));
+        qDebug() << "Created patch" << patch.fileName() << "against version" << info.patchBaseVersion;
+    }
+}
+
+// Splits the data archives of the component into content defined chunks, stores the chunks
+// that are new to the repository below its chunks directory and writes the list of chunks
+// of every archive next to it.
+static void storeArchiveChunks(const QString &repoDir, PackageInfo *const packageInfo)
+{
+    const QString namedRepoDir = QString::fromLatin1("%1/%2").arg(repoDir, packageInfo->name);
+    const QString chunkDir = repoDir + QLatin1String("/chunks/");
+    QStringList archives = packageInfo->copiedFiles;
+    foreach (const QString &patch, packageInfo->patchArchives) {
+        archives.append(archivePatchFileName(packageInfo->version
+            + patch.section(QLatin1Char(':'), 0, 0)));
+    }
+    foreach (const QString &file, archives) {
+        if (file.endsWith(QLatin1String(".sha1"), Qt::CaseInsensitive))
+            continue;
+
+        QFile archive(QString::fromLatin1("%1/%2").arg(namedRepoDir, QFileInfo(file).fileName()));
+        QInstaller::openForRead(&archive);
+
+        QVector<ArchiveChunk> chunks;
+        int storedChunks = 0;
+        ContentChunker chunker(&archive);
+        QByteArray data;
+        while (chunker.next(&data)) {
+            ArchiveChunk chunk;
+            chunk.sha1 = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+            chunk.size = data.size();
+            chunks.append(chunk);
+
+            const QString chunkPath = chunkDir + archiveChunkPath(chunk.sha1);
+            if (QFileInfo::exists(chunkPath))
+                continue;
+
+            // jobs running in parallel might store the same chunk, both write the same content
+            QInstaller::mkpath(QFileInfo(chunkPath).path());
+            QSaveFile chunkFile(chunkPath);
+            if (!chunkFile.open(QIODevice::WriteOnly) || chunkFile.write(data) != data.size()
+                    || !chunkFile.commit()) {
+                throw QInstaller::Error(QString::fromLatin1("Cannot write chunk \"%1\": %2").arg(
+                    QDir::toNativeSeparators(chunkPath), chunkFile.errorString()));
             }
-        } else {
-            foreach (const QString &file, (*infos)[i].copiedFiles) {
-                QFileInfo fromInfo(file);
-                QFile from(file);
-                QString target = QString::fromLatin1("%1/%2").arg(namedRepoDir, fromInfo.fileName());
-                qDebug() << "Copying file from" << from.fileName() << "to" << target;
-                if (!from.copy(target)) {
-                    throw QInstaller::Error(QString::fromLatin1("Cannot copy file \"%1\" to \"%2\": %3")
-                        .arg(QDir::toNativeSeparators(from.fileName()), QDir::toNativeSeparators(target), from.errorString()));
+            ++storedChunks;
+        }
+        archive.close();
+
+        QFile manifest(archive.fileName() + QLatin1String(".chunks"));
+        QInstaller::openForWrite(&manifest);
+        QInstaller::blockingWrite(&manifest, writeChunkManifest(chunks));
+        qDebug() << "Stored" << storedChunks << "of" << chunks.count() << "chunks of archive"
+            << archive.fileName();
+    }
+    packageInfo->chunkedArchives = true;
+}
+
+void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QString &repoDir,
+    PackageInfoVector *const infos, const QString &archiveSuffix, Compression compression,
+    bool recordEntryHashes, int jobs, const QString &cacheDir, bool chunks,
+    const QString &patchBaseDir)
+{
+    jobs = qBound(1, jobs, qMax(1, infos->count()));
+    if (jobs == 1) {
+        for (int i = 0; i < infos->count(); ++i) {
+            const int threadCount = infos->at(i).compressionThreads;
+            copyPackageData(packageDirs, repoDir, &(*infos)[i], archiveSuffix, compression,
+                recordEntryHashes, threadCount, cacheDir, chunks);
+            if (!infos->at(i).patchBaseVersion.isEmpty())
+                createArchivePatches(repoDir, patchBaseDir, &(*infos)[i], compression, threadCount);
+            if (chunks)
+                storeArchiveChunks(repoDir, &(*infos)[i]);
+        }
+        return;
+    }
+
+    // Share the cores between the jobs, as formats that compress in parallel would start one
+    // thread per core for every job otherwise.
+    const int jobThreadCount = qMax(1, QThread::idealThreadCount() / jobs);
+    qDebug() << "Packaging components with" << jobs << "jobs of" << jobThreadCount << "threads.";
+
+    // Every job only modifies its own entry, so the order of the components stays the same.
+    infos->detach();
+    QVector<QString> errors(infos->count());
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    for (int i = 0; i < infos->count(); ++i) {
+        QtConcurrent::run(&pool, [&, i]() {
+            try {
+                const int threadCount = infos->at(i).compressionThreads > 0
+                    ? infos->at(i).compressionThreads : jobThreadCount;
+                copyPackageData(packageDirs, repoDir, &(*infos)[i], archiveSuffix, compression,
+                    recordEntryHashes, threadCount, cacheDir, chunks);
+                if (!infos->at(i).patchBaseVersion.isEmpty()) {
+                    createArchivePatches(repoDir, patchBaseDir, &(*infos)[i], compression,
+                        threadCount);
                 }
+                if (chunks)
+                    storeArchiveChunks(repoDir, &(*infos)[i]);
+            } catch (const QInstaller::Error &e) {
+                errors[i] = QString::fromLatin1("%1: %2").arg(infos->at(i).name, e.message());
             }
+        });
+    }
+    pool.waitForDone();
+
+    QStringList failedComponents;
+    foreach (const QString &error, errors) {
+        if (!error.isEmpty())
+            failedComponents.append(error);
+    }
+    if (!failedComponents.isEmpty()) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot copy component data of %1 component(s):\n%2")
+            .arg(failedComponents.count()).arg(failedComponents.join(QLatin1Char('\n'))));
+    }
+}
+
+struct UpdatesDelta
+{
+    int age;
+    QSet<QString> changed;
+    QSet<QString> removed;
+};
+
+static QHash<QString, QString> packageUpdatesByName(const QDomDocument &doc)
+{
+    QHash<QString, QString> packages;
+    const QDomNodeList children = doc.documentElement().childNodes();
+    for (int i = 0; i < children.count(); ++i) {
+        const QDomElement el = children.at(i).toElement();
+        if (el.isNull() || el.tagName() != QLatin1String("PackageUpdate"))
+            continue;
+        QString content;
+        QTextStream stream(&content);
+        el.save(stream, 0);
+        packages.insert(el.firstChildElement(scName).text(), content);
+    }
+    return packages;
+}
+
+static void writeXml(const QString &fileName, const QDomDocument &doc)
+{
+    QFile file(fileName);
+    QInstaller::openForWrite(&file);
+    QInstaller::blockingWrite(&file, doc.toByteArray());
+    file.close();
+}
+
+// Stamps the Updates.xml in metaDir with a revision identifier and writes one delta document
+// per known previous revision (up to revisions back) to metaDir/deltas. A delta lists the
+// PackageUpdate elements added or changed and the packages removed since its base revision.
+void QInstallerTools::createUpdatesDeltas(const QString &repositoryDir, const QString &metaDir,
+    int revisions)
+{
+    const QString updatesXmlPath = metaDir + QLatin1String("/Updates.xml");
+    QDomDocument doc;
+    QFile updatesXml(updatesXmlPath);
+    QInstaller::openForRead(&updatesXml);
+    if (!doc.setContent(&updatesXml)) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot parse \"%1\".")
+            .arg(QDir::toNativeSeparators(updatesXmlPath)));
+    }
+    updatesXml.close();
+
+    QDomElement root = doc.documentElement();
+    QDomElement revisionElement = root.firstChildElement(QLatin1String("Revision"));
+    while (!revisionElement.isNull()) {
+        root.removeChild(revisionElement);
+        revisionElement = root.firstChildElement(QLatin1String("Revision"));
+    }
+    const QString revision = QString::fromLatin1(QCryptographicHash::hash(doc.toByteArray(),
+        QCryptographicHash::Sha1).toHex());
+    root.appendChild(doc.createElement(QLatin1String("Revision")))
+        .appendChild(doc.createTextNode(revision));
+    writeXml(updatesXmlPath, doc);
+    qDebug() << "Repository revision is" << revision;
+
+    QHash<QString, UpdatesDelta> deltas;
+    const QHash<QString, QString> packages = packageUpdatesByName(doc);
+
+    QDomDocument previousDoc;
+    QFile previousUpdatesXml(repositoryDir + QLatin1String("/Updates.xml"));
+    if (previousUpdatesXml.open(QIODevice::ReadOnly) && previousDoc.setContent(&previousUpdatesXml)) {
+        const QString previousRevision = previousDoc.documentElement()
+            .firstChildElement(QLatin1String("Revision")).text();
+        const int ageIncrement = (previousRevision == revision) ? 0 : 1;
+
+        // compose the deltas to the previous revision with the changes made since then
+        UpdatesDelta latest;
+        latest.age = ageIncrement;
+        const QHash<QString, QString> previousPackages = packageUpdatesByName(previousDoc);
+        for (auto it = packages.constBegin(); it != packages.constEnd(); ++it) {
+            if (previousPackages.value(it.key()) != it.value())
+                latest.changed.insert(it.key());
+        }
+        for (auto it = previousPackages.constBegin(); it != previousPackages.constEnd(); ++it) {
+            if (!packages.contains(it.key()))
+                latest.removed.insert(it.key());
+        }
+
+        QDirIterator it(repositoryDir + QLatin1String("/deltas"),
+            QStringList(QLatin1String("*_Updates.xml")), QDir::Files);
+        while (it.hasNext()) {
+            QDomDocument deltaDoc;
+            QFile deltaFile(it.next());
+            if (!deltaFile.open(QIODevice::ReadOnly) || !deltaDoc.setContent(&deltaFile)) {
+                qDebug() << "Ignoring unreadable delta" << deltaFile.fileName();
+                continue;
+            }
+            const QDomElement deltaRoot = deltaDoc.documentElement();
+            const QString base = deltaRoot.firstChildElement(QLatin1String("BaseRevision")).text();
+            UpdatesDelta delta;
+            delta.age = deltaRoot.firstChildElement(QLatin1String("Age")).text().toInt()
+                + ageIncrement;
+            if (base.isEmpty() || delta.age > revisions)
+                continue;
+
+            const QDomNodeList children = deltaRoot.childNodes();
+            for (int i = 0; i < children.count(); ++i) {
+                const QDomElement el = children.at(i).toElement();
+                if (el.tagName() == QLatin1String("PackageUpdate"))
+                    delta.changed.insert(el.firstChildElement(scName).text());
+                else if (el.tagName() == QLatin1String("RemovedPackage"))
+                    delta.removed.insert(el.text());
+            }
+            delta.changed.unite(latest.changed);
+            delta.removed.unite(latest.removed);
+            deltas.insert(base, delta);
+        }
+        if (!previousRevision.isEmpty() && previousRevision != revision)
+            deltas.insert(previousRevision, latest);
+    }
+    deltas.insert(revision, UpdatesDelta{0, QSet<QString>(), QSet<QString>()});
+
+    const QString deltaDir = metaDir + QLatin1String("/deltas");
+    QInstaller::mkpath(deltaDir);
+    for (auto it = deltas.constBegin(); it != deltas.constEnd(); ++it) {
+        QDomDocument deltaDoc;
+        QDomElement deltaRoot = deltaDoc.createElement(QLatin1String("UpdatesDelta"));
+        deltaDoc.appendChild(deltaRoot);
+        deltaRoot.appendChild(deltaDoc.createElement(QLatin1String("BaseRevision")))
+            .appendChild(deltaDoc.createTextNode(it.key()));
+        deltaRoot.appendChild(deltaDoc.createElement(QLatin1String("Age")))
+            .appendChild(deltaDoc.createTextNode(QString::number(it.value().age)));
+
+        // the repository wide elements are small, always ship them in full
+        const QDomNodeList children = root.childNodes();
+        for (int i = 0; i < children.count(); ++i) {
+            const QDomElement el = children.at(i).toElement();
+            if (el.isNull())
+                continue;
+            if (el.tagName() != QLatin1String("PackageUpdate")
+                    || it.value().changed.contains(el.firstChildElement(scName).text())) {
+                deltaRoot.appendChild(deltaDoc.importNode(el, true));
+            }
+        }
+        foreach (const QString &name, it.value().removed) {
+            if (packages.contains(name))
+                continue;
+            deltaRoot.appendChild(deltaDoc.createElement(QLatin1String("RemovedPackage")))
+                .appendChild(deltaDoc.createTextNode(name));
         }
+        writeXml(QString::fromLatin1("%1/%2_Updates.xml").arg(deltaDir, it.key()), deltaDoc);
     }
+    qDebug() << "Created" << deltas.count() << "Updates.xml deltas.";
+}
+
+void QInstallerTools::createRepositoryIndex(const QString &metaDir)
+{
+    // the index records the checksum of the exact Updates.xml it is created from
+    QFile updatesXml(metaDir + QLatin1String("/Updates.xml"));
+    QInstaller::openForRead(&updatesXml);
+    const QByteArray content = updatesXml.readAll();
+    updatesXml.close();
+
+    const QString indexFile = updatesXml.fileName() + QLatin1String(".idx");
+    qDebug() << "Writing repository index" << indexFile;
+    RepositoryIndex::write(content, indexFile);
 }
 
 void QInstallerTools::filterNewComponents(const QString &repositoryDir, QInstallerTools::PackageInfoVector &packages)
@@ -1017,36 +1772,25 @@ void QInstallerTools::filterNewComponents(const QString &repositoryDir, QInstall
         }
         file.close(); // close the file, we read the content already
 
-        // read the already existing updates xml content
-        const QDomNodeList children = root.childNodes();
-        QHash <QString, QInstallerTools::PackageInfo> hash;
-        for (int i = 0; i < children.count(); ++i) {
-            const QDomElement el = children.at(i).toElement();
-            if ((!el.isNull()) && (el.tagName() == QLatin1String("PackageUpdate"))) {
-                QInstallerTools::PackageInfo info;
-                const QDomNodeList c2 = el.childNodes();
-                for (int j = 0; j < c2.count(); ++j) {
-                    const QDomElement c2Element = c2.at(j).toElement();
-                    if (c2Element.tagName() == scName)
-                        info.name = c2Element.text();
-                    else if (c2Element.tagName() == scVersion)
-                        info.version = c2Element.text();
-                }
-                hash.insert(info.name, info);
-            }
+        // read the already existing updates xml content, the last entry of a name wins
+        QHash<QString, QString> versions;
+        for (QDomElement el = root.firstChildElement(QLatin1String("PackageUpdate")); !el.isNull();
+                el = el.nextSiblingElement(QLatin1String("PackageUpdate"))) {
+            versions.insert(el.firstChildElement(scName).text(), el.firstChildElement(scVersion).text());
         }
 
         // remove all components that have no update (decision based on the version tag)
-        for (int i = packages.count() - 1; i >= 0; --i) {
-            const QInstallerTools::PackageInfo info = packages.at(i);
-
+        QInstallerTools::PackageInfoVector updatedPackages;
+        updatedPackages.reserve(packages.count());
+        foreach (const QInstallerTools::PackageInfo &info, packages) {
             // check if component already exists & version did not change
-            if (hash.contains(info.name) && KDUpdater::compareVersion(info.version, hash.value(info.name).version) < 1) {
-                packages.remove(i); // the version did not change, no need to update the component
-                continue;
-            }
+            const QHash<QString, QString>::const_iterator existing = versions.constFind(info.name);
+            if (existing != versions.constEnd() && KDUpdater::compareVersion(info.version, existing.value()) < 1)
+                continue; // the version did not change, no need to update the component
             qDebug() << "Update component" << info.name << "in"<< repositoryDir << ".";
+            updatedPackages.append(info);
         }
+        packages.swap(updatedPackages);
     }
 }
 
@@ -1069,6 +1813,13 @@ QString QInstallerTools::existingUniteMeta7z(const QString &repositoryDir)
     return uniteMeta7z;
 }
 
+// The directory that keeps the previous version of updated components while repogen creates
+// patches against it.
+static QString patchBaseDirectory(const QString &repositoryDir)
+{
+    return repositoryDir + QLatin1String("/.patchbase");
+}
+
 PackageInfoVector QInstallerTools::collectPackages(RepositoryInfo info, QStringList *filteredPackages, FilterType filterType, bool updateNewComponents, QStringList packagesUpdatedWithSha)
 {
     PackageInfoVector packages;
@@ -1084,8 +1835,23 @@ PackageInfoVector QInstallerTools::collectPackages(RepositoryInfo info, QStringL
     }
     foreach (const QInstallerTools::PackageInfo &package, packages) {
         const QFileInfo fi(info.repositoryDir, package.name);
-        if (fi.exists())
+        if (!fi.exists())
+            continue;
+        if (!info.patches) {
             removeDirectory(fi.absoluteFilePath());
+            continue;
+        }
+
+        // keep the previous version until the patches against it are created
+        const QString patchBase = QString::fromLatin1("%1/%2").arg(patchBaseDirectory(info.repositoryDir),
+            package.name);
+        if (QFileInfo::exists(patchBase))
+            removeDirectory(patchBase);
+        QInstaller::mkpath(patchBaseDirectory(info.repositoryDir));
+        if (!QDir().rename(fi.absoluteFilePath(), patchBase)) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot move \"%1\" to \"%2\".").arg(
+                QDir::toNativeSeparators(fi.absoluteFilePath()), QDir::toNativeSeparators(patchBase)));
+        }
     }
     return packages;
 }
@@ -1108,7 +1874,35 @@ void QInstallerTools::createRepository(RepositoryInfo info, PackageInfoVector *p
             unite7zFiles.append(it.fileInfo().absoluteFilePath());
         }
     }
-    QInstallerTools::copyComponentData(directories, info.repositoryDir, packages, archiveSuffix, compression);
+    for (int i = 0; i < packages->count(); ++i) {
+        PackageInfo &package = (*packages)[i];
+        package.compressionThreads = info.compressionThreads;
+        if (package.dictionarySize == 0)
+            package.dictionarySize = info.dictionarySize;
+        if (package.solidBlockSize == 0)
+            package.solidBlockSize = info.solidBlockSize;
+    }
+    const QString patchBaseDir = patchBaseDirectory(info.repositoryDir);
+    if (info.patches && QFileInfo::exists(patchBaseDir)) {
+        // the repository still describes the previous version of the components
+        QDomDocument doc;
+        QFile file(info.repositoryDir + QLatin1String("/Updates.xml"));
+        if (file.open(QIODevice::ReadOnly) && doc.setContent(&file)) {
+            const QMultiHash<QString, QDomElement> updates = packageUpdatesByName(doc.documentElement());
+            for (int i = 0; i < packages->count(); ++i) {
+                PackageInfo &package = (*packages)[i];
+                const QString baseVersion = updates.value(package.name)
+                    .firstChildElement(scVersion).text();
+                if (!baseVersion.isEmpty() && baseVersion != package.version
+                        && QFileInfo::exists(QString::fromLatin1("%1/%2").arg(patchBaseDir, package.name))) {
+                    package.patchBaseVersion = baseVersion;
+                }
+            }
+        }
+    }
+    QInstallerTools::copyComponentData(directories, info.repositoryDir, packages, archiveSuffix, compression,
+        info.recordEntryHashes, info.jobs, info.cacheDir, info.chunks, patchBaseDir);
+    QInstaller::removeDirectory(patchBaseDir, true);
     QInstallerTools::copyMetaData(tmpMetaDir, info.repositoryDir, *packages, QLatin1String("{AnyApplication}"),
         QLatin1String(QUOTE(IFW_REPOSITORY_FORMAT_VERSION)), unite7zFiles);
 
@@ -1117,9 +1911,15 @@ void QInstallerTools::createRepository(RepositoryInfo info, PackageInfoVector *p
         existing7z = info.repositoryDir + QDir::separator() + existing7z;
     QInstallerTools::compressMetaDirectories(tmpMetaDir, existing7z, pathToVersionMapping,
                                              createComponentMetadata, createUnifiedMetadata);
+    if (info.deltaRevisions > 0) {
+        QInstallerTools::createUpdatesDeltas(info.repositoryDir, tmpMetaDir, info.deltaRevisions);
+        QInstaller::removeDirectory(info.repositoryDir + QLatin1String("/deltas"), true);
+    }
+    QInstallerTools::createRepositoryIndex(tmpMetaDir);
 
     QDirIterator it(info.repositoryDir, QStringList(QLatin1String("Updates*.xml"))
-                    << QLatin1String("*_meta.7z"), QDir::Files | QDir::CaseSensitive);
+                    << QLatin1String("Updates.xml.idx") << QLatin1String("*_meta.7z"),
+                    QDir::Files | QDir::CaseSensitive);
     while (it.hasNext()) {
         it.next();
         QFile::remove(it.fileInfo().absoluteFilePath());
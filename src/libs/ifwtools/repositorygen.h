@@ -52,6 +52,13 @@ struct IFWTOOLS_EXPORT PackageInfo
     QString metaNode;
     QString contentSha1;
     bool createContentSha1Node;
+    QStringList entryHashes;
+    bool chunkedArchives = false;
+    QString patchBaseVersion;
+    QStringList patchArchives;
+    int compressionThreads = 0;
+    quint64 dictionarySize = 0;
+    quint64 solidBlockSize = 0;
 };
 typedef QVector<PackageInfo> PackageInfoVector;
 typedef QInstaller::AbstractArchive::CompressionLevel Compression;
@@ -66,6 +73,15 @@ struct IFWTOOLS_EXPORT RepositoryInfo
     QStringList packages;
     QStringList repositoryPackages;
     QString repositoryDir;
+    int deltaRevisions = 0;
+    bool recordEntryHashes = false;
+    int jobs = 1;
+    QString cacheDir;
+    bool chunks = false;
+    bool patches = false;
+    int compressionThreads = 0;
+    quint64 dictionarySize = 0;
+    quint64 solidBlockSize = 0;
 };
 
 void IFWTOOLS_EXPORT printRepositoryGenOptions();
@@ -80,7 +96,8 @@ PackageInfoVector IFWTOOLS_EXPORT createListOfRepositoryPackages(const QStringLi
 
 QHash<QString, QString> IFWTOOLS_EXPORT buildPathToVersionMapping(const PackageInfoVector &info);
 
-void IFWTOOLS_EXPORT createArchive(const QString &filename, const QStringList &data, Compression compression = Compression::Normal);
+QByteArray IFWTOOLS_EXPORT createArchive(const QString &filename, const QStringList &data, Compression compression = Compression::Normal,
+    int threadCount = 0, bool solid = true, quint64 dictionarySize = 0, quint64 solidBlockSize = 0);
 
 void IFWTOOLS_EXPORT compressMetaDirectories(const QString &repoDir, const QString &existingUnite7zUrl,
     const QHash<QString, QString> &versionMapping, bool createSplitMetadata, bool createUnifiedMetadata);
@@ -93,7 +110,15 @@ void IFWTOOLS_EXPORT copyMetaData(const QString &outDir, const QString &dataDir,
     const QString &appName, const QString& appVersion, const QStringList &uniteMetadatas);
 void IFWTOOLS_EXPORT copyComponentData(const QStringList &packageDir, const QString &repoDir,
                                        PackageInfoVector *const infos, const QString &archiveSuffix,
-                                       Compression compression = Compression::Normal);
+                                       Compression compression = Compression::Normal,
+                                       bool recordEntryHashes = false, int jobs = 1,
+                                       const QString &cacheDir = QString(), bool chunks = false,
+                                       const QString &patchBaseDir = QString());
+
+void IFWTOOLS_EXPORT createUpdatesDeltas(const QString &repositoryDir, const QString &metaDir,
+                                         int revisions);
+
+void IFWTOOLS_EXPORT createRepositoryIndex(const QString &metaDir);
 
 void IFWTOOLS_EXPORT filterNewComponents(const QString &repositoryDir, QInstallerTools::PackageInfoVector &packages);
 
@@ -138,6 +138,9 @@ namespace QInstaller {
 AbstractArchive::AbstractArchive(QObject *parent)
     : QObject(parent)
     , m_compressionLevel(CompressionLevel::Normal)
+    , m_compressionThreadCount(0)
+    , m_dictionarySize(0)
+    , m_solidBlockSize(0)
 {
 }
 
@@ -164,6 +167,56 @@ void AbstractArchive::setCompressionLevel(const CompressionLevel level)
     m_compressionLevel = level;
 }
 
+/*!
+    Sets the number of threads used to compress new archives to \a count. The
+    default value \c 0 leaves the choice to the compression library. Formats
+    that cannot compress in parallel ignore this setting.
+*/
+void AbstractArchive::setCompressionThreadCount(int count)
+{
+    m_compressionThreadCount = qMax(0, count);
+}
+
+/*!
+    Sets the dictionary size in bytes used to compress new archives to \a size.
+    The default value \c 0 uses the size implied by the compression level.
+    Formats without a configurable dictionary ignore this setting.
+*/
+void AbstractArchive::setDictionarySize(quint64 size)
+{
+    m_dictionarySize = size;
+}
+
+/*!
+    Sets the maximum size in bytes of a solid block in new archives to \a size.
+    Smaller solid blocks compress slightly worse but can be decompressed in
+    parallel. The default value \c 0 uses the size implied by the compression
+    level. Formats without solid blocks ignore this setting.
+*/
+void AbstractArchive::setSolidBlockSize(quint64 size)
+{
+    m_solidBlockSize = size;
+}
+
+/*!
+    Returns the SHA-1 checksum of the archive written by the last successful call
+    to create(), calculated while the archive was written. Returns an empty array
+    if the implementation does not calculate the checksum, in which case it needs
+    to be calculated from the file.
+*/
+QByteArray AbstractArchive::archiveHash() const
+{
+    return m_archiveHash;
+}
+
+/*!
+    Sets the SHA-1 checksum of the archive written by create() to \a hash.
+*/
+void AbstractArchive::setArchiveHash(const QByteArray &hash)
+{
+    m_archiveHash = hash;
+}
+
 /*!
     Sets a human-readable description of the current \a error.
 */
@@ -180,6 +233,33 @@ AbstractArchive::CompressionLevel AbstractArchive::compressionLevel() const
     return m_compressionLevel;
 }
 
+/*!
+    Returns the number of threads used to compress new archives, or \c 0 if
+    the compression library should decide.
+*/
+int AbstractArchive::compressionThreadCount() const
+{
+    return m_compressionThreadCount;
+}
+
+/*!
+    Returns the dictionary size in bytes used to compress new archives, or \c 0
+    if the compression level decides.
+*/
+quint64 AbstractArchive::dictionarySize() const
+{
+    return m_dictionarySize;
+}
+
+/*!
+    Returns the maximum size in bytes of a solid block in new archives, or \c 0
+    if the compression level decides.
+*/
+quint64 AbstractArchive::solidBlockSize() const
+{
+    return m_solidBlockSize;
+}
+
 /*!
     Reads an \a entry from the specified \a istream. Returns a reference to \a istream.
 */
@@ -94,6 +94,11 @@ public:
     virtual bool isSupported() = 0;
 
     virtual void setCompressionLevel(const CompressionLevel level);
+    virtual void setCompressionThreadCount(int count);
+    virtual void setDictionarySize(quint64 size);
+    virtual void setSolidBlockSize(quint64 size);
+
+    virtual QByteArray archiveHash() const;
 
 Q_SIGNALS:
     void currentEntryChanged(const QString &filename);
@@ -105,10 +110,18 @@ public Q_SLOTS:
 protected:
     void setErrorString(const QString &error);
     CompressionLevel compressionLevel() const;
+    int compressionThreadCount() const;
+    quint64 dictionarySize() const;
+    quint64 solidBlockSize() const;
+    void setArchiveHash(const QByteArray &hash);
 
 private:
     QString m_error;
     CompressionLevel m_compressionLevel;
+    int m_compressionThreadCount;
+    quint64 m_dictionarySize;
+    quint64 m_solidBlockSize;
+    QByteArray m_archiveHash;
 };
 
 INSTALLER_EXPORT QDataStream &operator>>(QDataStream &istream, ArchiveEntry &entry);
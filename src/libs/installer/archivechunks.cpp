@@ -0,0 +1,271 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "archivechunks.h"
+
+#include "errors.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QMultiMap>
+#include <QStandardPaths>
+
+namespace QInstaller {
+
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::ArchiveChunk
+    \internal
+    \brief The ArchiveChunk struct describes a piece of an archive in a chunked repository.
+
+    Repositories created with the \c --chunks option of repogen store the archives of
+    their components additionally as chunks, which are named after the hex encoded SHA-1
+    checksum of their content. Chunks shared by several archives or versions are stored
+    only once. A manifest next to each archive lists the chunks the archive consists of,
+    so that the installer only needs to download the chunks it does not have yet.
+*/
+
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::ContentChunker
+    \internal
+    \brief The ContentChunker class splits data into chunks at content defined boundaries.
+
+    The boundaries are found with a gear based rolling hash over the last 64 bytes, so
+    they only depend on the data close to them. Inserting or removing data in one place
+    moves the surrounding boundaries along with it and leaves the remaining chunks
+    unchanged. Chunks are between \c MinimumSize and \c MaximumSize bytes long, except
+    for the last one, and 80 KiB on average.
+*/
+
+// A boundary is set where the upper 16 bits of the rolling hash are zero.
+static const quint64 scChunkBoundaryMask = Q_UINT64_C(0xFFFF000000000000);
+static const int scChunkerBufferSize = 4 * ContentChunker::MaximumSize;
+static const char scChunkManifestHeader[] = "IFWChunks 1";
+
+namespace {
+
+// Random values for the rolling hash, generated with a fixed seed so that the chunk
+// boundaries never change between repogen runs.
+struct GearTable
+{
+    GearTable()
+    {
+        quint64 state = Q_UINT64_C(0x2545F4914F6CDD1D);
+        for (int i = 0; i < 256; ++i) {
+            state += Q_UINT64_C(0x9E3779B97F4A7C15);
+            quint64 value = state;
+            value = (value ^ (value >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+            value = (value ^ (value >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+            values[i] = value ^ (value >> 31);
+        }
+    }
+    quint64 values[256];
+};
+
+} // namespace
+
+/*!
+    Creates a chunker that reads its data from \a source, which needs to be open.
+*/
+ContentChunker::ContentChunker(QIODevice *source)
+    : m_source(source)
+    , m_position(0)
+{
+}
+
+/*!
+    Reads the next chunk of the source device into \a chunk. Returns \c false if the end
+    of the data has been reached.
+
+    \note Throws Error if the source device cannot be read.
+*/
+bool ContentChunker::next(QByteArray *chunk)
+{
+    static const GearTable gear;
+
+    fill();
+    const int available = m_buffer.size() - m_position;
+    if (available == 0)
+        return false;
+
+    int length = qMin(available, int(MaximumSize));
+    if (length > MinimumSize) {
+        const uchar *data = reinterpret_cast<const uchar *>(m_buffer.constData()) + m_position;
+        quint64 hash = 0;
+        for (int i = MinimumSize; i < length; ++i) {
+            hash = (hash << 1) + gear.values[data[i]];
+            if (!(hash & scChunkBoundaryMask)) {
+                length = i + 1;
+                break;
+            }
+        }
+    }
+    *chunk = m_buffer.mid(m_position, length);
+    m_position += length;
+    return true;
+}
+
+/*!
+    \internal
+
+    Makes sure that at least \c MaximumSize bytes are buffered, unless the end of the source
+    device is reached before.
+*/
+void ContentChunker::fill()
+{
+    if (m_buffer.size() - m_position >= MaximumSize)
+        return;
+
+    m_buffer.remove(0, m_position);
+    m_position = 0;
+
+    qint64 filled = m_buffer.size();
+    m_buffer.resize(scChunkerBufferSize);
+    while (filled < scChunkerBufferSize) {
+        const qint64 read = m_source->read(m_buffer.data() + filled, scChunkerBufferSize - filled);
+        if (read < 0) {
+            m_buffer.resize(int(filled));
+            throw Error(QCoreApplication::translate("QInstaller", "Read failed after %1 bytes: %2")
+                .arg(QString::number(filled), m_source->errorString()));
+        }
+        if (read == 0)
+            break;
+        filled += read;
+    }
+    m_buffer.resize(int(filled));
+}
+
+/*!
+    Returns the path of the chunk with the hex encoded SHA-1 checksum \a sha1, relative to
+    the chunk directory of a repository or to the local chunk cache.
+*/
+QString archiveChunkPath(const QByteArray &sha1)
+{
+    return QString::fromLatin1("%1/%2").arg(QString::fromLatin1(sha1.left(2)),
+        QString::fromLatin1(sha1));
+}
+
+/*!
+    Returns the manifest listing \a chunks. The manifest is a text file starting with a
+    format line, followed by one line per chunk, which holds the hex encoded SHA-1 checksum
+    and the size of the chunk.
+*/
+QByteArray writeChunkManifest(const QVector<ArchiveChunk> &chunks)
+{
+    QByteArray manifest(scChunkManifestHeader);
+    manifest.append('\n');
+    foreach (const ArchiveChunk &chunk, chunks)
+        manifest.append(chunk.sha1 + ' ' + QByteArray::number(chunk.size) + '\n');
+    return manifest;
+}
+
+/*!
+    Returns the chunks listed in the manifest \a data.
+
+    \note Throws Error if \a data is not a valid chunk manifest.
+*/
+QVector<ArchiveChunk> readChunkManifest(const QByteArray &data)
+{
+    const QList<QByteArray> lines = data.split('\n');
+    if (lines.isEmpty() || lines.first().trimmed() != scChunkManifestHeader) {
+        throw Error(QCoreApplication::translate("QInstaller",
+            "Unsupported chunk manifest format."));
+    }
+
+    QVector<ArchiveChunk> chunks;
+    chunks.reserve(lines.count() - 1);
+    for (int i = 1; i < lines.count(); ++i) {
+        const QByteArray line = lines.at(i).trimmed();
+        if (line.isEmpty())
+            continue;
+
+        const QList<QByteArray> fields = line.split(' ');
+        ArchiveChunk chunk;
+        bool ok = fields.count() == 2 && fields.first().size() == 40;
+        if (ok) {
+            chunk.sha1 = fields.first().toLower();
+            chunk.size = fields.last().toLongLong(&ok);
+        }
+        if (!ok || chunk.size <= 0 || chunk.size > ContentChunker::MaximumSize
+                || QByteArray::fromHex(chunk.sha1).toHex() != chunk.sha1) {
+            throw Error(QCoreApplication::translate("QInstaller",
+                "Invalid entry in line %1 of the chunk manifest.").arg(i + 1));
+        }
+        chunks.append(chunk);
+    }
+    return chunks;
+}
+
+/*!
+    Returns the directory in which the chunks of downloaded archives are kept, so that
+    later updates of the same components do not need to download them again.
+*/
+QString archiveChunkCacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QLatin1String("/qt-installer-framework/chunks");
+}
+
+/*!
+    Removes the chunks from the local chunk cache that have not been used in the last
+    \a maximumAgeInDays days. If the remaining chunks take more than \a maximumSize bytes,
+    removes the least recently used ones until they fit. Chunks are marked as used by
+    updating their modification time.
+*/
+void pruneArchiveChunkCache(int maximumAgeInDays, qint64 maximumSize)
+{
+    const QDateTime oldest = QDateTime::currentDateTimeUtc().addDays(-maximumAgeInDays);
+    QMultiMap<QDateTime, QString> chunks;
+    qint64 size = 0;
+    QDirIterator it(archiveChunkCacheDirectory(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QDateTime lastModified = it.fileInfo().lastModified().toUTC();
+        if (lastModified < oldest) {
+            QFile::remove(it.filePath());
+        } else {
+            chunks.insert(lastModified, it.filePath());
+            size += it.fileInfo().size();
+        }
+    }
+
+    for (auto chunk = chunks.constBegin(); size > maximumSize && chunk != chunks.constEnd(); ++chunk) {
+        const qint64 chunkSize = QFileInfo(chunk.value()).size();
+        if (QFile::remove(chunk.value()))
+            size -= chunkSize;
+    }
+}
+
+} // namespace QInstaller
@@ -0,0 +1,81 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#ifndef ARCHIVECHUNKS_H
+#define ARCHIVECHUNKS_H
+
+#include "installer_global.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+
+namespace QInstaller {
+
+struct INSTALLER_EXPORT ArchiveChunk
+{
+    QByteArray sha1;
+    qint64 size;
+};
+
+class INSTALLER_EXPORT ContentChunker
+{
+    Q_DISABLE_COPY(ContentChunker)
+
+public:
+    enum {
+        MinimumSize = 16 * 1024,
+        MaximumSize = 256 * 1024
+    };
+
+    explicit ContentChunker(QIODevice *source);
+
+    bool next(QByteArray *chunk);
+
+private:
+    void fill();
+
+private:
+    QIODevice *const m_source;
+    QByteArray m_buffer;
+    int m_position;
+};
+
+QString INSTALLER_EXPORT archiveChunkPath(const QByteArray &sha1);
+QByteArray INSTALLER_EXPORT writeChunkManifest(const QVector<ArchiveChunk> &chunks);
+QVector<ArchiveChunk> INSTALLER_EXPORT readChunkManifest(const QByteArray &data);
+
+QString INSTALLER_EXPORT archiveChunkCacheDirectory();
+void INSTALLER_EXPORT pruneArchiveChunkCache(int maximumAgeInDays, qint64 maximumSize);
+
+} // namespace QInstaller
+
+#endif // ARCHIVECHUNKS_H
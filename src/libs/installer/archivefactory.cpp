@@ -142,6 +142,6 @@ ArchiveFactory::ArchiveFactory()
 #ifdef IFW_LIBARCHIVE
     registerArchive<LibArchiveWrapper>(QLatin1String("LibArchive"), QStringList()
         << QLatin1String("tar.gz") << QLatin1String("tar.bz2")
-        << QLatin1String("tar.xz") << QLatin1String("zip") );
+        << QLatin1String("tar.xz") << QLatin1String("tar.zst") << QLatin1String("zip") );
 #endif
 }
@@ -0,0 +1,477 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "archivepatch.h"
+
+#include "errors.h"
+#include "fileio.h"
+#include "fileutils.h"
+#include "utils.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+namespace QInstaller {
+
+// Repositories created with the --patches option of repogen publish a patch archive next to
+// each data archive of an updated component. The patch turns the files extracted from the
+// archive of the previous version into the files of the new archive. It contains a manifest,
+// a binary delta in diff/ for every modified file and the added files in add/. Unchanged
+// files are only listed in the manifest, together with their checksum.
+
+// Size of the blocks of the base file that the delta encoder looks for in the target.
+static const int scDeltaBlockSize = 32;
+// Files larger than this are stored in full instead of as a delta, to bound the memory use.
+static const qint64 scMaximumDeltaFileSize = 64 * 1024 * 1024;
+
+static const quint32 scDeltaMagic = 0x49465744; // "IFWD"
+static const quint32 scDeltaVersion = 1;
+static const char scPatchManifestHeader[] = "IFWPatch 1";
+static const char scPatchManifestName[] = "manifest";
+
+enum DeltaOperation {
+    CopyOperation = 0,
+    InsertOperation = 1
+};
+
+// The weak checksum of rsync, which can be rolled over the data one byte at a time.
+struct RollingChecksum
+{
+    void reset(const uchar *data)
+    {
+        a = 0;
+        b = 0;
+        for (int i = 0; i < scDeltaBlockSize; ++i) {
+            a += data[i];
+            b += quint32(scDeltaBlockSize - i) * data[i];
+        }
+    }
+
+    void roll(uchar out, uchar in)
+    {
+        a += quint32(in) - quint32(out);
+        b += a - quint32(scDeltaBlockSize) * out;
+    }
+
+    quint32 value() const
+    {
+        return ((b & 0xFFFF) << 16) | (a & 0xFFFF);
+    }
+
+    quint32 a;
+    quint32 b;
+};
+
+static void writeInsert(QDataStream &out, const char *data, int length)
+{
+    if (length <= 0)
+        return;
+    out << quint8(InsertOperation) << qint64(length);
+    out.writeRawData(data, length);
+}
+
+/*!
+    Returns a binary delta that turns \a base into \a target when passed to
+    applyBinaryDelta(). Blocks of \a base are located in \a target with a rolling checksum
+    and stored as copy instructions, everything else is stored as is.
+*/
+QByteArray createBinaryDelta(const QByteArray &base, const QByteArray &target)
+{
+    const uchar *baseData = reinterpret_cast<const uchar *>(base.constData());
+    const uchar *targetData = reinterpret_cast<const uchar *>(target.constData());
+    const int baseSize = base.size();
+    const int targetSize = target.size();
+
+    QHash<quint32, int> blocks;
+    blocks.reserve(baseSize / scDeltaBlockSize);
+    RollingChecksum checksum;
+    for (int i = 0; i + scDeltaBlockSize <= baseSize; i += scDeltaBlockSize) {
+        checksum.reset(baseData + i);
+        if (!blocks.contains(checksum.value()))
+            blocks.insert(checksum.value(), i);
+    }
+
+    QByteArray delta;
+    QDataStream out(&delta, QIODevice::WriteOnly);
+    out << scDeltaMagic << scDeltaVersion << qint64(targetSize);
+
+    int pending = 0; // start of the target data not written yet
+    int position = 0;
+    bool checksumValid = false;
+    while (position + scDeltaBlockSize <= targetSize) {
+        if (!checksumValid) {
+            checksum.reset(targetData + position);
+            checksumValid = true;
+        }
+
+        const QHash<quint32, int>::const_iterator block = blocks.constFind(checksum.value());
+        if (block != blocks.constEnd() && memcmp(baseData + block.value(), targetData + position,
+                scDeltaBlockSize) == 0) {
+            // grow the match in both directions as far as the data is the same
+            int baseStart = block.value();
+            int targetStart = position;
+            while (targetStart > pending && baseStart > 0
+                    && baseData[baseStart - 1] == targetData[targetStart - 1]) {
+                --baseStart;
+                --targetStart;
+            }
+            int baseEnd = block.value() + scDeltaBlockSize;
+            int targetEnd = position + scDeltaBlockSize;
+            while (targetEnd < targetSize && baseEnd < baseSize
+                    && baseData[baseEnd] == targetData[targetEnd]) {
+                ++baseEnd;
+                ++targetEnd;
+            }
+
+            writeInsert(out, target.constData() + pending, targetStart - pending);
+            out << quint8(CopyOperation) << qint64(baseStart) << qint64(targetEnd - targetStart);
+            position = pending = targetEnd;
+            checksumValid = false;
+            continue;
+        }
+
+        if (position + scDeltaBlockSize < targetSize)
+            checksum.roll(targetData[position], targetData[position + scDeltaBlockSize]);
+        ++position;
+    }
+    writeInsert(out, target.constData() + pending, targetSize - pending);
+    return delta;
+}
+
+/*!
+    Returns the data created by applying the binary \a delta to \a base.
+
+    \note Throws Error if \a delta is not a valid delta or does not fit \a base.
+*/
+QByteArray applyBinaryDelta(const QByteArray &base, const QByteArray &delta)
+{
+    QDataStream in(delta);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 targetSize = -1;
+    in >> magic >> version >> targetSize;
+    if (in.status() != QDataStream::Ok || magic != scDeltaMagic || version != scDeltaVersion
+            || targetSize < 0 || targetSize > scMaximumDeltaFileSize) {
+        throw Error(QCoreApplication::translate("QInstaller", "Invalid binary delta."));
+    }
+
+    QByteArray target;
+    target.reserve(int(targetSize));
+    while (!in.atEnd()) {
+        quint8 operation = 0;
+        qint64 length = 0;
+        in >> operation;
+        if (operation == CopyOperation) {
+            qint64 offset = -1;
+            in >> offset >> length;
+            if (in.status() != QDataStream::Ok || offset < 0 || length <= 0
+                    || offset + length > base.size() || target.size() + length > targetSize) {
+                break;
+            }
+            target.append(base.constData() + offset, int(length));
+        } else if (operation == InsertOperation) {
+            in >> length;
+            if (in.status() != QDataStream::Ok || length <= 0 || target.size() + length > targetSize)
+                break;
+            const int offset = target.size();
+            target.resize(offset + int(length));
+            if (in.readRawData(target.data() + offset, int(length)) != length)
+                break;
+        } else {
+            break;
+        }
+    }
+
+    if (!in.atEnd() || target.size() != targetSize)
+        throw Error(QCoreApplication::translate("QInstaller", "Invalid binary delta."));
+    return target;
+}
+
+/*!
+    Returns the file name of the patch archive that belongs to the data archive \a archive.
+*/
+QString archivePatchFileName(const QString &archive)
+{
+    return archive + QLatin1String(".patch.7z");
+}
+
+static QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    openForRead(&file);
+    const QByteArray data = file.readAll();
+    if (file.error() != QFile::NoError) {
+        throw Error(QCoreApplication::translate("QInstaller", "Cannot read file \"%1\": %2")
+            .arg(QDir::toNativeSeparators(path), file.errorString()));
+    }
+    return data;
+}
+
+static void writeFile(const QString &path, const QByteArray &data)
+{
+    QInstaller::mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    openForWrite(&file);
+    blockingWrite(&file, data);
+}
+
+static void copyFile(const QString &source, const QString &target)
+{
+    QInstaller::mkpath(QFileInfo(target).absolutePath());
+    QFile file(source);
+    if (!file.copy(target)) {
+        throw Error(QCoreApplication::translate("QInstaller", "Cannot copy file \"%1\" to \"%2\": %3")
+            .arg(QDir::toNativeSeparators(source), QDir::toNativeSeparators(target),
+            file.errorString()));
+    }
+}
+
+// Hard links the unchanged file source to target if they end up with the same permissions,
+// otherwise copies it. The link keeps the content alive once the installed file is removed.
+static void linkOrCopyFile(const QString &source, const QString &target, QFile::Permissions permissions)
+{
+    if (QFileInfo(source).permissions() == permissions) {
+        // linkFile() replaces an existing file that has the same permissions as the source
+        QInstaller::mkpath(QFileInfo(target).absolutePath());
+        QFile placeholder(target);
+        if (placeholder.open(QIODevice::WriteOnly)) {
+            placeholder.close();
+            if (placeholder.setPermissions(permissions) && linkFile(source, target))
+                return;
+            placeholder.remove();
+        }
+    }
+    copyFile(source, target);
+}
+
+static QByteArray fileHash(const QString &path)
+{
+    return calculateHash(path, QCryptographicHash::Sha1).toHex();
+}
+
+// Collects the files and directories below dir, keyed by their path relative to it. Returns
+// false if the tree contains anything a patch cannot describe.
+static bool collectEntries(const QString &dir, QMap<QString, QFileInfo> *entries)
+{
+    const QDir root(dir);
+    QDirIterator it(dir, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+        QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo fi = it.fileInfo();
+        const QString path = root.relativeFilePath(fi.filePath());
+        if (fi.isSymLink() || !(fi.isFile() || fi.isDir()) || path.contains(QLatin1Char('\t'))
+                || path.contains(QLatin1Char('\n'))) {
+            return false;
+        }
+        entries->insert(path, fi);
+    }
+    return true;
+}
+
+/*!
+    Writes a patch to \a patchDir that turns the files in \a baseDir into the files in
+    \a targetDir. Returns \c false if the content of one of the directories cannot be
+    described by a patch, for example because it contains symbolic links.
+
+    \note Throws Error if reading or writing a file fails.
+*/
+bool createArchivePatch(const QString &baseDir, const QString &targetDir, const QString &patchDir)
+{
+    QMap<QString, QFileInfo> baseEntries;
+    QMap<QString, QFileInfo> targetEntries;
+    if (!collectEntries(baseDir, &baseEntries) || !collectEntries(targetDir, &targetEntries))
+        return false;
+
+    QByteArray manifest(scPatchManifestHeader);
+    manifest.append('\n');
+    for (QMap<QString, QFileInfo>::const_iterator it = targetEntries.constBegin();
+            it != targetEntries.constEnd(); ++it) {
+        const QByteArray path = it.key().toUtf8();
+        if (it.value().isDir()) {
+            manifest.append("dir\t" + path + '\n');
+            continue;
+        }
+
+        const QString targetFile = it.value().filePath();
+        const QByteArray sha1 = fileHash(targetFile);
+        const QByteArray permissions = QByteArray::number(int(it.value().permissions()), 16);
+        const QFileInfo base = baseEntries.value(it.key());
+        if (base.isFile()) {
+            const QByteArray baseSha1 = fileHash(base.filePath());
+            if (baseSha1 == sha1) {
+                manifest.append("same\t" + path + '\t' + sha1 + '\t' + permissions + '\n');
+                continue;
+            }
+            if (base.size() <= scMaximumDeltaFileSize && it.value().size() <= scMaximumDeltaFileSize) {
+                const QByteArray delta = createBinaryDelta(readFile(base.filePath()),
+                    readFile(targetFile));
+                if (delta.size() < it.value().size()) {
+                    writeFile(patchDir + QLatin1String("/diff/") + it.key(), delta);
+                    manifest.append("diff\t" + path + '\t' + baseSha1 + '\t' + sha1 + '\t'
+                        + permissions + '\n');
+                    continue;
+                }
+            }
+        }
+        copyFile(targetFile, patchDir + QLatin1String("/add/") + it.key());
+        manifest.append("add\t" + path + '\t' + sha1 + '\t' + permissions + '\n');
+    }
+
+    for (QMap<QString, QFileInfo>::const_iterator it = baseEntries.constBegin();
+            it != baseEntries.constEnd(); ++it) {
+        if (it.value().isFile() && !targetEntries.contains(it.key()))
+            manifest.append("remove\t" + it.key().toUtf8() + '\n');
+    }
+
+    writeFile(patchDir + QLatin1Char('/') + QLatin1String(scPatchManifestName), manifest);
+    return true;
+}
+
+static void verifyFile(const QString &path, const QByteArray &sha1)
+{
+    if (fileHash(path) != sha1) {
+        throw Error(QCoreApplication::translate("QInstaller",
+            "File \"%1\" does not match the checksum in the patch.").arg(QDir::toNativeSeparators(path)));
+    }
+}
+
+/*!
+    Applies the patch in \a patchDir to the files in \a installedDir, which were extracted
+    from the archive the patch is based on, and writes the files of the patched archive to
+    \a targetDir. Every file taken from \a installedDir or created from the patch is
+    verified against the checksum in the manifest. Unchanged files are hard linked instead
+    of copied if both directories are on the same file system.
+
+    \note Throws Error if the patch is invalid or does not fit the files in \a installedDir.
+*/
+void applyArchivePatch(const QString &patchDir, const QString &installedDir, const QString &targetDir)
+{
+    const QList<QByteArray> lines = readFile(patchDir + QLatin1Char('/')
+        + QLatin1String(scPatchManifestName)).split('\n');
+    if (lines.isEmpty() || lines.first() != scPatchManifestHeader)
+        throw Error(QCoreApplication::translate("QInstaller", "Unsupported patch manifest format."));
+
+    for (int i = 1; i < lines.count(); ++i) {
+        if (lines.at(i).isEmpty())
+            continue;
+
+        const QList<QByteArray> fields = lines.at(i).split('\t');
+        const QByteArray type = fields.first();
+        const QString path = fields.count() > 1 ? QString::fromUtf8(fields.at(1)) : QString();
+        const QString cleanPath = QDir::cleanPath(path);
+        if (cleanPath.isEmpty() || QDir::isAbsolutePath(cleanPath) || cleanPath == QLatin1String("..")
+                || cleanPath.startsWith(QLatin1String("../"))) {
+            throw Error(QCoreApplication::translate("QInstaller",
+                "Invalid entry in line %1 of the patch manifest.").arg(i + 1));
+        }
+
+        const QString target = targetDir + QLatin1Char('/') + cleanPath;
+        const QString installed = installedDir + QLatin1Char('/') + cleanPath;
+        bool ok = false;
+        const int permissions = fields.last().toInt(&ok, 16);
+        if (type == "dir" && fields.count() == 2) {
+            QInstaller::mkpath(target);
+            continue;
+        } else if (type == "remove" && fields.count() == 2) {
+            continue; // the file is not part of the patched archive
+        } else if (type == "same" && fields.count() == 4) {
+            verifyFile(installed, fields.at(2));
+            linkOrCopyFile(installed, target, QFile::Permissions(permissions));
+        } else if (type == "diff" && fields.count() == 5) {
+            verifyFile(installed, fields.at(2));
+            writeFile(target, applyBinaryDelta(readFile(installed),
+                readFile(patchDir + QLatin1String("/diff/") + cleanPath)));
+            verifyFile(target, fields.at(3));
+        } else if (type == "add" && fields.count() == 4) {
+            copyFile(patchDir + QLatin1String("/add/") + cleanPath, target);
+            verifyFile(target, fields.at(2));
+        } else {
+            throw Error(QCoreApplication::translate("QInstaller",
+                "Invalid entry in line %1 of the patch manifest.").arg(i + 1));
+        }
+
+        if (!ok || !QFile::setPermissions(target, QFile::Permissions(permissions))) {
+            throw Error(QCoreApplication::translate("QInstaller",
+                "Cannot set the permissions of file \"%1\".").arg(QDir::toNativeSeparators(target)));
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Keeps the patched archives whose files were written to a directory instead of an
+    archive, so that the Extract operation can move them into place.
+*/
+class PatchedArchives
+{
+public:
+    void insert(const QString &archive, const QString &directory)
+    {
+        QMutexLocker _(&m_mutex);
+        m_directories.insert(archive, directory);
+    }
+
+    QString take(const QString &archive)
+    {
+        QMutexLocker _(&m_mutex);
+        return m_directories.take(archive);
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<QString, QString> m_directories;
+};
+Q_GLOBAL_STATIC(PatchedArchives, patchedArchives)
+
+/*!
+    Registers \a directory as holding the files of the patched archive \a archive, as
+    written by applyArchivePatch().
+*/
+void registerPatchedArchive(const QString &archive, const QString &directory)
+{
+    patchedArchives()->insert(archive, directory);
+}
+
+/*!
+    Returns the directory holding the files of the patched archive \a archive and forgets
+    about it, or an empty string if \a archive was not patched.
+*/
+QString takePatchedArchive(const QString &archive)
+{
+    return patchedArchives()->take(archive);
+}
+
+} // namespace QInstaller
@@ -0,0 +1,53 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#ifndef ARCHIVEPATCH_H
+#define ARCHIVEPATCH_H
+
+#include "installer_global.h"
+
+#include <QByteArray>
+#include <QString>
+
+namespace QInstaller {
+
+QByteArray INSTALLER_EXPORT createBinaryDelta(const QByteArray &base, const QByteArray &target);
+QByteArray INSTALLER_EXPORT applyBinaryDelta(const QByteArray &base, const QByteArray &delta);
+
+QString INSTALLER_EXPORT archivePatchFileName(const QString &archive);
+bool INSTALLER_EXPORT createArchivePatch(const QString &baseDir, const QString &targetDir,
+    const QString &patchDir);
+void INSTALLER_EXPORT applyArchivePatch(const QString &patchDir, const QString &installedDir,
+    const QString &targetDir);
+
+void INSTALLER_EXPORT registerPatchedArchive(const QString &archive, const QString &directory);
+QString INSTALLER_EXPORT takePatchedArchive(const QString &archive);
+
+} // namespace QInstaller
+
+#endif // ARCHIVEPATCH_H
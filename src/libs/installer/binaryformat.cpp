@@ -35,6 +35,11 @@
 #include <QFlags>
 #include <QUuid>
 
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace QInstaller {
 
 /*!
@@ -224,19 +229,46 @@ qint64 Resource::writeData(const char* data, qint64 maxSize)
     \overload
 
     Copies the resource data of \a resource to a file called \a out. Throws Error on failure.
+
+    On Linux the data is copied inside the kernel if both files support it, which lets file
+    systems supporting it share the data blocks instead of copying them.
 */
 void Resource::copyData(Resource *resource, QFileDevice *out)
 {
     qint64 left = resource->size();
-    char data[4096];
+#if defined(Q_OS_LINUX) && defined(SYS_copy_file_range)
+    const int inFd = resource->m_file.handle();
+    const int outFd = out->handle();
+    if (inFd != -1 && outFd != -1 && out->flush()) {
+        loff_t inOffset = resource->m_segment.start() + resource->pos();
+        loff_t outOffset = out->pos();
+        while (left > 0) {
+            const ssize_t copied = ::syscall(SYS_copy_file_range, inFd, &inOffset, outFd,
+                &outOffset, size_t(qMin<qint64>(left, 1 << 30)), 0u);
+            if (copied <= 0)
+                break; // not supported for these files, copy the rest below
+            left -= copied;
+        }
+        if (left < resource->size()) {
+            resource->seek(resource->pos() + resource->size() - left);
+            if (!out->seek(outOffset)) {
+                throw QInstaller::Error(tr("Write failed after %1 bytes: %2")
+                    .arg(QString::number(resource->size() - left), out->errorString()));
+            }
+        }
+    }
+#endif
+
+    static const qint64 blockSize = 1024 * 1024;
+    QByteArray data(int(qMin(blockSize, left)), '\0');
     while (left > 0) {
-        const qint64 len = qMin<qint64>(left, 4096);
-        const qint64 bytesRead = resource->read(data, len);
+        const qint64 len = qMin<qint64>(left, blockSize);
+        const qint64 bytesRead = resource->read(data.data(), len);
         if (bytesRead != len) {
             throw QInstaller::Error(tr("Read failed after %1 bytes: %2")
                 .arg(QString::number(resource->size() - left), resource->errorString()));
         }
-        const qint64 bytesWritten = out->write(data, len);
+        const qint64 bytesWritten = out->write(data.constData(), len);
         if (bytesWritten != len) {
             throw QInstaller::Error(tr("Write failed after %1 bytes: %2")
                 .arg(QString::number(resource->size() - left), out->errorString()));
@@ -396,6 +428,7 @@ Range<qint64> ResourceCollectionManager::write(QFileDevice *out, qint64 offset)
                     .arg(QString::fromUtf8(resource->name()), resource->errorString()));
             }
             resource->copyData(out);
+            resource->close(); // keeps the number of open files low for large collections
         }
 
         table.insert(collection.name(), Range<qint64>::fromStartAndEnd(dataBegin, out->pos())
@@ -39,6 +39,22 @@ namespace QInstaller {
         resource files.
 */
 
+static void splitResourceFileName(const QString &fileName, QByteArray *collectionName,
+    QByteArray *resourceName)
+{
+    static const QChar sep = QChar::fromLatin1('/');
+    static const QString prefix = QString::fromLatin1("installer://");
+    Q_ASSERT(fileName.toLower().startsWith(prefix));
+
+    // cut the prefix
+    QString path = fileName.mid(prefix.length());
+    while (path.endsWith(sep))
+        path.chop(1);
+
+    *resourceName = path.section(sep, 1, 1).toUtf8();
+    *collectionName = path.section(sep, 0, 0).toUtf8();
+}
+
 /*!
     Creates a file engine for the file specified by \a fileName. To be able to create a file
     engine, the file name needs to be prefixed with \c {installer://}.
@@ -89,17 +105,9 @@ void BinaryFormatEngineHandler::registerResources(const QList<ResourceCollection
 void
 BinaryFormatEngineHandler::registerResource(const QString &fileName, const QString &resourcePath)
 {
-    static const QChar sep = QChar::fromLatin1('/');
-    static const QString prefix = QString::fromLatin1("installer://");
-    Q_ASSERT(fileName.toLower().startsWith(prefix));
-
-    // cut the prefix
-    QString path = fileName.mid(prefix.length());
-    while (path.endsWith(sep))
-        path.chop(1);
-
-    const QByteArray resourceName = path.section(sep, 1, 1).toUtf8();
-    const QByteArray collectionName = path.section(sep, 0, 0).toUtf8();
+    QByteArray collectionName;
+    QByteArray resourceName;
+    splitResourceFileName(fileName, &collectionName, &resourceName);
 
     if (!ProductKeyCheck::instance()->isValidPackage(QString::fromUtf8(collectionName)))
         return;
@@ -109,4 +117,28 @@ BinaryFormatEngineHandler::registerResource(const QString &fileName, const QStri
         resourceName)));
 }
 
+/*!
+    Removes the resource specified by \a fileName, which was registered with
+    registerResource() before. The file name \a fileName must be in the form of
+    \c {installer://}, followed by the collection name and resource name separated by
+    a forward slash.
+*/
+void BinaryFormatEngineHandler::unregisterResource(const QString &fileName)
+{
+    QByteArray collectionName;
+    QByteArray resourceName;
+    splitResourceFileName(fileName, &collectionName, &resourceName);
+
+    const QHash<QByteArray, ResourceCollection>::iterator it = m_resources.find(collectionName);
+    if (it == m_resources.end())
+        return;
+
+    ResourceCollection collection(collectionName);
+    foreach (const QSharedPointer<Resource> &resource, it.value().resources()) {
+        if (resource->name() != resourceName)
+            collection.appendResource(resource);
+    }
+    it.value() = collection;
+}
+
 } // namespace QInstaller
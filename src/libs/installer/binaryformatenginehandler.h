@@ -47,6 +47,7 @@ public:
 
     void registerResources(const QList<ResourceCollection> &collections);
     void registerResource(const QString &fileName, const QString &resourcePath);
+    void unregisterResource(const QString &fileName);
 
 private:
     BinaryFormatEngineHandler() {}
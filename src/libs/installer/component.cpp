@@ -326,6 +326,12 @@ void Component::loadDataFromPackage(const Package &package)
     setValue(scInheritVersion, package.data(scInheritVersion).toString());
     setValue(scDependencies, package.data(scDependencies).toString());
     setValue(scDownloadableArchives, package.data(scDownloadableArchives).toString());
+    setValue(scArchiveEntries, package.data(scArchiveEntries).toString());
+    setValue(scArchiveRoots, package.data(scArchiveRoots).toString());
+    setValue(scEntryHashes, package.data(scEntryHashes).toString());
+    setValue(scChunkedArchives, package.data(scChunkedArchives).toString());
+    setValue(scPatchBaseVersion, package.data(scPatchBaseVersion).toString());
+    setValue(scPatchArchives, package.data(scPatchArchives).toString());
     setValue(scVirtual, package.data(scVirtual).toString());
     setValue(scSortingPriority, package.data(scSortingPriority).toString());
 
@@ -354,16 +360,16 @@ void Component::loadDataFromPackage(const Package &package)
     const QStringList uis = package.data(QLatin1String("UserInterfaces")).toString()
         .split(QInstaller::commaRegExp(), QString::SkipEmptyParts);
     if (!uis.isEmpty())
-        loadUserInterfaces(QDir(QString::fromLatin1("%1/%2").arg(localTempPath(), name())), uis);
+        loadUserInterfaces(QDir(metaDataPath()), uis);
 #ifndef IFW_DISABLE_TRANSLATIONS
     const QStringList qms = package.data(QLatin1String("Translations")).toString()
         .split(QInstaller::commaRegExp(), QString::SkipEmptyParts);
     if (!qms.isEmpty())
-        loadTranslations(QDir(QString::fromLatin1("%1/%2").arg(localTempPath(), name())), qms);
+        loadTranslations(QDir(metaDataPath()), qms);
 #endif
     QHash<QString, QVariant> licenseHash = package.data(QLatin1String("Licenses")).toHash();
     if (!licenseHash.isEmpty())
-        loadLicenses(QString::fromLatin1("%1/%2/").arg(localTempPath(), name()), licenseHash);
+        loadLicenses(metaDataPath() + QLatin1Char('/'), licenseHash);
     QVariant operationsVariant = package.data(QLatin1String("Operations"));
     if (operationsVariant.canConvert<QList<QPair<QString, QVariant>>>())
         m_operationsList = operationsVariant.value<QList<QPair<QString, QVariant>>>();
@@ -563,7 +569,7 @@ void Component::loadComponentScript()
 {
     const QString script = d->m_vars.value(scScriptTag);
     if (!localTempPath().isEmpty() && !script.isEmpty())
-        loadComponentScript(QString::fromLatin1("%1/%2/%3").arg(localTempPath(), name(), script));
+        loadComponentScript(QString::fromLatin1("%1/%2").arg(metaDataPath(), script));
 }
 
 /*!
@@ -869,11 +875,28 @@ void Component::createOperationsForArchive(const QString &archive)
     const bool isZip = (archiveFile && archiveFile->open(QIODevice::ReadOnly) && archiveFile->isSupported());
 
     if (isZip) {
+        QStringList arguments;
         // component.xml can override this value
         if (m_archivesHash.contains(archive))
-            addOperation(QLatin1String("Extract"), QStringList() << archive << m_archivesHash.value(archive));
+            arguments << archive << m_archivesHash.value(archive);
         else
-            addOperation(QLatin1String("Extract"), QStringList() << archive << m_defaultArchivePath);
+            arguments << archive << m_defaultArchivePath;
+
+        // repogen records the number of entries of each archive, pass it on so that the
+        // operation does not need to scan the archive before extracting it
+        const QString version = value(scVersion);
+        const QString archiveName = fi.fileName().startsWith(version)
+            ? fi.fileName().mid(version.length()) : fi.fileName();
+        const QStringList archiveEntries = value(scArchiveEntries)
+            .split(QLatin1Char(','), QString::SkipEmptyParts);
+        foreach (const QString &archiveEntry, archiveEntries) {
+            const QStringList fields = archiveEntry.trimmed().split(QLatin1Char(':'));
+            if (fields.count() > 1 && fields.first() == archiveName) {
+                arguments << fields.at(1);
+                break;
+            }
+        }
+        addOperation(QLatin1String("Extract"), arguments);
     } else {
         createOperationsForPath(archive);
     }
@@ -1615,6 +1638,31 @@ void Component::setLocalTempPath(const QString &tempLocalPath)
     d->m_localTempPath = tempLocalPath;
 }
 
+/*!
+    Returns the path to the directory holding the meta information of the component, like
+    its script, user interfaces, translations and licenses. Unless set otherwise, this is
+    the subdirectory of localTempPath() named after the component.
+
+    \sa setMetaDataPath()
+*/
+QString Component::metaDataPath() const
+{
+    if (!d->m_metaDataPath.isEmpty())
+        return d->m_metaDataPath;
+    return QString::fromLatin1("%1/%2").arg(localTempPath(), name());
+}
+
+/*!
+    Sets the directory holding the meta information of the component to \a path. Used if
+    the meta information is shared with an identical package from another repository.
+
+    \sa metaDataPath()
+*/
+void Component::setMetaDataPath(const QString &path)
+{
+    d->m_metaDataPath = path;
+}
+
 void Component::updateModelData(const QString &key, const QString &data)
 {
     if (key == scVirtual) {
@@ -171,6 +171,8 @@ public:
 
     void languageChanged();
     QString localTempPath() const;
+    QString metaDataPath() const;
+    void setMetaDataPath(const QString &path);
 
     bool autoCreateOperations() const;
     bool operationsCreatedSuccessfully() const;
@@ -68,6 +68,7 @@ public:
     QString m_componentName;
     QUrl m_repositoryUrl;
     QString m_localTempPath;
+    QString m_metaDataPath;
     QJSValue m_scriptContext;
     QHash<QString, QString> m_vars;
     QList<Component*> m_childComponents;
@@ -50,6 +50,12 @@ static const QLatin1String scRemoteDisplayVersion("RemoteDisplayVersion");
 static const QLatin1String scInheritVersion("inheritVersionFrom");
 static const QLatin1String scReplaces("Replaces");
 static const QLatin1String scDownloadableArchives("DownloadableArchives");
+static const QLatin1String scArchiveEntries("ArchiveEntries");
+static const QLatin1String scArchiveRoots("ArchiveRoots");
+static const QLatin1String scEntryHashes("EntryHashes");
+static const QLatin1String scChunkedArchives("ChunkedArchives");
+static const QLatin1String scPatchBaseVersion("PatchBaseVersion");
+static const QLatin1String scPatchArchives("PatchArchives");
 static const QLatin1String scEssential("Essential");
 static const QLatin1String scForcedUpdate("ForcedUpdate");
 static const QLatin1String scTargetDir("TargetDir");
@@ -29,6 +29,9 @@
 
 #include "binaryformatenginehandler.h"
 #include "component.h"
+#include "constants.h"
+#include "errors.h"
+#include "fileio.h"
 #include "messageboxhandler.h"
 #include "packagemanagercore.h"
 #include "utils.h"
@@ -37,12 +40,21 @@
 #include "filedownloader.h"
 #include "filedownloaderfactory.h"
 
-#include <QtCore/QFile>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
 #include <QtCore/QTimerEvent>
 
 using namespace QInstaller;
 using namespace KDUpdater;
 
+// Chunks that were not used by any download for this long get removed from the local cache.
+static const int scChunkCacheDays = 30;
+// The local chunk cache is trimmed to this size, least recently used chunks first.
+static const qint64 scChunkCacheSize = Q_INT64_C(2) * 1024 * 1024 * 1024;
+// Number of chunks downloaded at the same time, below the per host connection limit of
+// QNetworkAccessManager.
+static const int scParallelChunkDownloads = 4;
 
 /*!
     Creates a new DownloadArchivesJob with parent \a core.
@@ -58,6 +70,9 @@ DownloadArchivesJob::DownloadArchivesJob(PackageManagerCore *core)
     , m_progressChangedTimerId(0)
     , m_totalSizeToDownload(0)
     , m_totalSizeDownloaded(0)
+    , m_chunkedArchiveSize(0)
+    , m_chunkedArchiveAvailable(0)
+    , m_chunksUsed(false)
 {
     setCapabilities(Cancelable);
 }
@@ -67,6 +82,7 @@ DownloadArchivesJob::DownloadArchivesJob(PackageManagerCore *core)
 */
 DownloadArchivesJob::~DownloadArchivesJob()
 {
+    abortChunkDownloads();
     if (m_downloader)
         m_downloader->deleteLater();
 }
@@ -105,6 +121,7 @@ void DownloadArchivesJob::doStart()
 void DownloadArchivesJob::doCancel()
 {
     m_canceled = true;
+    abortChunkDownloads();
     if (m_downloader != nullptr)
         m_downloader->cancelDownload();
 }
@@ -118,7 +135,7 @@ void DownloadArchivesJob::fetchNextArchiveHash()
         }
 
         if (m_archivesToDownload.isEmpty()) {
-            emitFinished();
+            finishDownloads();
             return;
         }
 
@@ -154,7 +171,8 @@ void DownloadArchivesJob::finishedHashDownload()
 }
 
 /*!
-    Fetches the next archive and registers it in the installer.
+    Fetches the next archive and registers it in the installer. If the repository stores
+    the archive in chunks, fetches the list of chunks instead.
 */
 void DownloadArchivesJob::fetchNextArchive()
 {
@@ -164,14 +182,18 @@ void DownloadArchivesJob::fetchNextArchive()
     }
 
     if (m_archivesToDownload.isEmpty()) {
-        emitFinished();
+        finishDownloads();
         return;
     }
 
     if (m_downloader != nullptr)
         m_downloader->deleteLater();
 
-    m_downloader = setupDownloader(QString(), m_core->value(scUrlQueryString));
+    m_chunks.clear();
+    const Component *const component = currentComponent();
+    const bool chunked = component && component->value(scChunkedArchives) == scTrue;
+    m_downloader = setupDownloader(chunked ? QLatin1String(".chunks") : QString(),
+        m_core->value(scUrlQueryString));
     if (!m_downloader) {
         m_archivesToDownload.removeFirst();
         QMetaObject::invokeMethod(this, "fetchNextArchiveHash", Qt::QueuedConnection);
@@ -179,13 +201,297 @@ void DownloadArchivesJob::fetchNextArchive()
     }
 
     emit progressChanged(double(m_archivesDownloaded) / m_archivesToDownloadCount);
-    connect(m_downloader, SIGNAL(downloadProgress(double)), this, SLOT(emitDownloadProgress(double)));
-    connect(m_downloader, &FileDownloader::downloadCompleted,
-            this, &DownloadArchivesJob::registerFile, Qt::QueuedConnection);
+    if (chunked) {
+        connect(m_downloader, &FileDownloader::downloadCompleted,
+                this, &DownloadArchivesJob::finishedManifestDownload, Qt::QueuedConnection);
+    } else {
+        connect(m_downloader, SIGNAL(downloadProgress(double)), this, SLOT(emitDownloadProgress(double)));
+        connect(m_downloader, &FileDownloader::downloadCompleted,
+                this, &DownloadArchivesJob::registerFile, Qt::QueuedConnection);
+    }
 
     m_downloader->download();
 }
 
+/*!
+    Reads the list of chunks of the current archive and downloads the chunks missing from
+    the local chunk cache. If most of the archive is missing, downloads the complete archive
+    instead, as that needs far fewer requests.
+*/
+void DownloadArchivesJob::finishedManifestDownload()
+{
+    Q_ASSERT(m_downloader != nullptr);
+
+    if (m_canceled)
+        return;
+
+    const Component *const component = currentComponent();
+    if (!component) {
+        finishWithError(tr("Cannot find component for %1.").arg(m_archivesToDownload.first().first));
+        return;
+    }
+
+    try {
+        QFile manifest(m_downloader->downloadedFileName());
+        QInstaller::openForRead(&manifest);
+        m_chunks = readChunkManifest(manifest.readAll());
+        manifest.close();
+        manifest.remove();
+    } catch (const Error &error) {
+        finishWithError(error.message());
+        return;
+    }
+
+    m_chunksUsed = true;
+    m_chunkFiles.clear();
+    m_missingChunks.clear();
+    m_chunkedArchiveSize = 0;
+    m_chunkedArchiveAvailable = 0;
+
+    const QString cacheDir = archiveChunkCacheDirectory();
+    quint64 missingSize = 0;
+    foreach (const ArchiveChunk &chunk, m_chunks) {
+        m_chunkedArchiveSize += chunk.size;
+        if (m_chunkFiles.contains(chunk.sha1))
+            continue;
+        const QString cachePath = cacheDir + QLatin1Char('/') + archiveChunkPath(chunk.sha1);
+        m_chunkFiles.insert(chunk.sha1, cachePath);
+        if (QFileInfo(cachePath).size() == chunk.size) {
+            m_chunkedArchiveAvailable += chunk.size;
+        } else {
+            m_missingChunks.append(chunk);
+            missingSize += chunk.size;
+        }
+    }
+
+    const QString archiveName = QFileInfo(m_archivesToDownload.first().first).fileName();
+    if (missingSize * 2 > m_chunkedArchiveSize) {
+        // the chunks are kept once the archive is there, so the next update can use them
+        m_downloader->deleteLater();
+        m_downloader = setupDownloader(QString(), m_core->value(scUrlQueryString));
+        if (!m_downloader) {
+            m_archivesToDownload.removeFirst();
+            QMetaObject::invokeMethod(this, "fetchNextArchiveHash", Qt::QueuedConnection);
+            return;
+        }
+        connect(m_downloader, SIGNAL(downloadProgress(double)), this, SLOT(emitDownloadProgress(double)));
+        connect(m_downloader, &FileDownloader::downloadCompleted,
+                this, &DownloadArchivesJob::registerFile, Qt::QueuedConnection);
+        m_downloader->download();
+        return;
+    }
+
+    m_totalSizeToDownload -= qMin(m_totalSizeToDownload, m_chunkedArchiveSize - missingSize);
+    m_chunkBaseUrl = QUrl(m_archivesToDownload.first().second).resolved(QUrl(QLatin1String("../chunks/")));
+    emit outputTextChanged(tr("Downloading %n missing chunk(s) of archive \"%1\" for component %2.", "",
+        m_missingChunks.count()).arg(archiveName, component->displayName()));
+    fetchMissingChunks();
+}
+
+/*!
+    Starts downloading the next missing chunks of the current archive, at most
+    scParallelChunkDownloads at a time. Assembles the archive once no chunk is missing.
+*/
+void DownloadArchivesJob::fetchMissingChunks()
+{
+    if (m_canceled) {
+        finishWithError(tr("Canceled"));
+        return;
+    }
+
+    const Component *const component = currentComponent();
+    const QString queryString = m_core->value(scUrlQueryString);
+    while (m_chunkDownloads.count() < scParallelChunkDownloads && !m_missingChunks.isEmpty()) {
+        const ArchiveChunk chunk = m_missingChunks.takeFirst();
+        QUrl url = m_chunkBaseUrl.resolved(QUrl(archiveChunkPath(chunk.sha1)));
+        if (!queryString.isEmpty())
+            url.setQuery(queryString);
+        KDUpdater::FileDownloader *const downloader = component ? createDownloader(url, component) : nullptr;
+        if (!downloader) {
+            abortChunkDownloads();
+            finishWithError(tr("Scheme %1 not supported (URL: %2).").arg(url.scheme(), url.toString()));
+            return;
+        }
+        if (FileDownloaderFactory::isSupportedScheme(url.scheme())) {
+            const QString chunkDir = component->localTempPath() + QLatin1Char('/')
+                + component->name() + QLatin1String("/chunks");
+            QDir().mkpath(chunkDir);
+            downloader->setDownloadedFileName(chunkDir + QLatin1Char('/') + QString::fromLatin1(chunk.sha1));
+        }
+
+        connect(downloader, &FileDownloader::downloadCompleted,
+                this, &DownloadArchivesJob::finishedChunkDownload, Qt::QueuedConnection);
+        m_chunkDownloads.insert(downloader, chunk);
+        downloader->download();
+    }
+
+    if (m_chunkDownloads.isEmpty())
+        assembleChunkedArchive();
+}
+
+/*!
+    Verifies the just downloaded chunk and keeps it in the local chunk cache, then
+    continues with the remaining chunks.
+*/
+void DownloadArchivesJob::finishedChunkDownload()
+{
+    KDUpdater::FileDownloader *const downloader = qobject_cast<KDUpdater::FileDownloader *>(sender());
+    if (m_canceled || !m_chunkDownloads.contains(downloader))
+        return;
+
+    const ArchiveChunk chunk = m_chunkDownloads.take(downloader);
+    QFile downloaded(downloader->downloadedFileName());
+    downloader->deleteLater();
+    try {
+        QInstaller::openForRead(&downloaded);
+        const QByteArray data = downloaded.read(chunk.size + 1);
+        downloaded.close();
+        if (data.size() != chunk.size
+                || QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex() != chunk.sha1) {
+            downloaded.remove();
+            abortChunkDownloads();
+            finishWithError(tr("Hash verification of chunk %1 failed.")
+                .arg(QString::fromLatin1(chunk.sha1)));
+            return;
+        }
+    } catch (const Error &error) {
+        abortChunkDownloads();
+        finishWithError(error.message());
+        return;
+    }
+    m_totalSizeDownloaded += chunk.size;
+    m_chunkedArchiveAvailable += chunk.size;
+    if (m_chunkedArchiveSize > 0)
+        emitDownloadProgress(double(m_chunkedArchiveAvailable) / m_chunkedArchiveSize);
+
+    // keeping the chunk is optional, the cache might not be writable
+    const QString cachePath = m_chunkFiles.value(chunk.sha1);
+    QFile::remove(cachePath);
+    if (!QDir().mkpath(QFileInfo(cachePath).path()) || !downloaded.rename(cachePath))
+        m_chunkFiles.insert(chunk.sha1, downloaded.fileName());
+
+    fetchMissingChunks();
+}
+
+/*!
+    \internal
+
+    Writes the chunks of the current archive in order to the place a download of the archive
+    would have been stored to, and registers the archive. A damaged chunk in the local cache
+    is removed and downloaded again.
+*/
+void DownloadArchivesJob::assembleChunkedArchive()
+{
+    const Component *const component = currentComponent();
+    if (!component) {
+        finishWithError(tr("Cannot find component for %1.").arg(m_archivesToDownload.first().first));
+        return;
+    }
+
+    const QString cacheDir = archiveChunkCacheDirectory();
+    QFile archive(component->localTempPath() + QLatin1Char('/') + component->name() + QLatin1Char('/')
+        + QFileInfo(m_archivesToDownload.first().first).fileName());
+    QCryptographicHash archiveHash(QCryptographicHash::Sha1);
+    try {
+        QInstaller::mkpath(QFileInfo(archive).path());
+        QInstaller::openForWrite(&archive);
+        foreach (const ArchiveChunk &chunk, m_chunks) {
+            QFile chunkFile(m_chunkFiles.value(chunk.sha1));
+            const bool cached = chunkFile.fileName().startsWith(cacheDir);
+            const QByteArray data = chunkFile.open(QIODevice::ReadOnly) ? chunkFile.read(chunk.size + 1)
+                                                                        : QByteArray();
+            if (data.size() != chunk.size
+                    || QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex() != chunk.sha1) {
+                if (!cached)
+                    throw Error(tr("Hash verification of chunk %1 failed.").arg(QString::fromLatin1(chunk.sha1)));
+                // damaged, download it again
+                chunkFile.close();
+                chunkFile.remove();
+                archive.close();
+                archive.remove();
+                m_chunkedArchiveAvailable -= qMin(m_chunkedArchiveAvailable, quint64(chunk.size));
+                m_missingChunks.append(chunk);
+                fetchMissingChunks();
+                return;
+            }
+            if (cached) {
+                // mark the chunk as used, so that it does not get pruned from the cache
+                chunkFile.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+            }
+            chunkFile.close();
+
+            QInstaller::blockingWrite(&archive, data);
+            archiveHash.addData(data);
+        }
+        archive.close();
+    } catch (const Error &error) {
+        finishWithError(error.message());
+        return;
+    }
+
+    // chunks that could not be put into the cache are not needed anymore
+    foreach (const QString &chunkFile, m_chunkFiles) {
+        if (!chunkFile.startsWith(cacheDir))
+            QFile::remove(chunkFile);
+    }
+    m_chunkFiles.clear();
+    registerArchive(archive.fileName(), archiveHash.result(), 0);
+}
+
+/*!
+    \internal
+
+    Cancels and forgets the running chunk downloads.
+*/
+void DownloadArchivesJob::abortChunkDownloads()
+{
+    m_missingChunks.clear();
+    const QList<KDUpdater::FileDownloader *> downloaders = m_chunkDownloads.keys();
+    m_chunkDownloads.clear();
+    foreach (KDUpdater::FileDownloader *downloader, downloaders) {
+        disconnect(downloader, nullptr, this, nullptr);
+        downloader->cancelDownload();
+        downloader->deleteLater();
+    }
+}
+
+/*!
+    \internal
+
+    Puts the chunks of the just downloaded archive \a fileName into the local chunk cache,
+    so that later updates of the archive only need to download the chunks that changed.
+*/
+void DownloadArchivesJob::storeArchiveChunks(const QString &fileName)
+{
+    QFile archive(fileName);
+    if (!archive.open(QIODevice::ReadOnly) || quint64(archive.size()) != m_chunkedArchiveSize)
+        return;
+
+    const QString cacheDir = archiveChunkCacheDirectory();
+    foreach (const ArchiveChunk &chunk, m_chunks) {
+        const QByteArray data = archive.read(chunk.size);
+        if (data.size() != chunk.size
+                || QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex() != chunk.sha1) {
+            return;
+        }
+        const QString cachePath = cacheDir + QLatin1Char('/') + archiveChunkPath(chunk.sha1);
+        if (QFileInfo(cachePath).size() == chunk.size)
+            continue;
+
+        // written under a temporary name, so that a partial chunk is never used
+        QFile cached(cachePath + QLatin1String(".part"));
+        if (!QDir().mkpath(QFileInfo(cachePath).path()) || !cached.open(QIODevice::WriteOnly))
+            return;
+        const bool written = (cached.write(data) == data.size());
+        cached.close();
+        QFile::remove(cachePath);
+        if (!written || !cached.rename(cachePath)) {
+            cached.remove();
+            return;
+        }
+    }
+}
+
 /*!
     Emits the global download \a progress during a single download in a lazy way (uses a timer to reduce to
     much processChanged).
@@ -283,7 +589,25 @@ void DownloadArchivesJob::registerFile()
     if (m_canceled)
         return;
 
-    if (m_core->testChecksum() && m_currentHash != m_downloader->sha1Sum().toHex()) {
+    // a chunked archive that was downloaded as a whole
+    if (!m_chunks.isEmpty() && (!m_core->testChecksum() || m_currentHash == m_downloader->sha1Sum().toHex()))
+        storeArchiveChunks(m_downloader->downloadedFileName());
+
+    registerArchive(m_downloader->downloadedFileName(), m_downloader->sha1Sum(),
+        QFile(m_downloader->downloadedFileName()).size());
+}
+
+/*!
+    \internal
+
+    Verifies the downloaded archive \a fileName against its expected checksum using
+    \a sha1Sum and registers it in the installer's file system. \a downloadedSize is
+    added to the number of bytes downloaded in total.
+*/
+void DownloadArchivesJob::registerArchive(const QString &fileName, const QByteArray &sha1Sum,
+    quint64 downloadedSize)
+{
+    if (m_core->testChecksum() && m_currentHash != sha1Sum.toHex()) {
         //TODO: Maybe we should try to download the file again automatically
         const QMessageBox::Button res =
             MessageBoxHandler::critical(MessageBoxHandler::currentBestSuitParent(),
@@ -300,7 +624,7 @@ void DownloadArchivesJob::registerFile()
         }
     } else {
         ++m_archivesDownloaded;
-        m_totalSizeDownloaded += QFile(m_downloader->downloadedFileName()).size();
+        m_totalSizeDownloaded += downloadedSize;
         if (m_progressChangedTimerId) {
             killTimer(m_progressChangedTimerId);
             m_progressChangedTimerId = 0;
@@ -308,12 +632,24 @@ void DownloadArchivesJob::registerFile()
         }
 
         const QPair<QString, QString> pair = m_archivesToDownload.takeFirst();
-        BinaryFormatEngineHandler::instance()->registerResource(pair.first,
-            m_downloader->downloadedFileName());
+        BinaryFormatEngineHandler::instance()->registerResource(pair.first, fileName);
     }
     fetchNextArchiveHash();
 }
 
+/*!
+    \internal
+
+    Finishes the job once all archives are downloaded. Removes chunks that were not used
+    for a while from the local chunk cache, if any archive was assembled from chunks.
+*/
+void DownloadArchivesJob::finishDownloads()
+{
+    if (m_chunksUsed)
+        pruneArchiveChunkCache(scChunkCacheDays, scChunkCacheSize);
+    emitFinished();
+}
+
 void DownloadArchivesJob::downloadCanceled()
 {
     emitFinishedWithError(Job::Canceled, m_downloader->errorString());
@@ -324,6 +660,8 @@ void DownloadArchivesJob::downloadFailed(const QString &error)
     if (m_canceled)
         return;
 
+    abortChunkDownloads();
+
     const QMessageBox::StandardButton b =
         MessageBoxHandler::critical(MessageBoxHandler::currentBestSuitParent(),
         QLatin1String("archiveDownloadError"), tr("Download Error"), tr("Cannot download archive %1: %2")
@@ -347,36 +685,37 @@ void DownloadArchivesJob::finishWithError(const QString &error)
         emitFinishedWithError(QInstaller::DownloadError, msg.arg(error, m_downloader->url().toString()));
 }
 
+/*!
+    \internal
+
+    Returns the component the current archive belongs to, or \c nullptr if there is none.
+*/
+const Component *DownloadArchivesJob::currentComponent() const
+{
+    const QFileInfo fi = QFileInfo(m_archivesToDownload.first().first);
+    return m_core->componentByName(PackageManagerCore::checkableName(QFileInfo(fi.path()).fileName()));
+}
+
 KDUpdater::FileDownloader *DownloadArchivesJob::setupDownloader(const QString &suffix, const QString &queryString)
 {
     KDUpdater::FileDownloader *downloader = nullptr;
     const QFileInfo fi = QFileInfo(m_archivesToDownload.first().first);
-    const Component *const component = m_core->componentByName(PackageManagerCore::checkableName(QFileInfo(fi.path()).fileName()));
+    const Component *const component = currentComponent();
     if (component) {
         QString fullQueryString;
         if (!queryString.isEmpty())
             fullQueryString = QLatin1String("?") + queryString;
         const QUrl url(m_archivesToDownload.first().second + suffix + fullQueryString);
         const QString &scheme = url.scheme();
-        downloader = FileDownloaderFactory::instance().create(scheme, this);
+        downloader = createDownloader(url, component);
 
         if (downloader) {
-            downloader->setUrl(url);
-            downloader->setAutoRemoveDownloadedFile(false);
-
-            QAuthenticator auth;
-            auth.setUser(component->value(QLatin1String("username")));
-            auth.setPassword(component->value(QLatin1String("password")));
-            downloader->setAuthenticator(auth);
-
-            connect(downloader, &FileDownloader::downloadCanceled, this, &DownloadArchivesJob::downloadCanceled);
-            connect(downloader, &FileDownloader::downloadAborted, this, &DownloadArchivesJob::downloadFailed,
-                Qt::QueuedConnection);
-            connect(downloader, &FileDownloader::downloadStatus, this, &DownloadArchivesJob::onDownloadStatusChanged);
-
             if (FileDownloaderFactory::isSupportedScheme(scheme)) {
-                downloader->setDownloadedFileName(component->localTempPath() + QLatin1Char('/')
-                    + component->name() + QLatin1Char('/') + fi.fileName() + suffix);
+                // The directory does not exist yet if the meta information of the component is
+                // shared with another repository and was only extracted there.
+                const QString targetDir = component->localTempPath() + QLatin1Char('/') + component->name();
+                QDir().mkpath(targetDir);
+                downloader->setDownloadedFileName(targetDir + QLatin1Char('/') + fi.fileName() + suffix);
             }
 
             emit outputTextChanged(tr("Downloading archive \"%1\" for component %2.")
@@ -389,3 +728,31 @@ KDUpdater::FileDownloader *DownloadArchivesJob::setupDownloader(const QString &s
     }
     return downloader;
 }
+
+/*!
+    \internal
+
+    Returns a new downloader for \a url, which uses the credentials of \a component.
+    Returns \c nullptr if the scheme of \a url is not supported.
+*/
+KDUpdater::FileDownloader *DownloadArchivesJob::createDownloader(const QUrl &url,
+    const Component *component)
+{
+    KDUpdater::FileDownloader *downloader = FileDownloaderFactory::instance().create(url.scheme(), this);
+    if (!downloader)
+        return nullptr;
+
+    downloader->setUrl(url);
+    downloader->setAutoRemoveDownloadedFile(false);
+
+    QAuthenticator auth;
+    auth.setUser(component->value(QLatin1String("username")));
+    auth.setPassword(component->value(QLatin1String("password")));
+    downloader->setAuthenticator(auth);
+
+    connect(downloader, &FileDownloader::downloadCanceled, this, &DownloadArchivesJob::downloadCanceled);
+    connect(downloader, &FileDownloader::downloadAborted, this, &DownloadArchivesJob::downloadFailed,
+        Qt::QueuedConnection);
+    connect(downloader, &FileDownloader::downloadStatus, this, &DownloadArchivesJob::onDownloadStatusChanged);
+    return downloader;
+}
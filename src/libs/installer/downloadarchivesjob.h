@@ -29,10 +29,16 @@
 #ifndef DOWNLOADARCHIVESJOB_H
 #define DOWNLOADARCHIVESJOB_H
 
+#include "archivechunks.h"
 #include "job.h"
 
-#include <QtCore/QPair>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QUrl>
+#include <QtCore/QVector>
 
 QT_BEGIN_NAMESPACE
 class QTimerEvent;
@@ -44,6 +50,7 @@ namespace KDUpdater {
 
 namespace QInstaller {
 
+class Component;
 class MessageBoxHandler;
 class PackageManagerCore;
 
@@ -80,10 +87,20 @@ protected Q_SLOTS:
     void fetchNextArchive();
     void fetchNextArchiveHash();
     void finishedHashDownload();
+    void finishedManifestDownload();
+    void fetchMissingChunks();
+    void finishedChunkDownload();
     void emitDownloadProgress(double progress);
 
 private:
+    const Component *currentComponent() const;
     KDUpdater::FileDownloader *setupDownloader(const QString &suffix = QString(), const QString &queryString = QString());
+    KDUpdater::FileDownloader *createDownloader(const QUrl &url, const Component *component);
+    void assembleChunkedArchive();
+    void abortChunkDownloads();
+    void storeArchiveChunks(const QString &fileName);
+    void registerArchive(const QString &fileName, const QByteArray &sha1Sum, quint64 downloadedSize);
+    void finishDownloads();
 
 private:
     PackageManagerCore *m_core;
@@ -101,6 +118,15 @@ private:
     quint64 m_totalSizeToDownload;
     quint64 m_totalSizeDownloaded;
     QElapsedTimer m_totalDownloadSpeedTimer;
+
+    QVector<ArchiveChunk> m_chunks;
+    QVector<ArchiveChunk> m_missingChunks;
+    QHash<KDUpdater::FileDownloader *, ArchiveChunk> m_chunkDownloads;
+    QHash<QByteArray, QString> m_chunkFiles;
+    QUrl m_chunkBaseUrl;
+    quint64 m_chunkedArchiveSize;
+    quint64 m_chunkedArchiveAvailable;
+    bool m_chunksUsed;
 };
 
 } // namespace QInstaller
@@ -135,6 +135,7 @@ void Downloader::onReadyRead()
         return;
 
     Data &data = *m_downloads[reply];
+    data.elapsed.restart(); // the timeout measures inactivity, not the whole transfer
     if (!data.file) {
         std::unique_ptr<QFile> file = Q_NULLPTR;
         const QString target = data.taskItem.target();
@@ -212,6 +213,26 @@ void Downloader::onReadyRead()
 void Downloader::onFinished(QNetworkReply *reply)
 {
     Data &data = *m_downloads[reply];
+    if (data.timedOut) {
+        // Whatever arrived is incomplete, report the item without a target file.
+        if (data.file)
+            data.file->remove();
+        FileTaskItem taskItem = data.taskItem;
+        taskItem.insert(TaskRole::TimedOut, true);
+        m_futureInterface->reportResult(FileTaskResult(QString(), QByteArray(), taskItem, false));
+
+        m_downloads.erase(reply);
+        m_redirects.remove(reply);
+        reply->deleteLater();
+
+        m_finished++;
+        if (m_downloads.empty() || m_futureInterface->isCanceled()) {
+            m_futureInterface->reportFinished();
+            emit finished();    // emit finished, so the event loop can shutdown
+        }
+        return;
+    }
+
     const QString filename = data.file ? data.file->fileName() : QString();
     if (!m_futureInterface->isCanceled()) {
         if (reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
@@ -280,6 +301,9 @@ void Downloader::onError(QNetworkReply::NetworkError error)
 
     if (reply) {
         const Data &data = *m_downloads[reply];
+        if (data.timedOut)
+            return; // already reported by onTimeout
+
         //Do not throw error if Updates.xml not found. The repository might be removed
         //with RepositoryUpdate in Updates.xml later.
         //: %2 is a sentence describing the error
@@ -313,7 +337,8 @@ void Downloader::onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
     Q_UNUSED(bytesReceived)
     QNetworkReply *const reply = qobject_cast<QNetworkReply *>(sender());
     if (reply) {
-        const Data &data = *m_downloads[reply];
+        Data &data = *m_downloads[reply];
+        data.elapsed.restart();
         data.observer->setBytesToTransfer(bytesTotal);
     }
 }
@@ -358,9 +383,28 @@ void Downloader::onProxyAuthenticationRequired(const QNetworkProxy &proxy, QAuth
     does not create any events. QNam will drop after 45 seconds, though the user might have
     canceled the download before. In that case we block until the QNam timeout is reached,
     worst case resulting in deadlock while the application is shutting down at the same time.
+
+    Items that specify TaskRole::Timeout are aborted once no data arrived for that time, so
+    that a single unresponsive server does not hold back the results of all other downloads.
+    Slow transfers that still make progress are not affected.
 */
 void Downloader::onTimeout()
 {
+    QList<QNetworkReply *> expired;
+    for (const auto &pair : m_downloads) {
+        const Data &data = *pair.second;
+        const qint64 timeout = data.taskItem.value(TaskRole::Timeout).toLongLong();
+        if (timeout > 0 && !data.timedOut && data.elapsed.hasExpired(timeout))
+            expired.append(pair.first);
+    }
+    foreach (QNetworkReply *const reply, expired) {
+        Data &data = *m_downloads[reply];
+        data.timedOut = true;
+        qCWarning(QInstaller::lcServer) << QString::fromLatin1("Timeout while downloading '%1'.")
+            .arg(data.taskItem.source());
+        reply->abort(); // finishes the reply, handled in onFinished()
+    }
+
     if (testCanceled()) {
         // Inject exception, we can't use QFuturInterface::reportException() as the exception
         // store is "frozen" once cancel was called. On the other hand, client code could use
@@ -40,7 +40,9 @@ namespace QInstaller {
 namespace TaskRole {
 enum
 {
-    Authenticator = TaskRole::TargetFile + 10
+    Authenticator = TaskRole::TargetFile + 10,
+    Timeout,    // milliseconds without received data after which a single download is given up
+    TimedOut
 };
 }
 
@@ -32,6 +32,7 @@
 #include "downloadfiletask.h"
 #include <observer.h>
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -54,17 +55,23 @@ struct Data
     Data()
         : file(Q_NULLPTR)
         , observer(Q_NULLPTR)
+        , timedOut(false)
     {}
 
     Data(const FileTaskItem &fti)
         : taskItem(fti)
         , file(Q_NULLPTR)
         , observer(new FileTaskObserver(QCryptographicHash::Sha1))
-    {}
+        , timedOut(false)
+    {
+        elapsed.start();
+    }
 
     FileTaskItem taskItem;
     std::unique_ptr<QFile> file;
     std::unique_ptr<FileTaskObserver> observer;
+    QElapsedTimer elapsed;
+    bool timedOut;
 };
 
 class Downloader : public QObject
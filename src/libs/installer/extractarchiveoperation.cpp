@@ -28,16 +28,300 @@
 
 #include "extractarchiveoperation_p.h"
 
+#include "component.h"
 #include "constants.h"
+#include "errors.h"
 #include "globals.h"
+#include "lib7z_extract.h"
+#include "settings.h"
 
 #include <QEventLoop>
 #include <QThreadPool>
 #include <QFileInfo>
 #include <QDataStream>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSemaphore>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <functional>
 
 namespace QInstaller {
 
+// Never a valid size of a serialized QStringList, the format used by older versions.
+static const quint32 scFileListMagic = 0xfffffffe;
+static const quint8 scFileListVersion = 1;
+static const int scMaxUndoBatchSize = 256;
+
+static int parentDirectoryLength(const QString &path)
+{
+    return qMax(0, qMax(path.lastIndexOf(QLatin1Char('/')), path.lastIndexOf(QLatin1Char('\\'))));
+}
+
+static void appendNumber(QByteArray *buffer, quint64 number)
+{
+    while (number >= 0x80) {
+        buffer->append(char((number & 0x7f) | 0x80));
+        number >>= 7;
+    }
+    buffer->append(char(number));
+}
+
+/*!
+    \internal
+
+    Writes \a files to \a device. The files are grouped by directory, so that undo can
+    remove them in per-directory batches. Each path is stored as the length of the prefix
+    it shares with the previous path, followed by the remaining characters in UTF-8.
+*/
+static bool writeFileList(QIODevice *device, QStringList files)
+{
+    std::sort(files.begin(), files.end(), [](const QString &lhs, const QString &rhs) {
+        const int result = lhs.leftRef(parentDirectoryLength(lhs))
+            .compare(rhs.leftRef(parentDirectoryLength(rhs)));
+        return result == 0 ? lhs < rhs : result < 0;
+    });
+
+    QDataStream out(device);
+    out << scFileListMagic << scFileListVersion << quint64(files.count());
+    if (out.status() != QDataStream::Ok)
+        return false;
+
+    QByteArray buffer;
+    QString previous;
+    foreach (const QString &file, files) {
+        const int maxPrefix = qMin(previous.size(), file.size());
+        int prefix = 0;
+        while (prefix < maxPrefix && previous.at(prefix) == file.at(prefix))
+            ++prefix;
+        if (prefix > 0 && file.at(prefix - 1).isHighSurrogate())
+            --prefix; // do not split a surrogate pair
+        const QByteArray suffix = file.midRef(prefix).toUtf8();
+        appendNumber(&buffer, quint64(prefix));
+        appendNumber(&buffer, quint64(suffix.size()));
+        buffer.append(suffix);
+
+        if (buffer.size() >= 64 * 1024) {
+            if (device->write(buffer) != buffer.size())
+                return false;
+            buffer.clear();
+        }
+        previous = file;
+    }
+    return device->write(buffer) == buffer.size();
+}
+
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::FileListReader
+    \internal
+
+    Reads the files recorded by an Extract operation one at a time, without loading the
+    whole list into memory. Lists written by older versions are read at once.
+*/
+
+FileListReader::FileListReader(const QStringList &files)
+    : m_device(nullptr)
+    , m_files(files)
+    , m_count(files.count())
+    , m_read(0)
+{
+}
+
+FileListReader::FileListReader(QIODevice *device)
+    : m_device(device)
+    , m_count(0)
+    , m_read(0)
+{
+    QDataStream in(device);
+    quint32 magic = 0;
+    in >> magic;
+    if (magic == scFileListMagic) {
+        quint8 version = 0;
+        in >> version >> m_count;
+        if (in.status() != QDataStream::Ok || version != scFileListVersion) {
+            qCWarning(QInstaller::lcInstallerInstallLog) << "Unsupported file list format version"
+                << version;
+            m_count = 0;
+        }
+        return;
+    }
+
+    m_device = nullptr;
+    device->seek(0);
+    in.resetStatus();
+    in >> m_files;
+    m_count = m_files.count();
+}
+
+bool FileListReader::next(QString *file)
+{
+    if (m_read >= m_count)
+        return false;
+
+    if (!m_device) {
+        *file = m_files.at(int(m_read++));
+        return true;
+    }
+
+    quint64 prefix = 0;
+    quint64 size = 0;
+    QByteArray suffix;
+    if (readNumber(&prefix) && readNumber(&size) && prefix <= quint64(m_previous.size()))
+        suffix = m_device->read(qint64(size));
+    if (quint64(suffix.size()) != size || prefix > quint64(m_previous.size())) {
+        qCWarning(QInstaller::lcInstallerInstallLog) << "Unexpected end of file list after"
+            << m_read << "of" << m_count << "entries.";
+        m_count = m_read;
+        return false;
+    }
+
+    m_previous = m_previous.left(int(prefix)) + QString::fromUtf8(suffix);
+    *file = m_previous;
+    ++m_read;
+    return true;
+}
+
+bool FileListReader::readNumber(quint64 *number)
+{
+    *number = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        char byte;
+        if (!m_device->getChar(&byte))
+            return false;
+        *number |= quint64(uchar(byte) & 0x7f) << shift;
+        if (!(uchar(byte) & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/*!
+    Removes the files read from the file list. Files of the same directory are removed
+    in batches by a thread pool, directories are removed bottom-up at the end, once they
+    are empty.
+*/
+void WorkerThread::run()
+{
+    Q_ASSERT(m_op != 0);
+
+    QThreadPool pool;
+    // The file engine of the elevated server is not shared between threads.
+    if (RemoteClient::instance().isActive())
+        pool.setMaxThreadCount(1);
+    // Limits the number of paths held in memory while the list is being read.
+    QSemaphore pendingBatches(pool.maxThreadCount() * 4);
+
+    const auto startBatch = [&](const QStringList &batch) {
+        pendingBatches.acquire();
+        QtConcurrent::run(&pool, [this, batch, &pendingBatches]() {
+            removeFiles(batch);
+            pendingBatches.release();
+        });
+    };
+
+    QStringList batch;
+    QString batchDirectory;
+    QString file;
+    while (m_reader->next(&file)) {
+        file = replacePath(file, QLatin1String(scRelocatable), m_targetDir);
+        const QString directory = file.left(parentDirectoryLength(file));
+        if (!batch.isEmpty() && (directory != batchDirectory || batch.count() >= scMaxUndoBatchSize)) {
+            startBatch(batch);
+            batch.clear();
+        }
+        batchDirectory = directory;
+        batch.append(file);
+    }
+    if (!batch.isEmpty())
+        startBatch(batch);
+    pool.waitForDone();
+
+    // files that are in use get renamed and deleted later
+    foreach (const QString &remainingFile, m_remainingFiles)
+        m_op->deleteFileNowOrLater(remainingFile);
+
+    // a directory sorts before all paths inside it
+    std::sort(m_directories.begin(), m_directories.end(), std::greater<QString>());
+    foreach (const QString &directory, m_directories) {
+        removeSystemGeneratedFiles(directory);
+        QDir().rmdir(directory); // directory may not be empty
+    }
+}
+
+void WorkerThread::removeFiles(const QStringList &files)
+{
+    emit currentFileChanged(QDir::toNativeSeparators(files.first()));
+
+    QStringList directories;
+    QStringList remainingFiles;
+    foreach (const QString &file, files) {
+        const QFileInfo fi(file);
+        if (fi.isFile() || fi.isSymLink()) {
+            if (!QFile::remove(fi.absoluteFilePath()))
+                remainingFiles.append(fi.absoluteFilePath());
+        } else if (fi.isDir()) {
+            directories.append(fi.absoluteFilePath());
+        }
+    }
+
+    const int removed = m_removed.fetchAndAddRelaxed(files.count()) + files.count();
+    emit progressChanged(double(removed) / m_reader->count());
+
+    QMutexLocker _(&m_mutex);
+    m_directories.append(directories);
+    m_remainingFiles.append(remainingFiles);
+}
+
+/*!
+    \internal
+
+    Maps the content hashes recorded by repogen to the first extracted file having that
+    content. Entries are shared between all Extract operations of an installer run and
+    are verified against the file system before they are reused.
+*/
+class ContentHashIndex
+{
+public:
+    struct Entry
+    {
+        QString path;
+        qint64 size;
+        QDateTime lastModified;
+    };
+
+    QString lookup(const QByteArray &hash)
+    {
+        QMutexLocker _(&m_mutex);
+        const QHash<QByteArray, Entry>::iterator it = m_entries.find(hash);
+        if (it == m_entries.end())
+            return QString();
+
+        const QFileInfo fileInfo(it->path);
+        if (!fileInfo.isFile() || fileInfo.size() != it->size
+                || fileInfo.lastModified() != it->lastModified) {
+            m_entries.erase(it); // removed or modified since it was indexed
+            return QString();
+        }
+        return it->path;
+    }
+
+    void insert(const QByteArray &hash, const QString &path)
+    {
+        const QFileInfo fileInfo(path);
+        const Entry entry = { path, fileInfo.size(), fileInfo.lastModified() };
+        QMutexLocker _(&m_mutex);
+        m_entries.insert(hash, entry);
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<QByteArray, Entry> m_entries;
+};
+Q_GLOBAL_STATIC(ContentHashIndex, contentHashIndex)
+
 /*!
     \inmodule QtInstallerFramework
     \class QInstaller::ExtractArchiveOperation
@@ -76,24 +360,28 @@ void ExtractArchiveOperation::backup()
 
 bool ExtractArchiveOperation::performOperation()
 {
-    if (!checkArgumentCount(2))
+    if (!checkArgumentCount(2, 3, tr("<archive> <target directory> [number of entries]")))
         return false;
 
     const QStringList args = arguments();
     const QString archivePath = args.at(0);
     const QString targetDir = args.at(1);
+    // The number of entries is recorded in the repository metadata, if known.
+    const quint64 totalEntries = args.value(2).toULongLong();
 
     Receiver receiver;
     Callback callback;
 
     connect(&callback, &Callback::progressChanged, this, &ExtractArchiveOperation::progressChanged);
 
-    Worker *worker = new Worker(archivePath, targetDir, &callback);
+    Worker *worker = new Worker(archivePath, targetDir, totalEntries, &callback);
     connect(worker, &Worker::finished, &receiver, &Receiver::workerFinished,
         Qt::QueuedConnection);
 
-    if (PackageManagerCore *core = packageManager())
+    if (PackageManagerCore *core = packageManager()) {
         connect(core, &PackageManagerCore::statusChanged, worker, &Worker::onStatusChanged);
+        Lib7z::setExtractThreadCount(core->settings().extractThreads());
+    }
 
     QFileInfo fileInfo(archivePath);
     emit outputTextChanged(tr("Extracting \"%1\"").arg(fileInfo.fileName()));
@@ -122,6 +410,7 @@ bool ExtractArchiveOperation::performOperation()
     //    -<filename>.txt (file)
 
     QStringList files = callback.extractedFiles();
+    m_extractedFiles = files;
 
     QString installDir = targetDir;
     // If we have package manager in use (normal installer run) then use
@@ -150,11 +439,13 @@ bool ExtractArchiveOperation::performOperation()
     QFile file(targetDirectoryInfo.absolutePath() + QLatin1Char('/') + fileName);
     if (file.open(QIODevice::WriteOnly)) {
         setDefaultFilePermissions(file.fileName(), DefaultFilePermissions::NonExecutable);
-        QDataStream out (&file);
         for (int i = 0; i < files.count(); ++i) {
             files[i] = replacePath(files.at(i), installDir, QLatin1String(scRelocatable));
         }
-        out << files;
+        if (!writeFileList(&file, files)) {
+            qCWarning(QInstaller::lcInstallerInstallLog) << "Cannot write file list" << file.fileName()
+                << ":" << file.errorString();
+        }
         setValue(QLatin1String("files"), file.fileName());
         file.close();
     } else {
@@ -172,12 +463,43 @@ bool ExtractArchiveOperation::performOperation()
         setErrorString(receiver.errorString());
         return false;
     }
+
+    PackageManagerCore *const core = packageManager();
+    if (core && core->settings().deduplicateFiles()) {
+        // the files belong to the elevated server, which does not know the repository metadata
+        if (RemoteClient::instance().isActive()) {
+            qCDebug(QInstaller::lcInstallerInstallLog) << "Not deduplicating files extracted"
+                " with elevated rights from" << fileInfo.fileName();
+        } else {
+            deduplicateExtractedFiles(archivePath, targetDir);
+        }
+    }
+
+    if (core && core->settings().durabilityPolicy() == Settings::SyncPerFile) {
+        try {
+            foreach (const QString &extractedFile, m_extractedFiles)
+                syncFile(extractedFile);
+        } catch (const Error &error) {
+            setError(UserDefinedError);
+            setErrorString(error.message());
+            return false;
+        }
+    }
     return true;
 }
 
+/*!
+    Returns the absolute paths of the files and directories written by the
+    last call to performOperation().
+*/
+QStringList ExtractArchiveOperation::extractedFiles() const
+{
+    return m_extractedFiles;
+}
+
 bool ExtractArchiveOperation::undoOperation()
 {
-    Q_ASSERT(arguments().count() == 2);
+    Q_ASSERT(arguments().count() >= 2);
 
     // For backward compatibility, check if "files" can be converted to QStringList.
     // If yes, files are listed in .dat instead of in a separate file.
@@ -185,23 +507,24 @@ bool ExtractArchiveOperation::undoOperation()
     QString targetDir = arguments().at(1);
     if (packageManager())
         targetDir = packageManager()->value(scTargetDir);
-    QStringList files;
     if (useStringListType) {
-        files = value(QLatin1String("files")).toStringList();
+        FileListReader reader(value(QLatin1String("files")).toStringList());
+        startUndoProcess(&reader, targetDir);
     } else {
-        if (!readDataFileContents(targetDir, &files))
-            return false;
-    }
-    startUndoProcess(files);
-    if (!useStringListType)
+        QFile file;
+        if (openDataFile(targetDir, &file)) {
+            FileListReader reader(&file);
+            startUndoProcess(&reader, targetDir);
+            file.close();
+        }
         deleteDataFile(m_relocatedDataFileName);
-
+    }
     return true;
 }
 
-void ExtractArchiveOperation::startUndoProcess(const QStringList &files)
+void ExtractArchiveOperation::startUndoProcess(FileListReader *reader, const QString &targetDir)
 {
-    WorkerThread *const thread = new WorkerThread(this, files);
+    WorkerThread *const thread = new WorkerThread(this, reader, targetDir);
     connect(thread, &WorkerThread::currentFileChanged, this,
         &ExtractArchiveOperation::outputTextChanged);
     connect(thread, &WorkerThread::progressChanged, this,
@@ -214,6 +537,63 @@ void ExtractArchiveOperation::startUndoProcess(const QStringList &files)
     thread->deleteLater();
 }
 
+/*!
+    \internal
+
+    Replaces the files extracted from \a archivePath to \a targetDir that have the same
+    content as a file extracted earlier with a link to that file. The content hashes are
+    read from the repository metadata of the component owning the operation. Files that
+    are read-only in the repository are hard linked if their permissions match, other files
+    are only replaced if the file system supports copy-on-write clones, so that modifying
+    one of them later does not change the other.
+*/
+void ExtractArchiveOperation::deduplicateExtractedFiles(const QString &archivePath,
+    const QString &targetDir)
+{
+    const Component *const component = packageManager()->componentByName(value(QLatin1String("component"))
+        .toString());
+    if (!component)
+        return;
+
+    const QStringList entryHashes = component->value(scEntryHashes).split(QLatin1Char('\n'),
+        QString::SkipEmptyParts);
+    if (entryHashes.isEmpty())
+        return;
+
+    const QString version = component->value(scVersion);
+    QString archiveName = QFileInfo(archivePath).fileName();
+    if (archiveName.startsWith(version))
+        archiveName = archiveName.mid(version.length());
+    const QString prefix = archiveName + QLatin1Char('/');
+
+    int linkedFiles = 0;
+    foreach (const QString &line, entryHashes) {
+        // <sha1> <r|w> <archive name>/<path inside archive>
+        const QString entryHash = line.trimmed();
+        if (entryHash.length() < 44 || !entryHash.mid(43).startsWith(prefix))
+            continue;
+
+        const QByteArray hash = entryHash.left(40).toLatin1();
+        const bool readOnly = (entryHash.at(41) == QLatin1Char('r'));
+        const QString target = QDir::cleanPath(targetDir + QLatin1Char('/')
+            + entryHash.mid(43 + prefix.length()));
+        if (!QFileInfo(target).isFile())
+            continue;
+
+        const QString source = contentHashIndex()->lookup(hash);
+        if (source.isEmpty() || source == target) {
+            contentHashIndex()->insert(hash, target);
+            continue;
+        }
+        if ((readOnly && linkFile(source, target)) || cloneFile(source, target))
+            ++linkedFiles;
+    }
+    if (linkedFiles > 0) {
+        qCDebug(QInstaller::lcInstallerInstallLog) << "Linked" << linkedFiles
+            << "duplicate files extracted from" << archiveName;
+    }
+}
+
 void ExtractArchiveOperation::deleteDataFile(const QString &fileName)
 {
     if (fileName.isEmpty()) {
@@ -236,29 +616,24 @@ bool ExtractArchiveOperation::testOperation()
     return true;
 }
 
-bool ExtractArchiveOperation::readDataFileContents(QString &targetDir, QStringList *resultList)
+bool ExtractArchiveOperation::openDataFile(QString &targetDir, QFile *file)
 {
     const QString filePath = value(QLatin1String("files")).toString();
     // Does not change target on non macOS platforms.
     if (QInstaller::isInBundle(targetDir, &targetDir))
         targetDir = QDir::cleanPath(targetDir + QLatin1String("/.."));
     m_relocatedDataFileName = replacePath(filePath, QLatin1String(scRelocatable), targetDir);
-    QFile file(m_relocatedDataFileName);
+    file->setFileName(m_relocatedDataFileName);
 
-    if (file.open(QIODevice::ReadOnly)) {
-        QDataStream in(&file);
-        in >> *resultList;
-        for (int i = 0; i < resultList->count(); ++i)
-            resultList->replace(i, replacePath(resultList->at(i),  QLatin1String(scRelocatable), targetDir));
+    if (file->open(QIODevice::ReadOnly))
+        return true;
 
-    } else {
-        // We should not be here. Either user has manually deleted the installer related
-        // files or same component is installed several times.
-        qCWarning(QInstaller::lcInstallerInstallLog) << "Cannot open file " << file.fileName() << " for reading:"
-                << file.errorString() << ". Component is already uninstalled "
-                << "or file is manually deleted.";
-    }
-    return true;
+    // We should not be here. Either user has manually deleted the installer related
+    // files or same component is installed several times.
+    qCWarning(QInstaller::lcInstallerInstallLog) << "Cannot open file " << file->fileName() << " for reading:"
+            << file->errorString() << ". Component is already uninstalled "
+            << "or file is manually deleted.";
+    return false;
 }
 
 } // namespace QInstaller
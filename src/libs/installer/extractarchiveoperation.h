@@ -33,8 +33,12 @@
 
 #include <QtCore/QObject>
 
+QT_FORWARD_DECLARE_CLASS(QFile)
+
 namespace QInstaller {
 
+class FileListReader;
+
 class INSTALLER_EXPORT ExtractArchiveOperation : public QObject, public Operation
 {
     Q_OBJECT
@@ -48,18 +52,21 @@ public:
     bool undoOperation();
     bool testOperation();
 
-    bool readDataFileContents(QString &targetDir, QStringList *resultList);
+    QStringList extractedFiles() const;
 
 Q_SIGNALS:
     void outputTextChanged(const QString &progress);
     void progressChanged(double);
 
 private:
-    void startUndoProcess(const QStringList &files);
+    bool openDataFile(QString &targetDir, QFile *file);
+    void startUndoProcess(FileListReader *reader, const QString &targetDir);
     void deleteDataFile(const QString &fileName);
+    void deduplicateExtractedFiles(const QString &archivePath, const QString &targetDir);
 
 private:
     QString m_relocatedDataFileName;
+    QStringList m_extractedFiles;
 
 private:
     class Callback;
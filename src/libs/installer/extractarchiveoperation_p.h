@@ -32,53 +32,74 @@
 
 #include "fileutils.h"
 #include "archivefactory.h"
+#include "archivepatch.h"
+#include "globals.h"
 #include "packagemanagercore.h"
+#include "remoteclient.h"
 
+#include <QDirIterator>
+#include <QMutex>
 #include <QRunnable>
 #include <QThread>
 
+#include <algorithm>
+
 namespace QInstaller {
 
+class FileListReader
+{
+    Q_DISABLE_COPY(FileListReader)
+
+public:
+    explicit FileListReader(const QStringList &files);
+    explicit FileListReader(QIODevice *device);
+
+    quint64 count() const { return m_count; }
+    bool next(QString *file);
+
+private:
+    bool readNumber(quint64 *number);
+
+private:
+    QIODevice *m_device;
+    QStringList m_files;
+    QString m_previous;
+    quint64 m_count;
+    quint64 m_read;
+};
+
 class WorkerThread : public QThread
 {
     Q_OBJECT
     Q_DISABLE_COPY(WorkerThread)
 
 public:
-    WorkerThread(ExtractArchiveOperation *op, const QStringList &files)
-        : m_files(files)
+    WorkerThread(ExtractArchiveOperation *op, FileListReader *reader, const QString &targetDir)
+        : m_reader(reader)
+        , m_targetDir(targetDir)
         , m_op(op)
     {
         setObjectName(QLatin1String("ExtractArchive"));
     }
 
-    void run()
-    {
-        Q_ASSERT(m_op != 0);
-
-        int removedCounter = 0;
-        foreach (const QString &file, m_files) {
-            removedCounter++;
-
-            const QFileInfo fi(file);
-            emit currentFileChanged(QDir::toNativeSeparators(file));
-            emit progressChanged(double(removedCounter) / m_files.count());
-            if (fi.isFile() || fi.isSymLink()) {
-                m_op->deleteFileNowOrLater(fi.absoluteFilePath());
-            } else if (fi.isDir()) {
-                removeSystemGeneratedFiles(file);
-                fi.dir().rmdir(file); // directory may not exist
-            }
-        }
-    }
+    void run();
 
 signals:
     void currentFileChanged(const QString &filename);
     void progressChanged(double);
 
 private:
-    QStringList m_files;
+    void removeFiles(const QStringList &files);
+
+private:
+    FileListReader *m_reader;
+    QString m_targetDir;
     ExtractArchiveOperation *m_op;
+
+    QMutex m_mutex;
+    QStringList m_directories;
+    QStringList m_remainingFiles;
+    QAtomicInt m_removed;
 };
 
 typedef QPair<QString, QString> Backup;
@@ -153,9 +174,11 @@ class ExtractArchiveOperation::Worker : public QObject
     Q_DISABLE_COPY(Worker)
 
 public:
-    Worker(const QString &archivePath, const QString &targetDir, Callback *callback)
+    Worker(const QString &archivePath, const QString &targetDir, quint64 totalEntries,
+            Callback *callback)
         : m_archivePath(archivePath)
         , m_targetDir(targetDir)
+        , m_totalEntries(totalEntries)
         , m_canceled(false)
         , m_callback(callback)
     {}
@@ -167,6 +190,14 @@ public Q_SLOTS:
     void run()
     {
         m_canceled = false;
+        const QString patchedDir = takePatchedArchive(m_archivePath);
+        if (!patchedDir.isEmpty()) {
+            // the archive itself is an empty placeholder, keep the files for a retry
+            if (!movePatchedFiles(patchedDir))
+                registerPatchedArchive(m_archivePath, patchedDir);
+            return;
+        }
+
         m_archive.reset(ArchiveFactory::instance().create(m_archivePath));
         if (!m_archive) {
             emit finished(false, tr("Could not create handler object for archive \"%1\": \"%2\".")
@@ -182,31 +213,114 @@ public Q_SLOTS:
                 m_archive->errorString()));
             return;
         }
-        const QVector<ArchiveEntry> entries = m_archive->list();
-        if (entries.isEmpty()) {
-            emit finished(false, tr("Error while reading contents of archive \"%1\": %2").arg(m_archivePath,
-                m_archive->errorString()));
-            return;
-        }
-        for (auto &entry : entries) {
-            QString completeFilePath = m_targetDir + QDir::separator() + entry.path;
-            if (!entry.isDirectory && !m_callback->prepareForFile(completeFilePath)) {
-                emit finished(false, tr("Cannot prepare for file \"%1\"").arg(completeFilePath));
+
+        quint64 totalEntries = m_totalEntries;
+        m_prepareError.clear();
+        if (totalEntries > 0 && !RemoteClient::instance().isActive()) {
+            // The number of entries is known, skip reading the archive twice. Existing files
+            // are backed up right before the archive writes them, which works as long as the
+            // entry notifications are delivered synchronously, i.e. not by an elevated server.
+            connect(m_archive.get(), &AbstractArchive::currentEntryChanged, this,
+                &Worker::prepareForEntry, Qt::DirectConnection);
+        } else {
+            const QVector<ArchiveEntry> entries = m_archive->list();
+            if (entries.isEmpty()) {
+                emit finished(false, tr("Error while reading contents of archive \"%1\": %2").arg(m_archivePath,
+                    m_archive->errorString()));
                 return;
             }
+            for (auto &entry : entries) {
+                QString completeFilePath = m_targetDir + QDir::separator() + entry.path;
+                if (!entry.isDirectory && !m_callback->prepareForFile(completeFilePath)) {
+                    emit finished(false, tr("Cannot prepare for file \"%1\"").arg(completeFilePath));
+                    return;
+                }
+            }
+            totalEntries = entries.size();
         }
         if (m_canceled) {
             // For large archives the reading takes some time, and the user might have
             // canceled before we start the actual extracting.
             emit finished(false, tr("Extract for archive \"%1\" canceled.").arg(m_archivePath));
-        } else if (!m_archive->extract(m_targetDir, entries.size())) {
-            emit finished(false, tr("Error while extracting archive \"%1\": %2").arg(m_archivePath,
-                m_archive->errorString()));
+        } else if (!m_archive->extract(m_targetDir, totalEntries) || !m_prepareError.isEmpty()) {
+            emit finished(false, m_prepareError.isEmpty() ? tr("Error while extracting archive "
+                "\"%1\": %2").arg(m_archivePath, m_archive->errorString()) : m_prepareError);
         } else {
             emit finished(true, QString());
         }
     }
 
+    // Moves the files written by applying a patch to the archive into the target directory,
+    // reporting them like extracted files. On failure the files already moved are moved back,
+    // so that the operation can be retried.
+    bool movePatchedFiles(const QString &patchedDir)
+    {
+        const QDir sourceDir(patchedDir);
+        QStringList entries;
+        QDirIterator it(patchedDir, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden
+            | QDir::System, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            entries.append(sourceDir.relativeFilePath(it.next()));
+        // a directory sorts before the entries inside it
+        std::sort(entries.begin(), entries.end());
+
+        quint64 completed = 0;
+        QStringList moved;
+        QString errorString;
+        foreach (const QString &entry, entries) {
+            const QString source = patchedDir + QLatin1Char('/') + entry;
+            const QString target = m_targetDir + QLatin1Char('/') + entry;
+            if (QFileInfo(source).isDir()) {
+                if (!QDir().mkpath(target)) {
+                    errorString = tr("Cannot create directory \"%1\".").arg(target);
+                    break;
+                }
+            } else {
+                if (!m_callback->prepareForFile(target)) {
+                    errorString = tr("Cannot prepare for file \"%1\"").arg(target);
+                    break;
+                }
+                QDir().mkpath(QFileInfo(target).path());
+                QFile file(source);
+                if (!file.rename(target)) {
+                    errorString = tr("Cannot move file \"%1\" to \"%2\": %3").arg(source,
+                        target, file.errorString());
+                    break;
+                }
+                moved.prepend(entry);
+            }
+            m_callback->onCurrentEntryChanged(target);
+            m_callback->onCompletedChanged(++completed, entries.count());
+        }
+
+        if (!errorString.isEmpty()) {
+            foreach (const QString &entry, moved) {
+                QFile file(m_targetDir + QLatin1Char('/') + entry);
+                if (!file.rename(patchedDir + QLatin1Char('/') + entry)) {
+                    qCWarning(QInstaller::lcInstallerInstallLog) << "Cannot move file"
+                        << file.fileName() << "back:" << file.errorString();
+                }
+            }
+            emit finished(false, errorString);
+            return false;
+        }
+        QDir(patchedDir).removeRecursively();
+        emit finished(true, QString());
+        return true;
+    }
+
+    void prepareForEntry(const QString &filename)
+    {
+        // Directories, including the leading ones created by the archive, are not backed up.
+        const QFileInfo fi(filename);
+        if (!m_prepareError.isEmpty() || (fi.isDir() && !fi.isSymLink()))
+            return;
+        if (!m_callback->prepareForFile(filename)) {
+            m_prepareError = tr("Cannot prepare for file \"%1\"").arg(filename);
+            m_archive->cancel();
+        }
+    }
+
     void onStatusChanged(PackageManagerCore::Status status)
     {
         if (!m_archive)
@@ -229,9 +343,11 @@ public Q_SLOTS:
 private:
     QString m_archivePath;
     QString m_targetDir;
+    quint64 m_totalEntries;
     QScopedPointer<AbstractArchive> m_archive;
     bool m_canceled;
     Callback *m_callback;
+    QString m_prepareError;
 };
 
 class ExtractArchiveOperation::Receiver : public QObject
@@ -46,13 +46,23 @@
 #include <QScreen>
 
 #include <errno.h>
+#include <limits>
 
 #ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #endif
 
+#if defined(Q_OS_LINUX)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/clonefile.h>
+#endif
+
 using namespace QInstaller;
 
 /*!
@@ -151,6 +161,34 @@ QString QInstaller::humanReadableSize(const qint64 &size, int precision)
     return QString::fromLatin1("%1 %2").arg(sizeAsDouble, 0, 'f', precision).arg(measure);
 }
 
+/*!
+    Returns the number of bytes given by \a size, which is a non-negative integer optionally
+    followed by one of the binary unit suffixes \c k, \c m or \c g, for example \c 64m.
+    If \a ok is not \c nullptr, failure is reported by setting *\a{ok} to \c false, and
+    success by setting *\a{ok} to \c true. Returns \c 0 on failure.
+*/
+quint64 QInstaller::sizeFromString(const QString &size, bool *ok)
+{
+    QString value = size.trimmed().toLower();
+    quint64 multiplier = 1;
+    if (value.endsWith(QLatin1Char('k')))
+        multiplier = quint64(1) << 10;
+    else if (value.endsWith(QLatin1Char('m')))
+        multiplier = quint64(1) << 20;
+    else if (value.endsWith(QLatin1Char('g')))
+        multiplier = quint64(1) << 30;
+    if (multiplier > 1)
+        value.chop(1);
+
+    bool valid = false;
+    const quint64 number = value.toULongLong(&valid);
+    // toULongLong() accepts a sign
+    valid = valid && value.at(0).isDigit() && number <= std::numeric_limits<quint64>::max() / multiplier;
+    if (ok)
+        *ok = valid;
+    return valid ? number * multiplier : 0;
+}
+
 
 
 // -- read, write operations
@@ -819,3 +857,199 @@ void QInstaller::copyConfigChildElements(QDomDocument &dom, const QDomNodeList &
         }
     }
 }
+
+/*!
+    \internal
+
+    Flushes the data of the file or directory at \a path from the operating
+    system caches to the storage device. Symbolic links are skipped, they are
+    written with the directory containing them. Throws an Error if that fails.
+*/
+void QInstaller::syncFile(const QString &path)
+{
+    if (QFileInfo(path).isSymLink())
+        return;
+
+#if defined(Q_OS_WIN)
+    // directory entries are journaled by NTFS and cannot be flushed separately
+    if (QFileInfo(path).isDir())
+        return;
+
+    // FlushFileBuffers() needs write access, which read-only files refuse
+    const QString nativeName = QDir::toNativeSeparators(path);
+    const LPCWSTR nativePath = reinterpret_cast<LPCWSTR>(nativeName.utf16());
+    const DWORD attributes = GetFileAttributesW(nativePath);
+    const bool readOnly = (attributes != INVALID_FILE_ATTRIBUTES) && (attributes & FILE_ATTRIBUTE_READONLY);
+    if (readOnly)
+        SetFileAttributesW(nativePath, attributes & ~FILE_ATTRIBUTE_READONLY);
+
+    const HANDLE handle = CreateFileW(nativePath, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE
+        | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    const bool synced = (handle != INVALID_HANDLE_VALUE) && FlushFileBuffers(handle);
+    const DWORD error = GetLastError();
+    if (handle != INVALID_HANDLE_VALUE)
+        CloseHandle(handle);
+    if (readOnly)
+        SetFileAttributesW(nativePath, attributes);
+    if (!synced) {
+        throw Error(QCoreApplication::translate("QInstaller", "Cannot write \"%1\" to disk: %2")
+            .arg(QDir::toNativeSeparators(path), qt_error_string(error)));
+    }
+#elif defined(Q_OS_UNIX)
+    errno = 0;
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    bool synced = (fd != -1);
+    if (synced) {
+#if defined(Q_OS_MACOS)
+        // fsync() only hands the data to the drive, F_FULLFSYNC flushes the drive cache as well
+        synced = (::fcntl(fd, F_FULLFSYNC) != -1) || (::fsync(fd) == 0);
+#elif defined(Q_OS_LINUX)
+        synced = (::fdatasync(fd) == 0);
+#else
+        synced = (::fsync(fd) == 0);
+#endif
+    }
+    const int error = errno;
+    if (fd != -1)
+        ::close(fd);
+    if (!synced) {
+        throw Error(QCoreApplication::translate("QInstaller", "Cannot write \"%1\" to disk: %2")
+            .arg(QDir::toNativeSeparators(path), errnoToQString(error)));
+    }
+#else
+    Q_UNUSED(path)
+#endif
+}
+
+/*!
+    \internal
+
+    Flushes all pending writes of the file system containing \a path to the
+    storage device at once. Returns \c false if the platform has no way to do
+    that, in which case the files must be flushed one by one with syncFile().
+    Throws an Error if the flush fails.
+*/
+bool QInstaller::syncFileSystem(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    errno = 0;
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    const bool synced = (fd != -1) && (::syncfs(fd) == 0);
+    const int error = errno;
+    if (fd != -1)
+        ::close(fd);
+    if (!synced) {
+        throw Error(QCoreApplication::translate("QInstaller", "Cannot write \"%1\" to disk: %2")
+            .arg(QDir::toNativeSeparators(path), errnoToQString(error)));
+    }
+    return true;
+#else
+    Q_UNUSED(path)
+    return false;
+#endif
+}
+
+/*!
+    \internal
+
+    Replaces the file \a target with a copy-on-write clone of \a source, keeping the
+    permissions and modification time of \a target. Both files need to be on the same
+    file system. Returns \c false and leaves \a target untouched if the file system
+    does not support cloning.
+*/
+bool QInstaller::cloneFile(const QString &source, const QString &target)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+    const QByteArray targetPath = QFile::encodeName(target);
+    const QByteArray temporaryPath = targetPath + ".tmpClone";
+    struct stat targetStat;
+    if (::stat(targetPath.constData(), &targetStat) != 0)
+        return false;
+    ::unlink(temporaryPath.constData());
+
+#if defined(Q_OS_LINUX)
+    const int sourceFd = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd == -1)
+        return false;
+    const int targetFd = ::open(temporaryPath.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+        targetStat.st_mode & 07777);
+    bool cloned = (targetFd != -1) && (::ioctl(targetFd, FICLONE, sourceFd) == 0);
+    if (targetFd != -1)
+        cloned = (::fchmod(targetFd, targetStat.st_mode & 07777) == 0) && cloned;
+    ::close(sourceFd);
+    if (targetFd != -1)
+        ::close(targetFd);
+    const struct timespec times[2] = { targetStat.st_atim, targetStat.st_mtim };
+#else
+    bool cloned = (::clonefile(QFile::encodeName(source).constData(), temporaryPath.constData(),
+        CLONE_NOOWNERCOPY) == 0);
+    if (cloned)
+        cloned = (::chmod(temporaryPath.constData(), targetStat.st_mode & 07777) == 0);
+    const struct timespec times[2] = { targetStat.st_atimespec, targetStat.st_mtimespec };
+#endif
+    if (cloned)
+        cloned = (::utimensat(AT_FDCWD, temporaryPath.constData(), times, 0) == 0);
+    if (cloned)
+        cloned = (::rename(temporaryPath.constData(), targetPath.constData()) == 0);
+    if (!cloned)
+        ::unlink(temporaryPath.constData());
+    return cloned;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(target)
+    return false;
+#endif
+}
+
+/*!
+    \internal
+
+    Replaces the file \a target with a hard link to \a source. Both files need to be on
+    the same file system. Only use this for files that are never modified in place, as
+    the two paths share their content, permissions and modification time afterwards.
+    Returns \c false and leaves \a target untouched if the link cannot be created, or if
+    the permissions of the files differ.
+*/
+bool QInstaller::linkFile(const QString &source, const QString &target)
+{
+    if (QFileInfo(source).permissions() != QFileInfo(target).permissions())
+        return false;
+
+#if defined(Q_OS_WIN)
+    const QString temporary = QDir::toNativeSeparators(target + QLatin1String(".tmpLink"));
+    DeleteFileW(reinterpret_cast<LPCWSTR>(temporary.utf16()));
+    if (!CreateHardLinkW(reinterpret_cast<LPCWSTR>(temporary.utf16()),
+            reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(source).utf16()), nullptr)) {
+        return false;
+    }
+    // read-only files cannot be replaced, the link brings the attributes of source anyway
+    const QString nativeTarget = QDir::toNativeSeparators(target);
+    const DWORD attributes = GetFileAttributesW(reinterpret_cast<LPCWSTR>(nativeTarget.utf16()));
+    const bool readOnly = (attributes != INVALID_FILE_ATTRIBUTES) && (attributes & FILE_ATTRIBUTE_READONLY);
+    if (readOnly)
+        SetFileAttributesW(reinterpret_cast<LPCWSTR>(nativeTarget.utf16()), attributes & ~FILE_ATTRIBUTE_READONLY);
+    if (!MoveFileExW(reinterpret_cast<LPCWSTR>(temporary.utf16()),
+            reinterpret_cast<LPCWSTR>(nativeTarget.utf16()), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(reinterpret_cast<LPCWSTR>(temporary.utf16()));
+        if (readOnly)
+            SetFileAttributesW(reinterpret_cast<LPCWSTR>(nativeTarget.utf16()), attributes);
+        return false;
+    }
+    return true;
+#elif defined(Q_OS_UNIX)
+    const QByteArray targetPath = QFile::encodeName(target);
+    const QByteArray temporaryPath = targetPath + ".tmpLink";
+    ::unlink(temporaryPath.constData());
+    if (::link(QFile::encodeName(source).constData(), temporaryPath.constData()) != 0)
+        return false;
+    if (::rename(temporaryPath.constData(), targetPath.constData()) != 0) {
+        ::unlink(temporaryPath.constData());
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(target)
+    return false;
+#endif
+}
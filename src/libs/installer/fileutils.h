@@ -70,6 +70,7 @@ private:
 };
 
     QString INSTALLER_EXPORT humanReadableSize(const qint64 &size, int precision = 2);
+    quint64 INSTALLER_EXPORT sizeFromString(const QString &size, bool *ok = nullptr);
 
     void INSTALLER_EXPORT removeFiles(const QString &path, bool ignoreErrors = false);
     void INSTALLER_EXPORT removeDirectory(const QString &path, bool ignoreErrors = false);
@@ -90,6 +91,12 @@ private:
     void INSTALLER_EXPORT mkdir(const QString &path);
     void INSTALLER_EXPORT mkpath(const QString &path);
 
+    void INSTALLER_EXPORT syncFile(const QString &path);
+    bool INSTALLER_EXPORT syncFileSystem(const QString &path);
+
+    bool INSTALLER_EXPORT cloneFile(const QString &source, const QString &target);
+    bool INSTALLER_EXPORT linkFile(const QString &source, const QString &target);
+
     quint64 INSTALLER_EXPORT fileSize(const QFileInfo &info);
     bool INSTALLER_EXPORT isInBundle(const QString &path, QString *bundlePath = 0);
 
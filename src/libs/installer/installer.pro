@@ -51,6 +51,9 @@ HEADERS += packagemanagercore.h \
     binaryformatengine.h \
     binaryformatenginehandler.h \
     repository.h \
+    repositoryindex.h \
+    archivechunks.h \
+    archivepatch.h \
     utils.h \
     errors.h \
     component.h \
@@ -157,6 +160,9 @@ SOURCES += packagemanagercore.cpp \
     binaryformatengine.cpp \
     binaryformatenginehandler.cpp \
     repository.cpp \
+    repositoryindex.cpp \
+    archivechunks.cpp \
+    archivepatch.cpp \
     fileutils.cpp \
     utils.cpp \
     component.cpp \
@@ -36,6 +36,7 @@
 #include <7zip/UI/Common/Update.h>
 
 QT_BEGIN_NAMESPACE
+class QCryptographicHash;
 class QFileDevice;
 class QStringList;
 QT_END_NAMESPACE
@@ -62,9 +63,14 @@ namespace Lib7z
     };
 
     void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sources,
-        Compression level = Compression::Normal, UpdateCallback *callback = 0);
+        Compression level = Compression::Normal, UpdateCallback *callback = 0, int threadCount = 0,
+        QCryptographicHash *hash = 0, quint64 dictionarySize = 0, quint64 solidBlockSize = 0);
     void INSTALLER_EXPORT createArchive(const QString &archive, const QStringList &sources,
-        TmpFile mode, Compression level = Compression::Normal, UpdateCallback *callback = 0);
+        TmpFile mode, Compression level = Compression::Normal, UpdateCallback *callback = 0,
+        int threadCount = 0, quint64 dictionarySize = 0, quint64 solidBlockSize = 0);
+    void INSTALLER_EXPORT updateArchive(const QString &archive, const QStringList &sources,
+        const QStringList &removedEntries, Compression level = Compression::Normal,
+        UpdateCallback *callback = 0, int threadCount = 0, quint64 dictionarySize = 0);
 
 } // namespace Lib7z
 
@@ -41,9 +41,12 @@
 
 #include "installer_global.h"
 
+#include "lib7z_list.h"
+
 #include <Common/MyCom.h>
 #include <7zip/Archive/IArchive.h>
 
+#include <QSet>
 #include <QString>
 
 class CArc;
@@ -54,6 +57,8 @@ QT_END_NAMESPACE
 
 namespace Lib7z
 {
+    class FolderExtractCallback;
+
     class INSTALLER_EXPORT ExtractCallback : public IArchiveExtractCallback, public CMyUnknownImp
     {
         Q_DISABLE_COPY(ExtractCallback)
@@ -63,7 +68,12 @@ namespace Lib7z
         virtual ~ExtractCallback() = default;
 
         void setArchive(CArc *carc) { arc = carc; }
-        void setTarget(const QString &dir) { targetDir = dir; }
+        void setTarget(const QString &dir)
+        {
+            targetDir = dir;
+            existingDirectories.clear();
+            createdDirectories.clear();
+        }
 
         MY_UNKNOWN_IMP
         INTERFACE_IArchiveExtractCallback(;)
@@ -74,16 +84,26 @@ namespace Lib7z
         virtual HRESULT setCompleted(quint64 /*completed*/, quint64 /*total*/) { return S_OK; }
 
     private:
+        friend class FolderExtractCallback;
+
         CArc *arc = 0;
 
         QString targetDir;
+        QString currentPath;
+        QSet<QString> existingDirectories;
+        QSet<QString> createdDirectories;
         quint64 total = 0;
         quint64 completed = 0;
         quint32 currentIndex = 0;
     };
 
+    void INSTALLER_EXPORT setExtractThreadCount(int count);
+    int INSTALLER_EXPORT extractThreadCount();
+
     void INSTALLER_EXPORT extractArchive(QFileDevice *archive, const QString &targetDirectory,
         ExtractCallback *callback = 0);
+    void INSTALLER_EXPORT extractArchive(QFileDevice *archive, const QString &targetDirectory,
+        const QVector<File> &files, ExtractCallback *callback = 0);
 
 } // namespace Lib7z
 
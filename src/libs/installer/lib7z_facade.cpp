@@ -55,13 +55,19 @@
 #include <Windows/PropVariantConv.h>
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileInfo>
 #include <QIODevice>
+#include <QMutex>
 #include <QPointer>
 #include <QReadWriteLock>
 #include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
 
+#include <algorithm>
 #include <mutex>
 #include <memory>
 
@@ -82,6 +88,10 @@ extern "C" int global_use_utf16_conversion;
 #include <sys/stat.h>
 #endif
 
+#ifdef Q_OS_LINUX
+# include <fcntl.h>
+#endif
+
 namespace NArchive {
     namespace N7z {
         void registerArcDec7z();
@@ -116,6 +126,9 @@ void registerCodecByteSwap();
 
 namespace Lib7z {
 
+// files from this size on get their disk space reserved before they are written
+static const quint64 PreallocationThreshold = 1024 * 1024;
+
 /*!
     \inmodule Lib7z
     \class Lib7z::File
@@ -608,41 +621,63 @@ STDMETHODIMP ExtractCallback::GetStream(UInt32 index, ISequentialOutStream **out
         return E_FAIL;
     }
 
-    const QFileInfo fi(QString::fromLatin1("%1/%2").arg(targetDir, UString2QString(s)));
+    // compute the target path only once, SetOperationResult() uses it as well
+    currentPath = QFileInfo(QString::fromLatin1("%1/%2").arg(targetDir, UString2QString(s)))
+        .absoluteFilePath();
+    const int separator = currentPath.lastIndexOf(QLatin1Char('/'));
+    const QString parentPath = currentPath.left(separator);
 
-    QInstaller::DirectoryGuard guard(fi.absolutePath());
+    // directories known to exist are not checked again for every item inside them
+    QInstaller::DirectoryGuard guard(existingDirectories.contains(parentPath) ? QString() : parentPath);
     const QStringList directories = guard.tryCreate();
+    existingDirectories.insert(parentPath);
+    foreach (const QString &directory, directories) {
+        existingDirectories.insert(directory);
+        createdDirectories.insert(directory);
+    }
 
     bool isDir = false;
     Archive_IsItem_Folder(arc->Archive, index, isDir);
-    if (isDir)
-        QDir(fi.absolutePath()).mkdir(fi.fileName());
+    if (isDir) {
+        if (QDir(parentPath).mkdir(currentPath.mid(separator + 1)))
+            createdDirectories.insert(currentPath);
+        existingDirectories.insert(currentPath);
+    }
 
     // this makes sure that all directories created get removed as well
     foreach (const QString &directory, directories)
         setCurrentFile(directory);
 
-    if (!isDir && !prepareForFile(fi.absoluteFilePath()))
+    if (!isDir && !prepareForFile(currentPath))
         return E_FAIL;
 
-    setCurrentFile(fi.absoluteFilePath());
+    setCurrentFile(currentPath);
 
     if (!isDir) {
 #ifndef Q_OS_WIN
-        // do not follow symlinks, so we need to remove an existing one
-        if (fi.isSymLink() && (!QFile::remove(fi.absoluteFilePath()))) {
+        // do not follow symlinks, so we need to remove an existing one; there is nothing to
+        // remove inside a directory created by this extraction
+        if (!createdDirectories.contains(parentPath) && QFileInfo(currentPath).isSymLink()
+                && !QFile::remove(currentPath)) {
             setLastError(QCoreApplication::translate("ExtractCallbackImpl",
-                "Cannot remove already existing symlink %1.").arg(fi.absoluteFilePath()));
+                "Cannot remove already existing symlink %1.").arg(currentPath));
             return E_FAIL;
         }
 #endif
-        std::unique_ptr<QFile> file(new QFile(fi.absoluteFilePath()));
+        std::unique_ptr<QFile> file(new QFile(currentPath));
         if (!file->open(QIODevice::WriteOnly)) {
             setLastError(QCoreApplication::translate("ExtractCallbackImpl",
                                                      "Cannot open file \"%1\" for writing: %2").arg(
-                             QDir::toNativeSeparators(fi.absoluteFilePath()), file->errorString()));
+                             QDir::toNativeSeparators(currentPath), file->errorString()));
             return E_FAIL;
         }
+#ifdef Q_OS_LINUX
+        // Reserve the disk space of big files up front to avoid fragmentation. The file size
+        // stays unchanged, and a failure only means that the space is allocated while writing.
+        const quint64 size = getUInt64Property(arc->Archive, index, kpidSize, 0);
+        if (size >= PreallocationThreshold)
+            ::fallocate(file->handle(), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+#endif
         CMyComPtr<ISequentialOutStream> stream =
             new QIODeviceSequentialOutStream(std::move(file));
         *outStream = stream.Detach(); // CMyComPtr is needed, otherwise it crashes in Write().
@@ -668,15 +703,8 @@ STDMETHODIMP ExtractCallback::SetOperationResult(Int32 /*resultEOperationResult*
     if (targetDir.isEmpty())
         return S_OK;
 
-    UString s;
-    if (arc->GetItemPath(currentIndex, s) != S_OK) {
-        setLastError(QCoreApplication::translate("ExtractCallbackImpl",
-            "Cannot retrieve path of archive item %1.").arg(currentIndex));
-        return E_FAIL;
-    }
-
-    const QString absFilePath = QFileInfo(QString::fromLatin1("%1/%2").arg(targetDir,
-        UString2QString(s).replace(QLatin1Char('\\'), QLatin1Char('/')))).absoluteFilePath();
+    // the path was computed in GetStream()
+    const QString absFilePath = currentPath;
 
     // do we have a symlink?
     const quint32 attributes = getUInt32Property(arc->Archive, currentIndex, kpidAttrib, 0);
@@ -950,36 +978,127 @@ static QString createTmp7z()
     more files, one or more directories or a combination of files and folders. Also, \c * wildcard
     is supported. The value of \a level specifies the compression ratio, the default is set
     to \c 5 (Normal compression). The \a callback can be used to get information about the archive
-    creation process. If no \a callback is given, an empty implementation is used.
+    creation process. If no \a callback is given, an empty implementation is used. The value of
+    \a threadCount limits the number of compression threads, \c 0 uses one thread per core.
+    If \a hash is given, the data written to \a archive is added to it. The values of
+    \a dictionarySize and \a solidBlockSize have the same meaning as for the overload
+    writing to a file name.
 
     \note Throws SevenZipException on error.
     \note Filenames are stored case-sensitive with UTF-8 encoding.
     \note The ownership of \a callback is transferred to the function and gets delete on exit.
 */
 void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sources,
-    Compression level, UpdateCallback *callback)
+    Compression level, UpdateCallback *callback, int threadCount, QCryptographicHash *hash,
+    quint64 dictionarySize, quint64 solidBlockSize)
 {
     LIB7Z_ASSERTS(archive, Writable)
 
     const QString tmpArchive = createTmp7z();
-    Lib7z::createArchive(tmpArchive, sources, TmpFile::No, level, callback);
+    Lib7z::createArchive(tmpArchive, sources, TmpFile::No, level, callback, threadCount,
+        dictionarySize, solidBlockSize);
 
     try {
         QFile source(tmpArchive);
         QInstaller::openForRead(&source);
-        QInstaller::blockingCopy(&source, archive, source.size());
+        if (!hash) {
+            QInstaller::blockingCopy(&source, archive, source.size());
+        } else {
+            // The 7z signature header is only complete once the archive has been written, so
+            // the checksum is calculated while the archive gets copied to its final place.
+            QByteArray buffer(1024 * 1024, '\0');
+            qint64 remaining = source.size();
+            while (remaining > 0) {
+                const qint64 size = qMin(qint64(buffer.size()), remaining);
+                QInstaller::blockingRead(&source, buffer.data(), size);
+                QInstaller::blockingWrite(archive, buffer.constData(), size);
+                hash->addData(buffer.constData(), int(size));
+                remaining -= size;
+            }
+        }
     } catch (const QInstaller::Error &error) {
         throw SevenZipException(error.message());
     }
 }
 
+/*!
+    \internal
+
+    Runs the 7-Zip command given by \a commandStrings, which needs to be one of the commands
+    that update an archive, and reports its progress to \a callback. Returns the name of the
+    archive written by the command.
+*/
+static QString runUpdateCommand(const UStringVector &commandStrings, UpdateCallback *callback)
+{
+    CArcCmdLineOptions options;
+    try {
+        CArcCmdLineParser parser;
+        parser.Parse1(commandStrings, options);
+        parser.Parse2(options);
+    } catch (const CArcCmdLineException &e) {
+        throw SevenZipException(UString2QString(e));
+    }
+
+    CCodecs codecs;
+    if (codecs.Load() != S_OK)
+        throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
+
+    CObjectVector<COpenType> types;
+    if (!ParseOpenTypes(codecs, options.ArcType, types))
+        throw SevenZipException(QCoreApplication::translate("Lib7z", "Unsupported archive type."));
+
+    CUpdateErrorInfo errorInfo;
+    CMyComPtr<UpdateCallback> comCallback = callback == 0 ? new UpdateCallback : callback;
+    const HRESULT res = UpdateArchive(&codecs, types, options.ArchiveName, options.Censor,
+        options.UpdateOptions, errorInfo, nullptr, comCallback, true);
+
+    const QFile tempFile(UString2QString(options.ArchiveName));
+    if (res != S_OK || !tempFile.exists()) {
+        QString errorMsg;
+        if (res == S_OK) {
+            errorMsg = QCoreApplication::translate("Lib7z", "Cannot create archive \"%1\"")
+                .arg(QDir::toNativeSeparators(tempFile.fileName()));
+        } else {
+            errorMsg = QCoreApplication::translate("Lib7z", "Cannot create archive \"%1\": %2")
+                .arg(QDir::toNativeSeparators(tempFile.fileName()), errorMessageFrom7zResult(res));
+        }
+        throw SevenZipException(errorMsg);
+    }
+    return tempFile.fileName();
+}
+
+/*!
+    \internal
+
+    Appends the switches selecting the compression \a level, the number of compression threads
+    given by \a threadCount, the \a dictionarySize and the \a solidBlockSize to
+    \a commandStrings. A value of \c 0 keeps the 7-Zip default for the setting.
+*/
+static void addCompressionSwitches(UStringVector &commandStrings, Compression level,
+    int threadCount, quint64 dictionarySize, quint64 solidBlockSize = 0)
+{
+    if (threadCount > 0) // threads: multi-threaded
+        commandStrings.Add(QString2UString(QString::fromLatin1("-mmt=%1").arg(threadCount)));
+    else
+        commandStrings.Add(L"-mmt=on");
+    commandStrings.Add(QString2UString(QString::fromLatin1("-mx=%1").arg(int(level)))); // compression: level
+    if (dictionarySize > 0) // dictionary: size in bytes
+        commandStrings.Add(QString2UString(QString::fromLatin1("-md=%1b").arg(dictionarySize)));
+    if (solidBlockSize > 0) // solid: block size in bytes
+        commandStrings.Add(QString2UString(QString::fromLatin1("-ms=%1b").arg(solidBlockSize)));
+}
+
 /*!
     Creates an archive with the given filename \a archive. \a sources can contain one or more
     files, one or more directories or a combination of files and folders. Also, \c * wildcard
     is supported. To be able to use the function during an elevated installation, set \a mode to
     \c TmpFile::Yes. The value of \a level specifies the compression ratio, the default is set
     to \c 5 (Normal compression). The \a callback can be used to get information about the archive
-    creation process. If no \a callback is given, an empty implementation is used.
+    creation process. If no \a callback is given, an empty implementation is used. The value of
+    \a threadCount limits the number of compression threads, \c 0 uses one thread per core.
+    The value of \a dictionarySize sets the dictionary size in bytes, the value of
+    \a solidBlockSize limits the size in bytes of a solid block. Smaller solid blocks can be
+    decompressed in parallel. A value of \c 0 uses the default implied by \a level.
 
     \note Throws SevenZipException on error.
     \note If \a archive exists, it will be overwritten.
@@ -987,62 +1106,29 @@ void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sou
     \note The ownership of \a callback is transferred to the function and gets delete on exit.
 */
 void createArchive(const QString &archive, const QStringList &sources, TmpFile mode,
-    Compression level, UpdateCallback *callback)
+    Compression level, UpdateCallback *callback, int threadCount, quint64 dictionarySize,
+    quint64 solidBlockSize)
 {
     try {
         QString target = archive;
         if (mode == TmpFile::Yes)
             target = createTmp7z();
 
-        CArcCmdLineOptions options;
-        try {
-            UStringVector commandStrings;
-            commandStrings.Add(L"a"); // mode: add
-            commandStrings.Add(L"-t7z"); // type: 7z
-            commandStrings.Add(L"-mtm=on"); // time: modeifier|creation|access
-            commandStrings.Add(L"-mtc=on");
-            commandStrings.Add(L"-mta=on");
-            commandStrings.Add(L"-mmt=on"); // threads: multi-threaded
+        UStringVector commandStrings;
+        commandStrings.Add(L"a"); // mode: add
+        commandStrings.Add(L"-t7z"); // type: 7z
+        commandStrings.Add(L"-mtm=on"); // time: modeifier|creation|access
+        commandStrings.Add(L"-mtc=on");
+        commandStrings.Add(L"-mta=on");
 #ifdef Q_OS_WIN
-            commandStrings.Add(L"-sccUTF-8"); // files: case-sensitive|UTF8
+        commandStrings.Add(L"-sccUTF-8"); // files: case-sensitive|UTF8
 #endif
-            commandStrings.Add(QString2UString(QString::fromLatin1("-mx=%1").arg(int(level)))); // compression: level
-            commandStrings.Add(QString2UString(QDir::toNativeSeparators(target)));
-            foreach (const QString &source, sources)
-                commandStrings.Add(QString2UString(source));
-
-            CArcCmdLineParser parser;
-            parser.Parse1(commandStrings, options);
-            parser.Parse2(options);
-        } catch (const CArcCmdLineException &e) {
-            throw SevenZipException(UString2QString(e));
-        }
+        addCompressionSwitches(commandStrings, level, threadCount, dictionarySize, solidBlockSize);
+        commandStrings.Add(QString2UString(QDir::toNativeSeparators(target)));
+        foreach (const QString &source, sources)
+            commandStrings.Add(QString2UString(source));
 
-        CCodecs codecs;
-        if (codecs.Load() != S_OK)
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
-
-        CObjectVector<COpenType> types;
-        if (!ParseOpenTypes(codecs, options.ArcType, types))
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Unsupported archive type."));
-
-        CUpdateErrorInfo errorInfo;
-        CMyComPtr<UpdateCallback> comCallback = callback == 0 ? new UpdateCallback : callback;
-        const HRESULT res = UpdateArchive(&codecs, types, options.ArchiveName, options.Censor,
-            options.UpdateOptions, errorInfo, nullptr, comCallback, true);
-
-        const QFile tempFile(UString2QString(options.ArchiveName));
-        if (res != S_OK || !tempFile.exists()) {
-            QString errorMsg;
-            if (res == S_OK) {
-                errorMsg = QCoreApplication::translate("Lib7z", "Cannot create archive \"%1\"")
-                    .arg(QDir::toNativeSeparators(tempFile.fileName()));
-            } else {
-                errorMsg = QCoreApplication::translate("Lib7z", "Cannot create archive \"%1\": %2")
-                    .arg(QDir::toNativeSeparators(tempFile.fileName()), errorMessageFrom7zResult(res));
-            }
-            throw SevenZipException(errorMsg);
-        }
+        const QString archiveName = runUpdateCommand(commandStrings, callback);
 
         if (mode == TmpFile::Yes) {
             QFile org(archive);
@@ -1052,7 +1138,7 @@ void createArchive(const QString &archive, const QStringList &sources, TmpFile m
                                                 org.errorString()));
             }
 
-            QFile arc(UString2QString(options.ArchiveName));
+            QFile arc(archiveName);
             if(!arc.rename(archive)) {
                 throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot rename "
                     "temporary archive \"%1\" to \"%2\": %3").arg(
@@ -1074,13 +1160,326 @@ void createArchive(const QString &archive, const QStringList &sources, TmpFile m
 }
 
 /*!
-    Extracts the given \a archive content into target directory \a directory using the provided
-    extract callback \a callback. The output filenames are deduced from the \a archive content.
+    Updates the archive with the given filename \a archive in place. First the entries given by
+    \a removedEntries are deleted from the archive, including everything below them, then the
+    files and directories given by \a sources are added. If \a archive does not exist, it gets
+    created. The values of \a level, \a callback, \a threadCount and \a dictionarySize have
+    the same meaning as for createArchive().
+
+    Entries get added to the archive without solid compression, so that later updates can
+    remove and replace them without compressing the unchanged entries again.
 
     \note Throws SevenZipException on error.
-    \note The ownership of \a callback is not transferred to the function.
+    \note Filenames are stored case-sensitive with UTF-8 encoding.
+    \note The ownership of \a callback is transferred to the function and gets delete on exit.
 */
-void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallback *callback)
+void updateArchive(const QString &archive, const QStringList &sources,
+    const QStringList &removedEntries, Compression level, UpdateCallback *callback, int threadCount,
+    quint64 dictionarySize)
+{
+    CMyComPtr<UpdateCallback> comCallback = callback == 0 ? new UpdateCallback : callback;
+    try {
+        if (!removedEntries.isEmpty() && QFileInfo::exists(archive)) {
+            UStringVector commandStrings;
+            commandStrings.Add(L"d"); // mode: delete
+            commandStrings.Add(L"-t7z"); // type: 7z
+#ifdef Q_OS_WIN
+            commandStrings.Add(L"-sccUTF-8"); // files: case-sensitive|UTF8
+#endif
+            commandStrings.Add(QString2UString(QDir::toNativeSeparators(archive)));
+            foreach (const QString &entry, removedEntries)
+                commandStrings.Add(QString2UString(entry));
+            runUpdateCommand(commandStrings, comCallback);
+        }
+
+        if (!sources.isEmpty()) {
+            UStringVector commandStrings;
+            commandStrings.Add(L"a"); // mode: add
+            commandStrings.Add(L"-t7z"); // type: 7z
+            commandStrings.Add(L"-ms=off"); // solid: off, entries can be replaced on their own
+            commandStrings.Add(L"-mtm=on"); // time: modeifier|creation|access
+            commandStrings.Add(L"-mtc=on");
+            commandStrings.Add(L"-mta=on");
+#ifdef Q_OS_WIN
+            commandStrings.Add(L"-sccUTF-8"); // files: case-sensitive|UTF8
+#endif
+            addCompressionSwitches(commandStrings, level, threadCount, dictionarySize);
+            commandStrings.Add(QString2UString(QDir::toNativeSeparators(archive)));
+            foreach (const QString &source, sources)
+                commandStrings.Add(QString2UString(source));
+            runUpdateCommand(commandStrings, comCallback);
+        }
+    } catch (const char *err) {
+        throw SevenZipException(err);
+    } catch (SevenZipException &e) {
+        throw e; // re-throw unmodified
+    } catch (const QInstaller::Error &err) {
+        throw SevenZipException(err.message());
+    } catch (...) {
+        throw SevenZipException(QCoreApplication::translate("Lib7z",
+            "Unknown exception caught (%1)").arg(QString::fromLatin1(Q_FUNC_INFO)));
+    }
+}
+
+static QAtomicInt s_extractThreadCount(0);
+
+/*!
+    Sets the maximum number of threads used to extract the solid blocks of an archive
+    concurrently to \a count. A value of \c 1 extracts all blocks one after another, a value
+    of \c 0 or less restores the default.
+
+    \sa extractThreadCount()
+*/
+void setExtractThreadCount(int count)
+{
+    s_extractThreadCount.storeRelease(count);
+}
+
+/*!
+    Returns the maximum number of threads used to extract the solid blocks of an archive
+    concurrently. Defaults to the number of processor cores, but at most four, as every thread
+    needs its own dictionary buffer.
+
+    \sa setExtractThreadCount()
+*/
+int extractThreadCount()
+{
+    const int count = s_extractThreadCount.loadAcquire();
+    return count > 0 ? count : qBound(1, QThread::idealThreadCount(), 4);
+}
+
+static void openArchiveForExtraction(QFileDevice *archive, CCodecs *codecs, CArchiveLink *archiveLink)
+{
+    if (codecs->Load() != S_OK)
+        throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
+
+    COpenOptions op;
+    op.codecs = codecs;
+
+    CObjectVector<COpenType> types;
+    op.types = &types;  // Empty, because we use a stream.
+
+    CIntVector excluded;
+    excluded.Add(codecs->FindFormatForExtension(
+        QString2UString(QLatin1String("xz")))); // handled by libarchive
+    op.excludedFormats = &excluded;
+
+    const CMyComPtr<IInStream> stream = new QIODeviceInStream(archive);
+    op.stream = stream; // CMyComPtr is needed, otherwise it crashes in OpenStream().
+
+    CObjectVector<CProperty> properties;
+    op.props = &properties;
+
+    if (archiveLink->Open2(op, nullptr) != S_OK) {
+        throw SevenZipException(QCoreApplication::translate("Lib7z",
+            "Cannot open archive \"%1\".").arg(archive->fileName()));
+    }
+}
+
+struct FolderExtraction
+{
+    QMutex mutex;
+    ExtractCallback *callback = nullptr;
+    QVector<quint64> completed;
+    quint64 total = 0;
+    bool failed = false;
+    QString errorString;
+};
+
+/*!
+    \internal
+    \class Lib7z::FolderExtractCallback
+
+    Extracts a subset of the solid blocks of an archive on behalf of another extract callback.
+    All calls to the other callback are serialized, so it does not need to be thread-safe, and
+    it reports the combined progress of all blocks.
+*/
+class FolderExtractCallback : public ExtractCallback
+{
+    Q_DISABLE_COPY(FolderExtractCallback)
+
+public:
+    FolderExtractCallback(FolderExtraction *extraction, int worker)
+        : m_extraction(extraction)
+        , m_worker(worker)
+    {}
+
+protected:
+    bool prepareForFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        QMutexLocker locker(&m_extraction->mutex);
+        return !m_extraction->failed && m_extraction->callback->prepareForFile(filename);
+    }
+
+    void setCurrentFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        QMutexLocker locker(&m_extraction->mutex);
+        m_extraction->callback->setCurrentFile(filename);
+    }
+
+    HRESULT setCompleted(quint64 completed, quint64 /*total*/) Q_DECL_OVERRIDE
+    {
+        QMutexLocker locker(&m_extraction->mutex);
+        if (m_extraction->failed)
+            return E_ABORT;
+
+        m_extraction->completed[m_worker] = completed;
+        if (m_extraction->total == 0)
+            return S_OK;
+
+        quint64 sum = 0;
+        foreach (quint64 value, m_extraction->completed)
+            sum += value;
+        const HRESULT result = m_extraction->callback->setCompleted(qMin(sum, m_extraction->total),
+            m_extraction->total);
+        if (result != S_OK)
+            m_extraction->failed = true;
+        return result;
+    }
+
+private:
+    FolderExtraction *m_extraction;
+    int m_worker;
+};
+
+static void extractFolderItems(const QString &fileName, const QString &directory,
+    const QVector<UInt32> &indices, FolderExtraction *extraction, int worker)
+{
+    CMyComPtr<FolderExtractCallback> callback = new FolderExtractCallback(extraction, worker);
+    try {
+        // every thread reads the archive through its own handle
+        QFile archive(fileName);
+        if (!archive.open(QIODevice::ReadOnly)) {
+            throw SevenZipException(QCoreApplication::translate("Lib7z",
+                "Cannot open archive \"%1\".").arg(fileName));
+        }
+
+        CCodecs codecs;
+        CArchiveLink archiveLink;
+        openArchiveForExtraction(&archive, &codecs, &archiveLink);
+        if (archiveLink.Arcs.Size() != 1) {
+            throw SevenZipException(QCoreApplication::translate("Lib7z",
+                "Cannot open archive \"%1\".").arg(fileName));
+        }
+
+        callback->setTarget(directory);
+        callback->setArchive(&archiveLink.Arcs[0]);
+        const LONG result = archiveLink.Arcs[0].Archive->Extract(indices.constData(),
+            static_cast<UInt32>(indices.size()), false, callback);
+        if (result != S_OK)
+            throw SevenZipException(errorMessageFrom7zResult(result));
+    } catch (const SevenZipException &e) {
+        QMutexLocker locker(&extraction->mutex);
+        if (!extraction->failed || extraction->errorString.isEmpty())
+            extraction->errorString = e.message();
+        extraction->failed = true;
+    } catch (...) {
+        QMutexLocker locker(&extraction->mutex);
+        if (extraction->errorString.isEmpty()) {
+            extraction->errorString = QCoreApplication::translate("Lib7z",
+                "Unknown exception caught (%1).").arg(QString::fromLatin1(Q_FUNC_INFO));
+        }
+        extraction->failed = true;
+    }
+}
+
+/*!
+    \internal
+
+    Extracts the solid blocks of \a arc concurrently, each thread decoding a share of the
+    blocks from its own handle to \a archive. Items without a block, like directories and empty
+    files, are extracted by the first thread. Returns \c false without extracting anything if
+    the archive has less than two blocks, if only a single thread should be used or if
+    \a archive is not a plain file on disk. Archives read through a file engine, like
+    \c installer:// resources, share a single device that cannot be opened a second time.
+
+    \note Throws SevenZipException on error.
+*/
+static bool extractFoldersConcurrently(QFileDevice *archive, const QString &directory, CArc *arc,
+    const QVector<File> *files, ExtractCallback *callback)
+{
+    const int threadCount = extractThreadCount();
+    const QString fileName = archive->fileName();
+    if (threadCount < 2 || fileName.isEmpty() || !QFileInfo(fileName).isNativePath())
+        return false;
+
+    IInArchive *const arch = arc->Archive;
+    QVector<UInt32> indices;
+    if (files) {
+        foreach (const File &file, *files) {
+            if (file.archiveIndex.x() == 0)
+                indices.append(static_cast<UInt32>(file.archiveIndex.y()));
+        }
+    } else {
+        UInt32 numItems = 0;
+        if (arch->GetNumberOfItems(&numItems) != S_OK)
+            return false;
+        for (UInt32 item = 0; item < numItems; ++item)
+            indices.append(item);
+    }
+
+    QHash<quint32, QVector<UInt32> > blocks;
+    QHash<quint32, quint64> blockSizes;
+    QVector<UInt32> itemsWithoutBlock;
+    quint64 total = 0;
+    foreach (UInt32 index, indices) {
+        const quint64 size = getUInt64Property(arch, index, kpidSize, 0);
+        total += size;
+
+        const NCOM::CPropVariant block = readProperty(arch, index, kpidBlock);
+        if (block.vt != VT_UI4) {
+            itemsWithoutBlock.append(index);
+            continue;
+        }
+        blocks[block.ulVal].append(index);
+        blockSizes[block.ulVal] += size;
+    }
+    if (blocks.count() < 2)
+        return false;
+
+    // hand out the largest blocks first, always to the thread with the least data to decode
+    const int workerCount = qMin(threadCount, blocks.count());
+    QVector<QVector<UInt32> > workerIndices(workerCount);
+    QVector<quint64> workerSizes(workerCount, 0);
+    workerIndices[0] = itemsWithoutBlock;
+
+    QList<quint32> blockOrder = blocks.keys();
+    std::sort(blockOrder.begin(), blockOrder.end(), [&blockSizes](quint32 lhs, quint32 rhs) {
+        return blockSizes.value(lhs) > blockSizes.value(rhs);
+    });
+    foreach (quint32 block, blockOrder) {
+        const int worker = std::min_element(workerSizes.begin(), workerSizes.end())
+            - workerSizes.begin();
+        workerIndices[worker] += blocks.value(block);
+        workerSizes[worker] += blockSizes.value(block);
+    }
+
+    FolderExtraction extraction;
+    extraction.callback = callback;
+    extraction.completed.fill(0, workerCount);
+    extraction.total = total;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workerCount);
+    QList<QFuture<void> > futures;
+    for (int worker = 0; worker < workerCount; ++worker) {
+        // IInArchive::Extract() expects the item indices in ascending order.
+        std::sort(workerIndices[worker].begin(), workerIndices[worker].end());
+        futures.append(QtConcurrent::run(&pool, extractFolderItems, fileName, directory,
+            workerIndices.at(worker), &extraction, worker));
+    }
+    foreach (QFuture<void> future, futures)
+        future.waitForFinished();
+
+    if (extraction.failed) {
+        throw SevenZipException(extraction.errorString.isEmpty()
+            ? errorMessageFrom7zResult(E_ABORT) : extraction.errorString);
+    }
+    return true;
+}
+
+static void extractArchiveItems(QFileDevice *archive, const QString &directory,
+    const QVector<File> *files, ExtractCallback *callback)
 {
     LIB7Z_ASSERTS(archive, Readable)
 
@@ -1098,38 +1497,37 @@ void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallb
         outDir.tryCreate();
 
         CCodecs codecs;
-        if (codecs.Load() != S_OK)
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
-
-        COpenOptions op;
-        op.codecs = &codecs;
-
-        CObjectVector<COpenType> types;
-        op.types = &types;  // Empty, because we use a stream.
-
-        CIntVector excluded;
-        excluded.Add(codecs.FindFormatForExtension(
-            QString2UString(QLatin1String("xz")))); // handled by libarchive
-        op.excludedFormats = &excluded;
-
-        const CMyComPtr<IInStream> stream = new QIODeviceInStream(archive);
-        op.stream = stream; // CMyComPtr is needed, otherwise it crashes in OpenStream().
-
-        CObjectVector<CProperty> properties;
-        op.props = &properties;
-
         CArchiveLink archiveLink;
-        if (archiveLink.Open2(op, nullptr) != S_OK) {
-            throw SevenZipException(QCoreApplication::translate("Lib7z",
-                "Cannot open archive \"%1\".").arg(archive->fileName()));
-        }
+        openArchiveForExtraction(archive, &codecs, &archiveLink);
 
         callback->setTarget(directory);
+        if (archiveLink.Arcs.Size() == 1
+                && extractFoldersConcurrently(archive, directory, &archiveLink.Arcs[0], files, callback)) {
+            outDir.release();
+            externCallback.Detach();
+            return;
+        }
+
         for (unsigned a = 0; a < archiveLink.Arcs.Size(); ++a) {
             callback->setArchive(&archiveLink.Arcs[a]);
             IInArchive *const arch = archiveLink.Arcs[a].Archive;
 
-            const LONG result = arch->Extract(0, static_cast<UInt32>(-1), false, callback);
+            LONG result = S_OK;
+            if (!files) {
+                result = arch->Extract(0, static_cast<UInt32>(-1), false, callback);
+            } else {
+                // IInArchive::Extract() expects the item indices in ascending order.
+                QVector<UInt32> indices;
+                foreach (const File &file, *files) {
+                    if (file.archiveIndex.x() == static_cast<int>(a))
+                        indices.append(static_cast<UInt32>(file.archiveIndex.y()));
+                }
+                if (indices.isEmpty())
+                    continue;
+                std::sort(indices.begin(), indices.end());
+                result = arch->Extract(indices.constData(), static_cast<UInt32>(indices.size()),
+                    false, callback);
+            }
             if (result != S_OK)
                 throw SevenZipException(errorMessageFrom7zResult(result));
         }
@@ -1145,6 +1543,33 @@ void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallb
     externCallback.Detach();
 }
 
+/*!
+    Extracts the given \a archive content into target directory \a directory using the provided
+    extract callback \a callback. The output filenames are deduced from the \a archive content.
+
+    \note Throws SevenZipException on error.
+    \note The ownership of \a callback is not transferred to the function.
+*/
+void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallback *callback)
+{
+    extractArchiveItems(archive, directory, nullptr, callback);
+}
+
+/*!
+    Extracts only the entries listed in \a files from the given \a archive into target
+    directory \a directory using the provided extract callback \a callback. The entries
+    are identified by their archive index, as returned by listArchive(), so the archive
+    is not decoded into files that are not requested.
+
+    \note Throws SevenZipException on error.
+    \note The ownership of \a callback is not transferred to the function.
+*/
+void extractArchive(QFileDevice *archive, const QString &directory, const QVector<File> &files,
+    ExtractCallback *callback)
+{
+    extractArchiveItems(archive, directory, &files, callback);
+}
+
 /*!
     Returns \c true if the given \a archive is supported; otherwise returns \c false.
 
@@ -29,11 +29,15 @@
 #include "lib7zarchive.h"
 
 #include "errors.h"
+#include "fileio.h"
 #include "lib7z_facade.h"
 #include "lib7z_create.h"
 #include "lib7z_list.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QSet>
 
 namespace QInstaller {
 
@@ -145,6 +149,23 @@ bool Lib7zArchive::extract(const QString &dirPath, const quint64 totalFiles)
     return extract(dirPath);
 }
 
+/*!
+    Extracts only the \a entries of this archive to \a dirPath. The entries must
+    originate from list() called on the same archive. Returns \c true on success;
+    \c false otherwise.
+*/
+bool Lib7zArchive::extractEntries(const QString &dirPath, const QVector<ArchiveEntry> &entries)
+{
+    m_extractCallback->setState(S_OK);
+    try {
+        Lib7z::extractArchive(&m_file, dirPath, entries, m_extractCallback);
+    } catch (const Lib7z::SevenZipException &e) {
+        setErrorString(e.message());
+        return false;
+    }
+    return true;
+}
+
 /*!
     \reimp
 
@@ -152,10 +173,53 @@ bool Lib7zArchive::extract(const QString &dirPath, const quint64 totalFiles)
 */
 bool Lib7zArchive::create(const QStringList &data)
 {
+    setArchiveHash(QByteArray());
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    try {
+        // No support for callback yet.
+        Lib7z::createArchive(&m_file, data, compressionLevel(), 0, compressionThreadCount(), &hash,
+            dictionarySize(), solidBlockSize());
+    } catch (const Lib7z::SevenZipException &e) {
+        setErrorString(e.message());
+        return false;
+    }
+    setArchiveHash(hash.result());
+    return true;
+}
+
+/*!
+    Updates the archive file on disk in place: removes the top level entries named in
+    \a replacedEntries together with their contents, then adds the given \a data. Creates
+    the archive if it does not exist yet. Only the changed entries get compressed, as the
+    archive is written without solid compression. The archive must not be opened.
+    Returns \c true on success; \c false otherwise.
+*/
+bool Lib7zArchive::update(const QStringList &data, const QStringList &replacedEntries)
+{
+    setArchiveHash(QByteArray());
     try {
+        QStringList removedEntries;
+        if (!replacedEntries.isEmpty() && m_file.exists()) {
+            QInstaller::openForRead(&m_file);
+            const QVector<ArchiveEntry> entries = Lib7z::listArchive(&m_file);
+            m_file.close();
+
+            QSet<QString> topLevelEntries;
+            foreach (const ArchiveEntry &entry, entries)
+                topLevelEntries.insert(QDir::fromNativeSeparators(entry.path).section(QLatin1Char('/'), 0, 0));
+            foreach (const QString &entry, replacedEntries) {
+                if (topLevelEntries.contains(entry))
+                    removedEntries.append(entry);
+            }
+        }
         // No support for callback yet.
-        Lib7z::createArchive(&m_file, data, compressionLevel());
+        Lib7z::updateArchive(m_file.fileName(), data, removedEntries, compressionLevel(), 0,
+            compressionThreadCount(), dictionarySize());
     } catch (const Lib7z::SevenZipException &e) {
+        m_file.close();
+        setErrorString(e.message());
+        return false;
+    } catch (const Error &e) {
         setErrorString(e.message());
         return false;
     }
@@ -51,7 +51,9 @@ public:
 
     bool extract(const QString &dirPath) Q_DECL_OVERRIDE;
     bool extract(const QString &dirPath, const quint64 totalFiles) Q_DECL_OVERRIDE;
+    bool extractEntries(const QString &dirPath, const QVector<ArchiveEntry> &entries);
     bool create(const QStringList &data) Q_DECL_OVERRIDE;
+    bool update(const QStringList &data, const QStringList &replacedEntries);
     QVector<ArchiveEntry> list() Q_DECL_OVERRIDE;
     bool isSupported() Q_DECL_OVERRIDE;
 
@@ -32,15 +32,27 @@
 #include "errors.h"
 #include "globals.h"
 
+#include <errno.h>
 #include <stdio.h>
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QDir>
 #include <QTimer>
+#include <QtConcurrentRun>
 
 namespace QInstaller {
 
+// Regular files up to this size are decoded into memory and written by the writer pool.
+static const qint64 MaxQueuedEntrySize = 1024 * 1024;
+// Upper bound of decoded data waiting for a writer thread.
+static const qint64 MaxQueuedBytes = 16 * 1024 * 1024;
+// Archives with fewer files are written on the decoding thread only.
+static const quint64 MinFilesForWriterPool = 32;
+// Minimum time in milliseconds between two progress reports while extracting.
+static const qint64 ProgressInterval = 100;
+
 /*!
     \inmodule QtInstallerFramework
     \class QInstaller::ScopedPointerReaderDeleter
@@ -59,12 +71,308 @@ namespace QInstaller {
     \internal
 */
 
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::EntryWriterPool
+    \internal
+
+    Writes small regular files of an archive being extracted on a pool of writer threads.
+    The thread reading the archive stays the only one decompressing data; it hands complete
+    entries to the writers through a queue bounded by MaxQueuedBytes. Entries that depend
+    on the order of extraction, like links or paths written before, are written by the
+    reading thread once all queued entries are on disk.
+*/
+
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::DataBlockQueue
+    \internal
+
+    A ring buffer of data blocks passed from the thread receiving the archive data
+    to the thread reading the archive.
+*/
+
 /*!
     \inmodule QtInstallerFramework
     \class QInstaller::ExtractWorker
     \internal
 */
 
+/*!
+    Constructs a writer pool for extracting an archive with \a totalFiles entries. Small
+    archives and single core machines do not get any writer threads.
+*/
+EntryWriterPool::EntryWriterPool(quint64 totalFiles)
+{
+    const int threads = qBound(0, QThread::idealThreadCount() - 1, 4);
+    if (totalFiles < MinFilesForWriterPool || threads < 1)
+        return;
+
+    m_threadPool.setMaxThreadCount(threads);
+    for (int i = 0; i < threads; ++i)
+        m_writers.append(QtConcurrent::run(&m_threadPool, this, &EntryWriterPool::run));
+}
+
+/*!
+    Discards entries not yet written and waits for the writer threads to finish.
+*/
+EntryWriterPool::~EntryWriterPool()
+{
+    {
+        QMutexLocker _(&m_mutex);
+        qDeleteAll(m_queue);
+        m_queue.clear();
+        m_queuedBytes = 0;
+    }
+    finish();
+}
+
+/*!
+    Returns \c true if \a entry can be handed to the writer threads with queue().
+*/
+bool EntryWriterPool::canQueue(archive_entry *entry) const
+{
+    return !m_writers.isEmpty()
+        && archive_entry_filetype(entry) == AE_IFREG
+        && !archive_entry_hardlink(entry)
+        && archive_entry_size_is_set(entry)
+        && archive_entry_size(entry) <= MaxQueuedEntrySize
+        && !m_queuedPaths.contains(QByteArray(archive_entry_pathname(entry)));
+}
+
+/*!
+    Reads the data of the current \a entry from \a reader and queues it for writing.
+    Blocks while the queue is full. Returns \c false on failure.
+*/
+bool EntryWriterPool::queue(archive *reader, archive_entry *entry)
+{
+    QScopedPointer<Entry> item(new Entry);
+    item->entry = archive_entry_clone(entry);
+
+    const void *buff;
+    size_t size;
+    la_int64_t offset;
+    forever {
+        const int status = archive_read_data_block(reader, &buff, &size, &offset);
+        if (status == ARCHIVE_EOF)
+            break;
+        if (status != ARCHIVE_OK) {
+            setErrorString(QLatin1String(archive_error_string(reader)));
+            return false;
+        }
+        item->blocks.append({ offset, QByteArray(static_cast<const char *>(buff), int(size)) });
+        item->size += size;
+    }
+    m_queuedPaths.insert(QByteArray(archive_entry_pathname(entry)));
+
+    QMutexLocker _(&m_mutex);
+    while (m_errorString.isEmpty() && !m_queue.isEmpty()
+            && m_queuedBytes + item->size > MaxQueuedBytes) {
+        m_entryTaken.wait(&m_mutex);
+    }
+    if (!m_errorString.isEmpty())
+        return false;
+
+    m_queuedBytes += item->size;
+    m_queue.enqueue(item.take());
+    m_entryQueued.wakeOne();
+    return true;
+}
+
+/*!
+    Makes sure \a entry can be written by the reading thread without racing against queued
+    entries: hard links need their target on disk, symbolic links might replace directories
+    of queued files, and an entry might overwrite a path that is still queued. Returns
+    \c false if a writer thread failed.
+*/
+bool EntryWriterPool::prepareDirectWrite(archive_entry *entry)
+{
+    if (m_writers.isEmpty() || m_queuedPaths.isEmpty())
+        return true;
+
+    if (archive_entry_hardlink(entry) || archive_entry_filetype(entry) == AE_IFLNK
+            || m_queuedPaths.contains(QByteArray(archive_entry_pathname(entry)))) {
+        return waitForIdle();
+    }
+    return errorString().isEmpty();
+}
+
+/*!
+    Writes all queued entries and stops the writer threads. Returns \c false if
+    writing any of the entries failed.
+*/
+bool EntryWriterPool::finish()
+{
+    {
+        QMutexLocker _(&m_mutex);
+        m_closed = true;
+        m_entryQueued.wakeAll();
+    }
+    foreach (QFuture<void> writer, m_writers)
+        writer.waitForFinished();
+    m_writers.clear();
+    m_queuedPaths.clear();
+
+    return errorString().isEmpty();
+}
+
+/*!
+    Returns a human-readable description of the last error that occurred.
+*/
+QString EntryWriterPool::errorString() const
+{
+    QMutexLocker _(&m_mutex);
+    return m_errorString;
+}
+
+/*!
+    Takes entries from the queue and writes them to disk until the pool is finished.
+*/
+void EntryWriterPool::run()
+{
+    QScopedPointer<archive, ScopedPointerWriterDeleter> writer(archive_write_disk_new());
+    LibArchiveArchive::configureDiskWriter(writer.get());
+
+    forever {
+        QScopedPointer<Entry> item;
+        {
+            QMutexLocker _(&m_mutex);
+            while (m_queue.isEmpty() && !m_closed)
+                m_entryQueued.wait(&m_mutex);
+            if (m_queue.isEmpty())
+                return;
+
+            item.reset(m_queue.dequeue());
+            m_queuedBytes -= item->size;
+            ++m_busyWriters;
+            m_entryTaken.wakeAll();
+        }
+
+        QString error;
+        if (errorString().isEmpty()) {
+            if (archive_write_header(writer.get(), item->entry) != ARCHIVE_OK)
+                error = QLatin1String(archive_error_string(writer.get()));
+            for (int i = 0; error.isEmpty() && i < item->blocks.count(); ++i) {
+                const Block &block = item->blocks.at(i);
+                if (archive_write_data_block(writer.get(), block.data.constData(), block.data.size(),
+                        block.offset) != ARCHIVE_OK) {
+                    error = QLatin1String(archive_error_string(writer.get()));
+                }
+            }
+            // Close the file now, a hard link to it might be written next.
+            if (error.isEmpty() && archive_write_finish_entry(writer.get()) < ARCHIVE_WARN)
+                error = QLatin1String(archive_error_string(writer.get()));
+        }
+
+        QMutexLocker _(&m_mutex);
+        if (!error.isEmpty() && m_errorString.isEmpty())
+            m_errorString = error;
+        --m_busyWriters;
+        m_entryTaken.wakeAll();
+    }
+}
+
+/*!
+    Blocks until all queued entries are written. Returns \c false if a writer thread failed.
+*/
+bool EntryWriterPool::waitForIdle()
+{
+    QMutexLocker _(&m_mutex);
+    while (m_errorString.isEmpty() && (!m_queue.isEmpty() || m_busyWriters > 0))
+        m_entryTaken.wait(&m_mutex);
+    m_queuedPaths.clear();
+    return m_errorString.isEmpty();
+}
+
+/*!
+    Sets the human-readable description of the last error to \a error,
+    unless an earlier error is already set.
+*/
+void EntryWriterPool::setErrorString(const QString &error)
+{
+    QMutexLocker _(&m_mutex);
+    if (m_errorString.isEmpty())
+        m_errorString = error;
+}
+
+/*!
+    Constructs a queue with room for \a capacity blocks.
+*/
+DataBlockQueue::DataBlockQueue(int capacity)
+    : m_blocks(capacity)
+{
+}
+
+/*!
+    Appends \a block to the queue and wakes up a reader waiting in pop(). The queue grows
+    if it is full, the producer is never blocked.
+*/
+void DataBlockQueue::push(const QByteArray &block)
+{
+    QMutexLocker _(&m_mutex);
+    if (m_count == m_blocks.size()) {
+        QVector<QByteArray> blocks(qMax(1, m_blocks.size() * 2));
+        for (int i = 0; i < m_count; ++i)
+            blocks[i].swap(m_blocks[(m_first + i) % m_blocks.size()]);
+        m_blocks.swap(blocks);
+        m_first = 0;
+    }
+    m_blocks[(m_first + m_count) % m_blocks.size()] = block;
+    ++m_count;
+    m_blockAdded.wakeAll();
+}
+
+/*!
+    Marks the end of the data. Once all queued blocks are taken,
+    pop() returns empty blocks.
+*/
+void DataBlockQueue::setAtEnd()
+{
+    QMutexLocker _(&m_mutex);
+    m_atEnd = true;
+    m_blockAdded.wakeAll();
+}
+
+/*!
+    Discards all queued blocks and the end of data mark.
+*/
+void DataBlockQueue::clear()
+{
+    QMutexLocker _(&m_mutex);
+    for (int i = 0; i < m_count; ++i)
+        m_blocks[(m_first + i) % m_blocks.size()].clear();
+    m_first = 0;
+    m_count = 0;
+    m_atEnd = false;
+}
+
+/*!
+    Takes the first block of the queue into \a block, waiting up to \a timeout
+    milliseconds for it to arrive. Returns \c false if no data arrived in time.
+*/
+bool DataBlockQueue::pop(QByteArray *block, int timeout)
+{
+    QMutexLocker _(&m_mutex);
+    while (m_count == 0 && !m_atEnd) {
+        if (!m_blockAdded.wait(&m_mutex, timeout))
+            return false;
+    }
+    if (m_count == 0) {
+        block->clear();
+        return true;
+    }
+    block->swap(m_blocks[m_first]);
+    m_blocks[m_first].clear();
+    m_first = (m_first + 1) % m_blocks.size();
+    --m_count;
+    return true;
+}
+
+ExtractWorker::ExtractWorker()
+    : m_blocks(MaxBufferedBlocks)
+{
+}
+
 ExtractWorker::Status ExtractWorker::status() const
 {
     return m_status;
@@ -75,6 +383,11 @@ void ExtractWorker::extract(const QString &dirPath, const quint64 totalFiles)
     m_status = Unfinished;
     quint64 completed = 0;
 
+    m_blocks.clear();
+    m_requestedBlocks = 0;
+    m_lastPos = 0;
+    m_readPos = 0;
+
     if (!totalFiles) {
         m_status = Failure;
         emit finished(QLatin1String("The file count for current archive is null!"));
@@ -89,6 +402,12 @@ void ExtractWorker::extract(const QString &dirPath, const quint64 totalFiles)
     LibArchiveArchive::configureDiskWriter(writer.get());
 
     DirectoryGuard targetDir(QFileInfo(dirPath).absolutePath());
+    // Declared after the guard, so that writing stops before created directories are removed.
+    EntryWriterPool writerPool(totalFiles);
+    quint64 reported = 0;
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+
     try {
         const QStringList createdDirs = targetDir.tryCreate();
         // Make sure that all leading directories created get removed as well
@@ -130,14 +449,28 @@ void ExtractWorker::extract(const QString &dirPath, const quint64 totalFiles)
             }
 
             emit currentEntryChanged(outputPath);
-            if (!writeEntry(reader.get(), writer.get(), entry))
-                return;
+            if (writerPool.canQueue(entry)) {
+                if (!writerPool.queue(reader.get(), entry))
+                    throw Error(writerPool.errorString());
+            } else {
+                if (!writerPool.prepareDirectWrite(entry))
+                    throw Error(writerPool.errorString());
+                if (!writeEntry(reader.get(), writer.get(), entry))
+                    return;
+            }
 
             ++completed;
-            emit completedChanged(completed, totalFiles);
-
-            qApp->processEvents();
+            if (progressTimer.hasExpired(ProgressInterval)) {
+                emit completedChanged(completed, totalFiles);
+                reported = completed;
+                qApp->processEvents();
+                progressTimer.restart();
+            }
         }
+        if (!writerPool.finish())
+            throw Error(writerPool.errorString());
+        if (reported != completed)
+            emit completedChanged(completed, totalFiles);
     } catch (const Error &e) {
         m_status = Failure;
         emit finished(e.message());
@@ -148,15 +481,29 @@ void ExtractWorker::extract(const QString &dirPath, const quint64 totalFiles)
     emit finished();
 }
 
-void ExtractWorker::addDataBlock(const QByteArray buffer)
+/*!
+    Adds a \a buffer of archive data to be read. Can be called from any thread.
+*/
+void ExtractWorker::addDataBlock(const QByteArray &buffer)
 {
-    m_buffer.append(buffer);
-    emit dataReadyForRead();
+    m_blocks.push(buffer);
+}
+
+/*!
+    Informs that the client has no more data to be read. Can be called from any thread.
+*/
+void ExtractWorker::setDataAtEnd()
+{
+    m_blocks.setAtEnd();
 }
 
 void ExtractWorker::onFilePositionChanged(qint64 pos)
 {
+    // Blocks streamed ahead of the seek were all added before the new position arrived.
+    m_blocks.clear();
+    m_requestedBlocks = 0;
     m_lastPos = pos;
+    m_readPos = pos;
     emit seekReady();
 }
 
@@ -167,27 +514,25 @@ void ExtractWorker::cancel()
 
 ssize_t ExtractWorker::readCallback(archive *reader, void *caller, const void **buff)
 {
-    Q_UNUSED(reader)
-
     ExtractWorker *obj;
     if (!(obj = static_cast<ExtractWorker *>(caller)))
         return ARCHIVE_FATAL;
 
-    QByteArray *buffer = &obj->m_buffer;
-    if (!buffer->isEmpty())
-        buffer->clear();
-
-    emit obj->dataBlockRequested();
+    // Keep the client streaming ahead: ask for more blocks once half of the
+    // requested ones are consumed, so there is no round trip per block.
+    if (obj->m_requestedBlocks <= MaxBufferedBlocks / 2) {
+        emit obj->dataBlockRequested(MaxBufferedBlocks - obj->m_requestedBlocks);
+        obj->m_requestedBlocks = MaxBufferedBlocks;
+    }
 
-    // It's a bit bad that we have to wait here, but libarchive doesn't
-    // provide an event based reading method.
-    {
-        QEventLoop loop;
-        QTimer::singleShot(30000, &loop, &QEventLoop::quit);
-        connect(obj, &ExtractWorker::dataReadyForRead, &loop, &QEventLoop::quit);
-        connect(obj, &ExtractWorker::dataAtEnd, &loop, &QEventLoop::quit);
-        loop.exec();
+    QByteArray *buffer = &obj->m_buffer;
+    if (!obj->m_blocks.pop(buffer, 30000)) {
+        archive_set_error(reader, ARCHIVE_ERRNO_MISC, "Timeout while waiting for archive data.");
+        return ARCHIVE_FATAL;
     }
+    if (!buffer->isEmpty())
+        --obj->m_requestedBlocks;
+    obj->m_readPos += buffer->size();
 
     if (!(*buff = static_cast<const void *>(buffer->constData())))
         return ARCHIVE_FATAL;
@@ -203,6 +548,11 @@ la_int64_t ExtractWorker::seekCallback(archive *reader, void *caller, la_int64_t
     if (!(obj = static_cast<ExtractWorker *>(caller)))
         return ARCHIVE_FATAL;
 
+    // The client has read ahead of us, make the offset absolute.
+    if (whence == SEEK_CUR) {
+        offset += obj->m_readPos;
+        whence = SEEK_SET;
+    }
     emit obj->seekRequested(static_cast<qint64>(offset), whence);
 
     {
@@ -267,9 +617,10 @@ bool ExtractWorker::writeEntry(archive *reader, archive *writer, archive_entry *
 */
 
 /*!
-    \fn QInstaller::LibArchiveArchive::dataBlockRequested()
+    \fn QInstaller::LibArchiveArchive::dataBlockRequested(int count)
 
-    Emitted when the worker object requires more data to continue extracting.
+    Emitted when the worker object requires \a count more data blocks to continue
+    extracting. The blocks can be added without waiting for further requests.
 */
 
 /*!
@@ -292,19 +643,6 @@ bool ExtractWorker::writeEntry(archive *reader, archive *writer, archive_entry *
     from an archive to \a dirPath.
 */
 
-/*!
-    \fn QInstaller::LibArchiveArchive::workerAboutToAddDataBlock(const QByteArray buffer)
-
-    Emitted when the worker object is about to add and read the data block in \a buffer.
-*/
-
-/*!
-    \fn QInstaller::LibArchiveArchive::workerAboutToSetDataAtEnd()
-
-    Emitted when the worker object is about to set data-at-end, meaning there
-    will be no further read requests for the calling client.
-*/
-
 /*!
     \fn QInstaller::LibArchiveArchive::workerAboutToCancel()
 
@@ -422,6 +760,12 @@ bool LibArchiveArchive::extract(const QString &dirPath, const quint64 totalFiles
     configureDiskWriter(writer.get());
 
     DirectoryGuard targetDir(QFileInfo(dirPath).absolutePath());
+    // Declared after the guard, so that writing stops before created directories are removed.
+    EntryWriterPool writerPool(totalFiles);
+    quint64 reported = 0;
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+
     try {
         const QStringList createdDirs = targetDir.tryCreate();
         // Make sure that all leading directories created get removed as well
@@ -453,14 +797,28 @@ bool LibArchiveArchive::extract(const QString &dirPath, const quint64 totalFiles
             }
 
             emit currentEntryChanged(outputPath);
-            if (!writeEntry(reader.get(), writer.get(), entry))
-                throw Error(errorString()); // appropriate error string set in writeEntry()
+            if (writerPool.canQueue(entry)) {
+                if (!writerPool.queue(reader.get(), entry))
+                    throw Error(writerPool.errorString());
+            } else {
+                if (!writerPool.prepareDirectWrite(entry))
+                    throw Error(writerPool.errorString());
+                if (!writeEntry(reader.get(), writer.get(), entry))
+                    throw Error(errorString()); // appropriate error string set in writeEntry()
+            }
 
             ++completed;
-            emit completedChanged(completed, totalFiles);
-
-            qApp->processEvents();
+            if (progressTimer.hasExpired(ProgressInterval)) {
+                emit completedChanged(completed, totalFiles);
+                reported = completed;
+                qApp->processEvents();
+                progressTimer.restart();
+            }
         }
+        if (!writerPool.finish())
+            throw Error(writerPool.errorString());
+        if (reported != completed)
+            emit completedChanged(completed, totalFiles);
     } catch (const Error &e) {
         setErrorString(e.message());
         m_data->file.seek(0);
@@ -478,12 +836,32 @@ bool LibArchiveArchive::extract(const QString &dirPath, const quint64 totalFiles
 */
 bool LibArchiveArchive::create(const QStringList &data)
 {
+    setArchiveHash(QByteArray());
+
+    // The archive is written through a callback, so that its checksum can be calculated
+    // on the way and does not need to be read back from the disk. Needs to outlive the
+    // writer, which writes the end of the archive when it gets freed.
+    WriteTarget target;
+    target.file.setFileName(m_data->file.fileName());
+
     QScopedPointer<archive, ScopedPointerWriterDeleter> writer(archive_write_new());
     configureWriter(writer.get());
+    // Like archive_write_open_filename() does for regular files, do not pad the last block.
+    archive_write_set_bytes_in_last_block(writer.get(), 1);
+
+    // Stores files with several links on disk once in tar archives, further links become
+    // hard link entries. Zip has no hard links and stores a copy of each of them.
+    QScopedPointer<archive_entry_linkresolver, ScopedPointerLinkResolverDeleter> resolver;
+    if (archive_format(writer.get()) != ARCHIVE_FORMAT_ZIP) {
+        resolver.reset(archive_entry_linkresolver_new());
+        archive_entry_linkresolver_set_strategy(resolver.get(), archive_format(writer.get()));
+    }
 
     try {
         int status;
-        if ((status = archive_write_open_filename(writer.get(), m_data->file.fileName().toLocal8Bit())))
+        if (!target.file.open(QIODevice::WriteOnly))
+            throw Error(target.file.errorString());
+        if ((status = archive_write_open(writer.get(), &target, nullptr, writeCallback, nullptr)))
             throw Error(QLatin1String(archive_error_string(writer.get())));
 
         for (auto &dataEntry : data) {
@@ -506,6 +884,13 @@ bool LibArchiveArchive::create(const QStringList &data)
                 // Set new path name in archive, otherwise we add all directories from absolute path
                 const QString newPath = basePath.relativeFilePath(fileOrDir.filePath());
                 archive_entry_set_pathname(entry.get(), newPath.toLocal8Bit());
+                if (resolver) {
+                    // the tar strategy turns later links into hard links with a size of zero,
+                    // it neither defers nor replaces the entry
+                    archive_entry *linked = entry.get();
+                    archive_entry *spare = nullptr;
+                    archive_entry_linkify(resolver.get(), &linked, &spare);
+                }
 
                 archive_read_disk_descend(reader.get());
                 status = archive_write_header(writer.get(), entry.get());
@@ -531,10 +916,16 @@ bool LibArchiveArchive::create(const QStringList &data)
                 file.close();
             }
         }
+        // writes the end of the archive, which needs to be part of the checksum
+        if (archive_write_close(writer.get()) != ARCHIVE_OK)
+            throw Error(QLatin1String(archive_error_string(writer.get())));
+        if (!target.file.flush())
+            throw Error(target.file.errorString());
     } catch (const Error &e) {
         setErrorString(e.message());
         return false;
     }
+    setArchiveHash(target.hash.result());
     return true;
 }
 
@@ -616,19 +1007,21 @@ void LibArchiveArchive::workerExtract(const QString &dirPath, const quint64 tota
 }
 
 /*!
-    Adds data to be read by the worker object in \a buffer.
+    Adds data to be read by the worker object in \a buffer. The block is queued
+    for the worker thread directly, without waiting for its event loop.
 */
-void LibArchiveArchive::workerAddDataBlock(const QByteArray buffer)
+void LibArchiveArchive::workerAddDataBlock(const QByteArray &buffer)
 {
-    emit workerAboutToAddDataBlock(buffer);
+    m_worker.addDataBlock(buffer);
 }
 
 /*!
-    Signals the worker object that the client data is at end.
+    Signals the worker object that the client data is at end, meaning there
+    will be no further read requests for the calling client.
 */
 void LibArchiveArchive::workerSetDataAtEnd()
 {
-    emit workerAboutToSetDataAtEnd();
+    m_worker.setDataAtEnd();
 }
 
 /*!
@@ -682,6 +1075,7 @@ void LibArchiveArchive::configureReader(archive *archive)
     archive_read_support_filter_bzip2(archive);
     archive_read_support_filter_gzip(archive);
     archive_read_support_filter_xz(archive);
+    archive_read_support_filter_zstd(archive);
 
     archive_read_support_format_tar(archive);
     archive_read_support_format_zip(archive);
@@ -692,13 +1086,26 @@ void LibArchiveArchive::configureReader(archive *archive)
 */
 void LibArchiveArchive::configureWriter(archive *archive)
 {
-    if (QFileInfo(m_data->file.fileName()).suffix() == QLatin1String("zip")) {
+    const QString suffix = QFileInfo(m_data->file.fileName()).suffix();
+    if (suffix == QLatin1String("zip")) {
         archive_write_set_format_zip(archive);
+    } else if (suffix == QLatin1String("zst")) {
+        // libarchive's extension table does not know about zstd
+        archive_write_set_format_pax_restricted(archive);
+        archive_write_add_filter_zstd(archive);
     } else {
         archive_write_set_format_pax_restricted(archive);
         archive_write_set_format_filter_by_ext(archive, m_data->file.fileName().toLatin1());
     }
-    const QByteArray options = "compression-level=" + QString::number(compressionLevel()).toLatin1();
+    QByteArray options = "compression-level=" + QString::number(compressionLevel()).toLatin1();
+    if (compressionThreadCount() > 0) {
+        // the zstd and xz filters split their input between worker threads
+        const QByteArray threads = QString::number(compressionThreadCount()).toLatin1();
+        if (suffix == QLatin1String("zst"))
+            options += ",zstd:threads=" + threads;
+        else if (suffix == QLatin1String("xz"))
+            options += ",xz:threads=" + threads;
+    }
     if (archive_write_set_options(archive, options.constData())) { // not fatal
         qCWarning(QInstaller::lcInstallerInstallLog) << "Could not set options" << options
             << "for archive" << m_data->file.fileName() << ":" << archive_error_string(archive);
@@ -735,8 +1142,6 @@ void LibArchiveArchive::initExtractWorker()
     m_worker.moveToThread(&m_workerThread);
 
     connect(this, &LibArchiveArchive::workerAboutToExtract, &m_worker, &ExtractWorker::extract);
-    connect(this, &LibArchiveArchive::workerAboutToAddDataBlock, &m_worker, &ExtractWorker::addDataBlock);
-    connect(this, &LibArchiveArchive::workerAboutToSetDataAtEnd, &m_worker, &ExtractWorker::dataAtEnd);
     connect(this, &LibArchiveArchive::workerAboutToSetFilePosition, &m_worker, &ExtractWorker::onFilePositionChanged);
     connect(this, &LibArchiveArchive::workerAboutToCancel, &m_worker, &ExtractWorker::cancel);
 
@@ -818,6 +1223,27 @@ qint64 LibArchiveArchive::readData(QFile *file, char *data, qint64 maxSize)
     return bytesRead;
 }
 
+/*!
+    \internal
+
+    Called by libarchive when data of a new archive is written. Writes \a length bytes of
+    \a buff to the file of the write target \a target, and adds them to its checksum.
+    Returns the number of bytes written.
+*/
+ssize_t LibArchiveArchive::writeCallback(archive *writer, void *target, const void *buff,
+    size_t length)
+{
+    WriteTarget *writeTarget = static_cast<WriteTarget *>(target);
+    const char *data = static_cast<const char *>(buff);
+    const qint64 bytesWritten = writeTarget->file.write(data, qint64(length));
+    if (bytesWritten < 0) {
+        archive_set_error(writer, EIO, "%s", qPrintable(writeTarget->file.errorString()));
+        return ARCHIVE_FATAL;
+    }
+    writeTarget->hash.addData(data, int(bytesWritten));
+    return bytesWritten;
+}
+
 /*!
     \internal
 
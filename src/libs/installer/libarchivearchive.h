@@ -35,7 +35,14 @@
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <QCryptographicHash>
+#include <QFuture>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
 #include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #if defined(_MSC_VER)
 #include <BaseTsd.h>
@@ -44,6 +51,80 @@ typedef SSIZE_T ssize_t;
 
 namespace QInstaller {
 
+class EntryWriterPool
+{
+    Q_DISABLE_COPY(EntryWriterPool)
+
+    struct Block
+    {
+        la_int64_t offset;
+        QByteArray data;
+    };
+
+    struct Entry
+    {
+        Entry() = default;
+        ~Entry() { archive_entry_free(entry); }
+        Q_DISABLE_COPY(Entry)
+
+        archive_entry *entry = nullptr;
+        QVector<Block> blocks;
+        qint64 size = 0;
+    };
+
+public:
+    explicit EntryWriterPool(quint64 totalFiles);
+    ~EntryWriterPool();
+
+    bool canQueue(archive_entry *entry) const;
+    bool queue(archive *reader, archive_entry *entry);
+    bool prepareDirectWrite(archive_entry *entry);
+    bool finish();
+
+    QString errorString() const;
+
+private:
+    void run();
+    bool waitForIdle();
+    void setErrorString(const QString &error);
+
+private:
+    QThreadPool m_threadPool;
+    QList<QFuture<void>> m_writers;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_entryQueued;
+    QWaitCondition m_entryTaken;
+    QQueue<Entry *> m_queue;
+    qint64 m_queuedBytes = 0;
+    int m_busyWriters = 0;
+    bool m_closed = false;
+    QString m_errorString;
+
+    QSet<QByteArray> m_queuedPaths;
+};
+
+class DataBlockQueue
+{
+    Q_DISABLE_COPY(DataBlockQueue)
+
+public:
+    explicit DataBlockQueue(int capacity);
+
+    void push(const QByteArray &block);
+    void setAtEnd();
+    void clear();
+    bool pop(QByteArray *block, int timeout);
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_blockAdded;
+    QVector<QByteArray> m_blocks;
+    int m_first = 0;
+    int m_count = 0;
+    bool m_atEnd = false;
+};
+
 class ExtractWorker : public QObject
 {
     Q_OBJECT
@@ -57,20 +138,22 @@ public:
         Unfinished = 3
     };
 
-    ExtractWorker() = default;
+    enum { MaxBufferedBlocks = 4 };
+
+    ExtractWorker();
 
     Status status() const;
 
+    void addDataBlock(const QByteArray &buffer);
+    void setDataAtEnd();
+
 public Q_SLOTS:
     void extract(const QString &dirPath, const quint64 totalFiles);
-    void addDataBlock(const QByteArray buffer);
     void onFilePositionChanged(qint64 pos);
     void cancel();
 
 Q_SIGNALS:
-    void dataBlockRequested();
-    void dataAtEnd();
-    void dataReadyForRead();
+    void dataBlockRequested(int count);
     void seekRequested(qint64 offset, int whence);
     void seekReady();
     void finished(const QString &errorString = QString());
@@ -85,7 +168,10 @@ private:
 
 private:
     QByteArray m_buffer;
+    DataBlockQueue m_blocks;
+    int m_requestedBlocks = 0;
     qint64 m_lastPos = 0;
+    qint64 m_readPos = 0;
     Status m_status;
 };
 
@@ -110,20 +196,18 @@ public:
     bool isSupported() Q_DECL_OVERRIDE;
 
     void workerExtract(const QString &dirPath, const quint64 totalFiles);
-    void workerAddDataBlock(const QByteArray buffer);
+    void workerAddDataBlock(const QByteArray &buffer);
     void workerSetDataAtEnd();
     void workerSetFilePosition(qint64 pos);
     void workerCancel();
     ExtractWorker::Status workerStatus() const;
 
 Q_SIGNALS:
-    void dataBlockRequested();
+    void dataBlockRequested(int count);
     void seekRequested(qint64 offset, int whence);
     void workerFinished();
 
     void workerAboutToExtract(const QString &dirPath, const quint64 totalFiles);
-    void workerAboutToAddDataBlock(const QByteArray buffer);
-    void workerAboutToSetDataAtEnd();
     void workerAboutToSetFilePosition(qint64 pos);
     void workerAboutToCancel();
 
@@ -146,6 +230,7 @@ private:
 
     static qint64 readData(QFile *file, char *data, qint64 maxSize);
     static ssize_t readCallback(archive *reader, void *archiveData, const void **buff);
+    static ssize_t writeCallback(archive *writer, void *target, const void *buff, size_t length);
 
     static la_int64_t seekCallback(archive *reader, void *archiveData, la_int64_t offset, int whence);
 
@@ -155,6 +240,7 @@ private:
 
 private:
     friend class ExtractWorker;
+    friend class EntryWriterPool;
     friend class LibArchiveWrapperPrivate;
 
     struct ArchiveData
@@ -163,6 +249,14 @@ private:
         QByteArray buffer;
     };
 
+    struct WriteTarget
+    {
+        WriteTarget() : hash(QCryptographicHash::Sha1) {}
+
+        QFile file;
+        QCryptographicHash hash;
+    };
+
 private:
     ArchiveData *m_data;
     ExtractWorker m_worker;
@@ -195,6 +289,14 @@ struct ScopedPointerEntryDeleter
     }
 };
 
+struct ScopedPointerLinkResolverDeleter
+{
+    static inline void cleanup(archive_entry_linkresolver *p)
+    {
+        archive_entry_linkresolver_free(p);
+    }
+};
+
 } // namespace QInstaller
 
 #endif // LIBARCHIVEARCHIVE_H
@@ -178,6 +178,24 @@ void LibArchiveWrapper::setCompressionLevel(const CompressionLevel level)
     d->setCompressionLevel(level);
 }
 
+/*!
+    Sets the number of threads used to compress new archives to \a count.
+*/
+void LibArchiveWrapper::setCompressionThreadCount(int count)
+{
+    d->setCompressionThreadCount(count);
+}
+
+/*!
+    Returns the SHA-1 checksum of the archive written by the last call to create().
+    Archives created by the server are not hashed while they are written, for
+    those an empty array is returned.
+*/
+QByteArray LibArchiveWrapper::archiveHash() const
+{
+    return d->archiveHash();
+}
+
 /*!
     Cancels the extract operation in progress.
 
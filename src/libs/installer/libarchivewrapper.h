@@ -58,6 +58,9 @@ public:
     bool isSupported() Q_DECL_OVERRIDE;
 
     void setCompressionLevel(const AbstractArchive::CompressionLevel level) Q_DECL_OVERRIDE;
+    void setCompressionThreadCount(int count) Q_DECL_OVERRIDE;
+
+    QByteArray archiveHash() const Q_DECL_OVERRIDE;
 
 public Q_SLOTS:
     void cancel() Q_DECL_OVERRIDE;
@@ -41,9 +41,9 @@ namespace QInstaller {
 */
 
 /*!
-    \fn QInstaller::LibArchiveWrapperPrivate::dataBlockRequested()
+    \fn QInstaller::LibArchiveWrapperPrivate::dataBlockRequested(int count)
 
-    Emitted when the server process has requested another data block.
+    Emitted when the server process has requested \a count more data blocks.
 */
 
 /*!
@@ -58,6 +58,7 @@ namespace QInstaller {
 */
 LibArchiveWrapperPrivate::LibArchiveWrapperPrivate(const QString &filename)
     : RemoteObject(QLatin1String(Protocol::AbstractArchive))
+    , m_clientDataAtEnd(false)
 {
     init();
     LibArchiveWrapperPrivate::setFilename(filename);
@@ -68,6 +69,7 @@ LibArchiveWrapperPrivate::LibArchiveWrapperPrivate(const QString &filename)
 */
 LibArchiveWrapperPrivate::LibArchiveWrapperPrivate()
     : RemoteObject(QLatin1String(Protocol::AbstractArchive))
+    , m_clientDataAtEnd(false)
 {
     init();
 }
@@ -139,6 +141,7 @@ QString LibArchiveWrapperPrivate::errorString() const
 bool LibArchiveWrapperPrivate::extract(const QString &dirPath, const quint64 totalFiles)
 {
     if (connectToServer()) {
+        m_clientDataAtEnd = false;
         QTimer timer;
         connect(&timer, &QTimer::timeout, this, &LibArchiveWrapperPrivate::processSignals);
         timer.start();
@@ -209,6 +212,31 @@ void LibArchiveWrapperPrivate::setCompressionLevel(const AbstractArchive::Compre
     m_archive.setCompressionLevel(level);
 }
 
+/*!
+    Sets the number of threads used to compress new archives to \a count.
+
+    If the remote connection is active, the method is called by the server instead.
+*/
+void LibArchiveWrapperPrivate::setCompressionThreadCount(int count)
+{
+    if (connectToServer()) {
+        m_lock.lockForWrite();
+        callRemoteMethod(QLatin1String(Protocol::AbstractArchiveSetCompressionThreadCount), count, dummy);
+        m_lock.unlock();
+        return;
+    }
+    m_archive.setCompressionThreadCount(count);
+}
+
+/*!
+    Returns the SHA-1 checksum of the archive written by the last call to create()
+    in this process.
+*/
+QByteArray LibArchiveWrapperPrivate::archiveHash() const
+{
+    return m_archive.archiveHash();
+}
+
 /*!
     Cancels the extract operation in progress.
 
@@ -250,7 +278,7 @@ void LibArchiveWrapperPrivate::processSignals()
             const quint64 total = receivedSignals.takeFirst().value<quint64>();
             emit completedChanged(completed, total);
         } else if (name == QLatin1String(Protocol::AbstractArchiveSignalDataBlockRequested)) {
-            emit dataBlockRequested();
+            emit dataBlockRequested(receivedSignals.takeFirst().value<int>());
         } else if (name == QLatin1String(Protocol::AbstractArchiveSignalSeekRequested)) {
             const qint64 offset = receivedSignals.takeFirst().value<qint64>();
             const int whence = receivedSignals.takeFirst().value<int>();
@@ -262,43 +290,40 @@ void LibArchiveWrapperPrivate::processSignals()
 }
 
 /*!
-    Reads a block of data from the current position of the underlying file device.
+    Reads up to \a count blocks of data from the current position of the underlying
+    file device and sends them to the server, without waiting for a reply in between.
 */
-void LibArchiveWrapperPrivate::onDataBlockRequested()
+void LibArchiveWrapperPrivate::onDataBlockRequested(int count)
 {
     constexpr quint64 blockSize = 1024 * 1024; // 1MB
 
     QFile *const file = &m_archive.m_data->file;
-    if (!file->isOpen() || file->isSequential()) {
-        qCWarning(QInstaller::lcInstallerInstallLog) << file->errorString();
-        setClientDataAtEnd();
-        return;
-    }
-    if (file->atEnd() && file->seek(0)) {
-        setClientDataAtEnd();
-        return;
-    }
-
-    QByteArray *const buff = &m_archive.m_data->buffer;
-    if (!buff->isEmpty())
-        buff->clear();
+    for (int i = 0; i < count && !m_clientDataAtEnd; ++i) {
+        if (!file->isOpen() || file->isSequential()) {
+            qCWarning(QInstaller::lcInstallerInstallLog) << file->errorString();
+            setClientDataAtEnd();
+            return;
+        }
+        if (file->atEnd() && file->seek(0)) {
+            setClientDataAtEnd();
+            return;
+        }
 
-    if (buff->size() != blockSize)
-        buff->resize(blockSize);
+        QByteArray buff(blockSize, Qt::Uninitialized);
+        const qint64 bytesRead = file->read(buff.data(), blockSize);
+        if (bytesRead == -1) {
+            qCWarning(QInstaller::lcInstallerInstallLog) << file->errorString();
+            setClientDataAtEnd();
+            return;
+        }
+        // The read callback in ExtractWorker class expects the buffer size to
+        // match the number of bytes read. Some formats will fail if the buffer
+        // is larger than the actual data.
+        if (buff.size() != bytesRead)
+            buff.resize(bytesRead);
 
-    const qint64 bytesRead = file->read(buff->data(), blockSize);
-    if (bytesRead == -1) {
-        qCWarning(QInstaller::lcInstallerInstallLog) << file->errorString();
-        setClientDataAtEnd();
-        return;
+        addDataBlock(buff);
     }
-    // The read callback in ExtractWorker class expects the buffer size to
-    // match the number of bytes read. Some formats will fail if the buffer
-    // is larger than the actual data.
-    if (buff->size() != bytesRead)
-        buff->resize(bytesRead);
-
-    addDataBlock(*buff);
 }
 
 /*!
@@ -327,6 +352,7 @@ void LibArchiveWrapperPrivate::onSeekRequested(qint64 offset, int whence)
     default:
         break;
     }
+    m_clientDataAtEnd = false; // the server discards the data sent ahead
     setClientFilePosition(success ? file->pos() : ARCHIVE_FATAL);
 }
 
@@ -364,6 +390,7 @@ void LibArchiveWrapperPrivate::addDataBlock(const QByteArray &buffer)
 */
 void LibArchiveWrapperPrivate::setClientDataAtEnd()
 {
+    m_clientDataAtEnd = true;
     if (connectToServer()) {
         m_lock.lockForWrite();
         callRemoteMethod(QLatin1String(Protocol::AbstractArchiveSetClientDataAtEnd));
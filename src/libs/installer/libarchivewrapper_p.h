@@ -61,11 +61,14 @@ public:
     bool isSupported();
 
     void setCompressionLevel(const AbstractArchive::CompressionLevel level);
+    void setCompressionThreadCount(int count);
+
+    QByteArray archiveHash() const;
 
 Q_SIGNALS:
     void currentEntryChanged(const QString &filename);
     void completedChanged(const quint64 completed, const quint64 total);
-    void dataBlockRequested();
+    void dataBlockRequested(int count);
     void seekRequested(qint64 offset, int whence);
     void remoteWorkerFinished();
 
@@ -74,7 +77,7 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void processSignals();
-    void onDataBlockRequested();
+    void onDataBlockRequested(int count);
     void onSeekRequested(qint64 offset, int whence);
 
 private:
@@ -89,6 +92,7 @@ private:
     mutable QReadWriteLock m_lock;
 
     LibArchiveArchive m_archive;
+    bool m_clientDataAtEnd;
 };
 
 } // namespace QInstaller
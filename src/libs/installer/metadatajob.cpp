@@ -32,17 +32,25 @@
 #include "packagemanagerproxyfactory.h"
 #include "productkeycheck.h"
 #include "proxycredentialsdialog.h"
+#include "repositoryindex.h"
 #include "serverauthenticationdialog.h"
 #include "settings.h"
 #include "testrepository.h"
 #include "globals.h"
 
+#include <QCryptographicHash>
+#include <QStandardPaths>
 #include <QTemporaryDir>
 #include <QtMath>
 #include <QRandomGenerator>
 
 const QStringList metaElements = {QLatin1String("Script"), QLatin1String("Licenses"), QLatin1String("UserInterfaces"), QLatin1String("Translations")};
 
+// Holds the full Updates.xml task item of a delta download, used as fallback.
+static const int UpdatesDeltaRole = QInstaller::TaskRole::UserRole + 1;
+// Marks the download of the binary repository index.
+static const int UpdatesIndexRole = QInstaller::TaskRole::UserRole + 2;
+
 namespace QInstaller {
 
 /*!
@@ -57,6 +65,12 @@ namespace QInstaller {
     \internal
 */
 
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::CompressedRepository
+    \internal
+*/
+
 /*!
     \enum QInstaller::DownloadType
 
@@ -83,6 +97,125 @@ namespace QInstaller {
     \internal
 */
 
+static QString updatesCacheFile(const Repository &repository)
+{
+    const QByteArray key = QCryptographicHash::hash(repository.url().toString().toUtf8(),
+        QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QLatin1String("/qt-installer-framework/updates/") + QString::fromLatin1(key);
+}
+
+static QString cachedUpdatesRevision(const Repository &repository)
+{
+    QFile file(updatesCacheFile(repository) + QLatin1String(".revision"));
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    return QString::fromLatin1(file.readAll()).trimmed();
+}
+
+// Keeps a copy of the fetched Updates.xml if the remote repository publishes revisions,
+// so that the next metadata fetch can ask for a delta on top of it.
+static void cacheUpdatesXml(const Repository &repository, const QString &fileName,
+    const QString &revision)
+{
+    const QUrl url = repository.url();
+    if (url.scheme().isEmpty() || url.isLocalFile())
+        return;
+
+    const QString cacheFile = updatesCacheFile(repository);
+    QFile::remove(cacheFile + QLatin1String(".revision"));
+    QFile::remove(cacheFile + QLatin1String(".xml"));
+    if (revision.isEmpty())
+        return;
+
+    QDir().mkpath(QFileInfo(cacheFile).absolutePath());
+    QFile revisionFile(cacheFile + QLatin1String(".revision"));
+    if (!QFile::copy(fileName, cacheFile + QLatin1String(".xml"))
+            || !revisionFile.open(QIODevice::WriteOnly)) {
+        qCWarning(QInstaller::lcInstallerInstallLog) << "Cannot cache Updates.xml of repository"
+            << repository.displayname();
+        QFile::remove(cacheFile + QLatin1String(".xml"));
+        return;
+    }
+    revisionFile.write(revision.toLatin1());
+}
+
+// Returns the task item for the binary index published next to the Updates.xml of updatesItem.
+static FileTaskItem indexItem(const FileTaskItem &updatesItem)
+{
+    FileTaskItem item = updatesItem;
+    item.insert(TaskRole::SourceFile, updatesItem.source().replace(QLatin1String("/Updates.xml?"),
+        QLatin1String("/Updates.xml.idx?")));
+    item.insert(UpdatesIndexRole, true);
+    return item;
+}
+
+// Merges the downloaded delta document into the cached Updates.xml and writes the result
+// back to fileName. Returns false if the delta cannot be read or its base revision does
+// not match the cached copy, in which case the full Updates.xml needs to be fetched.
+static bool applyUpdatesDelta(const QString &fileName, const Repository &repository)
+{
+    if (fileName.isEmpty())
+        return false;
+
+    QDomDocument delta;
+    QFile deltaFile(fileName);
+    if (!deltaFile.open(QIODevice::ReadOnly) || !delta.setContent(&deltaFile))
+        return false;
+    deltaFile.close();
+
+    const QDomElement deltaRoot = delta.documentElement();
+    if (deltaRoot.tagName() != QLatin1String("UpdatesDelta") || deltaRoot
+            .firstChildElement(QLatin1String("BaseRevision")).text() != cachedUpdatesRevision(repository)) {
+        return false;
+    }
+
+    QDomDocument doc;
+    QFile cachedFile(updatesCacheFile(repository) + QLatin1String(".xml"));
+    if (!cachedFile.open(QIODevice::ReadOnly) || !doc.setContent(&cachedFile))
+        return false;
+    cachedFile.close();
+
+    // The delta ships all repository wide elements, only packages are merged by name.
+    QDomElement root = doc.documentElement();
+    QHash<QString, QDomElement> packages;
+    QList<QDomElement> obsolete;
+    for (QDomElement el = root.firstChildElement(); !el.isNull(); el = el.nextSiblingElement()) {
+        if (el.tagName() == QLatin1String("PackageUpdate"))
+            packages.insert(el.firstChildElement(scName).text(), el);
+        else
+            obsolete.append(el);
+    }
+    foreach (const QDomElement &el, obsolete)
+        root.removeChild(el);
+
+    for (QDomElement el = deltaRoot.firstChildElement(); !el.isNull(); el = el.nextSiblingElement()) {
+        const QString tagName = el.tagName();
+        if (tagName == QLatin1String("BaseRevision") || tagName == QLatin1String("Age"))
+            continue;
+
+        if (tagName == QLatin1String("RemovedPackage")) {
+            if (packages.contains(el.text()))
+                root.removeChild(packages.take(el.text()));
+        } else if (tagName == QLatin1String("PackageUpdate")) {
+            const QString name = el.firstChildElement(scName).text();
+            const QDomElement package = doc.importNode(el, true).toElement();
+            if (packages.contains(name))
+                root.replaceChild(package, packages.value(name));
+            else
+                root.appendChild(package);
+            packages.insert(name, package);
+        } else {
+            root.appendChild(doc.importNode(el, true));
+        }
+    }
+
+    if (!deltaFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    deltaFile.write(doc.toByteArray());
+    return true;
+}
+
 static QUrl resolveUrl(const FileTaskResult &result, const QString &url)
 {
     QUrl u(url);
@@ -145,6 +278,70 @@ Repository MetadataJob::repositoryForDirectory(const QString &directory) const
         return m_metaFromArchive.value(directory).repository;
 }
 
+/*!
+    Returns the path of the meta information of \a packageName fetched into the metadata
+    \a directory. Identical meta archives published by several repositories are fetched
+    and extracted only once, so the path might point to the directory of another repository.
+*/
+QString MetadataJob::metaDataPath(const QString &directory, const QString &packageName) const
+{
+    const QString path = directory + QLatin1Char('/') + packageName;
+    if (m_sharedMetaData.contains(path))
+        return m_sharedMetaData.value(path);
+    if (m_sharedMetaData.contains(directory))
+        return metaDataPath(m_sharedMetaData.value(directory), packageName);
+    return path;
+}
+
+/*!
+    Extracts the data archives listed in \a archives from the compressed repositories they
+    belong to. Each pair holds the URL the repository was unpacked to and the archive path
+    relative to the repository root. Compressed repositories are unpacked without their data
+    archives, so those are extracted here when they are needed for installation. All archives
+    of one repository are extracted in a single pass, so a solid repository is decoded only
+    once. Returns \c true if the archives are available in the repository directories
+    afterwards or they do not belong to a compressed repository; otherwise sets
+    \a errorString and returns \c false.
+*/
+bool MetadataJob::extractFromCompressedRepositories(const QList<QPair<QUrl, QString> > &archives,
+                                                    QString *errorString)
+{
+    QHash<QString, QVector<ArchiveEntry> > entriesToExtract;
+    for (const auto &archive : archives) {
+        if (!archive.first.isLocalFile())
+            continue;
+
+        const QString directory = archive.first.toLocalFile();
+        const auto repository = m_compressedRepositories.constFind(directory);
+        if (repository == m_compressedRepositories.constEnd())
+            continue;
+        // already extracted or not part of the repository
+        const auto entry = repository->deferredEntries.constFind(archive.second);
+        if (entry == repository->deferredEntries.constEnd())
+            continue;
+        if (!entriesToExtract[directory].contains(entry.value()))
+            entriesToExtract[directory].append(entry.value());
+    }
+
+    for (auto it = entriesToExtract.constBegin(); it != entriesToExtract.constEnd(); ++it) {
+        CompressedRepository &repository = m_compressedRepositories[it.key()];
+        Lib7zArchive archive(repository.archive);
+        if (!archive.open(QIODevice::ReadOnly)) {
+            *errorString = tr("Cannot open file \"%1\" for reading: %2")
+                .arg(QDir::toNativeSeparators(repository.archive), archive.errorString());
+            return false;
+        }
+        if (!archive.extractEntries(it.key(), it.value())) {
+            *errorString = tr("Error while extracting archive \"%1\": %2")
+                .arg(QDir::toNativeSeparators(repository.archive), archive.errorString());
+            return false;
+        }
+        foreach (const ArchiveEntry &entry, it.value())
+            repository.deferredEntries.remove(entry.path);
+    }
+    return true;
+}
+
 // -- private slots
 
 void MetadataJob::doStart()
@@ -170,15 +367,29 @@ void MetadataJob::doStart()
                     authenticator.setPassword(repo.password());
 
                     if (!repo.isCompressed()) {
-                        QString url = repo.url().toString() + QLatin1String("/Updates.xml?");
+                        QString query;
                         if (!m_core->value(scUrlQueryString).isEmpty())
-                            url += m_core->value(scUrlQueryString) + QLatin1Char('&');
+                            query += m_core->value(scUrlQueryString) + QLatin1Char('&');
 
                         // also append a random string to avoid proxy caches
-                        FileTaskItem item(url.append(QString::number(QRandomGenerator::global()->generate())));
+                        query.append(QString::number(QRandomGenerator::global()->generate()));
+                        FileTaskItem item(repo.url().toString() + QLatin1String("/Updates.xml?") + query);
                         item.insert(TaskRole::UserRole, QVariant::fromValue(repo));
                         item.insert(TaskRole::Authenticator, QVariant::fromValue(authenticator));
-                        items.append(item);
+                        item.insert(TaskRole::Timeout, m_core->settings().repositoryTimeout() * 1000);
+
+                        // fetch only the changes if we know a revision of the repository
+                        const QString revision = cachedUpdatesRevision(repo);
+                        if (!revision.isEmpty()) {
+                            FileTaskItem deltaItem = item;
+                            deltaItem.insert(TaskRole::SourceFile, repo.url().toString()
+                                + QString::fromLatin1("/deltas/%1_Updates.xml?").arg(revision) + query);
+                            deltaItem.insert(UpdatesDeltaRole, QVariant::fromValue(item));
+                            items.append(deltaItem);
+                        } else {
+                            items.append(item);
+                            items.append(indexItem(item));
+                        }
                     }
                 }
             }
@@ -248,6 +459,7 @@ void MetadataJob::startUnzipRepositoryTask(const Repository &repo)
     m_tempDirDeleter.add(tempRepoDir.path());
     QString url = repo.url().toLocalFile();
     UnzipArchiveTask *task = new UnzipArchiveTask(url, tempRepoDir.path());
+    task->setDeferPayloadArchives(true);
     QFutureWatcher<void> *watcher = new QFutureWatcher<void>();
     m_unzipRepositoryTasks.insert(watcher, qobject_cast<QObject*> (task));
     connect(watcher, &QFutureWatcherBase::finished, this,
@@ -286,6 +498,12 @@ void MetadataJob::unzipRepositoryTaskFinished()
                     FileTaskItem item(url);
                     item.insert(TaskRole::UserRole, QVariant::fromValue(repo));
                     m_unzipRepositoryitems.append(item);
+
+                    CompressedRepository compressedRepository;
+                    compressedRepository.archive = task->archive();
+                    foreach (const ArchiveEntry &entry, task->deferredEntries())
+                        compressedRepository.deferredEntries.insert(entry.path, entry);
+                    m_compressedRepositories.insert(task->target(), compressedRepository);
                 } else {
                     //Repository is not valid, remove it
                     Settings &s = m_core->settings();
@@ -406,6 +624,14 @@ void MetadataJob::xmlTaskFinished()
     if (error() != Job::NoError)
         return;
 
+    if (status == XmlDownloadSuccess && !m_updatesFallbackItems.isEmpty()) {
+        // some repositories could not provide a delta on top of the cached Updates.xml
+        const QList<FileTaskItem> items = m_updatesFallbackItems;
+        m_updatesFallbackItems.clear();
+        startXMLTask(items);
+        return;
+    }
+
     if (status == XmlDownloadSuccess) {
         if (m_downloadType != DownloadType::UpdatesXML) {
             if (!fetchMetaDataPackages())
@@ -534,6 +760,10 @@ void MetadataJob::reset()
     m_metaFromDefaultRepositories.clear();
     m_metaFromArchive.clear();
     m_fetchedArchive.clear();
+    m_compressedRepositories.clear();
+    m_updatesFallbackItems.clear();
+    m_metaArchives.clear();
+    m_sharedMetaData.clear();
 
     setError(Job::NoError);
     setErrorString(QString());
@@ -577,10 +807,38 @@ void MetadataJob::resetCompressedFetch()
 
 MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &results)
 {
+    QHash<QUrl, QString> indexFiles;
+    foreach (const FileTaskResult &result, results) {
+        const FileTaskItem item = result.value(TaskRole::TaskItem).value<FileTaskItem>();
+        if (item.value(UpdatesIndexRole).toBool() && !result.target().isEmpty())
+            indexFiles.insert(item.value(TaskRole::UserRole).value<Repository>().url(), result.target());
+    }
+
     foreach (const FileTaskResult &result, results) {
         if (error() != Job::NoError)
             return XmlDownloadFailure;
 
+        const FileTaskItem item = result.value(TaskRole::TaskItem).value<FileTaskItem>();
+        if (item.value(TaskRole::TimedOut).toBool()) {
+            // Build the tree from what arrived, the repository is not used in this run.
+            if (!item.value(UpdatesIndexRole).toBool()) {
+                qCWarning(QInstaller::lcInstallerInstallLog) << "Repository"
+                    << item.value(TaskRole::UserRole).value<Repository>().displayname()
+                    << "did not respond in time, continuing without it.";
+            }
+            continue;
+        }
+        if (item.value(UpdatesIndexRole).toBool())
+            continue;
+
+        const QVariant fullUpdatesItem = item.value(UpdatesDeltaRole);
+        if (fullUpdatesItem.isValid() && !applyUpdatesDelta(result.target(),
+                item.value(TaskRole::UserRole).value<Repository>())) {
+            m_updatesFallbackItems.append(fullUpdatesItem.value<FileTaskItem>());
+            m_updatesFallbackItems.append(indexItem(fullUpdatesItem.value<FileTaskItem>()));
+            continue;
+        }
+
         //If repository is not found, target might be empty. Do not continue parsing the
         //repository and do not prevent further repositories usage.
         if (result.target().isEmpty()) {
@@ -610,9 +868,42 @@ MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &re
             return XmlDownloadFailure;
         }
 
+        metadata.repository = item.value(TaskRole::UserRole).value<Repository>();
+        const bool online = !(metadata.repository.url().scheme()).isEmpty();
+
+        // Prefer the binary index published next to Updates.xml, it needs no parsing.
+        QScopedPointer<RepositoryIndex> index;
+        const QString indexFile = indexFiles.take(metadata.repository.url());
+        if (!indexFile.isEmpty()) {
+            const QString target = metadata.directory + QLatin1String("/Updates.xml.idx");
+            index.reset(new RepositoryIndex(target));
+            if (!QFile::rename(indexFile, target) || !index->open()
+                    || !index->matchesUpdates(file.fileName()) || index->hasRepositoryUpdate()) {
+                qCDebug(QInstaller::lcDeveloperBuild) << "Using Updates.xml of repository"
+                    << metadata.repository.displayname() << "instead of the index:" << index->errorString();
+                index.reset();
+                QFile::remove(indexFile);
+                QFile::remove(target);
+            }
+        }
+
+        // Mirrors publishing the very same Updates.xml share all of their meta information.
+        // The offline generator needs a complete copy of every repository though.
+        QString sharedDirectory;
+        if (!m_core->isOfflineGenerator()) {
+            // already calculated if the index was checked against the file
+            const QString updatesHash = QString::fromLatin1(RepositoryIndex::updatesChecksum(
+                file.fileName()).toHex());
+            sharedDirectory = m_metaArchives.value(updatesHash);
+            if (sharedDirectory.isEmpty())
+                m_metaArchives.insert(updatesHash, metadata.directory);
+            else
+                m_sharedMetaData.insert(metadata.directory, sharedDirectory);
+        }
+
         QString error;
         QDomDocument doc;
-        if (!doc.setContent(&file, &error)) {
+        if (!index && !doc.setContent(&file, &error)) {
             qCWarning(QInstaller::lcInstallerInstallLog).nospace() << "Cannot fetch a valid version of Updates.xml from repository "
                                << metadata.repository.displayname() << ": " << error;
             //If there are other repositories, try to use those
@@ -620,54 +911,55 @@ MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &re
         }
         file.close();
 
-        const FileTaskItem item = result.value(TaskRole::TaskItem).value<FileTaskItem>();
-        metadata.repository = item.value(TaskRole::UserRole).value<Repository>();
-        const bool online = !(metadata.repository.url().scheme()).isEmpty();
-
         bool testCheckSum = true;
         const QDomElement root = doc.documentElement();
-        const QDomNode checksum = root.firstChildElement(QLatin1String("Checksum"));
-        if (!checksum.isNull())
-            testCheckSum = (checksum.toElement().text().toLower() == scTrue);
+        cacheUpdatesXml(metadata.repository, file.fileName(), index
+            ? index->repositoryValue(QLatin1String("Revision"))
+            : root.firstChildElement(QLatin1String("Revision")).text());
+        const QString checksum = index ? index->repositoryValue(QLatin1String("Checksum"))
+            : root.firstChildElement(QLatin1String("Checksum")).text();
+        if (!checksum.isEmpty())
+            testCheckSum = (checksum.toLower() == scTrue);
 
         // If we have top level sha1 and MetadataName elements, we have compressed
         // all metadata inside one repository to a single 7z file. Fetch that
         // instead of component specific meta 7z files.
-        const QDomNode sha1 = root.firstChildElement(scSHA1);
-        QDomElement metadataNameElement = root.firstChildElement(QLatin1String("MetadataName"));
-        QDomNodeList children = root.childNodes();
-        if (!sha1.isNull() && !metadataNameElement.isNull()) {
-           const QString repoUrl = metadata.repository.url().toString();
-           const QString metadataName = metadataNameElement.toElement().text();
-           addFileTaskItem(QString::fromLatin1("%1/%2").arg(repoUrl, metadataName),
-               metadata.directory + QString::fromLatin1("/%1").arg(metadataName),
-               metadata, sha1.toElement().text(), QString());
+        const QString sha1 = index ? index->repositoryValue(scSHA1)
+            : root.firstChildElement(scSHA1).text();
+        const QString metadataName = index ? index->repositoryValue(QLatin1String("MetadataName"))
+            : root.firstChildElement(QLatin1String("MetadataName")).text();
+        if (!sharedDirectory.isEmpty()) {
+            qCDebug(QInstaller::lcDeveloperBuild) << "Repository" << metadata.repository.displayname()
+                << "shares its meta information with" << sharedDirectory;
+        } else if (!sha1.isEmpty() && !metadataName.isEmpty()) {
+            const QString owner = m_core->isOfflineGenerator() ? QString()
+                : m_metaArchives.value(sha1.toLower());
+            if (!owner.isEmpty()) {
+                m_sharedMetaData.insert(metadata.directory, owner);
+            } else {
+                if (!m_core->isOfflineGenerator())
+                    m_metaArchives.insert(sha1.toLower(), metadata.directory);
+                const QString repoUrl = metadata.repository.url().toString();
+                addFileTaskItem(QString::fromLatin1("%1/%2").arg(repoUrl, metadataName),
+                    metadata.directory + QString::fromLatin1("/%1").arg(metadataName),
+                    metadata, sha1, QString());
+            }
+        } else if (index) {
+            for (int i = 0; i < index->packageCount(); ++i) {
+                addPackageMetadata(metadata, index->name(i), online ? index->version(i) : QString(),
+                    testCheckSum ? index->sha1(i) : QString(),
+                    index->flags(i).testFlag(RepositoryIndex::HasMetadata));
+            }
         } else {
-            bool metaFound = false;
+            QDomNodeList children = root.childNodes();
             for (int i = 0; i < children.count(); ++i) {
                 const QDomElement el = children.at(i).toElement();
                 if (!el.isNull() && el.tagName() == QLatin1String("PackageUpdate")) {
                     const QDomNodeList c2 = el.childNodes();
                     QString packageName, packageVersion, packageHash;
-                    metaFound = parsePackageUpdate(c2, packageName, packageVersion, packageHash,
-                                                   online, testCheckSum);
-
-                    // If meta element (script, licenses, etc.) is not found, no need to fetch metadata.
-                    // The offline-generator instance is an exception to this - if the Updates.xml contains
-                    // checksum element for the meta-archive, we will fetch it, so that the temporary
-                    // location contents match the remote repository.
-                    if (metaFound || (m_core->isOfflineGenerator() && !packageHash.isEmpty())) {
-                        const QString repoUrl = metadata.repository.url().toString();
-                        addFileTaskItem(QString::fromLatin1("%1/%2/%3meta.7z").arg(repoUrl, packageName, packageVersion),
-                            metadata.directory + QString::fromLatin1("/%1-%2-meta.7z").arg(packageName, packageVersion),
-                            metadata, packageHash, packageName);
-                    } else {
-                        QString fileName = metadata.directory + QLatin1Char('/') + packageName;
-                        QDir directory(fileName);
-                        if (!directory.exists()) {
-                            directory.mkdir(fileName);
-                        }
-                    }
+                    const bool metaFound = parsePackageUpdate(c2, packageName, packageVersion,
+                        packageHash, online, testCheckSum);
+                    addPackageMetadata(metadata, packageName, packageVersion, packageHash, metaFound);
                 }
             }
         }
@@ -708,6 +1000,10 @@ MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &re
             }
         }
     }
+    // indexes of repositories that were not parsed
+    foreach (const QString &indexFile, indexFiles)
+        QFile::remove(indexFile);
+
     double taskCount = m_packages.length()/static_cast<double>(m_downloadableChunkSize);
     m_totalTaskCount = qCeil(taskCount);
     m_taskNumber = 0;
@@ -761,6 +1057,38 @@ void MetadataJob::addFileTaskItem(const QString &source, const QString &target,
     m_packages.append(item);
 }
 
+void MetadataJob::addPackageMetadata(const Metadata &metadata, const QString &packageName,
+                                     const QString &packageVersion, const QString &packageHash,
+                                     bool metaFound)
+{
+    // If meta element (script, licenses, etc.) is not found, no need to fetch metadata.
+    // The offline-generator instance is an exception to this - if the Updates.xml contains
+    // checksum element for the meta-archive, we will fetch it, so that the temporary
+    // location contents match the remote repository.
+    if (metaFound || (m_core->isOfflineGenerator() && !packageHash.isEmpty())) {
+        // Fetch and extract a meta archive published by several repositories only once.
+        if (!packageHash.isEmpty() && !m_core->isOfflineGenerator()) {
+            const QString path = metadata.directory + QLatin1Char('/') + packageName;
+            const QString owner = m_metaArchives.value(packageHash.toLower());
+            if (!owner.isEmpty()) {
+                m_sharedMetaData.insert(path, owner);
+                return;
+            }
+            m_metaArchives.insert(packageHash.toLower(), path);
+        }
+        const QString repoUrl = metadata.repository.url().toString();
+        addFileTaskItem(QString::fromLatin1("%1/%2/%3meta.7z").arg(repoUrl, packageName, packageVersion),
+            metadata.directory + QString::fromLatin1("/%1-%2-meta.7z").arg(packageName, packageVersion),
+            metadata, packageHash, packageName);
+    } else {
+        QString fileName = metadata.directory + QLatin1Char('/') + packageName;
+        QDir directory(fileName);
+        if (!directory.exists()) {
+            directory.mkdir(fileName);
+        }
+    }
+}
+
 bool MetadataJob::parsePackageUpdate(const QDomNodeList &c2, QString &packageName,
                                     QString &packageVersion, QString &packageHash,
                                     bool online, bool testCheckSum)
@@ -29,6 +29,7 @@
 #ifndef METADATAJOB_H
 #define METADATAJOB_H
 
+#include "abstractarchive.h"
 #include "downloadfiletask.h"
 #include "fileutils.h"
 #include "job.h"
@@ -55,6 +56,12 @@ struct ArchiveMetadata
     Metadata metaData;
 };
 
+struct CompressedRepository
+{
+    QString archive;
+    QHash<QString, ArchiveEntry> deferredEntries;
+};
+
 enum DownloadType
 {
     All,
@@ -79,9 +86,12 @@ public:
 
     QList<Metadata> metadata() const;
     Repository repositoryForDirectory(const QString &directory) const;
+    QString metaDataPath(const QString &directory, const QString &packageName) const;
     void setPackageManagerCore(PackageManagerCore *core) { m_core = core; }
     void addDownloadType(DownloadType downloadType) { m_downloadType = downloadType;}
     QStringList shaMismatchPackages() const { return m_shaMissmatchPackages; }
+    bool extractFromCompressedRepositories(const QList<QPair<QUrl, QString> > &archives,
+                                           QString *errorString);
 
 private slots:
     void doStart();
@@ -104,6 +114,8 @@ private:
     QSet<Repository> getRepositories();
     void addFileTaskItem(const QString &source, const QString &target, const Metadata &metadata,
                          const QString &sha1, const QString &packageName);
+    void addPackageMetadata(const Metadata &metadata, const QString &packageName,
+                            const QString &packageVersion, const QString &packageHash, bool metaFound);
     bool parsePackageUpdate(const QDomNodeList &c2, QString &packageName, QString &packageVersion,
                             QString &packageHash, bool online, bool testCheckSum);
     QHash<QString, QPair<Repository, Repository> > searchAdditionalRepositories(const QDomNode &repositoryUpdate,
@@ -122,6 +134,7 @@ private:
     QHash<QFutureWatcher<void> *, QObject*> m_unzipRepositoryTasks;
     DownloadType m_downloadType;
     QList<FileTaskItem> m_unzipRepositoryitems;
+    QList<FileTaskItem> m_updatesFallbackItems;
     QList<FileTaskResult> m_metadataResult;
     int m_downloadableChunkSize;
     int m_taskNumber;
@@ -130,6 +143,9 @@ private:
     QHash<QString, ArchiveMetadata> m_fetchedArchive;
     QHash<QString, Metadata> m_metaFromDefaultRepositories;
     QHash<QString, Metadata> m_metaFromArchive; //for faster lookups.
+    QHash<QString, CompressedRepository> m_compressedRepositories;
+    QHash<QString, QString> m_metaArchives; // content hash, location of the meta information
+    QHash<QString, QString> m_sharedMetaData; // package or repository directory, shared location
 };
 
 }   // namespace QInstaller
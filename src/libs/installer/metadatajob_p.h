@@ -34,6 +34,7 @@
 
 #include <QDir>
 #include <QFile>
+#include <QSet>
 
 namespace QInstaller{
 
@@ -61,10 +62,12 @@ class UnzipArchiveTask : public AbstractTask<void>
 
 public:
     UnzipArchiveTask(const QString &arcive, const QString &target)
-        : m_archive(arcive), m_targetDir(target)
+        : m_archive(arcive), m_targetDir(target), m_deferPayloadArchives(false)
     {}
     QString target() { return m_targetDir; }
     QString archive() { return m_archive; }
+    void setDeferPayloadArchives(bool defer) { m_deferPayloadArchives = defer; }
+    QVector<ArchiveEntry> deferredEntries() const { return m_deferredEntries; }
     void doTask(QFutureInterface<void> &fi)
     {
         fi.reportStarted();
@@ -79,8 +82,35 @@ public:
         if (!archive.open(QIODevice::ReadOnly)) {
             fi.reportException(UnzipArchiveException(MetadataJob::tr("Cannot open file \"%1\" for "
                 "reading: %2").arg(QDir::toNativeSeparators(m_archive), archive.errorString())));
+            fi.reportFinished(); return;    // error
         }
-        if (!archive.extract(m_targetDir)) {
+        if (m_deferPayloadArchives) {
+            // Component data archives are published with a .sha1 sidecar, the metadata is
+            // not. Extract only the metadata now, the data archives are extracted on demand.
+            const QVector<ArchiveEntry> entries = archive.list();
+            if (entries.isEmpty()) {
+                fi.reportException(UnzipArchiveException(MetadataJob::tr("Error while reading "
+                    "contents of archive \"%1\": %2").arg(QDir::toNativeSeparators(m_archive),
+                    archive.errorString())));
+                fi.reportFinished(); return;    // error
+            }
+            QSet<QString> paths;
+            foreach (const ArchiveEntry &entry, entries)
+                paths.insert(entry.path);
+
+            QVector<ArchiveEntry> metadataEntries;
+            foreach (const ArchiveEntry &entry, entries) {
+                if (!entry.isDirectory && paths.contains(entry.path + QLatin1String(".sha1")))
+                    m_deferredEntries.append(entry);
+                else
+                    metadataEntries.append(entry);
+            }
+            if (!archive.extractEntries(m_targetDir, metadataEntries)) {
+                fi.reportException(UnzipArchiveException(MetadataJob::tr("Error while extracting "
+                    "archive \"%1\": %2").arg(QDir::toNativeSeparators(m_archive), archive.errorString())));
+                fi.reportFinished(); return;    // error
+            }
+        } else if (!archive.extract(m_targetDir)) {
             fi.reportException(UnzipArchiveException(MetadataJob::tr("Error while extracting "
                 "archive \"%1\": %2").arg(QDir::toNativeSeparators(m_archive), archive.errorString())));
         }
@@ -91,6 +121,8 @@ public:
 private:
     QString m_archive;
     QString m_targetDir;
+    bool m_deferPayloadArchives;
+    QVector<ArchiveEntry> m_deferredEntries;
 };
 
 }   // namespace QInstaller
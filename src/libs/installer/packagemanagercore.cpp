@@ -29,11 +29,13 @@
 #include "packagemanagercore_p.h"
 
 #include "adminauthorization.h"
+#include "archivepatch.h"
 #include "binarycontent.h"
 #include "component.h"
 #include "componentmodel.h"
 #include "downloadarchivesjob.h"
 #include "errors.h"
+#include "fileutils.h"
 #include "globals.h"
 #include "messageboxhandler.h"
 #include "packagemanagerproxyfactory.h"
@@ -758,22 +760,85 @@ quint64 PackageManagerCore::requiredTemporaryDiskSpace() const
 /*!
     Returns the number of archives that will be downloaded.
 
+    Archives of installed components are updated from a patch instead, if the repository
+    provides one against the installed version. The complete archive is downloaded if the
+    patch cannot be downloaded or does not fit the installed files.
+
     \a partProgressSize is reserved for the download progress.
 */
 int PackageManagerCore::downloadNeededArchives(double partProgressSize)
 {
     Q_ASSERT(partProgressSize >= 0 && partProgressSize <= 1);
 
+    struct PatchDownload
+    {
+        Component *component;
+        QPair<QString, QString> archive;
+        QString patch;
+        QByteArray sha1;
+        QString installedDir;
+    };
+
     QList<QPair<QString, QString> > archivesToDownload;
+    QList<QPair<QString, QString> > patchesToDownload;
+    QList<PatchDownload> patches;
     quint64 archivesToDownloadTotalSize = 0;
+    quint64 patchesToDownloadTotalSize = 0;
     QList<Component*> neededComponents = orderedComponentsToInstall();
+
+    // archives of compressed repositories are unpacked only when needed, all at once
+    QList<QPair<QUrl, QString> > compressedArchives;
+    foreach (Component *component, neededComponents) {
+        foreach (const QString &versionFreeString, component->downloadableArchives()) {
+            compressedArchives.append(qMakePair(component->repositoryUrl(),
+                QString::fromLatin1("%1/%2").arg(component->name(), versionFreeString)));
+        }
+    }
+    QString errorString;
+    if (!d->m_metadataJob.extractFromCompressedRepositories(compressedArchives, &errorString))
+        throw Error(errorString);
+
     foreach (Component *component, neededComponents) {
+        // local repositories are patched too, they might be on a network share
+        const QString installedVersion = component->value(scInstalledVersion);
+        const QStringList availablePatches = (component->isInstalled()
+            && component->value(scPatchBaseVersion) == installedVersion)
+            ? component->value(scPatchArchives).split(QLatin1Char(','), QString::SkipEmptyParts)
+            : QStringList();
+
         // collect all archives to be downloaded
         const QStringList toDownload = component->downloadableArchives();
         foreach (const QString &versionFreeString, toDownload) {
-            archivesToDownload.push_back(qMakePair(QString::fromLatin1("installer://%1/%2")
+            const QPair<QString, QString> archive(QString::fromLatin1("installer://%1/%2")
                 .arg(component->name(), versionFreeString), QString::fromLatin1("%1/%2/%3")
-                .arg(component->repositoryUrl().toString(), component->name(), versionFreeString)));
+                .arg(component->repositoryUrl().toString(), component->name(), versionFreeString));
+            archivesToDownload.push_back(archive);
+
+            // patch entries are of the form "content.7z:<sha1>:<size>"
+            const QString archiveName = versionFreeString.mid(component->value(scVersion).length());
+            foreach (const QString &entry, availablePatches) {
+                const QStringList fields = entry.trimmed().split(QLatin1Char(':'));
+                if (fields.count() != 3 || fields.first() != archiveName)
+                    continue;
+
+                PatchDownload patch;
+                patch.installedDir = d->installedArchiveDirectory(component->name(),
+                    QString::fromLatin1("installer://%1/%2%3").arg(component->name(),
+                    installedVersion, archiveName));
+                if (patch.installedDir.isEmpty())
+                    break;
+
+                const QString patchName = archivePatchFileName(versionFreeString);
+                patch.component = component;
+                patch.archive = archive;
+                patch.patch = QString::fromLatin1("installer://%1/%2").arg(component->name(), patchName);
+                patch.sha1 = fields.at(1).toLatin1();
+                patches.append(patch);
+                patchesToDownload.push_back(qMakePair(patch.patch, QString::fromLatin1("%1/%2/%3")
+                    .arg(component->repositoryUrl().toString(), component->name(), patchName)));
+                patchesToDownloadTotalSize += fields.at(2).toULongLong();
+                break;
+            }
         }
         archivesToDownloadTotalSize += component->value(scCompressedSize).toULongLong();
     }
@@ -783,33 +848,78 @@ int PackageManagerCore::downloadNeededArchives(double partProgressSize)
 
     ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("\nDownloading packages..."));
 
-    DownloadArchivesJob archivesJob(this);
-    archivesJob.setAutoDelete(false);
-    archivesJob.setArchivesToDownload(archivesToDownload);
-    archivesJob.setExpectedTotalSize(archivesToDownloadTotalSize);
-    connect(this, &PackageManagerCore::installationInterrupted, &archivesJob, &Job::cancel);
-    connect(&archivesJob, &DownloadArchivesJob::outputTextChanged,
-            ProgressCoordinator::instance(), &ProgressCoordinator::emitLabelAndDetailTextChanged);
-    connect(&archivesJob, &DownloadArchivesJob::downloadStatusChanged,
-            ProgressCoordinator::instance(), &ProgressCoordinator::downloadStatusChanged);
+    const auto downloadArchives = [this](const QList<QPair<QString, QString> > &archives,
+            quint64 totalSize, double progressSize) {
+        DownloadArchivesJob archivesJob(this);
+        archivesJob.setAutoDelete(false);
+        archivesJob.setArchivesToDownload(archives);
+        archivesJob.setExpectedTotalSize(totalSize);
+        connect(this, &PackageManagerCore::installationInterrupted, &archivesJob, &Job::cancel);
+        connect(&archivesJob, &DownloadArchivesJob::outputTextChanged,
+                ProgressCoordinator::instance(), &ProgressCoordinator::emitLabelAndDetailTextChanged);
+        connect(&archivesJob, &DownloadArchivesJob::downloadStatusChanged,
+                ProgressCoordinator::instance(), &ProgressCoordinator::downloadStatusChanged);
+
+        ProgressCoordinator::instance()->registerPartProgress(&archivesJob,
+            SIGNAL(progressChanged(double)), progressSize);
+
+        archivesJob.start();
+        archivesJob.waitForFinished();
+
+        if (archivesJob.error() == Job::Canceled)
+            interrupt();
+        else if (archivesJob.error() != Job::NoError)
+            throw Error(archivesJob.errorString());
 
-    ProgressCoordinator::instance()->registerPartProgress(&archivesJob,
-        SIGNAL(progressChanged(double)), partProgressSize);
+        if (d->statusCanceledOrFailed())
+            throw Error(tr("Installation canceled by user."));
+
+        return archivesJob.numberOfDownloads();
+    };
+
+    int downloads = 0;
+    if (!patches.isEmpty()) {
+        const double patchesProgressSize = partProgressSize * patchesToDownloadTotalSize
+            / qMax<quint64>(1, patchesToDownloadTotalSize + archivesToDownloadTotalSize);
+        partProgressSize -= patchesProgressSize;
+        try {
+            downloads += downloadArchives(patchesToDownload, patchesToDownloadTotalSize,
+                patchesProgressSize);
+        } catch (const Error &error) {
+            if (d->statusCanceledOrFailed())
+                throw;
+            qCWarning(QInstaller::lcInstallerInstallLog).noquote() << "Cannot download patches:"
+                << error.message();
+        }
 
-    archivesJob.start();
-    archivesJob.waitForFinished();
+        QSet<Component *> patchedComponents;
+        foreach (const PatchDownload &patch, patches) {
+            if (d->applyArchivePatch(patch.component, patch.archive.first, patch.patch, patch.sha1,
+                    patch.installedDir)) {
+                archivesToDownload.removeAll(patch.archive);
+                patchedComponents.insert(patch.component);
+            }
+        }
 
-    if (archivesJob.error() == Job::Canceled)
-        interrupt();
-    else if (archivesJob.error() != Job::NoError)
-        throw Error(archivesJob.errorString());
+        // do not expect the size of components that need no download anymore
+        foreach (Component *component, patchedComponents) {
+            const QString prefix = QString::fromLatin1("installer://%1/").arg(component->name());
+            bool downloadNeeded = false;
+            for (int i = 0; i < archivesToDownload.count() && !downloadNeeded; ++i)
+                downloadNeeded = archivesToDownload.at(i).first.startsWith(prefix);
+            if (!downloadNeeded) {
+                archivesToDownloadTotalSize -= qMin(archivesToDownloadTotalSize,
+                    component->value(scCompressedSize).toULongLong());
+            }
+        }
+    }
 
-    if (d->statusCanceledOrFailed())
-        throw Error(tr("Installation canceled by user."));
+    if (!archivesToDownload.isEmpty())
+        downloads += downloadArchives(archivesToDownload, archivesToDownloadTotalSize, partProgressSize);
 
     ProgressCoordinator::instance()->emitDownloadStatus(tr("All downloads finished."));
 
-    return archivesJob.numberOfDownloads();
+    return downloads;
 }
 
 /*!
@@ -853,6 +963,10 @@ void PackageManagerCore::rollBackInstallation()
 {
     emit titleMessageChanged(tr("Canceling the Installer"));
 
+    // data of rolled back components does not need to reach the disk anymore
+    d->m_unsyncedFiles.clear();
+    d->m_unsyncedDirectories.clear();
+
     // this unregisters all operation progressChanged connected
     ProgressCoordinator::instance()->setUndoMode();
     const int progressOperationCount = d->countProgressOperations(d->m_performedOperationsCurrentSession);
@@ -3880,6 +3994,8 @@ bool PackageManagerCore::fetchAllPackages(const PackagesList &remotes, const Loc
 
         QScopedPointer<QInstaller::Component> component(new QInstaller::Component(this));
         data.package = package;
+        component->setMetaDataPath(d->m_metadataJob.metaDataPath(QInstaller::pathFromUrl(
+            package->packageSource().url), package->data(scName).toString()));
         component->loadDataFromPackage(*package);
         if (updateComponentData(data, component.data())) {
             // Create a list where is name and treename. Repo can contain a package with
@@ -3953,6 +4069,8 @@ bool PackageManagerCore::fetchReinstallerPackages(const PackagesList& remotes, c
 
         QScopedPointer<QInstaller::Component> component(new QInstaller::Component(this));
         data.package = update;
+        component->setMetaDataPath(d->m_metadataJob.metaDataPath(QInstaller::pathFromUrl(
+            update->packageSource().url), update->data(scName).toString()));
         component->loadDataFromPackage(*update);
         if (updateComponentData(data, component.data())) {
             // Keep a reference so we can resolve dependencies during update.
@@ -4110,6 +4228,8 @@ bool PackageManagerCore::fetchUpdaterPackages(const PackagesList &remotes, const
 
         QScopedPointer<QInstaller::Component> component(new QInstaller::Component(this));
         data.package = update;
+        component->setMetaDataPath(d->m_metadataJob.metaDataPath(QInstaller::pathFromUrl(
+            update->packageSource().url), update->data(scName).toString()));
         component->loadDataFromPackage(*update);
         if (updateComponentData(data, component.data())) {
             // Keep a reference so we can resolve dependencies during update.
@@ -28,6 +28,7 @@
 #include "packagemanagercore_p.h"
 
 #include "adminauthorization.h"
+#include "archivepatch.h"
 #include "binarycontent.h"
 #include "binaryformatenginehandler.h"
 #include "binarylayout.h"
@@ -41,6 +42,7 @@
 #include "messageboxhandler.h"
 #include "packagemanagercore.h"
 #include "progresscoordinator.h"
+#include "repositoryindex.h"
 #include "qprocesswrapper.h"
 #include "protocol.h"
 #include "qsettingswrapper.h"
@@ -54,10 +56,16 @@
 #include "selfrestarter.h"
 #include "filedownloaderfactory.h"
 #include "updateoperationfactory.h"
+#include "archivefactory.h"
+#include "remoteclient.h"
+#include "extractarchiveoperation.h"
+#include "fileutils.h"
+#include "utils.h"
 
 #include <productkeycheck.h>
 
 #include <QSettings>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
@@ -65,6 +73,7 @@
 #include <QtCore/QUuid>
 #include <QtCore/QFuture>
 #include <QtCore/QFutureWatcher>
+#include <QtCore/QTemporaryDir>
 #include <QtCore/QTemporaryFile>
 
 #include <QXmlStreamReader>
@@ -137,6 +146,107 @@ static bool runOperation(Operation *operation, Operation::OperationType type)
     return false;
 }
 
+static bool backupAndPerformOperation(Operation *operation)
+{
+    runOperation(operation, Operation::Backup);
+    return runOperation(operation, Operation::Perform);
+}
+
+/*!
+    \internal
+
+    Returns the top level entries of the archive extracted by \a operation, as absolute paths
+    below its target directory. They are read from the repository metadata of the component
+    owning the operation, so the archive does not need to be scanned. Returns an empty list if
+    the metadata does not describe the archive.
+*/
+static QStringList extractedArchiveRoots(PackageManagerCore *core, Operation *operation)
+{
+    const Component *const component = core->componentByName(operation->value(QLatin1String("component"))
+        .toString());
+    if (!component)
+        return QStringList();
+
+    const QString version = component->value(scVersion);
+    QString archiveName = QFileInfo(operation->arguments().at(0)).fileName();
+    if (archiveName.startsWith(version))
+        archiveName = archiveName.mid(version.length());
+    const QString prefix = archiveName + QLatin1Char('/');
+
+    const QString targetDir = QDir::cleanPath(operation->arguments().at(1));
+    QStringList roots;
+    foreach (const QString &line, component->value(scArchiveRoots).split(QLatin1Char('\n'),
+            QString::SkipEmptyParts)) {
+        // <archive name>/<top level entry>
+        if (line.startsWith(prefix) && line.length() > prefix.length())
+            roots.append(QDir::cleanPath(targetDir + QLatin1Char('/') + line.mid(prefix.length())) + QLatin1Char('/'));
+    }
+    return roots;
+}
+
+/*!
+    \internal
+
+    Returns the consecutive Extract operations starting at \a index in \a operations, if there
+    are at least two of them and none of their archives can overwrite a file extracted by another
+    one. Archives going to unrelated target directories cannot collide, otherwise the top level
+    entries repogen recorded for the archives must not overlap. Returns an empty list if the
+    operations must run one by one.
+*/
+static OperationList independentExtractOperations(PackageManagerCore *core,
+    const OperationList &operations, int index)
+{
+    OperationList batch;
+    for (int i = index; i < operations.count(); ++i) {
+        Operation *const operation = operations.at(i);
+        if (operation->name() != QLatin1String("Extract")
+                || operation->value(QLatin1String("admin")).toBool()
+                || operation->arguments().count() < 2) {
+            break;
+        }
+        batch.append(operation);
+    }
+    // the elevated server extracts one archive at a time
+    if (batch.count() < 2 || RemoteClient::instance().isActive())
+        return OperationList();
+
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    const Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+#else
+    const Qt::CaseSensitivity cs = Qt::CaseSensitive;
+#endif
+    QStringList targetDirs;
+    bool sharedTargetDir = false;
+    foreach (Operation *operation, batch) {
+        const QString targetDir = QDir::cleanPath(operation->arguments().at(1)) + QLatin1Char('/');
+        foreach (const QString &other, targetDirs) {
+            if (targetDir.startsWith(other, cs) || other.startsWith(targetDir, cs))
+                sharedTargetDir = true;
+        }
+        targetDirs.append(targetDir);
+    }
+    if (!sharedTargetDir)
+        return batch;
+
+    QList<QStringList> extractedRoots;
+    foreach (Operation *operation, batch) {
+        const QStringList roots = extractedArchiveRoots(core, operation);
+        if (roots.isEmpty())
+            return OperationList();
+
+        foreach (const QStringList &otherRoots, extractedRoots) {
+            foreach (const QString &root, roots) {
+                foreach (const QString &other, otherRoots) {
+                    if (root.startsWith(other, cs) || other.startsWith(root, cs))
+                        return OperationList();
+                }
+            }
+        }
+        extractedRoots.append(roots);
+    }
+    return batch;
+}
+
 static QStringList checkRunningProcessesFromList(const QStringList &processList)
 {
     const QList<ProcessInfo> allProcesses = runningProcesses();
@@ -386,6 +496,26 @@ bool PackageManagerCorePrivate::performOperationThreaded(Operation *operation, O
     return future.result();
 }
 
+/*!
+    Performs the backup and the operation itself for all of \a operations at the same time.
+    Returns the results in the order of \a operations.
+*/
+QList<bool> PackageManagerCorePrivate::performOperationsConcurrently(const OperationList &operations)
+{
+    QFutureWatcher<bool> futureWatcher;
+    const QFuture<bool> future = QtConcurrent::mapped(operations, backupAndPerformOperation);
+
+    QEventLoop loop;
+    QObject::connect(&futureWatcher, &decltype(futureWatcher)::finished, &loop, &QEventLoop::quit,
+                     Qt::QueuedConnection);
+    futureWatcher.setFuture(future);
+
+    if (!future.isFinished())
+        loop.exec();
+
+    return future.results();
+}
+
 QString PackageManagerCorePrivate::targetDir() const
 {
     return m_core->value(scTargetDir);
@@ -1775,6 +1905,8 @@ bool PackageManagerCorePrivate::runInstaller()
                 }
             }
         }
+        // the maintenance tool and components.xml must not get ahead of the installed data
+        commitInstalledComponents();
         emit m_core->titleMessageChanged(tr("Creating Maintenance Tool"));
 
         m_needToWriteMaintenanceTool = true;
@@ -1955,6 +2087,8 @@ bool PackageManagerCorePrivate::runReinstaller()
         foreach(Component * component, componentsToInstall)
             installComponent(component, progressOperationSize, adminRightsGained);
 
+        // the maintenance tool and components.xml must not get ahead of the installed data
+        commitInstalledComponents();
         emit m_core->titleMessageChanged(tr("Creating Maintenance Tool"));
 
         commitSessionOperations(); //end session, move ops to "old"
@@ -2135,6 +2269,8 @@ bool PackageManagerCorePrivate::runPackageUpdater()
         foreach (Component *component, componentsToInstall)
             installComponent(component, progressOperationSize, adminRightsGained);
 
+        // the maintenance tool and components.xml must not get ahead of the installed data
+        commitInstalledComponents();
         emit m_core->titleMessageChanged(tr("Creating Maintenance Tool"));
 
         commitSessionOperations(); //end session, move ops to "old"
@@ -2392,7 +2528,10 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
         showDetailsLog = true;
     }
 
-    foreach (Operation *operation, operations) {
+    // results of Extract operations already performed together with the preceding one
+    QHash<Operation *, bool> concurrentResults;
+    for (int i = 0; i < opCount; ++i) {
+        Operation *const operation = operations.at(i);
         if (statusCanceledOrFailed())
             throw Error(tr("Installation canceled by user"));
 
@@ -2403,14 +2542,44 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
             qCDebug(QInstaller::lcInstallerInstallLog) << operation->name() << "as admin:" << becameAdmin;
         }
 
-        connectOperationToInstaller(operation, progressOperationSize);
-        connectOperationCallMethodRequest(operation);
+        bool ok = false;
+        bool performed = false;
+        if (concurrentResults.contains(operation)) {
+            ok = concurrentResults.take(operation);
+            performed = ok || operation->error() > Operation::InvalidArguments;
+        } else {
+            // archives of the component that cannot overwrite each other are extracted at once
+            const bool startsExtractRun = (i == 0 || operations.at(i - 1)->name() != QLatin1String("Extract"));
+            const OperationList batch = startsExtractRun ? independentExtractOperations(m_core, operations, i)
+                                                         : OperationList();
+            if (!batch.isEmpty()) {
+                foreach (Operation *extractOperation, batch) {
+                    connectOperationToInstaller(extractOperation, progressOperationSize);
+                    connectOperationCallMethodRequest(extractOperation);
+                }
+                const QList<bool> results = performOperationsConcurrently(batch);
+                // record the performed operations in their original order, so that a
+                // cancellation at any point still undoes all of them
+                for (int j = 0; j < batch.count(); ++j) {
+                    Operation *const extractOperation = batch.at(j);
+                    if (results.at(j) || extractOperation->error() > Operation::InvalidArguments)
+                        addPerformed(extractOperation);
+                    if (j > 0)
+                        concurrentResults.insert(extractOperation, results.at(j));
+                }
+                ok = results.first();
+                performed = ok || operation->error() > Operation::InvalidArguments;
+            } else {
+                connectOperationToInstaller(operation, progressOperationSize);
+                connectOperationCallMethodRequest(operation);
 
-        // allow the operation to backup stuff before performing the operation
-        performOperationThreaded(operation, Operation::Backup);
+                // allow the operation to backup stuff before performing the operation
+                performOperationThreaded(operation, Operation::Backup);
+                ok = performOperationThreaded(operation);
+            }
+        }
 
         bool ignoreError = false;
-        bool ok = performOperationThreaded(operation);
         while (!ok && !ignoreError && m_core->status() != PackageManagerCore::Canceled) {
             qCDebug(QInstaller::lcInstallerInstallLog) << QString::fromLatin1("Operation \"%1\" with arguments "
                 "\"%2\" failed: %3").arg(operation->name(), operation->arguments()
@@ -2430,7 +2599,7 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
                 m_core->interrupt();
         }
 
-        if (ok || operation->error() > Operation::InvalidArguments) {
+        if (!performed && (ok || operation->error() > Operation::InvalidArguments)) {
             // Remember that the operation was performed, that allows us to undo it if a following operation
             // fails or if this operation failed but still needs an undo call to cleanup.
             addPerformed(operation);
@@ -2474,7 +2643,21 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
                                   component->isCheckable(),
                                   component->isExpandedByDefault(),
                                   component->value(scContentSha1));
-    m_localPackageHub->writeToDisk();
+
+    // components.xml may only list the component once its data has reached the disk
+    switch (m_data.settings().durabilityPolicy()) {
+    case Settings::SyncPerComponent:
+        collectUnsyncedData(operations);
+        syncUnsyncedData();
+        m_localPackageHub->writeToDisk();
+        break;
+    case Settings::SyncAtEndOfInstallation:
+        collectUnsyncedData(operations); // written by commitInstalledComponents()
+        break;
+    default: // the Extract operations synchronized their files already, if at all
+        m_localPackageHub->writeToDisk();
+        break;
+    }
 
     component->setInstalled();
     component->markAsPerformedInstallation();
@@ -2483,6 +2666,138 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
         ProgressCoordinator::instance()->emitDetailTextChanged(tr("Done"));
 }
 
+/*!
+    \internal
+
+    Remembers the files and target directories written by the Extract operations
+    in \a operations, so that they can be synchronized to disk together.
+*/
+void PackageManagerCorePrivate::collectUnsyncedData(const OperationList &operations)
+{
+    foreach (Operation *operation, operations) {
+        const ExtractArchiveOperation *const extract = dynamic_cast<ExtractArchiveOperation *>(operation);
+        if (!extract)
+            continue;
+        m_unsyncedFiles += extract->extractedFiles();
+        m_unsyncedDirectories.insert(extract->arguments().value(1));
+    }
+}
+
+/*!
+    \internal
+
+    Flushes the data remembered by collectUnsyncedData() to disk. Whole file
+    systems are flushed at once where the platform supports it, otherwise the
+    files are flushed one by one. Throws an Error if any of the data could not
+    be flushed, so that components.xml never lists data that is not on disk.
+*/
+void PackageManagerCorePrivate::syncUnsyncedData()
+{
+    const QStringList files = m_unsyncedFiles;
+    const QSet<QString> directories = m_unsyncedDirectories;
+    m_unsyncedFiles.clear();
+    m_unsyncedDirectories.clear();
+
+    bool fileSystemsSynced = !directories.isEmpty();
+    foreach (const QString &directory, directories)
+        fileSystemsSynced = syncFileSystem(directory) && fileSystemsSynced;
+    if (!fileSystemsSynced) {
+        foreach (const QString &file, files)
+            syncFile(file);
+    }
+}
+
+/*!
+    \internal
+
+    Makes the data of all components installed in this session durable and
+    writes components.xml describing them. Called before the maintenance tool
+    is written.
+*/
+void PackageManagerCorePrivate::commitInstalledComponents()
+{
+    syncUnsyncedData();
+    m_localPackageHub->writeToDisk();
+}
+
+/*!
+    \internal
+
+    Returns the directory the installed archive \a archive of \a component was extracted
+    to, or an empty string if no Extract operation of the installation extracted it.
+*/
+QString PackageManagerCorePrivate::installedArchiveDirectory(const QString &component,
+    const QString &archive) const
+{
+    foreach (const Operation *operation, m_performedOperationsOld) {
+        if (operation->name() != QLatin1String("Extract")
+                || operation->value(QLatin1String("component")).toString() != component) {
+            continue;
+        }
+        const QStringList arguments = operation->arguments();
+        if (arguments.count() > 1 && arguments.first() == archive)
+            return arguments.at(1);
+    }
+    return QString();
+}
+
+/*!
+    \internal
+
+    Writes the files of the data archive \a archive of \a component from the downloaded
+    \a patch and the files in \a installedDir, which were extracted from the installed
+    version of the archive, to a directory the Extract operation moves them from. Registers
+    an empty archive in place of \a archive, so that the operation gets created as if the
+    archive was downloaded. Returns \c false if the patch does not match the checksum
+    \a patchSha1 or does not fit the installed files, in which case the archive needs to
+    be downloaded.
+*/
+bool PackageManagerCorePrivate::applyArchivePatch(Component *component, const QString &archive,
+    const QString &patch, const QByteArray &patchSha1, const QString &installedDir)
+{
+    const QString fileName = QFileInfo(archive).fileName();
+    const QString target = QString::fromLatin1("%1/%2/%3").arg(component->localTempPath(),
+        component->name(), fileName);
+    const QString dataDir = target + QLatin1String(".patched");
+    try {
+        if (calculateHash(patch, QCryptographicHash::Sha1).toHex() != patchSha1)
+            throw Error(tr("Checksum of patch \"%1\" does not match.").arg(QFileInfo(patch).fileName()));
+
+        QTemporaryDir patchDir;
+        if (!patchDir.isValid())
+            throw Error(tr("Cannot create temporary directory: %1").arg(patchDir.errorString()));
+
+        QScopedPointer<AbstractArchive> patchArchive(ArchiveFactory::instance().create(patch));
+        if (!patchArchive || !patchArchive->open(QIODevice::ReadOnly)
+                || !patchArchive->extract(patchDir.path())) {
+            throw Error(tr("Cannot extract patch \"%1\": %2").arg(QFileInfo(patch).fileName(),
+                patchArchive ? patchArchive->errorString() : tr("Unsupported archive.")));
+        }
+        QDir(dataDir).removeRecursively();
+        QInstaller::mkpath(dataDir);
+        QInstaller::applyArchivePatch(patchDir.path(), installedDir, dataDir);
+
+        // the signature header of an empty 7z archive
+        QFile placeholder(target);
+        QInstaller::openForWrite(&placeholder);
+        QInstaller::blockingWrite(&placeholder, QByteArray::fromHex("377ABCAF271C00038D9BD50F"
+            "0000000000000000000000000000000000000000"));
+    } catch (const Error &error) {
+        QDir(dataDir).removeRecursively();
+        BinaryFormatEngineHandler::instance()->unregisterResource(patch);
+        qCWarning(QInstaller::lcInstallerInstallLog).noquote() << "Cannot update" << fileName
+            << "from a patch:" << error.message() << "Downloading the complete archive instead.";
+        return false;
+    }
+
+    // the patch must not end up in the archives of the component
+    BinaryFormatEngineHandler::instance()->unregisterResource(patch);
+    BinaryFormatEngineHandler::instance()->registerResource(archive, target);
+    QInstaller::registerPatchedArchive(archive, dataDir);
+    qCDebug(QInstaller::lcInstallerInstallLog) << "Updated" << fileName << "from a patch.";
+    return true;
+}
+
 bool PackageManagerCorePrivate::runningProcessesFound()
 {
     //Check if there are processes running in the install
@@ -2816,7 +3131,13 @@ bool PackageManagerCorePrivate::addUpdateResourcesFromRepositories(bool parseChe
         if (data.directory.isEmpty())
             continue;
 
-        if (parseChecksum) {
+        RepositoryIndex index(data.directory + QLatin1String("/Updates.xml.idx"));
+        if (parseChecksum && index.open()
+                && index.matchesUpdates(data.directory + QLatin1String("/Updates.xml"))) {
+            const QString checksum = index.repositoryValue(QLatin1String("Checksum"));
+            if (!checksum.isEmpty())
+                m_core->setTestChecksum(checksum.toLower() == scTrue);
+        } else if (parseChecksum) {
             const QString updatesXmlPath = data.directory + QLatin1String("/Updates.xml");
             QFile updatesFile(updatesXmlPath);
             try {
@@ -76,6 +76,7 @@ public:
 
     static bool performOperationThreaded(Operation *op, UpdateOperation::OperationType type
         = UpdateOperation::Perform);
+    static QList<bool> performOperationsConcurrently(const OperationList &operations);
 
     void initialize(const QHash<QString, QString> &params);
     bool isOfflineOnly() const;
@@ -167,6 +168,13 @@ public:
 
     void installComponent(Component *component, double progressOperationSize,
         bool adminRightsGained = false);
+    void collectUnsyncedData(const OperationList &operations);
+    void syncUnsyncedData();
+    void commitInstalledComponents();
+
+    QString installedArchiveDirectory(const QString &component, const QString &archive) const;
+    bool applyArchivePatch(Component *component, const QString &archive, const QString &patch,
+        const QByteArray &patchSha1, const QString &installedDir);
 
     bool runningProcessesFound();
     void setComponentSelection(const QString &id, Qt::CheckState state);
@@ -218,6 +226,9 @@ public:
     OperationList m_performedOperationsOld;
     OperationList m_performedOperationsCurrentSession;
 
+    QStringList m_unsyncedFiles;
+    QSet<QString> m_unsyncedDirectories;
+
     bool m_dependsOnLocalInstallerBinary;
     QStringList m_allowedRunningProcesses;
     bool m_autoAcceptLicenses;
@@ -590,6 +590,10 @@ void RemoteServerConnection::handleArchive(QIODevice *socket, const QString &com
         qint32 level;
         data >> level;
         archive->setCompressionLevel(static_cast<AbstractArchive::CompressionLevel>(level));
+    } else if (command == QLatin1String(Protocol::AbstractArchiveSetCompressionThreadCount)) {
+        qint32 count;
+        data >> count;
+        archive->setCompressionThreadCount(count);
     } else if (command == QLatin1String(Protocol::AbstractArchiveAddDataBlock)) {
         QByteArray buff;
         data >> buff;
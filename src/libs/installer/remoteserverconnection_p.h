@@ -165,10 +165,11 @@ private Q_SLOTS:
         m_receivedSignals.append(total);
     }
 
-    void onDataBlockRequested()
+    void onDataBlockRequested(int count)
     {
         QMutexLocker _(&m_lock);
         m_receivedSignals.append(QLatin1String(Protocol::AbstractArchiveSignalDataBlockRequested));
+        m_receivedSignals.append(count);
     }
 
     void onSeekRequested(qint64 offset, int whence)
@@ -0,0 +1,687 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "repositoryindex.h"
+
+#include "constants.h"
+#include "errors.h"
+#include "fileio.h"
+#include "fileutils.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDateTime>
+#include <QDomDocument>
+#include <QFileInfo>
+#include <QMutex>
+#include <QtEndian>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstring>
+
+namespace QInstaller {
+
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::RepositoryIndex
+    \internal
+    \brief The RepositoryIndex class reads and writes the binary index of a repository.
+
+    The index is written by repogen next to the Updates.xml file and holds the same
+    package information in a form that can be memory mapped and used without any text
+    parsing. It consists of a fixed size header, a table of package records in the order
+    of the Updates.xml, a table of attribute records, a table of package indices sorted by
+    package name and a pool of zero terminated UTF-8 strings. All integers are stored in little endian byte order. The header contains
+    a format version, the SHA-1 checksum of the remaining data and the size and SHA-1
+    checksum of the Updates.xml file the index was created from. Use matchesUpdates()
+    to make sure the index still describes the Updates.xml next to it.
+
+    Packages whose PackageUpdate element contains structured content, such as licenses
+    or operations, are flagged with \c NeedsXml and carry the XML of the element instead
+    of attributes.
+*/
+
+/*!
+    \enum QInstaller::RepositoryIndex::PackageFlag
+
+    \value HasMetadata
+           The package has a meta data archive with scripts, licenses, user interfaces
+           or translations.
+    \value HasSha1
+           The package record contains the SHA-1 checksum of the meta data archive.
+    \value HasUpdateFile
+           The package record contains the compressed and uncompressed size.
+    \value NeedsXml
+           The package needs to be read from its PackageUpdate XML, see packageXml().
+    \value HasVersion
+           The PackageUpdate element contains a Version element, which might be empty.
+*/
+
+/*!
+    \enum QInstaller::RepositoryIndex::RepositoryFlag
+
+    \value HasRepositoryUpdate
+           The Updates.xml contains a RepositoryUpdate element that is not part of the index.
+*/
+
+static const char scIndexMagic[] = "QIFW";
+static const quint16 scIndexFormatVersion = 3;
+
+enum HeaderLayout {
+    HeaderMagic = 0,
+    HeaderFormatVersion = 4,
+    HeaderRepositoryFlags = 6,
+    HeaderPackageCount = 8,
+    HeaderRepositoryAttributeCount = 12,
+    HeaderAttributeCount = 16,
+    HeaderStringPoolSize = 20,
+    HeaderChecksum = 24,
+    HeaderUpdatesChecksum = 44,
+    HeaderUpdatesSize = 64,
+    HeaderSize = 72
+};
+
+enum PackageLayout {
+    PackageName = 0,
+    PackageVersion = 4,
+    PackageFlagField = 8,
+    PackageFirstAttribute = 12,
+    PackageAttributeCount = 16,
+    PackageXml = 20,
+    PackageCompressedSize = 24,
+    PackageUncompressedSize = 32,
+    PackageSha1 = 40,
+    PackageXmlSize = 60,
+    PackageSize = 64
+};
+
+enum AttributeLayout {
+    AttributeName = 0,
+    AttributeLanguage = 4,
+    AttributeValue = 8,
+    AttributeSize = 12
+};
+
+// The size and checksum of every Updates.xml checked against an index, so that the file is
+// hashed only once even though the installer opens its index several times.
+class UpdatesChecksums
+{
+public:
+    QByteArray checksum(const QString &fileName)
+    {
+        const QFileInfo fileInfo(fileName);
+        const QString key = fileInfo.absoluteFilePath();
+        const QDateTime lastModified = fileInfo.lastModified();
+        {
+            QMutexLocker _(&m_mutex);
+            const QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+            if (it != m_entries.constEnd() && it->size == fileInfo.size()
+                    && it->lastModified == lastModified) {
+                return it->checksum;
+            }
+        }
+
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(&file);
+
+        Entry entry;
+        entry.size = fileInfo.size();
+        entry.lastModified = lastModified;
+        entry.checksum = hash.result();
+        QMutexLocker _(&m_mutex);
+        m_entries.insert(key, entry);
+        return entry.checksum;
+    }
+
+private:
+    struct Entry
+    {
+        qint64 size;
+        QDateTime lastModified;
+        QByteArray checksum;
+    };
+
+    QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+};
+Q_GLOBAL_STATIC(UpdatesChecksums, updatesChecksums)
+
+template <typename T>
+static void appendLittleEndian(QByteArray *data, T value)
+{
+    const T le = qToLittleEndian(value);
+    data->append(reinterpret_cast<const char *>(&le), sizeof(T));
+}
+
+template <typename T>
+static T readLittleEndian(const uchar *data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+/*!
+    Creates an index for the file \a fileName. Call open() to map and validate it.
+*/
+RepositoryIndex::RepositoryIndex(const QString &fileName)
+    : m_file(fileName)
+    , m_data(nullptr)
+    , m_size(0)
+{
+}
+
+/*!
+    Destroys the index and unmaps the file.
+*/
+RepositoryIndex::~RepositoryIndex()
+{
+    close();
+}
+
+/*!
+    Maps the index file into memory and validates its header and checksum. Returns
+    \c true on success; otherwise sets errorString() and returns \c false.
+*/
+bool RepositoryIndex::open()
+{
+    close();
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < HeaderSize) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex", "File is too small.");
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        m_errorString = m_file.errorString();
+        close();
+        return false;
+    }
+
+    if (memcmp(m_data + HeaderMagic, scIndexMagic, 4) != 0
+            || readLittleEndian<quint16>(m_data + HeaderFormatVersion) != scIndexFormatVersion) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex", "Unsupported format.");
+        close();
+        return false;
+    }
+
+    const quint64 packages = readLittleEndian<quint32>(m_data + HeaderPackageCount);
+    const quint64 attributes = readLittleEndian<quint32>(m_data + HeaderAttributeCount);
+    const quint64 poolSize = readLittleEndian<quint32>(m_data + HeaderStringPoolSize);
+    if (quint64(m_size) != HeaderSize + packages * (PackageSize + sizeof(quint32))
+            + attributes * AttributeSize + poolSize
+            || poolSize == 0 || m_data[m_size - 1] != 0
+            || readLittleEndian<quint32>(m_data + HeaderRepositoryAttributeCount) > attributes) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex", "Invalid file size.");
+        close();
+        return false;
+    }
+
+    const QByteArray checksum = QCryptographicHash::hash(QByteArray::fromRawData(reinterpret_cast
+        <const char *>(m_data + HeaderSize), m_size - HeaderSize), QCryptographicHash::Sha1);
+    if (memcmp(m_data + HeaderChecksum, checksum.constData(), checksum.size()) != 0) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex", "Checksum mismatch.");
+        close();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    Unmaps and closes the index file.
+*/
+void RepositoryIndex::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_data = nullptr;
+    m_size = 0;
+    m_file.close();
+}
+
+/*!
+    Returns \c true if the index was opened successfully.
+*/
+bool RepositoryIndex::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+/*!
+    Returns a human-readable description of the last error that occurred.
+*/
+QString RepositoryIndex::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+    Returns \c true if the index was created from the file \a updatesFileName, that is
+    the size and SHA-1 checksum of the file match the ones recorded in the index header.
+    An index left over from an older repogen run or an Updates.xml edited by hand does
+    not match; errorString() is set in that case and the XML needs to be read instead.
+    The checksum of an unchanged file is only calculated once, see updatesChecksum().
+*/
+bool RepositoryIndex::matchesUpdates(const QString &updatesFileName)
+{
+    Q_ASSERT(isOpen());
+
+    const QFileInfo updates(updatesFileName);
+    if (!updates.isFile()) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex",
+            "Cannot read \"%1\".").arg(updatesFileName);
+        return false;
+    }
+    // compare the size first, it is cheap and catches most edits
+    if (quint64(updates.size()) != readLittleEndian<quint64>(m_data + HeaderUpdatesSize)) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex",
+            "Index does not match \"%1\".").arg(updatesFileName);
+        return false;
+    }
+
+    const QByteArray checksum = updatesChecksum(updatesFileName);
+    if (checksum.isEmpty()) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex",
+            "Cannot read \"%1\".").arg(updatesFileName);
+        return false;
+    }
+    if (memcmp(m_data + HeaderUpdatesChecksum, checksum.constData(), checksum.size()) != 0) {
+        m_errorString = QCoreApplication::translate("RepositoryIndex",
+            "Index does not match \"%1\".").arg(updatesFileName);
+        return false;
+    }
+    return true;
+}
+
+/*!
+    Returns the SHA-1 checksum of the file \a updatesFileName, or an empty byte array if
+    the file cannot be read. The checksum is remembered as long as the size and modification
+    time of the file do not change, so every Updates.xml is read only once.
+*/
+QByteArray RepositoryIndex::updatesChecksum(const QString &updatesFileName)
+{
+    return updatesChecksums()->checksum(updatesFileName);
+}
+
+/*!
+    Returns \c true if the Updates.xml of the repository contains a RepositoryUpdate
+    element, which needs to be read from the XML.
+*/
+bool RepositoryIndex::hasRepositoryUpdate() const
+{
+    return readLittleEndian<quint16>(m_data + HeaderRepositoryFlags) & HasRepositoryUpdate;
+}
+
+/*!
+    Returns the simple top level elements of the Updates.xml, for example
+    \c ApplicationName or \c Checksum.
+*/
+QVector<RepositoryIndex::Attribute> RepositoryIndex::repositoryAttributes() const
+{
+    return attributes(0, readLittleEndian<quint32>(m_data + HeaderRepositoryAttributeCount));
+}
+
+/*!
+    Returns the value of the top level element \a name, or an empty string.
+*/
+QString RepositoryIndex::repositoryValue(const QString &name) const
+{
+    foreach (const Attribute &attribute, repositoryAttributes()) {
+        if (attribute.name == name)
+            return attribute.value;
+    }
+    return QString();
+}
+
+/*!
+    Returns the number of packages in the index.
+*/
+int RepositoryIndex::packageCount() const
+{
+    return readLittleEndian<quint32>(m_data + HeaderPackageCount);
+}
+
+/*!
+    Returns the index of the package \a name, or \c -1 if the repository does not
+    contain such a package. The lookup is a binary search on the sorted name table.
+*/
+int RepositoryIndex::indexOf(const QString &name) const
+{
+    const QByteArray key = name.toUtf8();
+    const uchar *const names = nameTable();
+    const int count = packageCount();
+    int first = 0;
+    int last = count - 1;
+    while (first <= last) {
+        const int middle = first + (last - first) / 2;
+        const quint32 index = readLittleEndian<quint32>(names + quint64(middle) * sizeof(quint32));
+        if (index >= quint32(count))
+            return -1;
+        const int result = qstrcmp(rawString(readLittleEndian<quint32>(package(index)
+            + PackageName)), key.constData());
+        if (result == 0)
+            return index;
+        if (result < 0)
+            first = middle + 1;
+        else
+            last = middle - 1;
+    }
+    return -1;
+}
+
+/*!
+    Returns the name of the package at \a index.
+*/
+QString RepositoryIndex::name(int index) const
+{
+    return string(readLittleEndian<quint32>(package(index) + PackageName));
+}
+
+/*!
+    Returns the version of the package at \a index.
+*/
+QString RepositoryIndex::version(int index) const
+{
+    return string(readLittleEndian<quint32>(package(index) + PackageVersion));
+}
+
+/*!
+    Returns the flags of the package at \a index.
+*/
+RepositoryIndex::PackageFlags RepositoryIndex::flags(int index) const
+{
+    return PackageFlags(readLittleEndian<quint32>(package(index) + PackageFlagField));
+}
+
+/*!
+    Returns the hex encoded SHA-1 checksum of the meta data archive of the package
+    at \a index, or an empty string if the package has none.
+*/
+QString RepositoryIndex::sha1(int index) const
+{
+    if (!flags(index).testFlag(HasSha1))
+        return QString();
+    return QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(package(index)
+        + PackageSha1), 20).toHex());
+}
+
+/*!
+    Returns the compressed size of the package at \a index.
+*/
+quint64 RepositoryIndex::compressedSize(int index) const
+{
+    return readLittleEndian<quint64>(package(index) + PackageCompressedSize);
+}
+
+/*!
+    Returns the uncompressed size of the package at \a index.
+*/
+quint64 RepositoryIndex::uncompressedSize(int index) const
+{
+    return readLittleEndian<quint64>(package(index) + PackageUncompressedSize);
+}
+
+/*!
+    Returns the simple child elements of the PackageUpdate element of the package at
+    \a index in document order. Name, Version, SHA1 and UpdateFile are not included.
+*/
+QVector<RepositoryIndex::Attribute> RepositoryIndex::attributes(int index) const
+{
+    const uchar *const record = package(index);
+    return attributes(readLittleEndian<quint32>(record + PackageFirstAttribute),
+        readLittleEndian<quint32>(record + PackageAttributeCount));
+}
+
+/*!
+    Returns the PackageUpdate element of the package at \a index if it is flagged with
+    \c NeedsXml; otherwise returns an empty byte array.
+*/
+QByteArray RepositoryIndex::packageXml(int index) const
+{
+    const uchar *const record = package(index);
+    const quint32 offset = readLittleEndian<quint32>(record + PackageXml);
+    const quint32 size = readLittleEndian<quint32>(record + PackageXmlSize);
+    const quint64 poolSize = readLittleEndian<quint32>(m_data + HeaderStringPoolSize);
+    if (!flags(index).testFlag(NeedsXml) || quint64(offset) + size > poolSize)
+        return QByteArray();
+    return QByteArray(rawString(offset), size);
+}
+
+/*!
+    Writes the index for the Updates.xml content \a updatesXml to \a fileName. The size
+    and checksum of \a updatesXml are recorded, so \a updatesXml needs to be the exact
+    content of the published file.
+
+    \note Throws Error on failure.
+*/
+void RepositoryIndex::write(const QByteArray &updatesXml, const QString &fileName)
+{
+    QDomDocument updates;
+    if (!updates.setContent(updatesXml)) {
+        throw Error(QCoreApplication::translate("RepositoryIndex", "Cannot parse Updates.xml "
+            "for index \"%1\".").arg(QDir::toNativeSeparators(fileName)));
+    }
+
+    QByteArray pool(1, '\0');
+    QHash<QByteArray, quint32> poolOffsets;
+    auto addString = [&pool, &poolOffsets](const QByteArray &string) -> quint32 {
+        if (string.isEmpty())
+            return 0;
+        if (poolOffsets.contains(string))
+            return poolOffsets.value(string);
+        const quint32 offset = pool.size();
+        pool.append(string).append('\0');
+        poolOffsets.insert(string, offset);
+        return offset;
+    };
+
+    QByteArray attributeTable;
+    quint32 attributeCount = 0;
+    auto addAttribute = [&](const QString &name, const QString &language, const QString &value) {
+        appendLittleEndian<quint32>(&attributeTable, addString(name.toUtf8()));
+        appendLittleEndian<quint32>(&attributeTable, addString(language.toUtf8()));
+        appendLittleEndian<quint32>(&attributeTable, addString(value.toUtf8()));
+        ++attributeCount;
+    };
+
+    const QString langAttribute = QLatin1String("xml:lang");
+    auto isSimple = [&langAttribute](const QDomElement &element) {
+        if (!element.firstChildElement().isNull())
+            return false;
+        const QDomNamedNodeMap attributes = element.attributes();
+        return attributes.isEmpty() || (attributes.count() == 1 && element.hasAttribute(langAttribute));
+    };
+
+    quint16 repositoryFlags = 0;
+    QList<QPair<QByteArray, QDomElement> > packages;
+    const QDomElement root = updates.documentElement();
+    for (QDomElement el = root.firstChildElement(); !el.isNull(); el = el.nextSiblingElement()) {
+        if (el.tagName() == QLatin1String("PackageUpdate"))
+            packages.append(qMakePair(el.firstChildElement(scName).text().toUtf8(), el));
+        else if (isSimple(el))
+            addAttribute(el.tagName(), el.attribute(langAttribute), el.text());
+        else if (el.tagName() == QLatin1String("RepositoryUpdate"))
+            repositoryFlags |= HasRepositoryUpdate;
+    }
+    const quint32 repositoryAttributeCount = attributeCount;
+
+    // the packages keep the order of the Updates.xml, lookups go through a sorted name table
+    QVector<quint32> sortedPackages(packages.count());
+    for (int i = 0; i < packages.count(); ++i)
+        sortedPackages[i] = i;
+    std::stable_sort(sortedPackages.begin(), sortedPackages.end(), [&packages](quint32 lhs, quint32 rhs) {
+        return packages.at(lhs).first < packages.at(rhs).first;
+    });
+
+    const QStringList metaElements = QStringList() << QLatin1String("Script")
+        << QLatin1String("Licenses") << QLatin1String("UserInterfaces") << QLatin1String("Translations");
+
+    QByteArray packageTable;
+    for (int i = 0; i < packages.count(); ++i) {
+        const QDomElement package = packages.at(i).second;
+        const quint32 firstAttribute = attributeCount;
+        quint32 flags = 0;
+        quint32 versionOffset = 0;
+        quint64 compressedSize = 0;
+        quint64 uncompressedSize = 0;
+        QByteArray sha1;
+
+        for (QDomElement el = package.firstChildElement(); !el.isNull(); el = el.nextSiblingElement()) {
+            const QString tagName = el.tagName();
+            if (metaElements.contains(tagName))
+                flags |= HasMetadata;
+
+            if (tagName == scName) {
+                continue;
+            } else if (tagName == scVersion) {
+                versionOffset = addString(el.text().toUtf8());
+                flags |= HasVersion;
+                const QString inheritVersionFrom = el.attribute(QLatin1String("inheritVersionFrom"));
+                if (!inheritVersionFrom.isEmpty())
+                    addAttribute(QLatin1String("inheritVersionFrom"), QString(), inheritVersionFrom);
+            } else if (tagName == scSHA1 && QByteArray::fromHex(el.text().toLatin1()).size() == 20) {
+                sha1 = QByteArray::fromHex(el.text().toLatin1());
+                flags |= HasSha1;
+            } else if (tagName == QLatin1String("UpdateFile")) {
+                compressedSize = el.attribute(QLatin1String("CompressedSize")).toULongLong();
+                uncompressedSize = el.attribute(QLatin1String("UncompressedSize")).toULongLong();
+                flags |= HasUpdateFile;
+            } else if (isSimple(el)) {
+                addAttribute(tagName, el.attribute(langAttribute), el.text());
+            } else {
+                flags |= NeedsXml;
+            }
+        }
+
+        quint32 xmlOffset = 0;
+        quint32 xmlSize = 0;
+        if (flags & NeedsXml) {
+            // structured content is read back from the XML, drop the partial attributes
+            attributeTable.truncate(firstAttribute * AttributeSize);
+            attributeCount = firstAttribute;
+
+            QString xml;
+            QTextStream stream(&xml);
+            package.save(stream, 0);
+            const QByteArray data = xml.toUtf8();
+            xmlOffset = pool.size();
+            xmlSize = data.size();
+            pool.append(data).append('\0');
+        }
+
+        appendLittleEndian<quint32>(&packageTable, addString(packages.at(i).first));
+        appendLittleEndian<quint32>(&packageTable, versionOffset);
+        appendLittleEndian<quint32>(&packageTable, flags);
+        appendLittleEndian<quint32>(&packageTable, firstAttribute);
+        appendLittleEndian<quint32>(&packageTable, attributeCount - firstAttribute);
+        appendLittleEndian<quint32>(&packageTable, xmlOffset);
+        appendLittleEndian<quint64>(&packageTable, compressedSize);
+        appendLittleEndian<quint64>(&packageTable, uncompressedSize);
+        packageTable.append(sha1.leftJustified(20, '\0', true));
+        appendLittleEndian<quint32>(&packageTable, xmlSize);
+    }
+
+    QByteArray nameTable;
+    foreach (quint32 index, sortedPackages)
+        appendLittleEndian<quint32>(&nameTable, index);
+
+    const QByteArray body = packageTable + attributeTable + nameTable + pool;
+    QByteArray header(scIndexMagic, 4);
+    appendLittleEndian<quint16>(&header, scIndexFormatVersion);
+    appendLittleEndian<quint16>(&header, repositoryFlags);
+    appendLittleEndian<quint32>(&header, packages.count());
+    appendLittleEndian<quint32>(&header, repositoryAttributeCount);
+    appendLittleEndian<quint32>(&header, attributeCount);
+    appendLittleEndian<quint32>(&header, pool.size());
+    header.append(QCryptographicHash::hash(body, QCryptographicHash::Sha1));
+    header.append(QCryptographicHash::hash(updatesXml, QCryptographicHash::Sha1));
+    appendLittleEndian<quint64>(&header, updatesXml.size());
+    Q_ASSERT(header.size() == HeaderSize);
+
+    QFile file(fileName);
+    QInstaller::openForWrite(&file);
+    QInstaller::blockingWrite(&file, header + body);
+    file.close();
+}
+
+const uchar *RepositoryIndex::package(int index) const
+{
+    Q_ASSERT(index >= 0 && index < packageCount());
+    return m_data + HeaderSize + quint64(index) * PackageSize;
+}
+
+const uchar *RepositoryIndex::nameTable() const
+{
+    return m_data + HeaderSize + quint64(packageCount()) * PackageSize
+        + quint64(readLittleEndian<quint32>(m_data + HeaderAttributeCount)) * AttributeSize;
+}
+
+const char *RepositoryIndex::rawString(quint32 offset) const
+{
+    const quint64 pool = (nameTable() - m_data) + quint64(packageCount()) * sizeof(quint32);
+    if (offset >= readLittleEndian<quint32>(m_data + HeaderStringPoolSize))
+        offset = 0;
+    return reinterpret_cast<const char *>(m_data + pool + offset);
+}
+
+QString RepositoryIndex::string(quint32 offset) const
+{
+    return QString::fromUtf8(rawString(offset));
+}
+
+QVector<RepositoryIndex::Attribute> RepositoryIndex::attributes(quint32 first, quint32 count) const
+{
+    QVector<Attribute> result;
+    const quint32 total = readLittleEndian<quint32>(m_data + HeaderAttributeCount);
+    if (quint64(first) + count > total)
+        return result;
+
+    result.reserve(count);
+    const uchar *record = m_data + HeaderSize + quint64(packageCount()) * PackageSize
+        + quint64(first) * AttributeSize;
+    for (quint32 i = 0; i < count; ++i, record += AttributeSize) {
+        Attribute attribute;
+        attribute.name = string(readLittleEndian<quint32>(record + AttributeName));
+        attribute.language = string(readLittleEndian<quint32>(record + AttributeLanguage));
+        attribute.value = string(readLittleEndian<quint32>(record + AttributeValue));
+        result.append(attribute);
+    }
+    return result;
+}
+
+} // namespace QInstaller
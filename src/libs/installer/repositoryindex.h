@@ -0,0 +1,110 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#ifndef REPOSITORYINDEX_H
+#define REPOSITORYINDEX_H
+
+#include "installer_global.h"
+
+#include <QFile>
+#include <QVector>
+
+namespace QInstaller {
+
+class INSTALLER_EXPORT RepositoryIndex
+{
+    Q_DISABLE_COPY(RepositoryIndex)
+
+public:
+    enum PackageFlag {
+        HasMetadata = 0x1,
+        HasSha1 = 0x2,
+        HasUpdateFile = 0x4,
+        NeedsXml = 0x8,
+        HasVersion = 0x10
+    };
+    Q_DECLARE_FLAGS(PackageFlags, PackageFlag)
+
+    enum RepositoryFlag {
+        HasRepositoryUpdate = 0x1
+    };
+
+    struct Attribute
+    {
+        QString name;
+        QString language;
+        QString value;
+    };
+
+    explicit RepositoryIndex(const QString &fileName);
+    ~RepositoryIndex();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+    bool matchesUpdates(const QString &updatesFileName);
+    static QByteArray updatesChecksum(const QString &updatesFileName);
+
+    bool hasRepositoryUpdate() const;
+    QVector<Attribute> repositoryAttributes() const;
+    QString repositoryValue(const QString &name) const;
+
+    int packageCount() const;
+    int indexOf(const QString &name) const;
+
+    QString name(int index) const;
+    QString version(int index) const;
+    PackageFlags flags(int index) const;
+    QString sha1(int index) const;
+    quint64 compressedSize(int index) const;
+    quint64 uncompressedSize(int index) const;
+    QVector<Attribute> attributes(int index) const;
+    QByteArray packageXml(int index) const;
+
+    static void write(const QByteArray &updatesXml, const QString &fileName);
+
+private:
+    const uchar *package(int index) const;
+    const uchar *nameTable() const;
+    QString string(quint32 offset) const;
+    const char *rawString(quint32 offset) const;
+    QVector<Attribute> attributes(quint32 first, quint32 count) const;
+
+private:
+    QFile m_file;
+    const uchar *m_data;
+    qint64 m_size;
+    QString m_errorString;
+};
+
+} // namespace QInstaller
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(QInstaller::RepositoryIndex::PackageFlags)
+
+#endif // REPOSITORYINDEX_H
@@ -70,6 +70,10 @@ static const QLatin1String scDependsOnLocalInstallerBinary("DependsOnLocalInstal
 static const QLatin1String scTranslations("Translations");
 static const QLatin1String scCreateLocalRepository("CreateLocalRepository");
 static const QLatin1String scInstallActionColumnVisible("InstallActionColumnVisible");
+static const QLatin1String scDurabilityPolicy("DurabilityPolicy");
+static const QLatin1String scDeduplicateFiles("DeduplicateFiles");
+static const QLatin1String scRepositoryTimeout("RepositoryTimeout");
+static const QLatin1String scExtractThreads("ExtractThreads");
 
 static const QLatin1String scFtpProxy("FtpProxy");
 static const QLatin1String scHttpProxy("HttpProxy");
@@ -304,7 +308,8 @@ Settings Settings::fromFileAndPrefix(const QString &path, const QString &prefix,
                 << scRepositorySettingsPageVisible << scTargetConfigurationFile
                 << scRemoteRepositories << scTranslations << scUrlQueryString << QLatin1String(scControlScript)
                 << scCreateLocalRepository << scInstallActionColumnVisible << scSupportsModify << scAllowUnstableComponents
-                << scSaveDefaultRepositories << scRepositoryCategories;
+                << scSaveDefaultRepositories << scRepositoryCategories << scDurabilityPolicy
+                << scDeduplicateFiles << scRepositoryTimeout << scExtractThreads;
 
     Settings s;
     s.d->m_data.insert(scPrefix, prefix);
@@ -384,6 +389,32 @@ Settings Settings::fromFileAndPrefix(const QString &path, const QString &prefix,
         s.d->m_data.insert(scAllowUnstableComponents, false);
     if (!s.d->m_data.contains(scSaveDefaultRepositories))
         s.d->m_data.insert(scSaveDefaultRepositories, true);
+    if (!s.d->m_data.contains(scDeduplicateFiles))
+        s.d->m_data.insert(scDeduplicateFiles, false);
+    if (s.d->m_data.contains(scRepositoryTimeout)) {
+        bool ok = false;
+        const int timeout = s.d->m_data.value(scRepositoryTimeout).toString().toInt(&ok);
+        if (!ok || timeout < 0) {
+            throw Error(QString::fromLatin1("Invalid value \"%1\" for <RepositoryTimeout> tag in %2.")
+                .arg(s.d->m_data.value(scRepositoryTimeout).toString(), file.fileName()));
+        }
+    }
+    if (s.d->m_data.contains(scExtractThreads)) {
+        bool ok = false;
+        const int threads = s.d->m_data.value(scExtractThreads).toString().toInt(&ok);
+        if (!ok || threads < 0) {
+            throw Error(QString::fromLatin1("Invalid value \"%1\" for <ExtractThreads> tag in %2.")
+                .arg(s.d->m_data.value(scExtractThreads).toString(), file.fileName()));
+        }
+    }
+    if (s.d->m_data.contains(scDurabilityPolicy)) {
+        const QString policy = s.d->m_data.value(scDurabilityPolicy).toString();
+        if (policy != QLatin1String("None") && policy != QLatin1String("PerFile")
+                && policy != QLatin1String("PerComponent") && policy != QLatin1String("EndOfInstallation")) {
+            throw Error(QString::fromLatin1("Invalid value \"%1\" for <DurabilityPolicy> tag in %2.")
+                .arg(policy, file.fileName()));
+        }
+    }
     return s;
 }
 
@@ -926,6 +957,66 @@ void Settings::setSaveDefaultRepositories(bool save)
     d->m_data.insert(scSaveDefaultRepositories, save);
 }
 
+bool Settings::deduplicateFiles() const
+{
+    return d->m_data.value(scDeduplicateFiles, false).toBool();
+}
+
+void Settings::setDeduplicateFiles(bool deduplicate)
+{
+    d->m_data.insert(scDeduplicateFiles, deduplicate);
+}
+
+int Settings::repositoryTimeout() const
+{
+    return d->m_data.value(scRepositoryTimeout, 30).toInt();
+}
+
+void Settings::setRepositoryTimeout(int seconds)
+{
+    d->m_data.insert(scRepositoryTimeout, seconds);
+}
+
+int Settings::extractThreads() const
+{
+    return d->m_data.value(scExtractThreads, 0).toInt();
+}
+
+void Settings::setExtractThreads(int threads)
+{
+    d->m_data.insert(scExtractThreads, threads);
+}
+
+Settings::DurabilityPolicy Settings::durabilityPolicy() const
+{
+    const QString policy = d->m_data.value(scDurabilityPolicy).toString();
+    if (policy == QLatin1String("PerFile"))
+        return Settings::SyncPerFile;
+    if (policy == QLatin1String("PerComponent"))
+        return Settings::SyncPerComponent;
+    if (policy == QLatin1String("EndOfInstallation"))
+        return Settings::SyncAtEndOfInstallation;
+    return Settings::NoSync;
+}
+
+void Settings::setDurabilityPolicy(Settings::DurabilityPolicy policy)
+{
+    switch (policy) {
+    case Settings::SyncPerFile:
+        d->m_data.insert(scDurabilityPolicy, QLatin1String("PerFile"));
+        break;
+    case Settings::SyncPerComponent:
+        d->m_data.insert(scDurabilityPolicy, QLatin1String("PerComponent"));
+        break;
+    case Settings::SyncAtEndOfInstallation:
+        d->m_data.insert(scDurabilityPolicy, QLatin1String("EndOfInstallation"));
+        break;
+    default:
+        d->m_data.insert(scDurabilityPolicy, QLatin1String("None"));
+        break;
+    }
+}
+
 QString Settings::repositoryCategoryDisplayName() const
 {
     QString displayName = d->m_data.value(QLatin1String(scRepositoryCategoryDisplayName)).toString();
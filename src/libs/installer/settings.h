@@ -64,6 +64,13 @@ public:
         StrictParseMode,
         RelaxedParseMode
     };
+
+    enum DurabilityPolicy {
+        NoSync,
+        SyncPerFile,
+        SyncPerComponent,
+        SyncAtEndOfInstallation
+    };
     explicit Settings();
     ~Settings();
 
@@ -174,6 +181,18 @@ public:
     bool saveDefaultRepositories() const;
     void setSaveDefaultRepositories(bool save);
 
+    bool deduplicateFiles() const;
+    void setDeduplicateFiles(bool deduplicate);
+
+    int repositoryTimeout() const;
+    void setRepositoryTimeout(int seconds);
+
+    int extractThreads() const;
+    void setExtractThreads(int threads);
+
+    Settings::DurabilityPolicy durabilityPolicy() const;
+    void setDurabilityPolicy(Settings::DurabilityPolicy policy);
+
     QString repositoryCategoryDisplayName() const;
     void setRepositoryCategoryDisplayName(const QString &displayName);
 
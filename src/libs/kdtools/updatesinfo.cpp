@@ -27,10 +27,12 @@
 ****************************************************************************/
 
 #include "updatesinfo_p.h"
+#include "repositoryindex.h"
 #include "utils.h"
 
 #include <QDomDocument>
 #include <QFile>
+#include <QFileInfo>
 #include <QLocale>
 #include <QPair>
 #include <QVector>
@@ -55,6 +57,11 @@ void UpdatesInfoData::setInvalidContentError(const QString &detail)
 
 void UpdatesInfoData::parseFile(const QString &updateXmlFile)
 {
+    // repositories created by newer versions of repogen ship a binary index
+    const QString indexFile = updateXmlFile + QLatin1String(".idx");
+    if (QFileInfo::exists(indexFile) && parseIndex(indexFile, updateXmlFile))
+        return;
+
     QFile file(updateXmlFile);
     if (!file.open(QFile::ReadOnly)) {
         error = UpdatesInfo::CouldNotReadUpdateInfoFileError;
@@ -94,6 +101,75 @@ void UpdatesInfoData::parseFile(const QString &updateXmlFile)
         }
     }
 
+    validateApplication();
+}
+
+bool UpdatesInfoData::parseIndex(const QString &indexFile, const QString &updateXmlFile)
+{
+    // a stale index describes another Updates.xml, read the XML instead
+    QInstaller::RepositoryIndex index(indexFile);
+    if (!index.open() || !index.matchesUpdates(updateXmlFile))
+        return false;
+
+    foreach (const QInstaller::RepositoryIndex::Attribute &attribute, index.repositoryAttributes()) {
+        if (attribute.name == QLatin1String("ApplicationName"))
+            applicationName = attribute.value;
+        else if (attribute.name == QLatin1String("ApplicationVersion"))
+            applicationVersion = attribute.value;
+    }
+
+    for (int i = 0; i < index.packageCount(); ++i) {
+        if (index.flags(i).testFlag(QInstaller::RepositoryIndex::NeedsXml)) {
+            QDomDocument doc;
+            if (!doc.setContent(index.packageXml(i))) {
+                setInvalidContentError(tr("Invalid PackageUpdate element for %1.").arg(index.name(i)));
+                return true;
+            }
+            if (!parsePackageUpdateElement(doc.documentElement()))
+                return true; //error handled in subroutine
+            continue;
+        }
+
+        UpdateInfo info;
+        QMap<QString, QString> localizedDescriptions;
+        info.data[QLatin1String("Name")] = index.name(i);
+        if (index.flags(i).testFlag(QInstaller::RepositoryIndex::HasVersion)) {
+            // like the XML, overridden by the attribute if the Version element has one
+            info.data.insert(QLatin1String("inheritVersionFrom"), QString());
+            info.data[QLatin1String("Version")] = index.version(i);
+        }
+        if (index.flags(i).testFlag(QInstaller::RepositoryIndex::HasSha1))
+            info.data[QLatin1String("SHA1")] = index.sha1(i);
+        if (index.flags(i).testFlag(QInstaller::RepositoryIndex::HasUpdateFile)) {
+            info.data[QLatin1String("CompressedSize")] = QString::number(index.compressedSize(i));
+            info.data[QLatin1String("UncompressedSize")] = QString::number(index.uncompressedSize(i));
+        }
+
+        foreach (const QInstaller::RepositoryIndex::Attribute &attribute, index.attributes(i)) {
+            if (attribute.name == QLatin1String("ReleaseNotes")) {
+                info.data[attribute.name] = QUrl(attribute.value);
+            } else if (attribute.name == QLatin1String("DisplayName")) {
+                processLocalizedTag(attribute.name, attribute.language, attribute.value, info.data);
+            } else if (attribute.name == QLatin1String("Description")) {
+                if (attribute.language.isEmpty())
+                    info.data[attribute.name] = attribute.value;
+                const QString language = attribute.language.isEmpty() ? QLatin1String("en")
+                    : attribute.language;
+                localizedDescriptions.insert(language.toLower(), attribute.value);
+            } else {
+                info.data[attribute.name] = attribute.value;
+            }
+        }
+        if (!addUpdateInfo(info, localizedDescriptions))
+            return true; //error handled in subroutine
+    }
+
+    validateApplication();
+    return true;
+}
+
+void UpdatesInfoData::validateApplication()
+{
     if (applicationName.isEmpty()) {
         setInvalidContentError(tr("ApplicationName element is missing."));
         return;
@@ -162,7 +238,11 @@ bool UpdatesInfoData::parsePackageUpdateElement(const QDomElement &updateE)
             info.data[childE.tagName()] = childE.text();
         }
     }
+    return addUpdateInfo(info, localizedDescriptions);
+}
 
+bool UpdatesInfoData::addUpdateInfo(UpdateInfo &info, const QMap<QString, QString> &localizedDescriptions)
+{
     QStringList candidates;
     foreach (const QString &lang, QLocale().uiLanguages())
         candidates << QInstaller::localeCandidates(lang.toLower());
@@ -192,13 +272,20 @@ bool UpdatesInfoData::parsePackageUpdateElement(const QDomElement &updateE)
 
 void UpdatesInfoData::processLocalizedTag(const QDomElement &childE, QHash<QString, QVariant> &info) const
 {
-    QString languageAttribute = childE.attribute(QLatin1String("xml:lang")).toLower();
-    if (!info.contains(childE.tagName()) && (languageAttribute.isEmpty()))
-        info[childE.tagName()] = childE.text();
+    processLocalizedTag(childE.tagName(), childE.attribute(QLatin1String("xml:lang")), childE.text(),
+        info);
+}
+
+void UpdatesInfoData::processLocalizedTag(const QString &tagName, const QString &language,
+    const QString &text, QHash<QString, QVariant> &info) const
+{
+    QString languageAttribute = language.toLower();
+    if (!info.contains(tagName) && (languageAttribute.isEmpty()))
+        info[tagName] = text;
 
     // overwrite default if we have a language specific description
     if (QLocale().name().startsWith(languageAttribute, Qt::CaseInsensitive))
-        info[childE.tagName()] = childE.text();
+        info[tagName] = text;
 }
 
 QVariant UpdatesInfoData::parseOperations(const QDomNodeList &operationNodes)
@@ -30,6 +30,7 @@
 #define UPDATESINFODATA_P_H
 
 #include <QCoreApplication>
+#include <QMap>
 #include <QSharedData>
 
 QT_FORWARD_DECLARE_CLASS(QDomElement)
@@ -55,12 +56,17 @@ public:
     QList<UpdateInfo> updateInfoList;
 
     void parseFile(const QString &updateXmlFile);
+    bool parseIndex(const QString &indexFile, const QString &updateXmlFile);
     bool parsePackageUpdateElement(const QDomElement &updateE);
 
     void setInvalidContentError(const QString &detail);
 
 private:
+    bool addUpdateInfo(UpdateInfo &info, const QMap<QString, QString> &localizedDescriptions);
+    void validateApplication();
     void processLocalizedTag(const QDomElement &childE, QHash<QString, QVariant> &info) const;
+    void processLocalizedTag(const QString &tagName, const QString &language, const QString &text,
+                             QHash<QString, QVariant> &info) const;
     QVariant parseOperations(const QDomNodeList &operationNodes);
 };
 
@@ -0,0 +1,195 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include <archivechunks.h>
+#include <errors.h>
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QStandardPaths>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_archivechunks : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray randomData(int size, quint32 seed)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = char(seed >> 16);
+        }
+        return data;
+    }
+
+    QList<QByteArray> chunksOf(const QByteArray &data)
+    {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+
+        QList<QByteArray> chunks;
+        QByteArray chunk;
+        ContentChunker chunker(&buffer);
+        while (chunker.next(&chunk))
+            chunks.append(chunk);
+        return chunks;
+    }
+
+    void writeCachedChunk(const QString &name, int size, const QDateTime &lastUsed)
+    {
+        const QString fileName = archiveChunkCacheDirectory() + '/' + name;
+        QDir().mkpath(QFileInfo(fileName).path());
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(QByteArray(size, 'x')), qint64(size));
+        QVERIFY(file.setFileTime(lastUsed, QFileDevice::FileModificationTime));
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void testChunkSizes()
+    {
+        const QByteArray data = randomData(4 * 1024 * 1024, 1);
+        const QList<QByteArray> chunks = chunksOf(data);
+        QVERIFY(chunks.count() > 1);
+
+        QByteArray assembled;
+        for (int i = 0; i < chunks.count(); ++i) {
+            QVERIFY(chunks.at(i).size() <= ContentChunker::MaximumSize);
+            if (i < chunks.count() - 1)
+                QVERIFY(chunks.at(i).size() >= ContentChunker::MinimumSize);
+            assembled.append(chunks.at(i));
+        }
+        QCOMPARE(assembled, data);
+    }
+
+    void testEmptySource()
+    {
+        QVERIFY(chunksOf(QByteArray()).isEmpty());
+    }
+
+    void testChunksAreDeterministic()
+    {
+        const QByteArray data = randomData(1024 * 1024, 2);
+        QCOMPARE(chunksOf(data), chunksOf(data));
+    }
+
+    void testChunksSurviveInsertion()
+    {
+        const QByteArray data = randomData(2 * 1024 * 1024, 3);
+        const QList<QByteArray> original = chunksOf(data);
+        const QList<QByteArray> shifted = chunksOf(QByteArray("inserted bytes") + data);
+
+        // boundaries depend on content only, so all but the leading chunks are shared
+        int shared = 0;
+        foreach (const QByteArray &chunk, shifted) {
+            if (original.contains(chunk))
+                ++shared;
+        }
+        QVERIFY(shared >= original.count() - 2);
+    }
+
+    void testManifest()
+    {
+        QVector<ArchiveChunk> chunks;
+        foreach (const QByteArray &chunk, chunksOf(randomData(512 * 1024, 4))) {
+            ArchiveChunk entry;
+            entry.sha1 = QCryptographicHash::hash(chunk, QCryptographicHash::Sha1).toHex();
+            entry.size = chunk.size();
+            chunks.append(entry);
+        }
+
+        const QVector<ArchiveChunk> read = readChunkManifest(writeChunkManifest(chunks));
+        QCOMPARE(read.count(), chunks.count());
+        for (int i = 0; i < chunks.count(); ++i) {
+            QCOMPARE(read.at(i).sha1, chunks.at(i).sha1);
+            QCOMPARE(read.at(i).size, chunks.at(i).size);
+        }
+        QCOMPARE(archiveChunkPath(chunks.first().sha1),
+            QString::fromLatin1(chunks.first().sha1.left(2) + '/' + chunks.first().sha1));
+    }
+
+    void testInvalidManifest_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+        QTest::newRow("missing header") << QByteArray("da39a3ee5e6b4b0d3255bfef95601890afd80709 10\n");
+        QTest::newRow("invalid size") << QByteArray("IFWChunks 1\n"
+            "da39a3ee5e6b4b0d3255bfef95601890afd80709 ten\n");
+        QTest::newRow("invalid checksum") << QByteArray("IFWChunks 1\nda39 10\n");
+    }
+
+    void testInvalidManifest()
+    {
+        QFETCH(QByteArray, data);
+        QVERIFY_EXCEPTION_THROWN(readChunkManifest(data), Error);
+    }
+
+    void testPruneCache()
+    {
+        const QDir cacheDir(archiveChunkCacheDirectory());
+        QDir(cacheDir).removeRecursively();
+
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+        writeCachedChunk("aa/expired", 10, now.addDays(-40));
+        writeCachedChunk("bb/oldest", 100, now.addDays(-3));
+        writeCachedChunk("cc/older", 100, now.addDays(-2));
+        writeCachedChunk("dd/newest", 100, now.addDays(-1));
+
+        pruneArchiveChunkCache(30, 1000);
+        QVERIFY(!cacheDir.exists("aa/expired"));
+        QVERIFY(cacheDir.exists("bb/oldest"));
+
+        // least recently used chunks go first
+        pruneArchiveChunkCache(30, 200);
+        QVERIFY(!cacheDir.exists("bb/oldest"));
+        QVERIFY(cacheDir.exists("cc/older"));
+        QVERIFY(cacheDir.exists("dd/newest"));
+
+        pruneArchiveChunkCache(30, 0);
+        QVERIFY(!cacheDir.exists("cc/older"));
+        QVERIFY(!cacheDir.exists("dd/newest"));
+
+        QVERIFY(QDir(cacheDir).removeRecursively());
+    }
+};
+
+QTEST_MAIN(tst_archivechunks)
+
+#include "tst_archivechunks.moc"
@@ -91,7 +91,7 @@ private slots:
             << "Lib7z" << "myfile.7z" << (QStringList() << "7z");
 #ifdef IFW_LIBARCHIVE
         QTest::newRow("LibArchive")
-            << "LibArchive" << "myfile.zip" << (QStringList() << "tar.gz" << "tar.bz2" << "tar.xz" << "zip");
+            << "LibArchive" << "myfile.zip" << (QStringList() << "tar.gz" << "tar.bz2" << "tar.xz" << "tar.zst" << "zip");
 #endif
     }
 
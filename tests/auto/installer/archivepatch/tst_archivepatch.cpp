@@ -0,0 +1,175 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include <archivepatch.h>
+#include <errors.h>
+#include <fileutils.h>
+
+#include <QDir>
+#include <QFile>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_archivepatch : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray randomData(int size, quint32 seed)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = char(seed >> 16);
+        }
+        return data;
+    }
+
+    void writeFile(const QString &path, const QByteArray &data)
+    {
+        QVERIFY(QDir().mkpath(QFileInfo(path).absolutePath()));
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    QByteArray readFile(const QString &path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        return file.readAll();
+    }
+
+private slots:
+    void testBinaryDelta_data()
+    {
+        const QByteArray base = randomData(256 * 1024, 1);
+        QByteArray modified = base;
+        modified.replace(1000, 10, "changed");
+        modified.insert(100000, randomData(5000, 2));
+        modified.remove(200000, 3000);
+
+        QTest::addColumn<QByteArray>("base");
+        QTest::addColumn<QByteArray>("target");
+        QTest::newRow("modified") << base << modified;
+        QTest::newRow("same") << base << base;
+        QTest::newRow("empty base") << QByteArray() << base;
+        QTest::newRow("empty target") << base << QByteArray();
+        QTest::newRow("unrelated") << base << randomData(1000, 3);
+    }
+
+    void testBinaryDelta()
+    {
+        QFETCH(QByteArray, base);
+        QFETCH(QByteArray, target);
+
+        const QByteArray delta = createBinaryDelta(base, target);
+        QCOMPARE(applyBinaryDelta(base, delta), target);
+    }
+
+    void testBinaryDeltaIsSmall()
+    {
+        const QByteArray base = randomData(256 * 1024, 1);
+        QByteArray modified = base;
+        modified.replace(1000, 10, "changed");
+        modified.insert(100000, randomData(5000, 2));
+
+        QVERIFY(createBinaryDelta(base, modified).size() < 6000);
+    }
+
+    void testInvalidBinaryDelta()
+    {
+        const QByteArray base = randomData(1024, 1);
+        const QByteArray delta = createBinaryDelta(base, base);
+
+        QVERIFY_EXCEPTION_THROWN(applyBinaryDelta(base, QByteArray("invalid")), Error);
+        QVERIFY_EXCEPTION_THROWN(applyBinaryDelta(base.left(512), delta), Error);
+        QVERIFY_EXCEPTION_THROWN(applyBinaryDelta(base, delta.left(delta.size() - 1)), Error);
+    }
+
+    void testArchivePatch()
+    {
+        const QString workingDir = generateTemporaryFileName() + "/";
+        const QString base = workingDir + "base";
+        const QString target = workingDir + "target";
+        const QString patch = workingDir + "patch";
+        const QString result = workingDir + "result";
+
+        const QByteArray large = randomData(128 * 1024, 4);
+        QByteArray largeModified = large;
+        largeModified.replace(5000, 4, "IFW!");
+
+        writeFile(base + "/same.txt", "unchanged");
+        writeFile(base + "/dir/large.bin", large);
+        writeFile(base + "/removed.txt", "removed");
+        writeFile(target + "/same.txt", "unchanged");
+        writeFile(target + "/dir/large.bin", largeModified);
+        writeFile(target + "/added/new.txt", "added");
+        QVERIFY(QDir().mkpath(target + "/empty"));
+
+        QVERIFY(createArchivePatch(base, target, patch));
+        QVERIFY(QFileInfo::exists(patch + "/diff/dir/large.bin"));
+        QVERIFY(QFileInfo(patch + "/diff/dir/large.bin").size() < 1024);
+        QVERIFY(QFileInfo::exists(patch + "/add/added/new.txt"));
+        QVERIFY(!QFileInfo::exists(patch + "/add/same.txt"));
+
+        applyArchivePatch(patch, base, result);
+        QCOMPARE(readFile(result + "/same.txt"), QByteArray("unchanged"));
+        QCOMPARE(readFile(result + "/dir/large.bin"), largeModified);
+        QCOMPARE(readFile(result + "/added/new.txt"), QByteArray("added"));
+        QVERIFY(QFileInfo(result + "/empty").isDir());
+        QVERIFY(!QFileInfo::exists(result + "/removed.txt"));
+
+        // the patch only applies to the files it was created for
+        writeFile(base + "/same.txt", "modified by the user");
+        QVERIFY_EXCEPTION_THROWN(applyArchivePatch(patch, base, workingDir + "result2"), Error);
+
+        removeDirectory(workingDir, true);
+    }
+
+    void testInvalidArchivePatch()
+    {
+        const QString workingDir = generateTemporaryFileName() + "/";
+        writeFile(workingDir + "patch/manifest", "IFWPatch 1\nadd\t../outside.txt\t"
+            "da39a3ee5e6b4b0d3255bfef95601890afd80709\t644\n");
+        writeFile(workingDir + "outside.txt", QByteArray());
+
+        QVERIFY_EXCEPTION_THROWN(applyArchivePatch(workingDir + "patch", workingDir + "base",
+            workingDir + "result"), Error);
+        QVERIFY(!QFileInfo::exists(workingDir + "result"));
+
+        removeDirectory(workingDir, true);
+    }
+};
+
+QTEST_MAIN(tst_archivepatch)
+
+#include "tst_archivepatch.moc"
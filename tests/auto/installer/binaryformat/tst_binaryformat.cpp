@@ -392,6 +392,39 @@ private slots:
         resource->close();
     }
 
+    void testCopyResourceSegment()
+    {
+        QTemporaryFile source;
+        QInstaller::openForWrite(&source);
+        QInstaller::blockingWrite(&source, QByteArray(scTinySize, '1'));
+        QInstaller::blockingWrite(&source, QByteArray(scLargeSize, '2'));
+        QInstaller::blockingWrite(&source, QByteArray(scTinySize, '3'));
+        source.close();
+
+        Resource resource(source.fileName(), Range<qint64>::fromStartAndLength(scTinySize,
+            scLargeSize));
+        QVERIFY(resource.open());
+
+        // the data gets copied behind buffered, not yet flushed data
+        QTemporaryFile target;
+        QInstaller::openForWrite(&target);
+        QInstaller::blockingWrite(&target, QByteArray("Head."));
+        try {
+            resource.copyData(&target);
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+        QCOMPARE(resource.pos(), scLargeSize);
+        QCOMPARE(target.pos(), qint64(5) + scLargeSize);
+        QInstaller::blockingWrite(&target, QByteArray("Tail."));
+        resource.close();
+        target.close();
+
+        QInstaller::openForRead(&target);
+        QCOMPARE(target.readAll(), QByteArray("Head.") + QByteArray(scLargeSize, '2')
+            + QByteArray("Tail."));
+    }
+
     void cleanupTestCase()
     {
         m_manager.clear();
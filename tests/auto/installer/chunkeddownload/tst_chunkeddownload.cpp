@@ -0,0 +1,197 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "../shared/packagemanager.h"
+
+#include <archivechunks.h>
+#include <lib7z_create.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QStandardPaths>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_chunkeddownload : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray randomData(int size, quint32 seed)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = char(seed >> 16);
+        }
+        return data;
+    }
+
+    void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QDir().mkpath(QFileInfo(fileName).path());
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    QString cachedChunk(const ArchiveChunk &chunk)
+    {
+        return archiveChunkCacheDirectory() + QLatin1Char('/') + archiveChunkPath(chunk.sha1);
+    }
+
+    // Installs component A into a new directory and checks its payload.
+    void install()
+    {
+        const QString targetDir = QInstaller::generateTemporaryFileName();
+        PackageManagerCore *core = PackageManager::getPackageManagerWithInit(targetDir, m_repoDir);
+        QCOMPARE(core->installSelectedComponentsSilently(QStringList() << "A"), PackageManagerCore::Success);
+        QCOMPARE(readFile(targetDir + "/payload.bin"), m_payload);
+        delete core;
+        QVERIFY(QDir(targetDir).removeRecursively());
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+        QStandardPaths::setTestModeEnabled(true);
+        qInstallMessageHandler(silentTestMessageHandler);
+
+        m_workingDir = QInstaller::generateTemporaryFileName();
+        m_repoDir = m_workingDir + "/repository";
+        m_archive = m_repoDir + "/A/1.0.0content.7z";
+        m_payload = randomData(2 * 1024 * 1024, 1);
+        writeFile(m_workingDir + "/payload.bin", m_payload);
+        QDir().mkpath(m_repoDir + "/A");
+        Lib7z::createArchive(m_archive, QStringList() << m_workingDir + "/payload.bin",
+            Lib7z::TmpFile::No);
+
+        QFile archive(m_archive);
+        QVERIFY(archive.open(QIODevice::ReadOnly));
+        const QByteArray archiveData = archive.readAll();
+        writeFile(m_archive + ".sha1",
+            QCryptographicHash::hash(archiveData, QCryptographicHash::Sha1).toHex());
+        archive.seek(0);
+
+        ContentChunker chunker(&archive);
+        QByteArray data;
+        while (chunker.next(&data)) {
+            ArchiveChunk chunk;
+            chunk.sha1 = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+            chunk.size = data.size();
+            m_chunks.append(chunk);
+            writeFile(m_repoDir + "/chunks/" + archiveChunkPath(chunk.sha1), data);
+        }
+        QVERIFY(m_chunks.count() > 4);
+        writeFile(m_archive + ".chunks", writeChunkManifest(m_chunks));
+
+        writeFile(m_repoDir + "/Updates.xml", QString::fromLatin1("<Updates>\n"
+            " <ApplicationName>{AnyApplication}</ApplicationName>\n"
+            " <ApplicationVersion>1.0.0</ApplicationVersion>\n"
+            " <Checksum>true</Checksum>\n"
+            " <PackageUpdate>\n"
+            "  <Name>A</Name>\n"
+            "  <DisplayName>A</DisplayName>\n"
+            "  <Version>1.0.0</Version>\n"
+            "  <ReleaseDate>2021-01-01</ReleaseDate>\n"
+            "  <Default>true</Default>\n"
+            "  <UpdateFile OS=\"Any\" CompressedSize=\"%1\" UncompressedSize=\"%2\"/>\n"
+            "  <DownloadableArchives>content.7z</DownloadableArchives>\n"
+            "  <ChunkedArchives>true</ChunkedArchives>\n"
+            " </PackageUpdate>\n"
+            "</Updates>\n").arg(archiveData.size()).arg(m_payload.size()).toLatin1());
+    }
+
+    void init()
+    {
+        QDir(archiveChunkCacheDirectory()).removeRecursively();
+    }
+
+    void testColdCacheDownloadsArchive()
+    {
+        install();
+
+        // the complete archive was downloaded and split into the cache
+        foreach (const ArchiveChunk &chunk, m_chunks)
+            QCOMPARE(QFileInfo(cachedChunk(chunk)).size(), qint64(chunk.size));
+    }
+
+    void testMissingChunksAreDownloaded()
+    {
+        install();
+        QFile::remove(cachedChunk(m_chunks.first()));
+        QFile::remove(cachedChunk(m_chunks.last()));
+
+        // the complete archive must not be needed anymore
+        QVERIFY(QFile::rename(m_archive, m_archive + ".moved"));
+        install();
+        QVERIFY(QFile::rename(m_archive + ".moved", m_archive));
+
+        QCOMPARE(QFileInfo(cachedChunk(m_chunks.first())).size(), qint64(m_chunks.first().size));
+        QCOMPARE(QFileInfo(cachedChunk(m_chunks.last())).size(), qint64(m_chunks.last().size));
+    }
+
+    void testDamagedChunkIsDownloadedAgain()
+    {
+        install();
+        const ArchiveChunk &chunk = m_chunks.at(m_chunks.count() / 2);
+        writeFile(cachedChunk(chunk), QByteArray(chunk.size, 'x'));
+
+        QVERIFY(QFile::rename(m_archive, m_archive + ".moved"));
+        install();
+        QVERIFY(QFile::rename(m_archive + ".moved", m_archive));
+
+        QCOMPARE(QCryptographicHash::hash(readFile(cachedChunk(chunk)), QCryptographicHash::Sha1).toHex(),
+            chunk.sha1);
+    }
+
+    void cleanupTestCase()
+    {
+        QDir(archiveChunkCacheDirectory()).removeRecursively();
+        QVERIFY(QDir(m_workingDir).removeRecursively());
+    }
+
+private:
+    QString m_workingDir;
+    QString m_repoDir;
+    QString m_archive;
+    QByteArray m_payload;
+    QVector<ArchiveChunk> m_chunks;
+};
+
+QTEST_MAIN(tst_chunkeddownload)
+
+#include "tst_chunkeddownload.moc"
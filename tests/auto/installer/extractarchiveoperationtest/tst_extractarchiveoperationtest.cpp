@@ -28,13 +28,23 @@
 
 #include "../shared/packagemanager.h"
 
+#include "archivepatch.h"
 #include "init.h"
+#include "component.h"
+#include "constants.h"
 #include "extractarchiveoperation.h"
+#include "lib7z_create.h"
+#include "utils.h"
 
+#include <QDataStream>
 #include <QDir>
 #include <QObject>
 #include <QTest>
 
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
 using namespace KDUpdater;
 using namespace QInstaller;
 
@@ -60,7 +70,8 @@ private slots:
 
         QCOMPARE(UpdateOperation::Error(op.error()), UpdateOperation::InvalidArguments);
         QCOMPARE(op.errorString(), QString("Invalid arguments in Extract: "
-                                           "0 arguments given, exactly 2 arguments expected."));
+                                           "0 arguments given, 2 or 3 arguments expected in the form: "
+                                           "<archive> <target directory> [number of entries]."));
 
     }
 
@@ -74,6 +85,194 @@ private slots:
         QVERIFY(op.undoOperation());
     }
 
+    void testExtractOperationWithEntryCount()
+    {
+        const QString targetDir = QInstaller::generateTemporaryFileName();
+        QVERIFY(QDir().mkpath(targetDir));
+
+        // the existing file gets backed up while extracting, without reading the archive twice
+        QFile existingFile(targetDir + "/valid");
+        QVERIFY(existingFile.open(QIODevice::WriteOnly));
+        QVERIFY(existingFile.write("existing content") > 0);
+        existingFile.close();
+
+        ExtractArchiveOperation op(nullptr);
+        op.setArguments(QStringList() << ":///data/valid.7z" << targetDir << "1");
+
+        QVERIFY(op.testOperation());
+        QVERIFY(op.performOperation());
+        QCOMPARE(QFileInfo(targetDir + "/valid").size(), 5242880);
+        QVERIFY(op.undoOperation());
+        QVERIFY(!QFileInfo::exists(targetDir + "/valid"));
+
+        QVERIFY(QDir(targetDir).removeRecursively());
+    }
+
+    void testUndoNestedDirectories()
+    {
+        const QString workingDir = QInstaller::generateTemporaryFileName();
+        const QString targetDir = workingDir + "/target";
+        QVERIFY(QDir().mkpath(workingDir + "/source/a/b"));
+        QVERIFY(QDir().mkpath(targetDir));
+
+        // enough files for several batches of several directories
+        for (int i = 0; i < 600; ++i) {
+            const QString subdir = (i % 3 == 0) ? "" : (i % 3 == 1) ? "a/" : "a/b/";
+            QFile file(workingDir + "/source/" + subdir + QString::number(i));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QVERIFY(file.write(QByteArray::number(i)) > 0);
+        }
+        const QString archive = workingDir + "/archive.7z";
+        Lib7z::createArchive(archive, QStringList() << workingDir + "/source", Lib7z::TmpFile::No);
+
+        ExtractArchiveOperation op(nullptr);
+        op.setArguments(QStringList() << archive << targetDir);
+        QVERIFY(op.performOperation());
+        QVERIFY(QFileInfo::exists(targetDir + "/source/a/b/599"));
+
+        QVERIFY(op.undoOperation());
+        QVERIFY(!QFileInfo::exists(targetDir + "/source"));
+
+        QVERIFY(QDir(workingDir).removeRecursively());
+    }
+
+    void testUndoLegacyFileList()
+    {
+        const QString targetDir = QInstaller::generateTemporaryFileName();
+        QVERIFY(QDir().mkpath(targetDir + "/legacy/subdir"));
+        QFile extractedFile(targetDir + "/legacy/subdir/file");
+        QVERIFY(extractedFile.open(QIODevice::WriteOnly));
+        extractedFile.close();
+
+        // file lists written by older versions are a serialized QStringList
+        QFile fileList(targetDir + "/installerResources/data/legacy.txt");
+        QVERIFY(QDir().mkpath(QFileInfo(fileList).absolutePath()));
+        QVERIFY(fileList.open(QIODevice::WriteOnly));
+        QDataStream out(&fileList);
+        out << (QStringList() << "@RELOCATABLE_PATH@/legacy/subdir/file"
+            << "@RELOCATABLE_PATH@/legacy/subdir" << "@RELOCATABLE_PATH@/legacy");
+        fileList.close();
+
+        ExtractArchiveOperation op(nullptr);
+        op.setArguments(QStringList() << ":///data/legacy.7z" << targetDir);
+        op.setValue("files", "@RELOCATABLE_PATH@/installerResources/data/legacy.txt");
+
+        QVERIFY(op.undoOperation());
+        QVERIFY(!QFileInfo::exists(targetDir + "/legacy"));
+        QVERIFY(!fileList.exists());
+
+        QVERIFY(QDir(targetDir).removeRecursively());
+    }
+
+    void testDeduplicateAndUndo()
+    {
+        const QString workingDir = QInstaller::generateTemporaryFileName();
+        const QString targetDir = workingDir + "/target";
+        QVERIFY(QDir().mkpath(workingDir + "/source"));
+        QVERIFY(QDir().mkpath(targetDir));
+
+        // a read-only file of the same content in two archives
+        const QString payload = workingDir + "/source/payload.bin";
+        QFile payloadFile(payload);
+        QVERIFY(payloadFile.open(QIODevice::WriteOnly));
+        QVERIFY(payloadFile.write(QByteArray(64 * 1024, 'x')) > 0);
+        payloadFile.close();
+        const QByteArray hash = QInstaller::calculateHash(payload, QCryptographicHash::Sha1).toHex();
+        QVERIFY(QFile::setPermissions(payload, QFileDevice::ReadOwner | QFileDevice::ReadUser
+            | QFileDevice::ReadGroup | QFileDevice::ReadOther));
+        // relative paths in the layout of installer://<component>/<archive>, which names the file lists
+        QVERIFY(QDir().mkpath(workingDir + "/archives/first"));
+        QVERIFY(QDir().mkpath(workingDir + "/archives/second"));
+        Lib7z::createArchive(workingDir + "/archives/first/1.0.0first.7z", QStringList() << payload,
+            Lib7z::TmpFile::No);
+        Lib7z::createArchive(workingDir + "/archives/second/1.0.0second.7z", QStringList() << payload,
+            Lib7z::TmpFile::No);
+        const QString currentDir = QDir::currentPath();
+        QVERIFY(QDir::setCurrent(workingDir));
+
+        QScopedPointer<PackageManagerCore> core(PackageManager::getPackageManagerWithInit(targetDir));
+        core->settings().setDeduplicateFiles(true);
+        Component *component = new Component(core.data());
+        component->setValue(scName, "D");
+        component->setValue(scVersion, "1.0.0");
+        component->setValue(scEntryHashes, QString::fromLatin1("%1 r first.7z/payload.bin\n"
+            "%1 r second.7z/payload.bin").arg(QString::fromLatin1(hash)));
+        core->appendRootComponent(component);
+
+        ExtractArchiveOperation first(core.data());
+        first.setValue("component", "D");
+        first.setArguments(QStringList() << "archives/first/1.0.0first.7z" << targetDir + "/first");
+        QVERIFY(first.performOperation());
+
+        ExtractArchiveOperation second(core.data());
+        second.setValue("component", "D");
+        second.setArguments(QStringList() << "archives/second/1.0.0second.7z" << targetDir + "/second");
+        QVERIFY(second.performOperation());
+
+        const QString original = targetDir + "/first/payload.bin";
+        const QString duplicate = targetDir + "/second/payload.bin";
+        QCOMPARE(QInstaller::calculateHash(duplicate, QCryptographicHash::Sha1).toHex(), hash);
+#ifdef Q_OS_UNIX
+        struct stat originalStat;
+        struct stat duplicateStat;
+        QCOMPARE(::stat(QFile::encodeName(original).constData(), &originalStat), 0);
+        QCOMPARE(::stat(QFile::encodeName(duplicate).constData(), &duplicateStat), 0);
+        QCOMPARE(duplicateStat.st_ino, originalStat.st_ino);
+#endif
+
+        // removing the link keeps the file it was linked to
+        QVERIFY(second.undoOperation());
+        QVERIFY(!QFileInfo::exists(duplicate));
+        QCOMPARE(QInstaller::calculateHash(original, QCryptographicHash::Sha1).toHex(), hash);
+
+        QVERIFY(first.undoOperation());
+        QVERIFY(!QFileInfo::exists(original));
+
+        QVERIFY(QDir::setCurrent(currentDir));
+        QVERIFY(QFile::setPermissions(payload, QFileDevice::ReadOwner | QFileDevice::WriteOwner));
+        QVERIFY(QDir(workingDir).removeRecursively());
+    }
+
+    void testRetryMovingPatchedFiles()
+    {
+        const QString workingDir = QInstaller::generateTemporaryFileName();
+        const QString patchedDir = workingDir + "/patched";
+        const QString targetDir = workingDir + "/target";
+        QVERIFY(QDir().mkpath(patchedDir + "/sub"));
+        QVERIFY(QDir().mkpath(targetDir));
+        foreach (const QString &fileName, QStringList() << "/a.txt" << "/sub/b.txt") {
+            QFile file(patchedDir + fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QVERIFY(file.write(fileName.toLatin1()) > 0);
+        }
+
+        // a file in place of the directory makes moving the patched files fail
+        QFile blocker(targetDir + "/sub");
+        QVERIFY(blocker.open(QIODevice::WriteOnly));
+        blocker.close();
+
+        const QString archive = "installer://P/1.0.0content.7z";
+        registerPatchedArchive(archive, patchedDir);
+        ExtractArchiveOperation op(nullptr);
+        op.setArguments(QStringList() << archive << targetDir);
+        QVERIFY(!op.performOperation());
+        QVERIFY(!QFileInfo::exists(targetDir + "/a.txt"));
+        QVERIFY(QFileInfo::exists(patchedDir + "/a.txt"));
+
+        QVERIFY(blocker.remove());
+        QVERIFY(op.performOperation());
+        QVERIFY(QFileInfo::exists(targetDir + "/a.txt"));
+        QVERIFY(QFileInfo::exists(targetDir + "/sub/b.txt"));
+        QVERIFY(!QFileInfo::exists(patchedDir));
+        QVERIFY(takePatchedArchive(archive).isEmpty());
+
+        QVERIFY(op.undoOperation());
+        QVERIFY(!QFileInfo::exists(targetDir + "/a.txt"));
+        QVERIFY(!QFileInfo::exists(targetDir + "/sub/b.txt"));
+
+        QVERIFY(QDir(workingDir).removeRecursively());
+    }
+
     void testExtractOperationInvalidFile()
     {
         ExtractArchiveOperation op(nullptr);
@@ -114,6 +313,39 @@ private slots:
         QVERIFY(dir.removeRecursively());
     }
 
+    void testDurabilityPolicy_data()
+    {
+        QTest::addColumn<int>("policy");
+        QTest::newRow("None") << int(Settings::NoSync);
+        QTest::newRow("PerFile") << int(Settings::SyncPerFile);
+        QTest::newRow("PerComponent") << int(Settings::SyncPerComponent);
+        QTest::newRow("EndOfInstallation") << int(Settings::SyncAtEndOfInstallation);
+    }
+
+    void testDurabilityPolicy()
+    {
+        QFETCH(int, policy);
+
+        m_testDirectory = QInstaller::generateTemporaryFileName();
+        QVERIFY(QDir().mkpath(m_testDirectory));
+
+        QScopedPointer<PackageManagerCore> core(PackageManager::getPackageManagerWithInit
+                (m_testDirectory, ":///data/xmloperationrepository"));
+        core->settings().setDurabilityPolicy(Settings::DurabilityPolicy(policy));
+        QCOMPARE(core->installDefaultComponentsSilently(), PackageManagerCore::Success);
+
+        QVERIFY(QFileInfo::exists(m_testDirectory + "/FolderForContent/content.txt"));
+        QVERIFY(QFileInfo::exists(m_testDirectory + "/FolderForDefault/default.txt"));
+
+        // components.xml lists the component once the installation has finished
+        QFile componentsXml(m_testDirectory + "/components.xml");
+        QVERIFY(componentsXml.open(QIODevice::ReadOnly));
+        QVERIFY(componentsXml.readAll().contains("<Name>A</Name>"));
+        componentsXml.close();
+
+        QVERIFY(QDir(m_testDirectory).removeRecursively());
+    }
+
 private:
     QString m_testDirectory;
 };
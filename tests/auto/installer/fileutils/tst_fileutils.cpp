@@ -33,6 +33,12 @@
 #include <QTest>
 #include <QFile>
 #include <QDir>
+#include <QDateTime>
+#include <QFileInfo>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
 
 using namespace QInstaller;
 
@@ -128,6 +134,124 @@ private slots:
         QVERIFY(testFile.remove());
 #endif
     }
+
+    void testSizeFromString_data()
+    {
+        QTest::addColumn<QString>("size");
+        QTest::addColumn<bool>("valid");
+        QTest::addColumn<quint64>("bytes");
+
+        QTest::newRow("bytes") << "4096" << true << quint64(4096);
+        QTest::newRow("kilobytes") << "64k" << true << quint64(64 * 1024);
+        QTest::newRow("megabytes") << "16M" << true << quint64(16 * 1024 * 1024);
+        QTest::newRow("gigabytes") << " 2g " << true << quint64(2) * 1024 * 1024 * 1024;
+        QTest::newRow("zero") << "0" << true << quint64(0);
+        QTest::newRow("empty") << "" << false << quint64(0);
+        QTest::newRow("negative") << "-1m" << false << quint64(0);
+        QTest::newRow("unknown suffix") << "12t" << false << quint64(0);
+        QTest::newRow("only suffix") << "m" << false << quint64(0);
+        QTest::newRow("overflow") << "18446744073709551615k" << false << quint64(0);
+    }
+
+    void testSizeFromString()
+    {
+        QFETCH(QString, size);
+        QFETCH(bool, valid);
+        QFETCH(quint64, bytes);
+
+        bool ok = !valid;
+        QCOMPARE(sizeFromString(size, &ok), bytes);
+        QCOMPARE(ok, valid);
+    }
+
+    void testLinkFile()
+    {
+        const QString testDir = QInstaller::generateTemporaryFileName();
+        QVERIFY(QDir().mkpath(testDir));
+        const QFlags<QFileDevice::Permission> readOnly(QFileDevice::ReadOwner | QFileDevice::ReadUser
+            | QFileDevice::ReadGroup | QFileDevice::ReadOther);
+
+        const QString source = testDir + "/source";
+        const QString target = testDir + "/target";
+        const QString writableTarget = testDir + "/writable";
+        foreach (const QString &fileName, QStringList() << source << target << writableTarget) {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QVERIFY(file.write("same content") > 0);
+        }
+        QVERIFY(QFile::setPermissions(source, readOnly));
+        QVERIFY(QFile::setPermissions(target, readOnly));
+        const QFlags<QFileDevice::Permission> writable = QFile::permissions(writableTarget);
+
+        QVERIFY(linkFile(source, target));
+        QFile linked(target);
+        QVERIFY(linked.open(QIODevice::ReadOnly));
+        QCOMPARE(linked.readAll(), QByteArray("same content"));
+        linked.close();
+#ifdef Q_OS_UNIX
+        struct stat sourceStat;
+        struct stat targetStat;
+        QCOMPARE(::stat(QFile::encodeName(source).constData(), &sourceStat), 0);
+        QCOMPARE(::stat(QFile::encodeName(target).constData(), &targetStat), 0);
+        QCOMPARE(targetStat.st_ino, sourceStat.st_ino);
+#endif
+        QVERIFY(!QFileInfo::exists(target + ".tmpLink"));
+
+        // a link would make the writable file read-only, so it is left alone
+        QVERIFY(!linkFile(source, writableTarget));
+        QCOMPARE(QFile::permissions(writableTarget), writable);
+
+        QVERIFY(!linkFile(testDir + "/missing", writableTarget));
+        QVERIFY(QFileInfo::exists(writableTarget));
+
+        QVERIFY(QFile::setPermissions(source, writable));
+        QVERIFY(QDir(testDir).removeRecursively());
+    }
+
+    void testCloneFile()
+    {
+        const QString testDir = QInstaller::generateTemporaryFileName();
+        QVERIFY(QDir().mkpath(testDir));
+
+        const QString source = testDir + "/source";
+        const QString target = testDir + "/target";
+        foreach (const QString &fileName, QStringList() << source << target) {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QVERIFY(file.write("same content") > 0);
+        }
+        QVERIFY(QFile::setPermissions(target, QFile::permissions(target) | QFileDevice::ExeOwner
+            | QFileDevice::ExeUser));
+        const QFlags<QFileDevice::Permission> permissions = QFile::permissions(target);
+        const QDateTime lastModified = QFileInfo(target).lastModified();
+
+        // file systems without copy-on-write support leave the target untouched, otherwise
+        // it keeps its own permissions and modification time
+        const bool cloned = cloneFile(source, target);
+        QFile file(target);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), QByteArray("same content"));
+        file.close();
+        QCOMPARE(QFile::permissions(target), permissions);
+        QCOMPARE(QFileInfo(target).lastModified(), lastModified);
+        QVERIFY(!QFileInfo::exists(target + ".tmpClone"));
+
+        if (cloned) {
+            // the clone does not share later changes
+            QFile sourceFile(source);
+            QVERIFY(sourceFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+            QVERIFY(sourceFile.write("changed") > 0);
+            sourceFile.close();
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), QByteArray("same content"));
+            file.close();
+        }
+
+        QVERIFY(!cloneFile(source, testDir + "/missing"));
+        QVERIFY(!QFileInfo::exists(testDir + "/missing"));
+
+        QVERIFY(QDir(testDir).removeRecursively());
+    }
 };
 
 QTEST_MAIN(tst_fileutils)
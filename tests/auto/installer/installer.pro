@@ -12,6 +12,11 @@ SUBDIRS += \
     extractarchiveoperationtest \
     lib7zarchive \
     fileutils \
+    archivechunks \
+    chunkeddownload \
+    archivepatch \
+    patchupdate \
+    sharedmetadata \
     unicodeexecutable \
     scriptengine \
     consumeoutputoperationtest \
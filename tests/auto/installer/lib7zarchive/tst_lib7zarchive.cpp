@@ -26,6 +26,8 @@
 **
 **************************************************************************/
 
+#include <binaryformatenginehandler.h>
+#include <lib7z_extract.h>
 #include <lib7z_facade.h>
 #include <lib7zarchive.h>
 #include <fileutils.h>
@@ -118,6 +120,130 @@ private slots:
         QVERIFY(QFile::remove(filename));
     }
 
+    void testUpdateArchive()
+    {
+        const QString workingDir = generateTemporaryFileName() + "/";
+        const QString filename = workingDir + "archive.7z";
+        QVERIFY(QDir().mkpath(workingDir + "A"));
+        QVERIFY(QDir().mkpath(workingDir + "B"));
+        writeFile(workingDir + "A/old", "Old content of A.");
+        writeFile(workingDir + "B/b", "Content of B.");
+
+        Lib7zArchive target(filename);
+        QVERIFY(target.update(QStringList() << workingDir + "A" << workingDir + "B", QStringList()));
+        QVERIFY(QFile::exists(filename));
+
+        QVERIFY(QFile::remove(workingDir + "A/old"));
+        writeFile(workingDir + "A/new", "New content of A.");
+        QVERIFY(target.update(QStringList() << workingDir + "A", QStringList() << "A" << "C"));
+
+        QVERIFY(target.open(QIODevice::ReadOnly));
+        QStringList files;
+        foreach (const ArchiveEntry &entry, target.list()) {
+            if (!entry.isDirectory)
+                files.append(QDir::fromNativeSeparators(entry.path));
+        }
+        target.close();
+        files.sort();
+        QCOMPARE(files, QStringList() << "A/new" << "B/b");
+
+        removeDirectory(workingDir, true);
+    }
+
+    void testCreateArchiveWithSolidBlocks_data()
+    {
+        QTest::addColumn<quint64>("dictionarySize");
+        QTest::addColumn<quint64>("solidBlockSize");
+        QTest::addColumn<bool>("duplicatesCompressed");
+
+        // the eight files have the same incompressible content, which only compresses if
+        // the copies end up in the same solid block and within the dictionary
+        QTest::newRow("defaults") << quint64(0) << quint64(0) << true;
+        QTest::newRow("solid blocks") << quint64(1024 * 1024) << quint64(64 * 1024) << false;
+        QTest::newRow("small dictionary") << quint64(64 * 1024) << quint64(0) << false;
+    }
+
+    void testCreateArchiveWithSolidBlocks()
+    {
+        QFETCH(quint64, dictionarySize);
+        QFETCH(quint64, solidBlockSize);
+        QFETCH(bool, duplicatesCompressed);
+
+        const QString workingDir = generateTemporaryFileName() + "/";
+        const QString filename = workingDir + "archive.7z";
+        const QString targetDir = workingDir + "target/";
+        QVERIFY(QDir().mkpath(workingDir + "source"));
+        QVERIFY(QDir().mkpath(targetDir));
+
+        const int fileSize = 128 * 1024;
+        const QByteArray data = incompressibleData(fileSize);
+        for (int i = 0; i < 8; ++i)
+            writeFile(workingDir + "source/" + QString::number(i), data);
+
+        Lib7zArchive target(filename);
+        target.setCompressionThreadCount(2);
+        target.setDictionarySize(dictionarySize);
+        target.setSolidBlockSize(solidBlockSize);
+        QVERIFY(target.open(QIODevice::ReadWrite));
+        QVERIFY(target.create(QStringList() << workingDir + "source"));
+        QCOMPARE(target.list().count(), 9);
+        QVERIFY(target.extract(targetDir));
+        target.close();
+
+        if (duplicatesCompressed)
+            QVERIFY(QFileInfo(filename).size() < 2 * fileSize);
+        else
+            QVERIFY(QFileInfo(filename).size() > 6 * fileSize);
+
+        for (int i = 0; i < 8; ++i) {
+            QFile file(targetDir + "source/" + QString::number(i));
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), data);
+        }
+
+        removeDirectory(workingDir, true);
+    }
+
+    void testExtractMultiBlockArchiveFromResource()
+    {
+        const QString workingDir = generateTemporaryFileName() + "/";
+        const QString filename = workingDir + "archive.7z";
+        const QString targetDir = workingDir + "target/";
+        QVERIFY(QDir().mkpath(workingDir + "source"));
+        QVERIFY(QDir().mkpath(targetDir));
+
+        const QByteArray data = incompressibleData(128 * 1024);
+        for (int i = 0; i < 4; ++i)
+            writeFile(workingDir + "source/" + QString::number(i), data);
+
+        Lib7zArchive source(filename);
+        source.setSolidBlockSize(64 * 1024);
+        QVERIFY(source.open(QIODevice::ReadWrite));
+        QVERIFY(source.create(QStringList() << workingDir + "source"));
+        source.close();
+
+        // installer:// resources share one device, so their blocks are extracted serially
+        const QString resourceName = "installer://lib7zarchive/archive.7z";
+        BinaryFormatEngineHandler::instance()->registerResource(resourceName, filename);
+        Lib7z::setExtractThreadCount(4);
+
+        Lib7zArchive target(resourceName);
+        QVERIFY(target.open(QIODevice::ReadOnly));
+        QVERIFY2(target.extract(targetDir), qPrintable(target.errorString()));
+        target.close();
+
+        Lib7z::setExtractThreadCount(0);
+        BinaryFormatEngineHandler::instance()->unregisterResource(resourceName);
+
+        for (int i = 0; i < 4; ++i) {
+            QFile file(targetDir + "source/" + QString::number(i));
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), data);
+        }
+
+        removeDirectory(workingDir, true);
+    }
+
     void testExtractArchive()
     {
         Lib7zArchive source(":///data/valid.7z");
@@ -129,6 +255,25 @@ private slots:
     }
 
 private:
+    QByteArray incompressibleData(int size)
+    {
+        // pseudo-random, but the same in every run
+        QByteArray data(size, Qt::Uninitialized);
+        quint32 seed = 1;
+        for (int i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = char(seed >> 16);
+        }
+        return data;
+    }
+
+    void writeFile(const QString &path, const QByteArray &data)
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
     QString tempSourceFile(const QByteArray &data, const QString &templateName = QString())
     {
         QTemporaryFile source;
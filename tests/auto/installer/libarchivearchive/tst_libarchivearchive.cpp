@@ -30,12 +30,18 @@
 
 #include <libarchivearchive.h>
 #include <fileutils.h>
+#include <utils.h>
 
 #include <QDir>
 #include <QObject>
 #include <QTemporaryFile>
 #include <QTest>
 
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace QInstaller;
 
 class tst_libarchivearchive : public QObject
@@ -106,6 +112,30 @@ private slots:
         QVERIFY(QFile(filename).remove());
     }
 
+    void testCreateArchiveHash_data()
+    {
+        archiveSuffixesTestData();
+    }
+
+    void testCreateArchiveHash()
+    {
+        QFETCH(QString, suffix);
+
+        const QString path1 = tempSourceFile("Source File 1.");
+
+        const QString filename = generateTemporaryFileName() + suffix;
+        LibArchiveArchive target(filename);
+        QVERIFY(target.open(QIODevice::ReadWrite));
+        QVERIFY(target.create(QStringList() << path1));
+        target.close();
+
+        QFile archive(filename);
+        QVERIFY(archive.open(QIODevice::ReadOnly));
+        QCOMPARE(target.archiveHash(), calculateHash(&archive, QCryptographicHash::Sha1));
+        archive.close();
+        QVERIFY(archive.remove());
+    }
+
     void testCreateArchiveWithSpaces_data()
     {
         archiveSuffixesTestData();
@@ -205,6 +235,112 @@ private slots:
         removeDirectory(workingDir, true);
     }
 
+    void testCreateExtractManyFiles_data()
+    {
+        archiveSuffixesTestData();
+    }
+
+    void testCreateExtractManyFiles()
+    {
+        QFETCH(QString, suffix);
+
+        const QString workingDir = generateTemporaryFileName() + "/";
+        const QString sourceDir = workingDir + "source/";
+        const QString archiveName = workingDir + "archive" + suffix;
+        const QString targetName = workingDir + "target/";
+
+        QVERIFY(QDir().mkpath(sourceDir + "subdir"));
+        QVERIFY(QDir().mkpath(targetName));
+
+        // enough files to have them written by the writer pool
+        for (int i = 0; i < 200; ++i) {
+            QFile file(sourceDir + (i % 2 ? "subdir/" : "") + QString::number(i));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QVERIFY(file.write(QByteArray(i * 100, char('a' + i % 26))) == i * 100);
+        }
+#ifdef Q_OS_UNIX
+        // entries that need more than their data written
+        QFile executable(sourceDir + "executable");
+        QVERIFY(executable.open(QIODevice::WriteOnly));
+        QVERIFY(executable.write("#!/bin/sh\n") > 0);
+        executable.close();
+        QVERIFY(executable.setPermissions(executable.permissions() | QFileDevice::ExeOwner
+            | QFileDevice::ExeGroup | QFileDevice::ExeOther));
+        QVERIFY(QFile::link(sourceDir + "subdir/1", sourceDir + "symlink"));
+        QCOMPARE(::link(QFile::encodeName(sourceDir + "2").constData(),
+            QFile::encodeName(sourceDir + "hardlink").constData()), 0);
+#endif
+
+        LibArchiveArchive archive(archiveName);
+        QVERIFY(archive.open(QIODevice::ReadWrite));
+        QVERIFY(archive.create(QStringList() << workingDir + "source"));
+        QVERIFY(archive.extract(targetName));
+        archive.close();
+
+        for (int i = 0; i < 200; ++i) {
+            const QString name = QString::fromLatin1("source/") + (i % 2 ? "subdir/" : "")
+                + QString::number(i);
+            QFile file(targetName + name);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), QByteArray(i * 100, char('a' + i % 26)));
+        }
+#ifdef Q_OS_UNIX
+        const QString extractedDir = targetName + "source/";
+        const QFileInfo extractedExecutable(extractedDir + "executable");
+        QVERIFY(extractedExecutable.exists());
+        QCOMPARE(extractedExecutable.permissions(), executable.permissions());
+
+        QVERIFY(QFileInfo(extractedDir + "symlink").isSymLink());
+        QCOMPARE(QFile::symLinkTarget(extractedDir + "symlink"), sourceDir + "subdir/1");
+
+        QFile hardlink(extractedDir + "hardlink");
+        QVERIFY(hardlink.open(QIODevice::ReadOnly));
+        QCOMPARE(hardlink.readAll(), QByteArray(200, 'c'));
+        if (suffix != QLatin1String(".zip")) { // zip stores a copy instead
+            struct stat original;
+            struct stat linked;
+            QCOMPARE(::stat(QFile::encodeName(extractedDir + "2").constData(), &original), 0);
+            QCOMPARE(::stat(QFile::encodeName(hardlink.fileName()).constData(), &linked), 0);
+            QCOMPARE(linked.st_ino, original.st_ino);
+            QCOMPARE(int(linked.st_nlink), 2);
+        }
+        hardlink.close();
+#endif
+
+        removeDirectory(workingDir, true);
+    }
+
+    void testCreateExtractMultithreadedZstd()
+    {
+        const QString workingDir = generateTemporaryFileName() + "/";
+        const QString archiveName = workingDir + "archive.tar.zst";
+        const QString targetName = workingDir + "target/";
+        QVERIFY(QDir().mkpath(targetName));
+
+        // large enough for zstd to split the input between its workers
+        const QByteArray content = QByteArray(8 * 1024 * 1024, 'z');
+        QFile source(workingDir + "file");
+        QVERIFY(source.open(QIODevice::WriteOnly));
+        QCOMPARE(source.write(content), qint64(content.size()));
+        source.close();
+
+        LibArchiveArchive archive(archiveName);
+        archive.setCompressionLevel(AbstractArchive::Ultra);
+        archive.setCompressionThreadCount(2);
+        QVERIFY(archive.open(QIODevice::ReadWrite));
+        QVERIFY(archive.create(QStringList() << source.fileName()));
+        QVERIFY(QFileInfo(archiveName).size() < content.size());
+
+        QVERIFY(archive.extract(targetName));
+        archive.close();
+        QFile extracted(targetName + "file");
+        QVERIFY(extracted.open(QIODevice::ReadOnly));
+        QCOMPARE(extracted.readAll(), content);
+        extracted.close();
+
+        removeDirectory(workingDir, true);
+    }
+
 private:
     void archiveFilenamesTestData()
     {
@@ -213,6 +349,7 @@ private:
         QTest::newRow("gzip compressed tar archive") << ":///data/valid.tar.gz";
         QTest::newRow("bzip2 compressed tar archive") << ":///data/valid.tar.bz2";
         QTest::newRow("xz compressed tar archive") << ":///data/valid.tar.xz";
+        QTest::newRow("zstd compressed tar archive") << ":///data/valid.tar.zst";
     }
 
     void archiveSuffixesTestData()
@@ -222,6 +359,7 @@ private:
         QTest::newRow("gzip compressed tar archive") << ".tar.gz";
         QTest::newRow("bzip2 compressed tar archive") << ".tar.bz2";
         QTest::newRow("xz compressed tar archive") << ".tar.xz";
+        QTest::newRow("zstd compressed tar archive") << ".tar.zst";
     }
 
     QString tempSourceFile(const QByteArray &data, const QString &templateName = QString())
@@ -36,6 +36,8 @@
 #include <packagemanagercore.h>
 #include <progresscoordinator.h>
 
+#include <QDomDocument>
+#include <QStandardPaths>
 #include <QTest>
 
 using namespace QInstaller;
@@ -44,7 +46,43 @@ class tst_MetaDataJob : public QObject
 {
     Q_OBJECT
 
+private:
+    QDomDocument fetchUpdatesXml(const Repository &repo)
+    {
+        PackageManagerCore core;
+        core.setInstaller();
+        core.settings().setDefaultRepositories(QSet<Repository>() << repo);
+        MetadataJob metadata;
+        metadata.setPackageManagerCore(&core);
+        metadata.start();
+        metadata.waitForFinished();
+
+        // the meta information gets removed together with the job
+        QDomDocument doc;
+        const QList<Metadata> list = metadata.metadata();
+        if (list.count() == 1) {
+            QFile file(list.first().directory + "/Updates.xml");
+            if (file.open(QIODevice::ReadOnly))
+                doc.setContent(&file);
+        }
+        return doc;
+    }
+
+    QStringList packageDescriptions(const QDomDocument &doc)
+    {
+        QStringList descriptions;
+        const QDomNodeList packages = doc.documentElement().elementsByTagName("PackageUpdate");
+        for (int i = 0; i < packages.count(); ++i)
+            descriptions.append(packages.at(i).firstChildElement("Description").text());
+        return descriptions;
+    }
+
 private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
     void testRepository()
     {
         PackageManagerCore core;
@@ -97,6 +135,36 @@ private slots:
         metadata.waitForFinished();
         QCOMPARE(metadata.metadata().count(), 1);
     }
+
+    void testRepositoryUpdatesDelta()
+    {
+        // deltas are only used for remote repositories, serve this one from the resources
+        const Repository repo(QUrl("qrc:///data/repositoryDelta"), false);
+        QInstaller::removeDirectory(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/qt-installer-framework/updates", true);
+
+        // nothing cached yet, the full Updates.xml is fetched and cached
+        QDomDocument doc = fetchUpdatesXml(repo);
+        QCOMPARE(doc.documentElement().firstChildElement("Revision").text(), QString("base"));
+        QCOMPARE(packageDescriptions(doc), QStringList() << "Example component C");
+
+        // the delta against the cached revision changes C and adds A
+        doc = fetchUpdatesXml(repo);
+        QCOMPARE(doc.documentElement().tagName(), QString("Updates"));
+        QCOMPARE(doc.documentElement().firstChildElement("Revision").text(), QString("next"));
+        QCOMPARE(doc.documentElement().elementsByTagName("Revision").count(), 1);
+        QCOMPARE(packageDescriptions(doc), QStringList() << "Changed component C"
+            << "Example component A");
+
+        // the delta published for the merged revision has another base, so the
+        // full Updates.xml is fetched instead of removing C
+        doc = fetchUpdatesXml(repo);
+        QCOMPARE(doc.documentElement().firstChildElement("Revision").text(), QString("base"));
+        QCOMPARE(packageDescriptions(doc), QStringList() << "Example component C");
+
+        QInstaller::removeDirectory(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/qt-installer-framework/updates", true);
+    }
 };
 
 
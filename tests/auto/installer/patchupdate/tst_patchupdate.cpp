@@ -0,0 +1,209 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "../shared/packagemanager.h"
+
+#include <archivepatch.h>
+#include <lib7z_create.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_patchupdate : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray randomData(int size, quint32 seed)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = char(seed >> 16);
+        }
+        return data;
+    }
+
+    void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QVERIFY(QDir().mkpath(QFileInfo(fileName).path()));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    QString packageUpdate(const QString &name, const QString &version, const QString &elements = QString())
+    {
+        return QString::fromLatin1(" <PackageUpdate>\n"
+            "  <Name>%1</Name>\n"
+            "  <DisplayName>%1</DisplayName>\n"
+            "  <Version>%2</Version>\n"
+            "  <ReleaseDate>2021-01-01</ReleaseDate>\n"
+            "  <UpdateFile OS=\"Any\" CompressedSize=\"0\" UncompressedSize=\"0\"/>\n"
+            "  <DownloadableArchives>content.7z</DownloadableArchives>\n"
+            "%3 </PackageUpdate>\n").arg(name, version, elements);
+    }
+
+    void writeUpdatesXml(const QString &repository, const QString &packageUpdates)
+    {
+        writeFile(repository + "/Updates.xml", QString::fromLatin1("<Updates>\n"
+            " <ApplicationName>{AnyApplication}</ApplicationName>\n"
+            " <ApplicationVersion>1.0.0</ApplicationVersion>\n"
+            " <Checksum>false</Checksum>\n%1</Updates>\n").arg(packageUpdates).toLatin1());
+    }
+
+    // Creates a patch from the files in baseDir to the ones in targetDir and returns the
+    // PatchArchives entry describing it.
+    QString writePatch(const QString &baseDir, const QString &targetDir, const QString &patch)
+    {
+        const QString patchDir = m_workingDir + "/patch_" + QFileInfo(patch).fileName();
+        if (!createArchivePatch(baseDir, targetDir, patchDir))
+            return QString();
+        QStringList patchData;
+        foreach (const QFileInfo &fi, QDir(patchDir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot))
+            patchData.append(fi.absoluteFilePath());
+        Lib7z::createArchive(patch, patchData, Lib7z::TmpFile::No);
+
+        QFile file(patch);
+        if (!file.open(QIODevice::ReadOnly))
+            return QString();
+        return QString::fromLatin1("content.7z:%1:%2").arg(QString::fromLatin1(
+            QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1).toHex())).arg(file.size());
+    }
+
+    void setRepository(const QString &repository)
+    {
+        m_core->reset();
+        m_core->cancelMetaInfoJob(); // reset the metadata, so that the new repository is fetched
+
+        QSet<Repository> repoList;
+        repoList.insert(Repository::fromUserInput(repository));
+        m_core->settings().setDefaultRepositories(repoList);
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+        qInstallMessageHandler(silentTestMessageHandler);
+        m_workingDir = QInstaller::generateTemporaryFileName();
+        m_targetDir = m_workingDir + "/target";
+
+        // A.bin changes in a few bytes only, B.bin gets replaced
+        m_data = randomData(256 * 1024, 1);
+        m_updatedData = m_data;
+        m_updatedData.replace(1000, 4, "IFW!");
+        writeFile(m_workingDir + "/A1/A.bin", m_data);
+        writeFile(m_workingDir + "/A1/same.txt", "unchanged");
+        writeFile(m_workingDir + "/A2/A.bin", m_updatedData);
+        writeFile(m_workingDir + "/A2/same.txt", "unchanged");
+        writeFile(m_workingDir + "/A2/sub/added.txt", "added");
+        writeFile(m_workingDir + "/B1/B.txt", "B 1.0.0");
+        writeFile(m_workingDir + "/B2/B.txt", "B 2.0.0");
+
+        const auto createArchive = [this](const QString &archive, const QString &sourceDir) {
+            QVERIFY(QDir().mkpath(QFileInfo(archive).path()));
+            QStringList sources;
+            foreach (const QFileInfo &fi, QDir(sourceDir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot))
+                sources.append(fi.absoluteFilePath());
+            Lib7z::createArchive(archive, sources, Lib7z::TmpFile::No);
+        };
+
+        m_repository = m_workingDir + "/repository";
+        createArchive(m_repository + "/A/1.0.0content.7z", m_workingDir + "/A1");
+        createArchive(m_repository + "/B/1.0.0content.7z", m_workingDir + "/B1");
+        writeUpdatesXml(m_repository, packageUpdate("A", "1.0.0") + packageUpdate("B", "1.0.0"));
+
+        // the complete archive of A is missing, so it can only be updated from the patch
+        m_updateRepository = m_workingDir + "/repositoryUpdate";
+        const QString patchA = writePatch(m_workingDir + "/A1", m_workingDir + "/A2",
+            m_updateRepository + "/A/2.0.0content.7z.patch.7z");
+        QVERIFY(!patchA.isEmpty());
+
+        // the checksum of the patch of B does not match, so the complete archive is downloaded
+        createArchive(m_updateRepository + "/B/2.0.0content.7z", m_workingDir + "/B2");
+        const QString patchB = writePatch(m_workingDir + "/B1", m_workingDir + "/B2",
+            m_updateRepository + "/B/2.0.0content.7z.patch.7z");
+        QVERIFY(!patchB.isEmpty());
+        const QString invalidPatchB = QString::fromLatin1("content.7z:%1:%2").arg(QString(40, '0'),
+            patchB.section(':', 2, 2));
+
+        writeUpdatesXml(m_updateRepository, packageUpdate("A", "2.0.0",
+            "  <PatchBaseVersion>1.0.0</PatchBaseVersion>\n"
+            "  <PatchArchives>" + patchA + "</PatchArchives>\n")
+            + packageUpdate("B", "2.0.0", "  <PatchBaseVersion>1.0.0</PatchBaseVersion>\n"
+            "  <PatchArchives>" + invalidPatchB + "</PatchArchives>\n"));
+
+        m_core = PackageManager::getPackageManagerWithInit(m_targetDir, m_repository);
+    }
+
+    void testUpdateFromPatch()
+    {
+        QCOMPARE(m_core->installSelectedComponentsSilently(QStringList() << "A" << "B"),
+            PackageManagerCore::Success);
+        QCOMPARE(readFile(m_targetDir + "/A.bin"), m_data);
+
+        m_core->commitSessionOperations();
+        m_core->setPackageManager();
+        setRepository(m_updateRepository);
+        QCOMPARE(m_core->updateComponentsSilently(QStringList()), PackageManagerCore::Success);
+
+        QCOMPARE(readFile(m_targetDir + "/A.bin"), m_updatedData);
+        QCOMPARE(readFile(m_targetDir + "/same.txt"), QByteArray("unchanged"));
+        QCOMPARE(readFile(m_targetDir + "/sub/added.txt"), QByteArray("added"));
+        QCOMPARE(readFile(m_targetDir + "/B.txt"), QByteArray("B 2.0.0"));
+    }
+
+    void cleanupTestCase()
+    {
+        delete m_core;
+        QVERIFY(QDir(m_workingDir).removeRecursively());
+    }
+
+private:
+    QString m_workingDir;
+    QString m_targetDir;
+    QString m_repository;
+    QString m_updateRepository;
+    QByteArray m_data;
+    QByteArray m_updatedData;
+    PackageManagerCore *m_core;
+};
+
+QTEST_MAIN(tst_patchupdate)
+
+#include "tst_patchupdate.moc"
@@ -53,6 +53,7 @@ private slots:
     void loadUnexpectedTagConfig();
     void loadConfigWithValidLengthUnits();
     void loadConfigWithInvalidLengthUnits();
+    void loadConfigWithInvalidDurabilityPolicy();
 };
 
 void tst_Settings::loadTutorialConfig()
@@ -126,11 +127,19 @@ void tst_Settings::loadTutorialConfig()
     QCOMPARE(settings.controlScript(), QString());
 
     QCOMPARE(settings.supportsModify(), true);
+    QCOMPARE(settings.durabilityPolicy(), Settings::NoSync);
+    QCOMPARE(settings.deduplicateFiles(), false);
+    QCOMPARE(settings.repositoryTimeout(), 30);
+    QCOMPARE(settings.extractThreads(), 0);
 }
 
 void tst_Settings::loadFullConfig()
 {
     Settings settings = Settings::fromFileAndPrefix(":///data/full_config.xml", ":///data");
+    QCOMPARE(settings.durabilityPolicy(), Settings::SyncAtEndOfInstallation);
+    QCOMPARE(settings.deduplicateFiles(), true);
+    QCOMPARE(settings.repositoryTimeout(), 120);
+    QCOMPARE(settings.extractThreads(), 2);
 }
 
 void tst_Settings::loadEmptyConfig()
@@ -272,6 +281,18 @@ void tst_Settings::loadConfigWithInvalidLengthUnits()
     }
 }
 
+void tst_Settings::loadConfigWithInvalidDurabilityPolicy()
+{
+    try {
+        Settings::fromFileAndPrefix(":///data/durability_policy_invalid.xml", ":///data");
+    } catch (const Error &error) {
+        QCOMPARE(error.message(), QLatin1String("Invalid value \"Always\" for <DurabilityPolicy> tag in "
+            ":///data/durability_policy_invalid.xml."));
+        return;
+    }
+    QFAIL("No exception thrown");
+}
+
 QTEST_MAIN(tst_Settings)
 
 #include "tst_settings.moc"
@@ -0,0 +1,8 @@
+include(../../qttest.pri)
+
+QT += qml
+
+SOURCES += tst_sharedmetadata.cpp
+
+RESOURCES += \
+    ..\shared\config.qrc
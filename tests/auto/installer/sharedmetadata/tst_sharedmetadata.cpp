@@ -0,0 +1,163 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "../shared/packagemanager.h"
+
+#include <lib7z_create.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_sharedmetadata : public QObject
+{
+    Q_OBJECT
+
+private:
+    void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QVERIFY(QDir().mkpath(QFileInfo(fileName).path()));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    QString sha1(const QString &fileName)
+    {
+        return QString::fromLatin1(QCryptographicHash::hash(readFile(fileName),
+            QCryptographicHash::Sha1).toHex());
+    }
+
+    void createArchive(const QString &archive, const QStringList &sources)
+    {
+        QVERIFY(QDir().mkpath(QFileInfo(archive).path()));
+        Lib7z::createArchive(archive, sources, Lib7z::TmpFile::No);
+    }
+
+    // Writes the content archive of name in version to repository, with the meta archive
+    // metaArchive copied next to it, and returns the PackageUpdate element describing both.
+    QString writePackage(const QString &repository, const QString &name, const QString &version,
+        const QString &metaArchive)
+    {
+        const QString sourceDir = m_workingDir + "/content/" + name + version;
+        writeFile(sourceDir + "/" + name + ".txt", QString(name + " " + version).toLatin1());
+        const QString contentArchive = repository + "/" + name + "/" + version + "content.7z";
+        createArchive(contentArchive, QStringList() << sourceDir + "/" + name + ".txt");
+        writeFile(contentArchive + ".sha1", sha1(contentArchive).toLatin1());
+
+        const QString targetMetaArchive = repository + "/" + name + "/" + version + "meta.7z";
+        if (!QFile::copy(metaArchive, targetMetaArchive))
+            return QString();
+
+        return QString::fromLatin1(" <PackageUpdate>\n"
+            "  <Name>%1</Name>\n"
+            "  <DisplayName>%1</DisplayName>\n"
+            "  <Version>%2</Version>\n"
+            "  <ReleaseDate>2021-01-01</ReleaseDate>\n"
+            "  <Script>installscript.qs</Script>\n"
+            "  <UpdateFile OS=\"Any\" CompressedSize=\"0\" UncompressedSize=\"0\"/>\n"
+            "  <DownloadableArchives>content.7z</DownloadableArchives>\n"
+            "  <SHA1>%3</SHA1>\n"
+            " </PackageUpdate>\n").arg(name, version, sha1(targetMetaArchive));
+    }
+
+    void writeUpdatesXml(const QString &repository, const QString &packageUpdates)
+    {
+        writeFile(repository + "/Updates.xml", QString::fromLatin1("<Updates>\n"
+            " <ApplicationName>{AnyApplication}</ApplicationName>\n"
+            " <ApplicationVersion>1.0.0</ApplicationVersion>\n"
+            " <Checksum>true</Checksum>\n%1</Updates>\n").arg(packageUpdates).toLatin1());
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+        qInstallMessageHandler(silentTestMessageHandler);
+        m_workingDir = QInstaller::generateTemporaryFileName();
+        m_targetDir = m_workingDir + "/target";
+    }
+
+    void testInstallWithSharedMetaArchives()
+    {
+        // Both repositories publish the same meta archives, which are fetched and extracted
+        // from only one of them. Each repository provides the newest version of one of the
+        // components, so one is always installed from the repository that shares its meta.
+        QStringList metaArchives;
+        foreach (const QString &name, QStringList() << "A" << "B") {
+            const QString metaDir = m_workingDir + "/meta/" + name;
+            writeFile(metaDir + "/installscript.qs", "function Component()\n{\n}\n");
+            metaArchives.append(m_workingDir + "/meta/" + name + "meta.7z");
+            createArchive(metaArchives.last(), QStringList() << metaDir);
+        }
+
+        const QString repository1 = m_workingDir + "/repository1";
+        const QString repository2 = m_workingDir + "/repository2";
+        const QString packageA1 = writePackage(repository1, "A", "1.0.0", metaArchives.at(0));
+        const QString packageB2 = writePackage(repository1, "B", "2.0.0", metaArchives.at(1));
+        const QString packageA2 = writePackage(repository2, "A", "2.0.0", metaArchives.at(0));
+        const QString packageB1 = writePackage(repository2, "B", "1.0.0", metaArchives.at(1));
+        QVERIFY(!packageA1.isEmpty() && !packageB2.isEmpty());
+        QVERIFY(!packageA2.isEmpty() && !packageB1.isEmpty());
+        writeUpdatesXml(repository1, packageA1 + packageB2);
+        writeUpdatesXml(repository2, packageA2 + packageB1);
+
+        QScopedPointer<PackageManagerCore> core(PackageManager::getPackageManagerWithInit(m_targetDir));
+        QSet<Repository> repositories;
+        repositories.insert(Repository::fromUserInput(repository1));
+        repositories.insert(Repository::fromUserInput(repository2));
+        core->settings().setDefaultRepositories(repositories);
+
+        QCOMPARE(core->installSelectedComponentsSilently(QStringList() << "A" << "B"),
+            PackageManagerCore::Success);
+        QCOMPARE(readFile(m_targetDir + "/A.txt"), QByteArray("A 2.0.0"));
+        QCOMPARE(readFile(m_targetDir + "/B.txt"), QByteArray("B 2.0.0"));
+    }
+
+    void cleanupTestCase()
+    {
+        QVERIFY(QDir(m_workingDir).removeRecursively());
+    }
+
+private:
+    QString m_workingDir;
+    QString m_targetDir;
+};
+
+QTEST_MAIN(tst_sharedmetadata)
+
+#include "tst_sharedmetadata.moc"
@@ -0,0 +1,11 @@
+include(../../qttest.pri)
+
+QT -= gui
+QT += network
+
+INCLUDEPATH += ../../../../tools/repocompare
+
+SOURCES += tst_repocompare.cpp \
+    ../../../../tools/repocompare/repositorymanager.cpp
+
+HEADERS += ../../../../tools/repocompare/repositorymanager.h
@@ -0,0 +1,382 @@
+/**************************************************************************
+**
+** Copyright (C) 2021 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include <repositorymanager.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+static QByteArray packageUpdate(const QString &name, const QString &version, const QString &releaseDate,
+    const QString &updateText, const QString &archives = QString())
+{
+    QString package = QString::fromLatin1("<PackageUpdate><Name>%1</Name><Version>%2</Version>"
+        "<ReleaseDate>%3</ReleaseDate><UpdateText>%4</UpdateText><SHA1>%5</SHA1>")
+        .arg(name, version, releaseDate, updateText, name.toLower() + QLatin1String("1234"));
+    if (!archives.isEmpty())
+        package += QString::fromLatin1("<DownloadableArchives>%1</DownloadableArchives>").arg(archives);
+    package += QLatin1String("</PackageUpdate>");
+    return package.toUtf8();
+}
+
+static QByteArray updatesXml(const QByteArray &packages)
+{
+    return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Updates>\n"
+        "<ApplicationName>{AnyApplication}</ApplicationName>\n"
+        "<ApplicationVersion>1.0.0</ApplicationVersion>\n"
+        "<Checksum>true</Checksum>\n" + packages + "\n</Updates>\n";
+}
+
+class tst_repocompare : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString writeRepository(const QString &name, const QByteArray &updates)
+    {
+        const QString fileName = m_dir->path() + QLatin1Char('/') + name + QLatin1String("/Updates.xml");
+        QDir().mkpath(QFileInfo(fileName).absolutePath());
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(updates) != updates.size())
+            qFatal("Cannot write %s", qPrintable(fileName));
+        return fileName;
+    }
+
+    void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QDir().mkpath(QFileInfo(fileName).absolutePath());
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    void compareRepositories(RepositoryManager *manager, const QString &production, const QString &update)
+    {
+        QSignalSpy compared(manager, &RepositoryManager::repositoriesCompared);
+        QSignalSpy errors(manager, &RepositoryManager::error);
+        manager->setProductionRepository(QUrl::fromLocalFile(production).toString());
+        manager->setUpdateRepository(QUrl::fromLocalFile(update).toString());
+        QTRY_COMPARE(compared.count() + errors.count(), 1);
+        QCOMPARE(errors.count(), 0);
+    }
+
+    void writeReport(RepositoryManager *manager, int expectedErrorCount, QJsonObject *report)
+    {
+        const QString reportFile = m_dir->path() + QLatin1String("/report.json");
+        int errorCount = -1;
+        QVERIFY(manager->writeReport(reportFile, &errorCount));
+        // repocompare -r exits with 1 if the error count is not zero
+        QCOMPARE(errorCount, expectedErrorCount);
+
+        QFile file(reportFile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QVERIFY(document.isObject());
+        *report = document.object();
+    }
+
+    QHash<QString, QJsonObject> reportComponents(const QJsonObject &report)
+    {
+        QHash<QString, QJsonObject> components;
+        foreach (const QJsonValue &value, report.value(QLatin1String("components")).toArray()) {
+            const QJsonObject component = value.toObject();
+            components.insert(component.value(QLatin1String("name")).toString(), component);
+        }
+        return components;
+    }
+
+private slots:
+    void init()
+    {
+        m_dir.reset(new QTemporaryDir);
+        QVERIFY(m_dir->isValid());
+    }
+
+    void testParserChunks_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::newRow("single bytes") << 1;
+        QTest::newRow("small chunks") << 5;
+        QTest::newRow("large chunks") << 64;
+        QTest::newRow("whole document") << 0;
+    }
+
+    void testParserChunks()
+    {
+        QFETCH(int, chunkSize);
+
+        const QByteArray data = updatesXml(packageUpdate("A", "1.0.0-1", "2021-03-01",
+            QString::fromUtf8("Gr\xc3\xbc\xc3\x9f" "e aus dem Update"), " content.7z, meta.7z,")
+            + "<PackageUpdate><Name>B</Name><Version>2.0.0</Version>"
+                "<Operations><Operation name=\"Extract\"><Argument>Name</Argument></Operation></Operations>"
+                "</PackageUpdate>"
+            + "<PackageUpdate><Version>3.0.0</Version></PackageUpdate>");
+        if (chunkSize == 0)
+            chunkSize = data.size();
+
+        ComponentHash components;
+        RepositoryParser parser(&components);
+        for (int i = 0; i < data.size(); i += chunkSize)
+            parser.addData(data.mid(i, chunkSize));
+        QString errorString;
+        QVERIFY2(parser.finish(&errorString), qPrintable(errorString));
+
+        // the package without a name is skipped
+        QCOMPARE(components.count(), 2);
+        const ComponentDescription a = components.value("A");
+        QCOMPARE(a.version, QString("1.0.0-1"));
+        QCOMPARE(a.releaseDate, QDate(2021, 3, 1));
+        QCOMPARE(a.updateText, QString::fromUtf8("Gr\xc3\xbc\xc3\x9f" "e aus dem Update"));
+        QCOMPARE(a.checksum, QString("a1234"));
+        QCOMPARE(a.archives, QStringList() << "content.7z" << "meta.7z");
+        QCOMPARE(a.update, false);
+
+        const ComponentDescription b = components.value("B");
+        QCOMPARE(b.version, QString("2.0.0"));
+        QVERIFY(b.archives.isEmpty());
+
+        // the parser can be reused for another document
+        parser.clear();
+        QVERIFY(components.isEmpty());
+        parser.addData(updatesXml(packageUpdate("C", "1.0.0", "2021-03-01", "C")));
+        QVERIFY2(parser.finish(&errorString), qPrintable(errorString));
+        QCOMPARE(components.keys(), QStringList() << "C");
+    }
+
+    void testParserErrors_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+        QTest::addColumn<QStringList>("expectedComponents");
+
+        const QByteArray document = updatesXml(packageUpdate("A", "1.0.0", "2021-03-01", "A")
+            + packageUpdate("B", "1.0.0", "2021-03-01", "B"));
+        QTest::newRow("empty") << QByteArray() << QStringList();
+        QTest::newRow("truncated") << document.left(document.indexOf("<Version>1.0.0</Version><ReleaseDate>2021-03-01"
+            "</ReleaseDate><UpdateText>B")) << (QStringList() << "A");
+        QTest::newRow("mismatched tag") << QByteArray("<Updates><PackageUpdate><Name>A</Version>"
+            "</PackageUpdate></Updates>") << QStringList();
+        QTest::newRow("unescaped character") << QByteArray("<Updates><PackageUpdate><Name>A & B</Name>"
+            "</PackageUpdate></Updates>") << QStringList();
+    }
+
+    void testParserErrors()
+    {
+        QFETCH(QByteArray, data);
+        QFETCH(QStringList, expectedComponents);
+
+        ComponentHash components;
+        RepositoryParser parser(&components);
+        for (int i = 0; i < data.size(); i += 3)
+            parser.addData(data.mid(i, 3));
+        QString errorString;
+        QVERIFY(!parser.finish(&errorString));
+        QVERIFY2(errorString.contains(" at line "), qPrintable(errorString));
+
+        QStringList names = components.keys();
+        names.sort();
+        QCOMPARE(names, expectedComponents);
+    }
+
+    void testReport()
+    {
+        const QString production = writeRepository("production", updatesXml(
+            packageUpdate("A", "1.0.0", "2021-01-01", "A")
+            + packageUpdate("B", "1.0.0", "2021-01-01", "B")
+            + packageUpdate("C", "1.0.0", "2021-01-01", "C")
+            + packageUpdate("D", "2.0.0", "2021-01-01", "D")
+            + packageUpdate("E", "1.0.0", "2021-05-01", "E")
+            + packageUpdate("F", "1.0.0", "2021-01-01", "F")));
+        const QString update = writeRepository("update", updatesXml(
+            packageUpdate("A", "1.1.0", "2021-02-01", "New A")
+            + packageUpdate("B", "1.0.0", "2021-01-01", "B")
+            + packageUpdate("C", "1.1.0", "2021-02-01", "C")
+            + packageUpdate("D", "1.0.0", "2021-02-01", "Old D")
+            + packageUpdate("E", "1.1.0", "2021-04-01", "New E")
+            + packageUpdate("G", "1.0.0", "2021-02-01", "G")));
+
+        RepositoryManager manager;
+        compareRepositories(&manager, production, update);
+
+        QJsonObject report;
+        writeReport(&manager, 1, &report);
+        QCOMPARE(report.value("production").toString(), QUrl::fromLocalFile(production).toString());
+        QCOMPARE(report.value("update").toString(), QUrl::fromLocalFile(update).toString());
+
+        QJsonObject expectedSummary;
+        expectedSummary.insert("updated", 2);
+        expectedSummary.insert("unchanged", 1);
+        expectedSummary.insert("outdated", 1);
+        expectedSummary.insert("error", 1);
+        expectedSummary.insert("removed", 1);
+        expectedSummary.insert("new", 1);
+        QCOMPARE(report.value("summary").toObject(), expectedSummary);
+
+        // components are sorted by name
+        QStringList names;
+        foreach (const QJsonValue &value, report.value("components").toArray())
+            names.append(value.toObject().value("name").toString());
+        QCOMPARE(names, QStringList() << "A" << "B" << "C" << "D" << "E" << "F" << "G");
+
+        const QHash<QString, QJsonObject> components = reportComponents(report);
+        QJsonObject a;
+        a.insert("name", "A");
+        a.insert("productionVersion", "1.0.0");
+        a.insert("updateVersion", "1.1.0");
+        a.insert("releaseDate", "2021-02-01");
+        a.insert("status", "updated");
+        QCOMPARE(components.value("A"), a);
+
+        QCOMPARE(components.value("B").value("status").toString(), QString("unchanged"));
+        QVERIFY(!components.value("B").contains("message"));
+
+        QCOMPARE(components.value("C").value("status").toString(), QString("updated"));
+        QVERIFY(components.value("C").value("message").toString().startsWith("Warning: Component C has no new update text"));
+
+        QCOMPARE(components.value("D").value("status").toString(), QString("outdated"));
+
+        QCOMPARE(components.value("E").value("status").toString(), QString("error"));
+        QVERIFY(components.value("E").value("message").toString().startsWith("Error: Component E has wrong release date"));
+
+        QJsonObject f;
+        f.insert("name", "F");
+        f.insert("productionVersion", "1.0.0");
+        f.insert("status", "removed");
+        QCOMPARE(components.value("F"), f);
+
+        QCOMPARE(components.value("G").value("status").toString(), QString("new"));
+        QVERIFY(!components.value("G").contains("productionVersion"));
+        QCOMPARE(components.value("G").value("updateVersion").toString(), QString("1.0.0"));
+    }
+
+    void testReportWithVerifiedArchives()
+    {
+        const QString production = writeRepository("production", updatesXml(
+            packageUpdate("A", "1.0.0", "2021-01-01", "A", "content.7z")
+            + packageUpdate("B", "1.0.0", "2021-01-01", "B", "content.7z")
+            + packageUpdate("C", "1.0.0", "2021-01-01", "C", "content.7z")));
+        const QString update = writeRepository("update", updatesXml(
+            packageUpdate("A", "1.1.0", "2021-02-01", "New A", "content.7z,data.7z,nochecksum.7z,missing.7z")
+            + packageUpdate("B", "1.0.0", "2021-01-01", "B", "content.7z")
+            + packageUpdate("C", "1.1.0", "2021-02-01", "New C", "content.7z")));
+
+        const QString updateDir = QFileInfo(update).absolutePath();
+        const QByteArray content("content");
+        writeFile(updateDir + "/A/1.1.0content.7z", content);
+        writeFile(updateDir + "/A/1.1.0content.7z.sha1",
+            QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex().toUpper() + '\n');
+        writeFile(updateDir + "/A/1.1.0data.7z", "data");
+        writeFile(updateDir + "/A/1.1.0data.7z.sha1",
+            QCryptographicHash::hash("other data", QCryptographicHash::Sha1).toHex());
+        writeFile(updateDir + "/A/1.1.0nochecksum.7z", "data");
+        writeFile(updateDir + "/C/1.1.0content.7z", content);
+        writeFile(updateDir + "/C/1.1.0content.7z.sha1",
+            QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex());
+
+        RepositoryManager manager;
+        compareRepositories(&manager, production, update);
+
+        QSignalSpy verified(&manager, &RepositoryManager::archivesVerified);
+        manager.verifyArchives();
+        QTRY_COMPARE(verified.count(), 1);
+
+        QJsonObject report;
+        writeReport(&manager, 1, &report);
+        const QHash<QString, QJsonObject> components = reportComponents(report);
+        QCOMPARE(components.count(), 3);
+
+        const QJsonObject a = components.value("A");
+        QCOMPARE(a.value("status").toString(), QString("error"));
+        const QJsonObject archives = a.value("archives").toObject();
+        QCOMPARE(archives.keys(), QStringList() << "content.7z" << "data.7z" << "missing.7z"
+            << "nochecksum.7z");
+        QCOMPARE(archives.value("content.7z").toString(), QString("ok"));
+        QVERIFY(archives.value("data.7z").toString().startsWith("Checksum mismatch"));
+        QVERIFY(archives.value("nochecksum.7z").toString().startsWith("Cannot download checksum"));
+        QVERIFY(archives.value("missing.7z").toString().startsWith("Cannot download archive"));
+
+        // unchanged components are not verified
+        QCOMPARE(components.value("B").value("status").toString(), QString("unchanged"));
+        QVERIFY(!components.value("B").contains("archives"));
+
+        QCOMPARE(components.value("C").value("status").toString(), QString("updated"));
+        QCOMPARE(components.value("C").value("archives").toObject().value("content.7z").toString(),
+            QString("ok"));
+    }
+
+    void testReportWithoutErrors()
+    {
+        const QString production = writeRepository("production", updatesXml(
+            packageUpdate("A", "1.0.0", "2021-01-01", "A")));
+        const QString update = writeRepository("update", updatesXml(
+            packageUpdate("A", "1.1.0", "2021-02-01", "New A")));
+
+        RepositoryManager manager;
+        compareRepositories(&manager, production, update);
+        QJsonObject report;
+        writeReport(&manager, 0, &report);
+        QCOMPARE(report.value("summary").toObject().value("updated").toInt(), 1);
+    }
+
+    void testBrokenRepository()
+    {
+        const QByteArray document = updatesXml(packageUpdate("A", "1.0.0", "2021-01-01", "A"));
+        const QString production = writeRepository("production", document);
+        const QString update = writeRepository("update", document.left(document.size() / 2));
+
+        RepositoryManager manager;
+        QSignalSpy compared(&manager, &RepositoryManager::repositoriesCompared);
+        QSignalSpy errors(&manager, &RepositoryManager::error);
+        manager.setProductionRepository(QUrl::fromLocalFile(production).toString());
+        manager.setUpdateRepository(QUrl::fromLocalFile(update).toString());
+        QTRY_COMPARE(errors.count(), 1);
+        QVERIFY(errors.first().first().toString().startsWith("Cannot read repository"));
+        QCOMPARE(compared.count(), 0);
+
+        manager.setUpdateRepository(QUrl::fromLocalFile(m_dir->path() + "/missing/Updates.xml").toString());
+        QTRY_COMPARE(errors.count(), 2);
+        QVERIFY(errors.last().first().toString().startsWith("Cannot read repository"));
+        QCOMPARE(compared.count(), 0);
+    }
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+QTEST_MAIN(tst_repocompare)
+
+#include "tst_repocompare.moc"
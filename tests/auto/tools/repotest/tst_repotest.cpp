@@ -27,16 +27,39 @@
 **************************************************************************/
 #include "../../installer/shared/verifyinstaller.h"
 
+#include <archivechunks.h>
 #include <repositorygen.h>
 #include <repositorygen.cpp>
 #include <init.h>
 #include <lib7z_facade.h>
 #include <lib7zarchive.h>
+#include <repositoryindex.h>
+#include <updatesinfo_p.h>
 
 #include <QFile>
 #include <QTest>
 #include <QRegularExpression>
 
+static QStringList s_messages;
+
+static void collectMessageHandler(QtMsgType, const QMessageLogContext &, const QString &message)
+{
+    s_messages.append(message);
+}
+
+// Returns pseudo-random data of size bytes, the same in every run. 7z cannot compress it, so
+// only copies of it in the same solid block or patch shrink.
+static QByteArray incompressibleData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    quint32 seed = 1;
+    for (int i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = char(seed >> 16);
+    }
+    return data;
+}
+
 class tst_repotest : public QObject
 {
     Q_OBJECT
@@ -66,6 +89,15 @@ private:
         QInstaller::removeDirectory(tmpMetaDir, true);
     }
 
+    QString repositoryRevision()
+    {
+        QFile file(m_repoInfo.repositoryDir + "/Updates.xml");
+        QDomDocument doc;
+        if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file))
+            return QString();
+        return doc.documentElement().firstChildElement("Revision").text();
+    }
+
     void clearData()
     {
         m_repoInfo.packages.clear();
@@ -108,7 +140,7 @@ private:
         }
 
         VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir, QStringList() << "Updates.xml"
-                                            << matches.at(1));
+                                            << "Updates.xml.idx" << matches.at(1));
         VerifyInstaller::verifyFileContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
                                             "SHA1");
         VerifyInstaller::verifyFileContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
@@ -134,11 +166,34 @@ private:
 
     void verifyComponentMetaUpdatesXml()
     {
-        VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir, QStringList() << "Updates.xml");
+        VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir, QStringList() << "Updates.xml"
+                                            << "Updates.xml.idx");
         VerifyInstaller::verifyFileHasNoContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
                                            "MetadataName");
     }
 
+    void verifyRepositoryIndex(const QString &componentAVersion, const QString &componentBVersion)
+    {
+        RepositoryIndex index(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml.idx");
+        QVERIFY2(index.open(), qPrintable(index.errorString()));
+        QVERIFY2(index.matchesUpdates(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml"),
+            qPrintable(index.errorString()));
+        QCOMPARE(index.packageCount(), 2);
+        QCOMPARE(index.repositoryValue("Checksum"), QLatin1String("true"));
+        QCOMPARE(index.indexOf("C"), -1);
+
+        const int a = index.indexOf("A");
+        QVERIFY(a >= 0);
+        QCOMPARE(index.name(a), QLatin1String("A"));
+        QCOMPARE(index.version(a), componentAVersion);
+        QVERIFY(index.flags(a).testFlag(RepositoryIndex::HasMetadata));
+
+        const int b = index.indexOf("B");
+        QVERIFY(b >= 0);
+        QCOMPARE(index.version(b), componentBVersion);
+        QVERIFY(!index.flags(b).testFlag(RepositoryIndex::HasMetadata));
+    }
+
     void ignoreMessagesForComponentHash(const QStringList &components, bool update)
     {
         QString packageDir = m_repoInfo.packages.first();
@@ -152,7 +207,7 @@ private:
                 message = "Compressing files found in data directory: (\"%1/%2/data/%2.txt\")";
             QTest::ignoreMessage(QtDebugMsg, qPrintable(message.arg(packageDir, component)));
             QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Hash is stored in *"));
-            QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Creating hash of archive *"));
+            QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Using hash of archive .* calculated while writing it"));
             QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Generated sha1 hash: *"));
         }
     }
@@ -264,6 +319,73 @@ private:
         QTest::ignoreMessage(QtDebugMsg, qPrintable(message.arg(m_repoInfo.repositoryDir)));
     }
 
+    // Writes meta/package.xml of component \a name to \a packagesDir, with \a elements added to
+    // the Package element, and returns the data directory of the component.
+    QString writePackage(const QString &packagesDir, const QString &name, const QString &elements = QString(),
+        const QString &version = QLatin1String("1.0.0"))
+    {
+        const QString dataDir = packagesDir + "/" + name + "/data";
+        if (!QDir().mkpath(dataDir) || !QDir().mkpath(packagesDir + "/" + name + "/meta"))
+            return QString();
+        QFile packageXml(packagesDir + "/" + name + "/meta/package.xml");
+        if (!packageXml.open(QIODevice::WriteOnly))
+            return QString();
+        packageXml.write(QString::fromLatin1("<?xml version=\"1.0\"?>\n<Package>\n"
+            "    <DisplayName>%1</DisplayName>\n    <Description>Component %1</Description>\n"
+            "    <Version>%3</Version>\n    <ReleaseDate>2021-01-01</ReleaseDate>\n%2"
+            "</Package>\n").arg(name, elements, version).toUtf8());
+        return dataDir;
+    }
+
+    // Consumes the messages init() expects from the default repository and returns a new,
+    // empty packages directory.
+    QString createPackagesDir()
+    {
+        ignoreMessagesForComponentSha(QStringList() << "A" << "B", false);
+        generateRepo(true, false, false);
+
+        const QString packagesDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(packagesDir);
+        return packagesDir;
+    }
+
+    void writeDataFile(const QString &fileName, const QByteArray &data)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    // Creates a repository from \a packagesDir in a new repository directory. The debug output
+    // depends on the temporary paths, so it is collected in s_messages instead of being checked.
+    void generateRepoFromPackageDir(const QString &packagesDir)
+    {
+        clearData();
+        m_repoInfo.packages << packagesDir;
+        m_repoInfo.repositoryDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(m_repoInfo.repositoryDir);
+
+        s_messages.clear();
+        const QtMessageHandler previousHandler = qInstallMessageHandler(collectMessageHandler);
+        generateRepo(true, false, false);
+        qInstallMessageHandler(previousHandler);
+    }
+
+    // Returns the text of the child element \a element of the PackageUpdate of \a component.
+    QString updatesXmlElement(const QString &component, const QString &element)
+    {
+        QFile file(m_repoInfo.repositoryDir + "/Updates.xml");
+        QDomDocument doc;
+        if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file))
+            return QString();
+        const QDomNodeList packageNodes = doc.documentElement().elementsByTagName("PackageUpdate");
+        for (int i = 0; i < packageNodes.count(); ++i) {
+            if (packageNodes.at(i).firstChildElement("Name").text() == component)
+                return packageNodes.at(i).firstChildElement(element).text();
+        }
+        return QString();
+    }
+
     void verifyComponentShaUpdate(int shaUpdateComponents)
     {
         QString updatesXmlFile(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml");
@@ -305,6 +427,109 @@ private slots:
 
         verifyComponentRepository("1.0.0", "1.0.0", true);
         verifyComponentMetaUpdatesXml();
+        verifyRepositoryIndex("1.0.0", "1.0.0");
+
+        // the top level entries of the archives let the installer extract them in parallel
+        VerifyInstaller::verifyFileContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
+            "<ArchiveRoots>content.7z/A.txt</ArchiveRoots>");
+        VerifyInstaller::verifyFileContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
+            "<ArchiveRoots>content.7z/B.txt</ArchiveRoots>");
+    }
+
+    void testRepositoryIndexOfEditedUpdatesXml()
+    {
+        ignoreMessagesForComponentSha(QStringList () << "A" << "B", false);
+        generateRepo(true, false, false);
+
+        // edit Updates.xml by hand without changing its size
+        const QString updatesXml = m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml";
+        QFile file(updatesXml);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QByteArray content = file.readAll();
+        QVERIFY(content.contains("<Version>1.0.0</Version>"));
+        content.replace("<Version>1.0.0</Version>", "<Version>1.0.1</Version>");
+        QVERIFY(file.seek(0));
+        QCOMPARE(file.write(content), qint64(content.size()));
+        file.close();
+
+        RepositoryIndex index(updatesXml + ".idx");
+        QVERIFY2(index.open(), qPrintable(index.errorString()));
+        QVERIFY(!index.matchesUpdates(updatesXml));
+        index.close();
+
+        // the stale index is ignored, the edited XML is read instead
+        KDUpdater::UpdatesInfo updatesInfo;
+        updatesInfo.setFileName(updatesXml);
+        QVERIFY(updatesInfo.isValid());
+        const QList<KDUpdater::UpdateInfo> updateInfos = updatesInfo.updatesInfo();
+        QCOMPARE(updateInfos.count(), 2);
+        foreach (const KDUpdater::UpdateInfo &info, updateInfos)
+            QCOMPARE(info.data.value("Version").toString(), QString("1.0.1"));
+    }
+
+    void testRepositoryIndexMatchesUpdatesXml()
+    {
+        ignoreMessagesForComponentSha(QStringList() << "A" << "B", false);
+        generateRepo(true, false, false);
+
+        const QByteArray updates("<Updates>\n"
+            " <ApplicationName>{AnyApplication}</ApplicationName>\n"
+            " <ApplicationVersion>1.0.0</ApplicationVersion>\n"
+            " <PackageUpdate><Name>B</Name><Version></Version><ReleaseDate>2021-01-01</ReleaseDate>"
+            "<Default></Default></PackageUpdate>\n"
+            " <PackageUpdate><Name>A</Name><Version inheritVersionFrom=\"B\">1.0.0</Version>"
+            "<ReleaseDate>2021-01-01</ReleaseDate></PackageUpdate>\n"
+            " <PackageUpdate><Name>C</Name><Version>2.0.0</Version><ReleaseDate>2021-01-01</ReleaseDate>"
+            "<DisplayName>C</DisplayName></PackageUpdate>\n"
+            "</Updates>\n");
+        const QString xmlDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        const QString indexDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(xmlDir);
+        m_tempDirDeleter.add(indexDir);
+        foreach (const QString &dir, QStringList() << xmlDir << indexDir) {
+            QVERIFY(QDir().mkpath(dir));
+            QFile file(dir + "/Updates.xml");
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QCOMPARE(file.write(updates), qint64(updates.size()));
+        }
+        RepositoryIndex::write(updates, indexDir + "/Updates.xml.idx");
+
+        RepositoryIndex index(indexDir + "/Updates.xml.idx");
+        QVERIFY2(index.open(), qPrintable(index.errorString()));
+        QVERIFY2(index.matchesUpdates(indexDir + "/Updates.xml"), qPrintable(index.errorString()));
+        // a second check uses the checksum calculated before
+        QVERIFY2(index.matchesUpdates(indexDir + "/Updates.xml"), qPrintable(index.errorString()));
+
+        // the packages keep the order of the Updates.xml
+        QCOMPARE(index.packageCount(), 3);
+        QCOMPARE(index.name(0), QString("B"));
+        QCOMPARE(index.name(1), QString("A"));
+        QCOMPARE(index.name(2), QString("C"));
+        QCOMPARE(index.indexOf("A"), 1);
+        QCOMPARE(index.indexOf("B"), 0);
+        QCOMPARE(index.indexOf("C"), 2);
+        QCOMPARE(index.indexOf("D"), -1);
+        QVERIFY(index.flags(0).testFlag(RepositoryIndex::HasVersion));
+        foreach (const RepositoryIndex::Attribute &attribute, index.attributes(0))
+            QVERIFY(attribute.name != "inheritVersionFrom");
+        index.close();
+
+        // the index resolves to the same packages as the XML
+        KDUpdater::UpdatesInfo fromXml;
+        fromXml.setFileName(xmlDir + "/Updates.xml");
+        QVERIFY(fromXml.isValid());
+        KDUpdater::UpdatesInfo fromIndex;
+        fromIndex.setFileName(indexDir + "/Updates.xml");
+        QVERIFY(fromIndex.isValid());
+
+        const QList<KDUpdater::UpdateInfo> xmlInfos = fromXml.updatesInfo();
+        const QList<KDUpdater::UpdateInfo> indexInfos = fromIndex.updatesInfo();
+        QCOMPARE(indexInfos.count(), 3);
+        QCOMPARE(xmlInfos.count(), indexInfos.count());
+        for (int i = 0; i < xmlInfos.count(); ++i)
+            QCOMPARE(indexInfos.at(i).data, xmlInfos.at(i).data);
+        QCOMPARE(indexInfos.at(0).data.value("Version").toString(), QString());
+        QCOMPARE(indexInfos.at(1).data.value("inheritVersionFrom").toString(), QString("B"));
     }
 
     void testWithComponentAndUniteMeta()
@@ -326,6 +551,208 @@ private slots:
         verifyUniteMetadata("1.0.0");
     }
 
+    void testWithParallelJobs()
+    {
+        m_repoInfo.jobs = 2;
+        ignoreMessagesForComponentSha(QStringList () << "A" << "B", false);
+        generateRepo(true, false, false);
+
+        verifyComponentRepository("1.0.0", "1.0.0", true);
+        verifyComponentMetaUpdatesXml();
+
+        // the components keep their order, regardless of which job finished first
+        QFile file(m_repoInfo.repositoryDir + "/Updates.xml");
+        QDomDocument doc;
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QVERIFY(doc.setContent(&file));
+        const QDomNodeList packageNodes = doc.documentElement().elementsByTagName("PackageUpdate");
+        QCOMPARE(packageNodes.count(), 2);
+        QCOMPARE(packageNodes.at(0).firstChildElement("Name").text(), QString("A"));
+        QCOMPARE(packageNodes.at(1).firstChildElement("Name").text(), QString("B"));
+    }
+
+    void testWithBuildCache()
+    {
+        const QString cacheDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(cacheDir);
+        m_repoInfo.cacheDir = cacheDir;
+        ignoreMessagesForComponentSha(QStringList () << "A" << "B", false);
+        generateRepo(true, false, false);
+        verifyComponentRepository("1.0.0", "1.0.0", true);
+        VerifyInstaller::verifyFileExistence(cacheDir + "/A", QStringList() << "manifest.xml"
+            << "content.7z" << "content.7z.sha1");
+
+        // a second repository from unchanged data reuses the cached archives
+        const QString firstRepositoryDir = m_repoInfo.repositoryDir;
+        m_repoInfo.repositoryDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(m_repoInfo.repositoryDir);
+        QTest::ignoreMessage(QtDebugMsg, "Reusing cached data for component \"A\"");
+        QTest::ignoreMessage(QtDebugMsg, "Reusing cached data for component \"B\"");
+        generateRepo(true, false, false);
+        verifyComponentRepository("1.0.0", "1.0.0", true);
+        QCOMPARE(VerifyInstaller::fileContent(m_repoInfo.repositoryDir + "/A/1.0.0content.7z.sha1"),
+            VerifyInstaller::fileContent(firstRepositoryDir + "/A/1.0.0content.7z.sha1"));
+    }
+
+    void testWithBuildCacheAndNewVersion()
+    {
+        const QString cacheDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(cacheDir);
+        m_repoInfo.cacheDir = cacheDir;
+        ignoreMessagesForComponentSha(QStringList () << "A" << "B", false);
+        generateRepo(true, false, false);
+
+        const QString packagesDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(packagesDir);
+        const QString dataDir = writePackage(packagesDir, "D");
+        QVERIFY(!dataDir.isEmpty());
+        QFile file(dataDir + "/D.txt");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write("unchanged data") > 0);
+        file.close();
+        generateRepoFromPackageDir(packagesDir);
+        QVERIFY(!s_messages.contains("Reusing cached data for component \"D\""));
+        const QString firstRepositoryDir = m_repoInfo.repositoryDir;
+
+        // a nightly build bumps the version without changing the data
+        QVERIFY(!writePackage(packagesDir, "D", QString(), "1.0.1").isEmpty());
+        generateRepoFromPackageDir(packagesDir);
+        QVERIFY(s_messages.contains("Reusing cached data for component \"D\""));
+        VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir + "/D", QStringList()
+            << "1.0.1content.7z" << "1.0.1content.7z.sha1");
+        QVERIFY(!QFileInfo::exists(m_repoInfo.repositoryDir + "/D/1.0.0content.7z"));
+        QCOMPARE(VerifyInstaller::fileContent(m_repoInfo.repositoryDir + "/D/1.0.1content.7z.sha1"),
+            VerifyInstaller::fileContent(firstRepositoryDir + "/D/1.0.0content.7z.sha1"));
+        QCOMPARE(updatesXmlElement("D", "Version"), QString("1.0.1"));
+    }
+
+    void testWithChunks()
+    {
+        m_repoInfo.chunks = true;
+        ignoreMessagesForComponentSha(QStringList () << "A" << "B", false);
+        QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Stored .* chunks of archive .*A/1.0.0content.7z"));
+        QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Stored .* chunks of archive .*B/1.0.0content.7z"));
+        generateRepo(true, false, false);
+        verifyComponentRepository("1.0.0", "1.0.0", true);
+        VerifyInstaller::verifyFileContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
+            "<ChunkedArchives>true</ChunkedArchives>");
+
+        // the archive can be assembled from the stored chunks
+        const QString archive = m_repoInfo.repositoryDir + "/A/1.0.0content.7z";
+        QFile manifest(archive + ".chunks");
+        QVERIFY(manifest.open(QIODevice::ReadOnly));
+        QByteArray assembled;
+        foreach (const ArchiveChunk &chunk, readChunkManifest(manifest.readAll())) {
+            QFile chunkFile(m_repoInfo.repositoryDir + "/chunks/" + archiveChunkPath(chunk.sha1));
+            QVERIFY(chunkFile.open(QIODevice::ReadOnly));
+            QCOMPARE(chunkFile.size(), chunk.size);
+            assembled.append(chunkFile.readAll());
+        }
+        QFile archiveFile(archive);
+        QVERIFY(archiveFile.open(QIODevice::ReadOnly));
+        QCOMPARE(assembled, archiveFile.readAll());
+    }
+
+    void testWithArchiveCompressionSettings()
+    {
+        const QString packagesDir = createPackagesDir();
+        const QString dataDirD = writePackage(packagesDir, "D",
+            "    <ArchiveDictionarySize>1m</ArchiveDictionarySize>\n"
+            "    <ArchiveSolidBlockSize>64k</ArchiveSolidBlockSize>\n");
+        const QString dataDirE = writePackage(packagesDir, "E");
+        QVERIFY(!dataDirD.isEmpty() && !dataDirE.isEmpty());
+
+        // the copies of the incompressible data only compress if they share a solid block
+        const QByteArray data = incompressibleData(128 * 1024);
+        for (int i = 0; i < 8; ++i) {
+            writeDataFile(dataDirD + "/" + QString::number(i), data);
+            writeDataFile(dataDirE + "/" + QString::number(i), data);
+        }
+
+        generateRepoFromPackageDir(packagesDir);
+        foreach (const QInstallerTools::PackageInfo &info, m_packages) {
+            QCOMPARE(info.dictionarySize, info.name == "D" ? quint64(1024 * 1024) : quint64(0));
+            QCOMPARE(info.solidBlockSize, info.name == "D" ? quint64(64 * 1024) : quint64(0));
+        }
+        QVERIFY(QFileInfo(m_repoInfo.repositoryDir + "/D/1.0.0content.7z").size() > 6 * data.size());
+        QVERIFY(QFileInfo(m_repoInfo.repositoryDir + "/E/1.0.0content.7z").size() < 2 * data.size());
+
+        // the settings only concern repogen
+        const QString updatesXml = m_repoInfo.repositoryDir + "/Updates.xml";
+        VerifyInstaller::verifyFileHasNoContent(updatesXml, "ArchiveDictionarySize");
+        VerifyInstaller::verifyFileHasNoContent(updatesXml, "ArchiveSolidBlockSize");
+    }
+
+    void testWithInvalidArchiveCompressionSettings_data()
+    {
+        QTest::addColumn<QString>("elements");
+        QTest::newRow("text") << "    <ArchiveDictionarySize>large</ArchiveDictionarySize>\n";
+        QTest::newRow("negative") << "    <ArchiveSolidBlockSize>-1</ArchiveSolidBlockSize>\n";
+        QTest::newRow("unit") << "    <ArchiveSolidBlockSize>64x</ArchiveSolidBlockSize>\n";
+        QTest::newRow("overflow") << "    <ArchiveDictionarySize>99999999999999999999</ArchiveDictionarySize>\n";
+    }
+
+    void testWithInvalidArchiveCompressionSettings()
+    {
+        QFETCH(QString, elements);
+        const QString packagesDir = createPackagesDir();
+        QVERIFY(!writePackage(packagesDir, "D", elements).isEmpty());
+
+        bool thrown = false;
+        QStringList filteredPackages;
+        const QtMessageHandler previousHandler = qInstallMessageHandler(collectMessageHandler);
+        try {
+            QInstallerTools::createListOfPackages(QStringList() << packagesDir, &filteredPackages,
+                QInstallerTools::Exclude);
+        } catch (const QInstaller::Error &) {
+            thrown = true;
+        }
+        qInstallMessageHandler(previousHandler);
+        QVERIFY(thrown);
+    }
+
+    void testWithEntryHashes()
+    {
+        // the files of the default packages are too small to be worth linking
+        m_repoInfo.recordEntryHashes = true;
+        ignoreMessagesForComponentSha(QStringList() << "A" << "B", false);
+        generateRepo(true, false, false);
+        VerifyInstaller::verifyFileHasNoContent(m_repoInfo.repositoryDir + QDir::separator() + "Updates.xml",
+            "EntryHashes");
+
+        const QString packagesDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(packagesDir);
+        const QByteArray content(64 * 1024, 'x');
+        const QString hash = QString::fromLatin1(QCryptographicHash::hash(content, QCryptographicHash::Sha1)
+            .toHex());
+
+        const QString dataDirD = writePackage(packagesDir, "D");
+        const QString dataDirE = writePackage(packagesDir, "E");
+        QVERIFY(!dataDirD.isEmpty() && !dataDirE.isEmpty());
+        QVERIFY(QDir().mkpath(dataDirE + "/sub"));
+        QFile file(dataDirD + "/readonly.bin");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(content), qint64(content.size()));
+        file.close();
+        QVERIFY(file.setPermissions(QFileDevice::ReadOwner | QFileDevice::ReadUser
+            | QFileDevice::ReadGroup | QFileDevice::ReadOther));
+        file.setFileName(dataDirE + "/sub/writable.bin");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(content), qint64(content.size()));
+        file.close();
+        file.setFileName(dataDirE + "/small.txt");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write("small") > 0);
+        file.close();
+
+        generateRepoFromPackageDir(packagesDir);
+        QCOMPARE(updatesXmlElement("D", "EntryHashes"), hash + " r content.7z/readonly.bin");
+        QCOMPARE(updatesXmlElement("E", "EntryHashes"), hash + " w content.7z/sub/writable.bin");
+
+        QVERIFY(QFile::setPermissions(dataDirD + "/readonly.bin", QFileDevice::ReadOwner
+            | QFileDevice::WriteOwner));
+    }
+
     void testWithComponentShaUpdate()
     {
         ignoreMessagesForComponentSha(QStringList () << "A" << "B", false);
@@ -377,6 +804,130 @@ private slots:
         generateRepo(true, false, false);
         verifyComponentRepository("2.0.0", "1.0.0", true);
         verifyComponentMetaUpdatesXml();
+        verifyRepositoryIndex("2.0.0", "1.0.0");
+    }
+
+    void testUpdateComponentsWithPatches()
+    {
+        ignoreMessagesForComponentSha(QStringList() << "A" << "B", false);
+        generateRepo(true, false, false);
+        verifyComponentRepository("1.0.0", "1.0.0", true);
+
+        // the data of A is replaced by a different file, so the patch is not worth it
+        m_repoInfo.patches = true;
+        initRepoUpdate();
+        ignoreMessagesForUpdateComponents();
+        QTest::ignoreMessage(QtDebugMsg, QRegularExpression("Skipping patch .*A/2.0.0content.7z.patch.7z "
+            "as it is not smaller than the archive"));
+        generateRepo(true, false, false);
+        verifyComponentRepository("2.0.0", "1.0.0", true);
+        verifyComponentMetaUpdatesXml();
+        QVERIFY(!QFileInfo::exists(m_repoInfo.repositoryDir + "/.patchbase"));
+        QVERIFY(!QFileInfo::exists(m_repoInfo.repositoryDir + "/A/2.0.0content.7z.patch.7z"));
+
+        QFile updatesXml(m_repoInfo.repositoryDir + "/Updates.xml");
+        QVERIFY(updatesXml.open(QIODevice::ReadOnly));
+        QVERIFY(!updatesXml.readAll().contains("PatchArchives"));
+    }
+
+    void testUpdateComponentsWithSmallerPatch()
+    {
+        const QString packagesDir = createPackagesDir();
+        const QByteArray data = incompressibleData(256 * 1024);
+        const QString dataDir = writePackage(packagesDir, "D");
+        QVERIFY(!dataDir.isEmpty());
+        writeDataFile(dataDir + "/large.bin", data);
+        writeDataFile(dataDir + "/same.txt", "unchanged");
+        generateRepoFromPackageDir(packagesDir);
+        QVERIFY(updatesXmlElement("D", "PatchArchives").isEmpty());
+
+        // keep the installed files of the first version
+        const QString installedDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(installedDir);
+        extractArchive(m_repoInfo.repositoryDir + "/D/1.0.0content.7z", installedDir);
+
+        // only a few bytes of the large file change
+        QByteArray updatedData = data;
+        updatedData.replace(1000, 4, "IFW!");
+        QVERIFY(!writePackage(packagesDir, "D", QString(), "1.0.1").isEmpty());
+        writeDataFile(dataDir + "/large.bin", updatedData);
+
+        clearData();
+        m_repoInfo.packages << packagesDir;
+        m_repoInfo.patches = true;
+        s_messages.clear();
+        const QtMessageHandler previousHandler = qInstallMessageHandler(collectMessageHandler);
+        generateRepo(true, false, false);
+        qInstallMessageHandler(previousHandler);
+
+        const QString patch = m_repoInfo.repositoryDir + "/D/1.0.1content.7z.patch.7z";
+        VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir + "/D", QStringList()
+            << "1.0.1content.7z" << "1.0.1content.7z.sha1" << "1.0.1content.7z.patch.7z"
+            << "1.0.1content.7z.patch.7z.sha1");
+        QVERIFY(!QFileInfo::exists(m_repoInfo.repositoryDir + "/.patchbase"));
+        QVERIFY(QFileInfo(patch).size() < QFileInfo(m_repoInfo.repositoryDir + "/D/1.0.1content.7z").size());
+
+        QFile file(patch);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QString sha1 = QString::fromLatin1(QCryptographicHash::hash(file.readAll(),
+            QCryptographicHash::Sha1).toHex());
+        file.close();
+        QCOMPARE(VerifyInstaller::fileContent(patch + ".sha1"), sha1);
+        QCOMPARE(updatesXmlElement("D", "PatchBaseVersion"), QString("1.0.0"));
+        QCOMPARE(updatesXmlElement("D", "PatchArchives"), QString::fromLatin1("content.7z:%1:%2")
+            .arg(sha1).arg(QFileInfo(patch).size()));
+
+        // the patch turns the installed files into the ones of the new archive
+        const QString patchDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        const QString resultDir = QInstallerTools::makePathAbsolute(QInstaller::generateTemporaryFileName());
+        m_tempDirDeleter.add(patchDir);
+        m_tempDirDeleter.add(resultDir);
+        extractArchive(patch, patchDir);
+        QInstaller::applyArchivePatch(patchDir, installedDir, resultDir);
+        QCOMPARE(VerifyInstaller::fileContent(resultDir + "/same.txt"), QString("unchanged"));
+        file.setFileName(resultDir + "/large.bin");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), updatedData);
+    }
+
+    void testUpdateComponentsWithDeltaUpdates()
+    {
+        m_repoInfo.deltaRevisions = 2;
+        ignoreMessagesForComponentSha(QStringList() << "A" << "B", false);
+        generateRepo(true, false, false);
+        verifyComponentRepository("1.0.0", "1.0.0", true);
+        const QString baseRevision = repositoryRevision();
+        QVERIFY(!baseRevision.isEmpty());
+        VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir + "/deltas",
+            QStringList() << baseRevision + "_Updates.xml");
+
+        initRepoUpdate();
+        ignoreMessagesForUpdateComponents();
+        generateRepo(true, false, false);
+        verifyComponentRepository("2.0.0", "1.0.0", true);
+        const QString revision = repositoryRevision();
+        QVERIFY(revision != baseRevision);
+        VerifyInstaller::verifyFileExistence(m_repoInfo.repositoryDir + "/deltas",
+            QStringList() << baseRevision + "_Updates.xml" << revision + "_Updates.xml");
+
+        QFile file(m_repoInfo.repositoryDir + "/deltas/" + baseRevision + "_Updates.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QDomDocument delta;
+        QVERIFY(delta.setContent(&file));
+        QStringList packages;
+        const QDomNodeList packageNodes = delta.documentElement().elementsByTagName("PackageUpdate");
+        for (int i = 0; i < packageNodes.count(); ++i)
+            packages.append(packageNodes.at(i).firstChildElement("Name").text());
+        QVERIFY(packages.contains("A"));
+        QCOMPARE(delta.documentElement().firstChildElement("BaseRevision").text(), baseRevision);
+        QCOMPARE(delta.documentElement().firstChildElement("Revision").text(), revision);
+
+        // the delta to the current revision is empty
+        file.close();
+        file.setFileName(m_repoInfo.repositoryDir + "/deltas/" + revision + "_Updates.xml");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QVERIFY(delta.setContent(&file));
+        QCOMPARE(delta.documentElement().elementsByTagName("PackageUpdate").count(), 0);
     }
 
     void testUpdateComponentsFromPartialPackageDir()
@@ -532,6 +1083,12 @@ private slots:
         m_repoInfo.packages.clear();
         m_packages.clear();
         m_repoInfo.repositoryPackages.clear();
+        m_repoInfo.deltaRevisions = 0;
+        m_repoInfo.jobs = 1;
+        m_repoInfo.cacheDir.clear();
+        m_repoInfo.chunks = false;
+        m_repoInfo.patches = false;
+        m_repoInfo.recordEntryHashes = false;
     }
 
 private:
@@ -28,6 +28,7 @@
 
 #include <errors.h>
 #include <archivefactory.h>
+#include <fileutils.h>
 #include <lib7z_facade.h>
 #include <utils.h>
 
@@ -72,9 +73,33 @@ int main(int argc, char *argv[])
                 "Note: some formats do not support all the possible values, "
                 "for example bzip2 compression only supports values from 1 to 9."
             ), QLatin1String("5"), QLatin1String("5"));
+        const QCommandLineOption threads = QCommandLineOption(QStringList()
+            << QLatin1String("t") << QLatin1String("threads"),
+            QCoreApplication::translate("archivegen",
+                "Number of threads used for compressing. Defaults to 0, which lets the "
+                "compression library decide. Currently used by the 7z, tar.xz and tar.zst formats."
+            ), QLatin1String("threads"), QLatin1String("0"));
+        const QCommandLineOption dictionarySize = QCommandLineOption(QStringList()
+            << QLatin1String("d") << QLatin1String("dictionary-size"),
+            QCoreApplication::translate("archivegen",
+                "Dictionary size in bytes, optionally followed by k, m or g. Defaults to 0, "
+                "which uses the size implied by the compression level. Currently used by "
+                "the 7z format."
+            ), QLatin1String("size"), QLatin1String("0"));
+        const QCommandLineOption solidBlockSize = QCommandLineOption(QStringList()
+            << QLatin1String("s") << QLatin1String("solid-block-size"),
+            QCoreApplication::translate("archivegen",
+                "Maximum size of a solid block in bytes, optionally followed by k, m or g. "
+                "Smaller blocks compress slightly worse but can be extracted in parallel. "
+                "Defaults to 0, which uses the size implied by the compression level. "
+                "Currently used by the 7z format."
+            ), QLatin1String("size"), QLatin1String("0"));
 
         parser.addOption(format);
         parser.addOption(compression);
+        parser.addOption(threads);
+        parser.addOption(dictionarySize);
+        parser.addOption(solidBlockSize);
         parser.addPositionalArgument(QLatin1String("archive"),
             QCoreApplication::translate("archivegen", "Compressed archive to create."));
         parser.addPositionalArgument(QLatin1String("sources"),
@@ -106,6 +131,26 @@ int main(int argc, char *argv[])
                 "Unknown compression level \"%1\". See 'archivgen --help'.").arg(value));
         }
 
+        const int threadCount = parser.value(threads).toInt(&ok);
+        if (!ok || threadCount < 0) {
+            throw QInstaller::Error(QCoreApplication::translate("archivegen",
+                "Invalid thread count \"%1\". See 'archivgen --help'.").arg(parser.value(threads)));
+        }
+
+        const quint64 dictionaryBytes = sizeFromString(parser.value(dictionarySize), &ok);
+        if (!ok) {
+            throw QInstaller::Error(QCoreApplication::translate("archivegen",
+                "Invalid dictionary size \"%1\". See 'archivgen --help'.")
+                .arg(parser.value(dictionarySize)));
+        }
+
+        const quint64 solidBlockBytes = sizeFromString(parser.value(solidBlockSize), &ok);
+        if (!ok) {
+            throw QInstaller::Error(QCoreApplication::translate("archivegen",
+                "Invalid solid block size \"%1\". See 'archivgen --help'.")
+                .arg(parser.value(solidBlockSize)));
+        }
+
         Lib7z::initSevenZ();
         QString archiveFilename = args[0];
         // Check if filename already has a supported suffix
@@ -118,6 +163,9 @@ int main(int argc, char *argv[])
                 "object for archive \"%1\": \"%2\".").arg(archiveFilename, QLatin1String(Q_FUNC_INFO)));
         }
         archive->setCompressionLevel(AbstractArchive::CompressionLevel(value));
+        archive->setCompressionThreadCount(threadCount);
+        archive->setDictionarySize(dictionaryBytes);
+        archive->setSolidBlockSize(solidBlockBytes);
         if (archive->open(QIODevice::WriteOnly) && archive->create(args.mid(1)))
             return EXIT_SUCCESS;
 
@@ -31,31 +31,77 @@
 #include "mainwindow.h"
 #include "repositorymanager.h"
 
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "-i") == 0 || qstrcmp(argv[i], "-r") == 0)
+            return true;
+    }
+    return false;
+}
+
+static int runHeadless(QCoreApplication &a)
+{
+    QStringList arguments = a.arguments();
+    const QString program = arguments.takeFirst();
+    const bool report = arguments.removeAll(QLatin1String("-r")) > 0;
+    const bool update = arguments.removeAll(QLatin1String("-i")) > 0;
+    const bool verify = arguments.removeAll(QLatin1String("--verify-archives")) > 0;
+    if (arguments.count() != 3 || report == update || (verify && !report)) {
+        qWarning() << "Usage: " << program << " -i <production Repo> <update Repo> <outputFile>";
+        qWarning() << "       " << program << " -r [--verify-archives] <production Repo> <update Repo> <reportFile>";
+        return -1;
+    }
+    const QString productionRepo = arguments.at(0);
+    const QString updateRepo = arguments.at(1);
+    const QString outputFile = arguments.at(2);
+
+    RepositoryManager manager;
+    bool failed = false;
+    a.connect(&manager, &RepositoryManager::error, [&failed](const QString &message) {
+        qWarning().noquote() << message;
+        failed = true;
+        QCoreApplication::exit(-1);
+    });
+    if (verify) {
+        a.connect(&manager, &RepositoryManager::repositoriesCompared, &manager, &RepositoryManager::verifyArchives);
+        a.connect(&manager, &RepositoryManager::archivesVerified, &a, &QCoreApplication::quit);
+    } else {
+        a.connect(&manager, &RepositoryManager::repositoriesCompared, &a, &QCoreApplication::quit);
+    }
+    // both repositories are downloaded and parsed at the same time
+    manager.setProductionRepository(productionRepo);
+    manager.setUpdateRepository(updateRepo);
+    if (failed)
+        return -1;
+    qDebug() << "Waiting for server reply...";
+    if (a.exec() != 0 || failed)
+        return -1;
+
+    if (report) {
+        int errorCount = 0;
+        qDebug() << "Writing report into " << outputFile;
+        if (!manager.writeReport(outputFile, &errorCount))
+            return -1;
+        qDebug() << "Found" << errorCount << "components with errors";
+        return errorCount > 0 ? 1 : 0;
+    }
+    qDebug() << "Writing into " << outputFile;
+    return manager.writeUpdateFile(outputFile) ? 0 : -1;
+}
+
 int main(int argc, char *argv[])
 {
+    if (isHeadless(argc, argv)) {
+        QCoreApplication a(argc, argv);
+        QCoreApplication::setApplicationName(QLatin1String("IFW_repocompare"));
+        return runHeadless(a);
+    }
+
     QApplication a(argc, argv);
     QCoreApplication::setApplicationName(QLatin1String("IFW_repocompare"));
-    if (a.arguments().contains(QLatin1String("-i"))) {
-        if (a.arguments().count() != 5) {
-            qWarning() << "Usage: " << a.arguments().at(0) << " -i <production Repo> <update Repo> <outputFile>";
-            return -1;
-        }
-        const QString productionRepo = a.arguments().at(2);
-        const QString updateRepo = a.arguments().at(3);
-        const QString outputFile = a.arguments().at(4);
-        RepositoryManager manager;
-        manager.setProductionRepository(productionRepo);
-        manager.setUpdateRepository(updateRepo);
-        a.connect(&manager, &RepositoryManager::repositoriesCompared, &a, &QApplication::quit);
-        qDebug() << "Waiting for server reply...";
-        a.exec();
-        qDebug() << "Writing into " << outputFile;
-        manager.writeUpdateFile(outputFile);
-        return 0;
-    } else {
-        MainWindow w;
-        w.show();
+    MainWindow w;
+    w.show();
 
-        return a.exec();
-    }
+    return a.exec();
 }
@@ -29,7 +29,6 @@
 #include "ui_mainwindow.h"
 #include <QFile>
 #include <QTemporaryFile>
-#include <QMapIterator>
 #include <QTextStream>
 #include <QUrl>
 #include <QXmlStreamReader>
@@ -77,6 +76,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->updateButton, &QAbstractButton::clicked, this, &MainWindow::getUpdateRepository);
     connect(ui->exportButton, &QAbstractButton::clicked, this, &MainWindow::createExportFile);
     connect(&manager, &RepositoryManager::repositoriesCompared, this, &MainWindow::displayRepositories);
+    connect(&manager, &RepositoryManager::error, this, &MainWindow::showError);
 }
 
 MainWindow::~MainWindow()
@@ -105,13 +105,13 @@ void MainWindow::displayRepositories()
 
     // First we put everything into the treeview
     for (int i = 0; i < 2; ++i) {
-        QMap<QString, ComponentDescription>* map;
+        ComponentHash* map;
         if (i == 0)
             map = manager.productionComponents();
         else
             map = manager.updateComponents();
         int indexIncrement = 4*i;
-        for (QMap<QString, ComponentDescription>::iterator it = map->begin(); it != map->end(); ++it) {
+        for (ComponentHash::iterator it = map->begin(); it != map->end(); ++it) {
             QList<QTreeWidgetItem*> list = ui->treeWidget->findItems(it.key(), Qt::MatchExactly);
             QTreeWidgetItem* item;
             if (list.size())
@@ -134,6 +134,7 @@ void MainWindow::displayRepositories()
             }
         }
     }
+    ui->treeWidget->sortItems(0, Qt::AscendingOrder);
 }
 
 void MainWindow::createExportFile()
@@ -143,3 +144,8 @@ void MainWindow::createExportFile()
         return;
     manager.writeUpdateFile(fileName);
 }
+
+void MainWindow::showError(const QString &message)
+{
+    QMessageBox::critical(this, QLatin1String("Error"), message);
+}
@@ -57,10 +57,9 @@ public slots:
     void getProductionRepository();
     void getUpdateRepository();
     void createExportFile();
+    void showError(const QString &message);
 
 private:
-    void createRepositoryMap(const QByteArray &data, QMap<QString, ComponentDescription> &map);
-
     Ui::MainWindow *ui;
     RepositoryManager manager;
 };
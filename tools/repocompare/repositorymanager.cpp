@@ -27,17 +27,26 @@
 **************************************************************************/
 #include "repositorymanager.h"
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
 #include <QStringList>
 #include <QUrl>
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QXmlStreamReader>
-#include <QMessageBox>
+
+#include <algorithm>
 
 namespace {
+// every verification downloads an archive and its checksum, so three of them keep the six
+// connections the network access manager opens per server busy without queuing requests
+const int MaxParallelVerifications = 3;
+
 qreal createVersionNumber(const QString &text)
 {
     QStringList items = text.split(QLatin1Char('.'));
@@ -58,91 +67,185 @@ qreal createVersionNumber(const QString &text)
 }
 }
 
+struct ArchiveVerification
+{
+    ArchiveVerification()
+        : hash(QCryptographicHash::Sha1)
+        , pendingReplies(2)
+    {}
+
+    QString component;
+    QString archive;
+    QUrl url;
+    QCryptographicHash hash;
+    QByteArray expectedChecksum;
+    QString error;
+    int pendingReplies;
+};
+
+RepositoryParser::RepositoryParser(ComponentHash *components)
+    : m_components(components)
+    , m_depth(0)
+{
+}
+
+void RepositoryParser::clear()
+{
+    m_components->clear();
+    m_reader.clear();
+    m_depth = 0;
+    m_text.clear();
+    m_currentItem.clear();
+}
+
+void RepositoryParser::addData(const QByteArray &data)
+{
+    m_reader.addData(data);
+    readTokens();
+}
+
+bool RepositoryParser::finish(QString *errorString)
+{
+    readTokens();
+    if (m_reader.hasError()) {
+        *errorString = QString::fromLatin1("%1 at line %2").arg(m_reader.errorString())
+            .arg(m_reader.lineNumber());
+        return false;
+    }
+    return true;
+}
+
+void RepositoryParser::readTokens()
+{
+    // Stops with a premature end of document error once all data added so far is read, the
+    // reader continues at the same place once more data gets added.
+    while (!m_reader.atEnd()) {
+        const QXmlStreamReader::TokenType type = m_reader.readNext();
+        if (type == QXmlStreamReader::StartElement) {
+            ++m_depth;
+            m_text.clear();
+            if (m_depth == 2 && m_reader.name() == QLatin1String("PackageUpdate")) {
+                // new package
+                m_currentItem.clear();
+                m_currentDescription = ComponentDescription();
+                m_currentDescription.update = false;
+            }
+        } else if (type == QXmlStreamReader::Characters) {
+            m_text += m_reader.text();
+        } else if (type == QXmlStreamReader::EndElement) {
+            const QStringRef name = m_reader.name();
+            if (m_depth == 2 && name == QLatin1String("PackageUpdate")) {
+                if (!m_currentItem.isEmpty())
+                    m_components->insert(m_currentItem, m_currentDescription);
+            } else if (m_depth == 3) {
+                if (name == QLatin1String("SHA1")) {
+                    m_currentDescription.checksum = m_text;
+                } else if (name == QLatin1String("Version")) {
+                    m_currentDescription.version = m_text;
+                } else if (name == QLatin1String("ReleaseDate")) {
+                    m_currentDescription.releaseDate = QDate::fromString(m_text,
+                        QLatin1String("yyyy-MM-dd"));
+                } else if (name == QLatin1String("UpdateText")) {
+                    m_currentDescription.updateText = m_text;
+                } else if (name == QLatin1String("Name")) {
+                    m_currentItem = m_text;
+                } else if (name == QLatin1String("DownloadableArchives")) {
+                    foreach (const QString &archive, m_text.split(QLatin1Char(','), QString::SkipEmptyParts))
+                        m_currentDescription.archives.append(archive.trimmed());
+                }
+            }
+            --m_depth;
+            m_text.clear();
+        }
+    }
+}
+
 RepositoryManager::RepositoryManager(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    productionReply(nullptr),
+    updateReply(nullptr),
+    productionParser(&productionMap),
+    updateParser(&updateMap),
+    productionLoaded(false),
+    updateLoaded(false),
+    runningVerifications(0)
 {
     manager = new QNetworkAccessManager(this);
     connect(manager, &QNetworkAccessManager::finished, this, &RepositoryManager::receiveRepository);
-    productionMap.clear();
-    updateMap.clear();
 }
 
-void RepositoryManager::setProductionRepository(const QString &repo)
+QNetworkReply *RepositoryManager::fetchRepository(const QString &repo, QUrl *url)
 {
-    QUrl url(repo);
-    if (!url.isValid()) {
-        QMessageBox::critical(nullptr, QLatin1String("Error"), QLatin1String("Specified URL is not valid"));
-        return;
+    *url = QUrl::fromUserInput(repo, QDir::currentPath());
+    if (!url->isValid()) {
+        emit error(QString::fromLatin1("Specified URL \"%1\" is not valid").arg(repo));
+        return nullptr;
     }
 
-    QNetworkRequest request(url);
-    productionReply = manager->get(request);
+    // Parse the data as it arrives, both repositories get downloaded at the same time.
+    QNetworkReply *reply = manager->get(QNetworkRequest(*url));
+    connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        if (reply == productionReply)
+            productionParser.addData(reply->readAll());
+        else if (reply == updateReply)
+            updateParser.addData(reply->readAll());
+    });
+    return reply;
 }
 
-void RepositoryManager::setUpdateRepository(const QString &repo)
+void RepositoryManager::setProductionRepository(const QString &repo)
 {
-    QUrl url(repo);
-    if (!url.isValid()) {
-        QMessageBox::critical(nullptr, QLatin1String("Error"), QLatin1String("Specified URL is not valid"));
-        return;
-    }
+    if (productionReply)
+        productionReply->deleteLater();
+    productionParser.clear();
+    productionLoaded = false;
+    productionReply = fetchRepository(repo, &productionUrl);
+}
 
-    QNetworkRequest request(url);
-    updateReply = manager->get(request);
+void RepositoryManager::setUpdateRepository(const QString &repo)
+{
+    if (updateReply)
+        updateReply->deleteLater();
+    updateParser.clear();
+    updateLoaded = false;
+    updateReply = fetchRepository(repo, &updateUrl);
 }
 
 void RepositoryManager::receiveRepository(QNetworkReply *reply)
 {
-    QByteArray data = reply->readAll();
-    if (reply == productionReply) {
-        createRepositoryMap(data, productionMap);
-    } else if (reply == updateReply) {
-        createRepositoryMap(data, updateMap);
+    const bool production = (reply == productionReply);
+    if (!production && reply != updateReply)
+        return; // archive verifications handle their replies themselves
+
+    RepositoryParser &parser = production ? productionParser : updateParser;
+    parser.addData(reply->readAll());
+    QString errorString;
+    if (reply->error() != QNetworkReply::NoError)
+        errorString = reply->errorString();
+    else
+        parser.finish(&errorString);
+
+    if (production) {
+        productionReply = nullptr;
+        productionLoaded = errorString.isEmpty();
+    } else {
+        updateReply = nullptr;
+        updateLoaded = errorString.isEmpty();
     }
     reply->deleteLater();
 
-    if (productionMap.size() && updateMap.size())
-        compareRepositories();
-}
-
-void RepositoryManager::createRepositoryMap(const QByteArray &data, QMap<QString, ComponentDescription> &map)
-{
-    QXmlStreamReader reader(data);
-    QString currentItem;
-    ComponentDescription currentDescription;
-    while (!reader.atEnd()) {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        if (type == QXmlStreamReader::StartElement) {
-            if (reader.name() == QLatin1String("PackageUpdate")) {
-                // new package
-                if (!currentItem.isEmpty())
-                    map.insert(currentItem, currentDescription);
-                currentDescription.updateText.clear();
-                currentDescription.version.clear();
-                currentDescription.checksum.clear();
-                currentDescription.update = false;
-            }
-            if (reader.name() == QLatin1String("SHA1"))
-                currentDescription.checksum = reader.readElementText();
-            else if (reader.name() == QLatin1String("Version"))
-                currentDescription.version = reader.readElementText();
-            else if (reader.name() == QLatin1String("ReleaseDate")) {
-                currentDescription.releaseDate = QDate::fromString(reader.readElementText(),
-                    QLatin1String("yyyy-MM-dd"));
-            } else if (reader.name() == QLatin1String("UpdateText"))
-                currentDescription.updateText = reader.readElementText();
-            else if (reader.name() == QLatin1String("Name"))
-                currentItem = reader.readElementText();
-        }
+    if (!errorString.isEmpty()) {
+        emit error(QString::fromLatin1("Cannot read repository \"%1\": %2")
+            .arg(reply->url().toString(), errorString));
+        return;
     }
-    // Insert the last item
-    if (!currentItem.isEmpty())
-        map.insert(currentItem, currentDescription);
+    if (productionLoaded && updateLoaded)
+        compareRepositories();
 }
 
 void RepositoryManager::compareRepositories()
 {
-    for (QMap<QString, ComponentDescription>::iterator it = updateMap.begin(); it != updateMap.end(); ++it) {
+    for (ComponentHash::iterator it = updateMap.begin(); it != updateMap.end(); ++it) {
         // New item in the update
         if (!productionMap.contains(it.key())) {
             it.value().update = true;
@@ -153,10 +256,102 @@ void RepositoryManager::compareRepositories()
     emit repositoriesCompared();
 }
 
+void RepositoryManager::verifyArchives()
+{
+    QStringList names = updateMap.keys();
+    std::sort(names.begin(), names.end());
+    foreach (const QString &name, names) {
+        ComponentDescription &description = updateMap[name];
+        description.archiveErrors.clear();
+        if (!description.update)
+            continue;
+
+        foreach (const QString &archive, description.archives) {
+            QSharedPointer<ArchiveVerification> verification(new ArchiveVerification);
+            verification->component = name;
+            verification->archive = archive;
+            verification->url = updateUrl.resolved(QUrl(QString::fromLatin1("%1/%2%3")
+                .arg(name, description.version, archive)));
+            pendingVerifications.enqueue(verification);
+        }
+    }
+
+    if (pendingVerifications.isEmpty() && runningVerifications == 0) {
+        emit archivesVerified();
+        return;
+    }
+    startVerifications();
+}
+
+void RepositoryManager::startVerifications()
+{
+    while (runningVerifications < MaxParallelVerifications && !pendingVerifications.isEmpty()) {
+        const QSharedPointer<ArchiveVerification> verification = pendingVerifications.dequeue();
+        ++runningVerifications;
+
+        // The archive gets hashed while it is downloaded, it is never kept as a whole.
+        QNetworkReply *archiveReply = manager->get(QNetworkRequest(verification->url));
+        connect(archiveReply, &QNetworkReply::readyRead, this, [verification, archiveReply]() {
+            verification->hash.addData(archiveReply->readAll());
+        });
+        connect(archiveReply, &QNetworkReply::finished, this, [this, verification, archiveReply]() {
+            verification->hash.addData(archiveReply->readAll());
+            if (archiveReply->error() != QNetworkReply::NoError) {
+                verification->error = QString::fromLatin1("Cannot download archive: %1")
+                    .arg(archiveReply->errorString());
+            }
+            archiveReply->deleteLater();
+            finishVerification(verification);
+        });
+
+        QUrl checksumUrl = verification->url;
+        checksumUrl.setPath(checksumUrl.path() + QLatin1String(".sha1"));
+        QNetworkReply *checksumReply = manager->get(QNetworkRequest(checksumUrl));
+        connect(checksumReply, &QNetworkReply::finished, this, [this, verification, checksumReply]() {
+            if (checksumReply->error() != QNetworkReply::NoError) {
+                if (verification->error.isEmpty()) {
+                    verification->error = QString::fromLatin1("Cannot download checksum: %1")
+                        .arg(checksumReply->errorString());
+                }
+            } else {
+                verification->expectedChecksum = checksumReply->readAll().trimmed().toLower();
+            }
+            checksumReply->deleteLater();
+            finishVerification(verification);
+        });
+    }
+}
+
+void RepositoryManager::finishVerification(const QSharedPointer<ArchiveVerification> &verification)
+{
+    if (--verification->pendingReplies > 0)
+        return;
+
+    QString errorString = verification->error;
+    const QByteArray checksum = verification->hash.result().toHex();
+    if (errorString.isEmpty() && checksum != verification->expectedChecksum) {
+        errorString = QString::fromLatin1("Checksum mismatch, expected %1 but calculated %2")
+            .arg(QString::fromLatin1(verification->expectedChecksum), QString::fromLatin1(checksum));
+    }
+    ComponentHash::iterator it = updateMap.find(verification->component);
+    if (it != updateMap.end())
+        it.value().archiveErrors.insert(verification->archive, errorString);
+
+    --runningVerifications;
+    startVerifications();
+    if (runningVerifications == 0 && pendingVerifications.isEmpty())
+        emit archivesVerified();
+}
+
 bool RepositoryManager::updateRequired(const QString &componentName, QString *message)
 {
-    if (!productionMap.contains(componentName) || !updateMap.contains(componentName))
+    if (!updateMap.contains(componentName))
         qFatal("Accessing non existing component");
+    if (!productionMap.contains(componentName)) {
+        if (message)
+            *message = QLatin1String("New component");
+        return true;
+    }
     const ComponentDescription &productionDescription = productionMap.value(componentName);
     const ComponentDescription &updateDescription = updateMap.value(componentName);
     if (createVersionNumber(productionDescription.version) < createVersionNumber(updateDescription.version)) {
@@ -178,23 +373,109 @@ bool RepositoryManager::updateRequired(const QString &componentName, QString *me
     return false;
 }
 
-void RepositoryManager::writeUpdateFile(const QString &fileName)
+bool RepositoryManager::writeUpdateFile(const QString &fileName)
 {
     QFile file(fileName);
     if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
-        QMessageBox::critical(nullptr, QLatin1String("Error"),
-                              QString::fromLatin1("Cannot open file \"%1\" for writing: %2").arg(
-                                  QDir::toNativeSeparators(fileName), file.errorString()));
-        return;
+        emit error(QString::fromLatin1("Cannot open file \"%1\" for writing: %2").arg(
+            QDir::toNativeSeparators(fileName), file.errorString()));
+        return false;
     }
 
     QStringList items;
-    for (QMap<QString, ComponentDescription>::const_iterator it = updateMap.constBegin();
-         it != updateMap.constEnd(); ++it) {
-            if (it.value().update)
-                items.append(it.key());
+    for (ComponentHash::const_iterator it = updateMap.constBegin(); it != updateMap.constEnd(); ++it) {
+        if (it.value().update)
+            items.append(it.key());
     }
+    std::sort(items.begin(), items.end());
 
     file.write(items.join(QLatin1String(",")).toLatin1());
     file.close();
+    return true;
+}
+
+/*
+    Writes the result of the comparison as JSON document to \a fileName. Every component of
+    both repositories is listed with one of the states new, removed, updated, unchanged,
+    outdated or error, together with the result of the archive verification if it was run.
+    Sets \a errorCount to the number of components with errors.
+*/
+bool RepositoryManager::writeReport(const QString &fileName, int *errorCount)
+{
+    QStringList names = productionMap.keys() + updateMap.keys();
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    int errors = 0;
+    QHash<QString, int> statusCounts;
+    QJsonArray components;
+    foreach (const QString &name, names) {
+        const ComponentHash::const_iterator production = productionMap.constFind(name);
+        const ComponentHash::const_iterator update = updateMap.constFind(name);
+
+        QJsonObject component;
+        component.insert(QLatin1String("name"), name);
+        QString status;
+        QString message;
+        if (update == updateMap.constEnd()) {
+            status = QLatin1String("removed");
+        } else if (production == productionMap.constEnd()) {
+            status = QLatin1String("new");
+        } else if (updateRequired(name, &message)) {
+            status = QLatin1String("updated");
+        } else if (!message.isEmpty()) {
+            status = QLatin1String("error");
+        } else if (production.value().version == update.value().version) {
+            status = QLatin1String("unchanged");
+        } else {
+            status = QLatin1String("outdated");
+        }
+
+        if (production != productionMap.constEnd())
+            component.insert(QLatin1String("productionVersion"), production.value().version);
+        if (update != updateMap.constEnd()) {
+            component.insert(QLatin1String("updateVersion"), update.value().version);
+            component.insert(QLatin1String("releaseDate"), update.value().releaseDate
+                .toString(QLatin1String("yyyy-MM-dd")));
+
+            QJsonObject archives;
+            for (QMap<QString, QString>::const_iterator it = update.value().archiveErrors.constBegin();
+                    it != update.value().archiveErrors.constEnd(); ++it) {
+                archives.insert(it.key(), it.value().isEmpty() ? QLatin1String("ok") : it.value());
+                if (!it.value().isEmpty())
+                    status = QLatin1String("error");
+            }
+            if (!archives.isEmpty())
+                component.insert(QLatin1String("archives"), archives);
+        }
+        if (!message.isEmpty() && message != QLatin1String("Ok"))
+            component.insert(QLatin1String("message"), message);
+        component.insert(QLatin1String("status"), status);
+
+        if (status == QLatin1String("error"))
+            ++errors;
+        ++statusCounts[status];
+        components.append(component);
+    }
+
+    QJsonObject summary;
+    for (QHash<QString, int>::const_iterator it = statusCounts.constBegin(); it != statusCounts.constEnd(); ++it)
+        summary.insert(it.key(), it.value());
+
+    QJsonObject report;
+    report.insert(QLatin1String("production"), productionUrl.toString());
+    report.insert(QLatin1String("update"), updateUrl.toString());
+    report.insert(QLatin1String("summary"), summary);
+    report.insert(QLatin1String("components"), components);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(report).toJson()) < 0
+            || !file.commit()) {
+        emit error(QString::fromLatin1("Cannot write report \"%1\": %2").arg(
+            QDir::toNativeSeparators(fileName), file.errorString()));
+        return false;
+    }
+    if (errorCount)
+        *errorCount = errors;
+    return true;
 }
@@ -29,8 +29,14 @@
 #define REPOSITORYMANAGER_H
 
 #include <QObject>
+#include <QHash>
 #include <QMap>
 #include <QDate>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QUrl>
+#include <QXmlStreamReader>
 #include <QNetworkAccessManager>
 
 struct ComponentDescription {
@@ -38,9 +44,36 @@ struct ComponentDescription {
     QDate releaseDate;
     QString checksum;
     QString updateText;
+    QStringList archives;
+    QMap<QString, QString> archiveErrors; // archive name -> error, empty if verified
     bool update;
 };
 
+typedef QHash<QString, ComponentDescription> ComponentHash;
+
+// Reads the components of an Updates.xml while it is downloaded.
+class RepositoryParser
+{
+public:
+    explicit RepositoryParser(ComponentHash *components);
+
+    void clear();
+    void addData(const QByteArray &data);
+    bool finish(QString *errorString);
+
+private:
+    void readTokens();
+
+    ComponentHash *m_components;
+    QXmlStreamReader m_reader;
+    int m_depth;
+    QString m_text;
+    QString m_currentItem;
+    ComponentDescription m_currentDescription;
+};
+
+struct ArchiveVerification;
+
 class RepositoryManager : public QObject
 {
     Q_OBJECT
@@ -48,26 +81,43 @@ public:
     explicit RepositoryManager(QObject *parent = 0);
 
     bool updateRequired(const QString &componentName, QString *message = 0);
-    QMap<QString, ComponentDescription>* productionComponents() { return &productionMap; }
-    QMap<QString, ComponentDescription>* updateComponents() { return &updateMap; }
+    ComponentHash* productionComponents() { return &productionMap; }
+    ComponentHash* updateComponents() { return &updateMap; }
+    bool writeReport(const QString &fileName, int *errorCount = 0);
+
 signals:
     void repositoriesCompared();
+    void archivesVerified();
+    void error(const QString &message);
 
 public slots:
     void setProductionRepository(const QString &repo);
     void setUpdateRepository(const QString &repo);
-    void writeUpdateFile(const QString &fileName);
+    bool writeUpdateFile(const QString &fileName);
 
     void receiveRepository(QNetworkReply *reply);
 
     void compareRepositories();
+    void verifyArchives();
+
 private:
-    void createRepositoryMap(const QByteArray &data, QMap<QString, ComponentDescription> &map);
+    QNetworkReply *fetchRepository(const QString &repo, QUrl *url);
+    void startVerifications();
+    void finishVerification(const QSharedPointer<ArchiveVerification> &verification);
+
     QNetworkReply *productionReply;
     QNetworkReply *updateReply;
     QNetworkAccessManager *manager;
-    QMap<QString, ComponentDescription> productionMap;
-    QMap<QString, ComponentDescription> updateMap;
+    QUrl productionUrl;
+    QUrl updateUrl;
+    ComponentHash productionMap;
+    ComponentHash updateMap;
+    RepositoryParser productionParser;
+    RepositoryParser updateParser;
+    bool productionLoaded;
+    bool updateLoaded;
+    QQueue<QSharedPointer<ArchiveVerification> > pendingVerifications;
+    int runningVerifications;
 };
 
 #endif // REPOSITORYMANAGER_H
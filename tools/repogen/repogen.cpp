@@ -75,11 +75,31 @@ static void printUsage()
     std::cout << "                            download phase." << std::endl;
 
     std::cout << "  --component-metadata      Creates one metadata 7z per component. " << std::endl;
+    std::cout << "  --delta-updates n         Stamp Updates.xml with a revision and publish delta documents" << std::endl;
+    std::cout << "                            against the previous n revisions, so that clients can fetch" << std::endl;
+    std::cout << "                            only the changed entries." << std::endl;
+    std::cout << "  --entry-hashes            Record the SHA-1 of larger files packaged into new data archives, so" << std::endl;
+    std::cout << "                            that installers can link identical files of different components." << std::endl;
     std::cout << "  --af|--archive-format " << archiveFormats << std::endl;
     std::cout << "                            Set the format used when packaging new component data archives. If" << std::endl;
     std::cout << "                            you omit this option the 7z format will be used as a default." << std::endl;
     std::cout << "  --ac|--compression 0,1,3,5,7,9" << std::endl;
     std::cout << "                            Sets the compression level used when packaging new data archives." << std::endl;
+    std::cout << "  -j|--jobs n               Package up to n components at the same time. The processor cores" << std::endl;
+    std::cout << "                            are shared between the jobs. Defaults to 1." << std::endl;
+    std::cout << "  --compression-threads n   Use n threads to compress a single data archive. Defaults to the" << std::endl;
+    std::cout << "                            share of the processor cores of a job." << std::endl;
+    std::cout << "  --dictionary-size size    Set the dictionary size of new 7z data archives, for example 64m." << std::endl;
+    std::cout << "  --solid-block-size size   Limit the size of a solid block in new 7z data archives, for" << std::endl;
+    std::cout << "                            example 16m. Smaller blocks can be extracted in parallel." << std::endl;
+    std::cout << "  --cache dir               Keep the packaged data of each component in dir and reuse it in" << std::endl;
+    std::cout << "                            later runs, as long as the data and the compression settings of" << std::endl;
+    std::cout << "                            the component did not change." << std::endl;
+    std::cout << "  --chunks                  Additionally store the data archives in content defined chunks, so" << std::endl;
+    std::cout << "                            that installers only download the chunks they do not have yet." << std::endl;
+    std::cout << "  --patches                 When updating components, additionally create patches against the" << std::endl;
+    std::cout << "                            previous version of their data archives, so that installers can" << std::endl;
+    std::cout << "                            update an installed component without downloading its archives." << std::endl;
 
     std::cout << std::endl;
     std::cout << "Example:" << std::endl;
@@ -204,6 +224,28 @@ int main(int argc, char** argv)
             } else if (args.first() == QLatin1String("--component-metadata")) {
                 createUnifiedMetadata = false;
                 args.removeFirst();
+            } else if (args.first() == QLatin1String("--entry-hashes")) {
+                repoInfo.recordEntryHashes = true;
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--chunks")) {
+                repoInfo.chunks = true;
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--patches")) {
+                repoInfo.patches = true;
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--delta-updates")) {
+                args.removeFirst();
+                if (args.isEmpty()) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Delta updates parameter missing argument"));
+                }
+                bool ok = false;
+                repoInfo.deltaRevisions = args.first().toInt(&ok);
+                if (!ok || repoInfo.deltaRevisions < 1) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Invalid number of delta revisions \"%1\".").arg(args.first()));
+                }
+                args.removeFirst();
             } else if (args.first() == QLatin1String("--sha-update") || args.first() == QLatin1String("-s")) {
                 args.removeFirst();
                 packagesUpdatedWithSha = args.first().split(QLatin1Char(','));
@@ -214,8 +256,11 @@ int main(int argc, char** argv)
                     return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
                         "Error: Archive format parameter missing argument"));
                 }
-                // TODO: do we need early check for supported formats?
                 archiveSuffix = args.first();
+                if (!ArchiveFactory::isSupportedType(QLatin1String("archive.") + archiveSuffix)) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Unsupported archive format \"%1\"").arg(archiveSuffix));
+                }
                 args.removeFirst();
             } else if (args.first() == QLatin1String("--ac") || args.first() == QLatin1String("--compression")) {
                 args.removeFirst();
@@ -232,6 +277,66 @@ int main(int argc, char** argv)
                 }
                 compression = static_cast<AbstractArchive::CompressionLevel>(value);
                 args.removeFirst();
+            } else if (args.first() == QLatin1String("--cache")) {
+                args.removeFirst();
+                if (args.isEmpty()) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Cache parameter missing argument"));
+                }
+                repoInfo.cacheDir = QInstallerTools::makePathAbsolute(args.first());
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("-j") || args.first() == QLatin1String("--jobs")) {
+                args.removeFirst();
+                if (args.isEmpty()) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Jobs parameter missing argument"));
+                }
+                bool ok = false;
+                repoInfo.jobs = args.first().toInt(&ok);
+                if (!ok || repoInfo.jobs < 1) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Invalid number of jobs \"%1\".").arg(args.first()));
+                }
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--compression-threads")) {
+                args.removeFirst();
+                if (args.isEmpty()) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Compression threads parameter missing argument"));
+                }
+                bool ok = false;
+                repoInfo.compressionThreads = args.first().toInt(&ok);
+                if (!ok || repoInfo.compressionThreads < 1) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Invalid number of compression threads \"%1\".").arg(args.first()));
+                }
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--dictionary-size")) {
+                args.removeFirst();
+                if (args.isEmpty()) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Dictionary size parameter missing argument"));
+                }
+                bool ok = false;
+                repoInfo.dictionarySize = QInstaller::sizeFromString(args.first(), &ok);
+                if (!ok) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Invalid dictionary size \"%1\".").arg(args.first()));
+                }
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--solid-block-size")) {
+                args.removeFirst();
+                if (args.isEmpty()) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Solid block size parameter missing argument"));
+                }
+                bool ok = false;
+                repoInfo.solidBlockSize = QInstaller::sizeFromString(args.first(), &ok);
+                if (!ok) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Invalid solid block size \"%1\".").arg(args.first()));
+                }
+                args.removeFirst();
             } else {
                 printUsage();
                 return 1;